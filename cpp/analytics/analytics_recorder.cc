@@ -80,7 +80,7 @@ using ::location::nearby::proto::connections::UPGRADED;
 constexpr absl::string_view AnalyticsRecorder::kVersion;
 
 AnalyticsRecorder::AnalyticsRecorder(EventLogger *event_logger)
-    : event_logger_(event_logger) {
+    : event_logger_(event_logger), async_event_logger_(event_logger) {
   started_client_session_time_ = SystemClock::ElapsedRealtime();
   NEARBY_LOGS(INFO) << "AnalyticsRecorder ctor event_logger_=" << event_logger_;
   MutexLock lock(&mutex_);
@@ -95,7 +95,6 @@ AnalyticsRecorder::~AnalyticsRecorder() {
   outgoing_connection_requests_.clear();
   active_connections_.clear();
   bandwidth_upgrade_attempts_.clear();
-  serial_executor_.Shutdown();
 }
 
 void AnalyticsRecorder::OnStartAdvertising(connections::Strategy strategy,
@@ -346,6 +345,27 @@ void AnalyticsRecorder::OnConnectionClosed(const std::string &endpoint_id,
             current_strategy_session_->mutable_established_connection()));
   }
 }
+
+AnalyticsRecorder::ChunkCounter AnalyticsRecorder::GetIncomingChunkCounter(
+    const std::string &endpoint_id, std::int64_t payload_id) {
+  MutexLock lock(&mutex_);
+  auto it = active_connections_.find(endpoint_id);
+  if (it == active_connections_.end()) {
+    return ChunkCounter();
+  }
+  return ChunkCounter(it->second->GetIncomingChunkCounts(payload_id));
+}
+
+AnalyticsRecorder::ChunkCounter AnalyticsRecorder::GetOutgoingChunkCounter(
+    const std::string &endpoint_id, std::int64_t payload_id) {
+  MutexLock lock(&mutex_);
+  auto it = active_connections_.find(endpoint_id);
+  if (it == active_connections_.end()) {
+    return ChunkCounter();
+  }
+  return ChunkCounter(it->second->GetOutgoingChunkCounts(payload_id));
+}
+
 void AnalyticsRecorder::OnIncomingPayloadStarted(
     const std::string &endpoint_id, std::int64_t payload_id,
     connections::Payload::Type type, std::int64_t total_size_bytes) {
@@ -364,17 +384,10 @@ void AnalyticsRecorder::OnIncomingPayloadStarted(
 
 void AnalyticsRecorder::OnPayloadChunkReceived(const std::string &endpoint_id,
                                                std::int64_t payload_id,
-                                               std::int64_t chunk_size_bytes) {
-  MutexLock lock(&mutex_);
-  if (!CanRecordAnalyticsLocked("OnPayloadChunkReceived")) {
-    return;
-  }
-  auto it = active_connections_.find(endpoint_id);
-  if (it == active_connections_.end()) {
-    return;
-  }
-  const std::unique_ptr<LogicalConnection> &logical_connection = it->second;
-  logical_connection->ChunkReceived(payload_id, chunk_size_bytes);
+                                               std::int64_t chunk_size_bytes,
+                                               int num_chunks) {
+  GetIncomingChunkCounter(endpoint_id, payload_id)
+      .Add(chunk_size_bytes, num_chunks);
 }
 
 void AnalyticsRecorder::OnIncomingPayloadDone(const std::string &endpoint_id,
@@ -412,17 +425,10 @@ void AnalyticsRecorder::OnOutgoingPayloadStarted(
 
 void AnalyticsRecorder::OnPayloadChunkSent(const std::string &endpoint_id,
                                            std::int64_t payload_id,
-                                           std::int64_t chunk_size_bytes) {
-  MutexLock lock(&mutex_);
-  if (!CanRecordAnalyticsLocked("OnPayloadChunkSent")) {
-    return;
-  }
-  auto it = active_connections_.find(endpoint_id);
-  if (it == active_connections_.end()) {
-    return;
-  }
-  const std::unique_ptr<LogicalConnection> &logical_connection = it->second;
-  logical_connection->ChunkSent(payload_id, chunk_size_bytes);
+                                           std::int64_t chunk_size_bytes,
+                                           int num_chunks) {
+  GetOutgoingChunkCounter(endpoint_id, payload_id)
+      .Add(chunk_size_bytes, num_chunks);
 }
 
 void AnalyticsRecorder::OnOutgoingPayloadDone(const std::string &endpoint_id,
@@ -527,19 +533,15 @@ void AnalyticsRecorder::OnErrorCode(const ErrorCodeParams& params) {
     }
   }
 
-  serial_executor_.Execute(
-      "analytics-recorder", [this, error_code = error_code.release()]() {
-        ConnectionsLog connections_log;
-        connections_log.set_event_type(ERROR_CODE);
-        connections_log.set_version(kVersion);
-        connections_log.set_allocated_error_code(error_code);
+  ConnectionsLog connections_log;
+  connections_log.set_event_type(ERROR_CODE);
+  connections_log.set_version(kVersion);
+  connections_log.set_allocated_error_code(error_code.release());
 
-        NEARBY_LOGS(VERBOSE)
-            << "AnalyticsRecorder LogErrorCode connections_log="
-            << connections_log.DebugString();
+  NEARBY_LOGS(VERBOSE) << "AnalyticsRecorder LogErrorCode connections_log="
+                       << connections_log.DebugString();
 
-        event_logger_->Log(connections_log);
-      });
+  async_event_logger_.Log(std::move(connections_log));
 }
 
 void AnalyticsRecorder::LogSession() {
@@ -576,32 +578,26 @@ bool AnalyticsRecorder::CanRecordAnalyticsLocked(
 }
 
 void AnalyticsRecorder::LogClientSession() {
-  serial_executor_.Execute(
-      "analytics-recorder", [this]() {
-        ConnectionsLog connections_log;
-        connections_log.set_event_type(CLIENT_SESSION);
-        connections_log.set_allocated_client_session(client_session_.release());
-        connections_log.set_version(kVersion);
-
-        NEARBY_LOGS(VERBOSE)
-            << "AnalyticsRecorder LogClientSession connections_log="
-            << connections_log.DebugString();
-
-        event_logger_->Log(connections_log);
-      });
+  ConnectionsLog connections_log;
+  connections_log.set_event_type(CLIENT_SESSION);
+  connections_log.set_allocated_client_session(client_session_.release());
+  connections_log.set_version(kVersion);
+
+  NEARBY_LOGS(VERBOSE) << "AnalyticsRecorder LogClientSession connections_log="
+                       << connections_log.DebugString();
+
+  async_event_logger_.Log(std::move(connections_log));
 }
 
 void AnalyticsRecorder::LogEvent(EventType event_type) {
-  serial_executor_.Execute("analytics-recorder", [this, event_type]() {
-    ConnectionsLog connections_log;
-    connections_log.set_event_type(event_type);
-    connections_log.set_version(kVersion);
+  ConnectionsLog connections_log;
+  connections_log.set_event_type(event_type);
+  connections_log.set_version(kVersion);
 
-    NEARBY_LOGS(VERBOSE) << "AnalyticsRecorder LogEvent connections_log="
-                         << connections_log.DebugString();
+  NEARBY_LOGS(VERBOSE) << "AnalyticsRecorder LogEvent connections_log="
+                       << connections_log.DebugString();
 
-    event_logger_->Log(connections_log);
-  });
+  async_event_logger_.Log(std::move(connections_log));
 }
 
 void AnalyticsRecorder::UpdateStrategySessionLocked(
@@ -873,10 +869,11 @@ PayloadType AnalyticsRecorder::PayloadTypeToProtoPayloadType(
   }
 }
 
-void AnalyticsRecorder::PendingPayload::AddChunk(
-    std::int64_t chunk_size_bytes) {
-  num_bytes_transferred_ += chunk_size_bytes;
-  num_chunks_++;
+void AnalyticsRecorder::ChunkCounter::Add(std::int64_t chunk_size_bytes,
+                                         int num_chunks) const {
+  if (counts_ == nullptr) return;
+  counts_->num_bytes.fetch_add(chunk_size_bytes, std::memory_order_relaxed);
+  counts_->num_chunks.fetch_add(num_chunks, std::memory_order_relaxed);
 }
 
 ConnectionsLog::Payload AnalyticsRecorder::PendingPayload::GetProtoPayload(
@@ -886,8 +883,9 @@ ConnectionsLog::Payload AnalyticsRecorder::PendingPayload::GetProtoPayload(
       absl::ToInt64Milliseconds(SystemClock::ElapsedRealtime() - start_time_));
   payload.set_type(type_);
   payload.set_total_size_bytes(total_size_bytes_);
-  payload.set_num_bytes_transferred(num_bytes_transferred_);
-  payload.set_num_chunks(num_chunks_);
+  payload.set_num_bytes_transferred(counts_->num_bytes.load() -
+                                    start_num_bytes_);
+  payload.set_num_chunks(counts_->num_chunks.load() - start_num_chunks_);
   payload.set_status(status);
 
   return payload;
@@ -983,17 +981,9 @@ AnalyticsRecorder::LogicalConnection::GetEstablisedConnections() {
 void AnalyticsRecorder::LogicalConnection::IncomingPayloadStarted(
     std::int64_t payload_id, PayloadType type, std::int64_t total_size_bytes) {
   incoming_payloads_.insert(
-      {payload_id, absl::make_unique<PendingPayload>(type, total_size_bytes)});
-}
-
-void AnalyticsRecorder::LogicalConnection::ChunkReceived(
-    std::int64_t payload_id, std::int64_t size_bytes) {
-  auto it = incoming_payloads_.find(payload_id);
-  if (it == incoming_payloads_.end()) {
-    return;
-  }
-  PendingPayload *pending_payload = it->second.get();
-  pending_payload->AddChunk(size_bytes);
+      {payload_id, absl::make_unique<PendingPayload>(
+                       type, total_size_bytes,
+                       std::make_shared<ChunkCounts>())});
 }
 
 void AnalyticsRecorder::LogicalConnection::IncomingPayloadDone(
@@ -1019,17 +1009,9 @@ void AnalyticsRecorder::LogicalConnection::IncomingPayloadDone(
 void AnalyticsRecorder::LogicalConnection::OutgoingPayloadStarted(
     std::int64_t payload_id, PayloadType type, std::int64_t total_size_bytes) {
   outgoing_payloads_.insert(
-      {payload_id, absl::make_unique<PendingPayload>(type, total_size_bytes)});
-}
-
-void AnalyticsRecorder::LogicalConnection::ChunkSent(std::int64_t payload_id,
-                                                     std::int64_t size_bytes) {
-  auto it = outgoing_payloads_.find(payload_id);
-  if (it == outgoing_payloads_.end()) {
-    return;
-  }
-  PendingPayload *payload = it->second.get();
-  payload->AddChunk(size_bytes);
+      {payload_id, absl::make_unique<PendingPayload>(
+                       type, total_size_bytes,
+                       std::make_shared<ChunkCounts>())});
 }
 
 void AnalyticsRecorder::LogicalConnection::OutgoingPayloadDone(
@@ -1052,6 +1034,26 @@ void AnalyticsRecorder::LogicalConnection::OutgoingPayloadDone(
   }
 }
 
+std::shared_ptr<AnalyticsRecorder::ChunkCounts>
+AnalyticsRecorder::LogicalConnection::GetIncomingChunkCounts(
+    std::int64_t payload_id) const {
+  auto it = incoming_payloads_.find(payload_id);
+  if (it == incoming_payloads_.end()) {
+    return nullptr;
+  }
+  return it->second->counts();
+}
+
+std::shared_ptr<AnalyticsRecorder::ChunkCounts>
+AnalyticsRecorder::LogicalConnection::GetOutgoingChunkCounts(
+    std::int64_t payload_id) const {
+  auto it = outgoing_payloads_.find(payload_id);
+  if (it == outgoing_payloads_.end()) {
+    return nullptr;
+  }
+  return it->second->counts();
+}
+
 void AnalyticsRecorder::LogicalConnection::FinishPhysicalConnection(
     ConnectionsLog::EstablishedConnection *established_connection,
     DisconnectionReason reason) {
@@ -1090,9 +1092,10 @@ AnalyticsRecorder::LogicalConnection::ResolvePendingPayloads(
     completed_payloads.push_back(proto_payload);
     if (reason == UPGRADED) {
       upgraded_payloads.insert(
-          {item.first,
-           absl::make_unique<PendingPayload>(
-               pending_payload->type(), pending_payload->total_size_bytes())});
+          {item.first, absl::make_unique<PendingPayload>(
+                           pending_payload->type(),
+                           pending_payload->total_size_bytes(),
+                           pending_payload->counts())});
     }
   }
   pending_payloads.clear();
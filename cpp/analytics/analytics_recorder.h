@@ -15,16 +15,19 @@
 #ifndef ANALYTICS_ANALYTICS_RECORDER_H_
 #define ANALYTICS_ANALYTICS_RECORDER_H_
 
+#include <atomic>
+#include <memory>
 #include <string>
 
 #include "absl/container/btree_map.h"
+#include "absl/strings/string_view.h"
 #include "absl/time/time.h"
+#include "third_party/nearby_connections/cpp/analytics/async_event_logger.h"
 #include "core/event_logger.h"
 #include "core/payload.h"
 #include "core/strategy.h"
 #include "platform/base/error_code_params.h"
 #include "platform/public/mutex.h"
-#include "platform/public/single_thread_executor.h"
 #include "proto/analytics/connections_log.proto.h"
 #include "proto/connections_enums.proto.h"
 
@@ -33,6 +36,8 @@ namespace nearby {
 namespace analytics {
 
 class AnalyticsRecorder {
+  struct ChunkCounts;
+
  public:
   static constexpr absl::string_view kVersion = "v1.0.0";
 
@@ -96,15 +101,49 @@ class AnalyticsRecorder {
       ABSL_LOCKS_EXCLUDED(mutex_);
 
   // Payload
+  // Counts the chunks of a pending Payload to or from one endpoint, without
+  // taking |mutex_| or looking the Payload up. The counts are reported when
+  // the Payload is done, or when its connection closes. Chunks counted after
+  // that are dropped. A default ChunkCounter counts nothing.
+  class ChunkCounter {
+   public:
+    ChunkCounter() = default;
+
+    // |chunk_size_bytes| is the total size of |num_chunks| chunks.
+    void Add(std::int64_t chunk_size_bytes, int num_chunks = 1) const;
+
+    // Returns false if the Payload was not pending when this was made.
+    bool IsValid() const { return counts_ != nullptr; }
+
+   private:
+    friend class AnalyticsRecorder;
+    explicit ChunkCounter(std::shared_ptr<ChunkCounts> counts)
+        : counts_(std::move(counts)) {}
+
+    std::shared_ptr<ChunkCounts> counts_;
+  };
+
+  // Returns the ChunkCounter of |payload_id| from or to |endpoint_id|, or a
+  // default one if that Payload is not pending. OnPayloadChunkReceived() and
+  // OnPayloadChunkSent() do the same lookup for every call.
+  ChunkCounter GetIncomingChunkCounter(const std::string &endpoint_id,
+                                       std::int64_t payload_id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  ChunkCounter GetOutgoingChunkCounter(const std::string &endpoint_id,
+                                       std::int64_t payload_id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
   void OnIncomingPayloadStarted(const std::string &endpoint_id,
                                 std::int64_t payload_id,
                                 connections::Payload::Type type,
                                 std::int64_t total_size_bytes)
       ABSL_LOCKS_EXCLUDED(mutex_);
+  // |chunk_size_bytes| is the total size of |num_chunks| chunks, when
+  // several are recorded at once.
   void OnPayloadChunkReceived(const std::string &endpoint_id,
                               std::int64_t payload_id,
-                              std::int64_t chunk_size_bytes)
-      ABSL_LOCKS_EXCLUDED(mutex_);
+                              std::int64_t chunk_size_bytes,
+                              int num_chunks = 1) ABSL_LOCKS_EXCLUDED(mutex_);
   void OnIncomingPayloadDone(
       const std::string &endpoint_id, std::int64_t payload_id,
       location::nearby::proto::connections::PayloadStatus status)
@@ -116,7 +155,7 @@ class AnalyticsRecorder {
       ABSL_LOCKS_EXCLUDED(mutex_);
   void OnPayloadChunkSent(const std::string &endpoint_id,
                           std::int64_t payload_id,
-                          std::int64_t chunk_size_bytes)
+                          std::int64_t chunk_size_bytes, int num_chunks = 1)
       ABSL_LOCKS_EXCLUDED(mutex_);
   void OnOutgoingPayloadDone(
       const std::string &endpoint_id, std::int64_t payload_id,
@@ -142,26 +181,34 @@ class AnalyticsRecorder {
   // Error Code
   void OnErrorCode(const ErrorCodeParams &params);
 
-  // Invokes event_logger_.Log() at the end of life of client. Log action is
-  // called in a separate thread to allow synchronous potentially lengthy
-  // execution.
+  // Logs the client session to event_logger_, at the end of life of client.
+  // Like all other records, it is delivered by |async_event_logger_|, on a
+  // thread of its own, to allow synchronous potentially lengthy execution.
   void LogSession() ABSL_LOCKS_EXCLUDED(mutex_);
 
  private:
+  // The bytes and chunks transferred of a Payload, updated by ChunkCounter.
+  struct ChunkCounts {
+    std::atomic<std::int64_t> num_bytes{0};
+    std::atomic<int> num_chunks{0};
+  };
+
   // Tracks the chunks and duration of a Payload on a particular medium.
   class PendingPayload {
    public:
+    // Only the chunks counted in |counts| from now on are reported: a
+    // Payload keeps its counts when it moves to a new medium.
     PendingPayload(location::nearby::proto::connections::PayloadType type,
-                   std::int64_t total_size_bytes)
+                   std::int64_t total_size_bytes,
+                   std::shared_ptr<ChunkCounts> counts)
         : start_time_(SystemClock::ElapsedRealtime()),
           type_(type),
           total_size_bytes_(total_size_bytes),
-          num_bytes_transferred_(0),
-          num_chunks_(0) {}
+          counts_(std::move(counts)),
+          start_num_bytes_(counts_->num_bytes.load()),
+          start_num_chunks_(counts_->num_chunks.load()) {}
     ~PendingPayload() = default;
 
-    void AddChunk(std::int64_t chunk_size_bytes);
-
     proto::ConnectionsLog::Payload GetProtoPayload(
         location::nearby::proto::connections::PayloadStatus status);
 
@@ -171,12 +218,15 @@ class AnalyticsRecorder {
 
     std::int64_t total_size_bytes() const { return total_size_bytes_; }
 
+    const std::shared_ptr<ChunkCounts> &counts() const { return counts_; }
+
    private:
     absl::Time start_time_;
     location::nearby::proto::connections::PayloadType type_;
     std::int64_t total_size_bytes_;
-    std::int64_t num_bytes_transferred_;
-    int num_chunks_;
+    std::shared_ptr<ChunkCounts> counts_;
+    std::int64_t start_num_bytes_;
+    int start_num_chunks_;
   };
 
   class LogicalConnection {
@@ -208,7 +258,6 @@ class AnalyticsRecorder {
         std::int64_t payload_id,
         location::nearby::proto::connections::PayloadType type,
         std::int64_t total_size_bytes);
-    void ChunkReceived(std::int64_t payload_id, std::int64_t size_bytes);
     void IncomingPayloadDone(
         std::int64_t payload_id,
         location::nearby::proto::connections::PayloadStatus status);
@@ -216,11 +265,16 @@ class AnalyticsRecorder {
         std::int64_t payload_id,
         location::nearby::proto::connections::PayloadType type,
         std::int64_t total_size_bytes);
-    void ChunkSent(std::int64_t payload_id, std::int64_t size_bytes);
     void OutgoingPayloadDone(
         std::int64_t payload_id,
         location::nearby::proto::connections::PayloadStatus status);
 
+    // Returns nullptr if the Payload is not pending.
+    std::shared_ptr<ChunkCounts> GetIncomingChunkCounts(
+        std::int64_t payload_id) const;
+    std::shared_ptr<ChunkCounts> GetOutgoingChunkCounts(
+        std::int64_t payload_id) const;
+
     std::vector<proto::ConnectionsLog::EstablishedConnection>
     GetEstablisedConnections();
 
@@ -301,7 +355,9 @@ class AnalyticsRecorder {
   // that outlives the one constructed.
   EventLogger *event_logger_;
 
-  SingleThreadExecutor serial_executor_;
+  // Delivers the records to |event_logger_|, so that logging never waits for
+  // it.
+  AsyncEventLogger async_event_logger_;
   // Protects all sub-protos reading and writing in ConnectionLog.
   Mutex mutex_;
 
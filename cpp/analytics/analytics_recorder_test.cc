@@ -24,6 +24,7 @@
 #include "platform/base/error_code_recorder.h"
 #include "platform/public/count_down_latch.h"
 #include "platform/public/logging.h"
+#include "platform/public/multi_thread_executor.h"
 #include "proto/analytics/connections_log.proto.h"
 #include "proto/connections_enums.proto.h"
 
@@ -617,6 +618,78 @@ TEST(AnalyticsRecorderTest, OutgoingPayloadUpgraded) {
                 >)pb")));
 }
 
+TEST(AnalyticsRecorderTest, ConcurrentPayloadChunksCounted) {
+  connections::Strategy strategy = connections::Strategy::kP2pStar;
+  std::vector<Medium> mediums = {BLUETOOTH};
+  std::vector<std::string> endpoint_ids = {"endpoint_a", "endpoint_b"};
+  std::int64_t payload_id = 123456789;
+  std::string connection_token = "connection_token";
+  constexpr int kChunksPerThread = 1000;
+
+  CountDownLatch client_session_done_latch(1);
+  FakeEventLogger event_logger(client_session_done_latch);
+  AnalyticsRecorder analytics_recorder(&event_logger);
+
+  analytics_recorder.OnStartAdvertising(strategy, mediums);
+  for (const auto& endpoint_id : endpoint_ids) {
+    analytics_recorder.OnConnectionEstablished(endpoint_id, BLUETOOTH,
+                                               connection_token);
+  }
+  analytics_recorder.OnOutgoingPayloadStarted(
+      endpoint_ids, payload_id, connections::Payload::Type::kBytes,
+      4 * kChunksPerThread);
+  {
+    // Two threads per endpoint, one with a ChunkCounter of its own.
+    MultiThreadExecutor executor(4);
+    for (int i = 0; i < 4; i++) {
+      executor.Execute([&analytics_recorder, &endpoint_ids, payload_id, i]() {
+        const std::string& endpoint_id = endpoint_ids[i % 2];
+        if (i < 2) {
+          AnalyticsRecorder::ChunkCounter counter =
+              analytics_recorder.GetOutgoingChunkCounter(endpoint_id,
+                                                         payload_id);
+          EXPECT_TRUE(counter.IsValid());
+          for (int chunk = 0; chunk < kChunksPerThread; chunk++) {
+            counter.Add(1);
+          }
+        } else {
+          for (int chunk = 0; chunk < kChunksPerThread; chunk++) {
+            analytics_recorder.OnPayloadChunkSent(endpoint_id, payload_id, 1);
+          }
+        }
+      });
+    }
+  }
+  for (const auto& endpoint_id : endpoint_ids) {
+    AnalyticsRecorder::ChunkCounter counter =
+        analytics_recorder.GetOutgoingChunkCounter(endpoint_id, payload_id);
+    analytics_recorder.OnOutgoingPayloadDone(endpoint_id, payload_id, SUCCESS);
+    // Chunks of a Payload that is done are not counted.
+    counter.Add(1);
+    analytics_recorder.OnPayloadChunkSent(endpoint_id, payload_id, 1);
+    EXPECT_FALSE(analytics_recorder.GetOutgoingChunkCounter(endpoint_id,
+                                                            payload_id)
+                     .IsValid());
+    analytics_recorder.OnConnectionClosed(endpoint_id, BLUETOOTH,
+                                          LOCAL_DISCONNECTION);
+  }
+
+  analytics_recorder.LogSession();
+  ASSERT_TRUE(client_session_done_latch.Await(kDefaultTimeout).result());
+
+  const auto& strategy_session =
+      event_logger.GetLoggedClientSession().strategy_session(0);
+  ASSERT_EQ(strategy_session.established_connection_size(), 2);
+  for (const auto& established_connection :
+       strategy_session.established_connection()) {
+    ASSERT_EQ(established_connection.sent_payload_size(), 1);
+    EXPECT_EQ(established_connection.sent_payload(0).num_bytes_transferred(),
+              2 * kChunksPerThread);
+    EXPECT_EQ(established_connection.sent_payload(0).num_chunks(),
+              2 * kChunksPerThread);
+  }
+}
+
 TEST(AnalyticsRecorderTest, UpgradeAttemptWorks) {
   connections::Strategy strategy = connections::Strategy::kP2pStar;
   std::vector<Medium> mediums = {BLE, BLUETOOTH};
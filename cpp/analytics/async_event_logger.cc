@@ -0,0 +1,130 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "third_party/nearby_connections/cpp/analytics/async_event_logger.h"
+
+#include <utility>
+
+#include "absl/algorithm/container.h"
+#include "platform/public/count_down_latch.h"
+#include "platform/public/logging.h"
+#include "platform/public/mutex_lock.h"
+#include "proto/connections_enums.proto.h"
+
+namespace location {
+namespace nearby {
+namespace analytics {
+
+using ::location::nearby::analytics::proto::ConnectionsLog;
+
+namespace {
+
+bool IsSessionRecord(const ConnectionsLog& connections_log) {
+  switch (connections_log.event_type()) {
+    case location::nearby::proto::connections::CLIENT_SESSION:
+    case location::nearby::proto::connections::START_CLIENT_SESSION:
+    case location::nearby::proto::connections::STOP_CLIENT_SESSION:
+    case location::nearby::proto::connections::START_STRATEGY_SESSION:
+    case location::nearby::proto::connections::STOP_STRATEGY_SESSION:
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+AsyncEventLogger::AsyncEventLogger(EventLogger* event_logger, Options options)
+    : event_logger_(event_logger), options_(std::move(options)) {}
+
+AsyncEventLogger::~AsyncEventLogger() {
+  Flush();
+  executor_.Shutdown();
+}
+
+void AsyncEventLogger::Log(const ConnectionsLog& connections_log) {
+  Log(ConnectionsLog(connections_log));
+}
+
+void AsyncEventLogger::Log(ConnectionsLog&& connections_log) {
+  MutexLock lock(&mutex_);
+  if (static_cast<int>(queue_.size()) >= options_.max_queue_size &&
+      !MakeRoomLocked(connections_log)) {
+    return;
+  }
+  queue_.push_back(std::move(connections_log));
+  if (!delivering_) {
+    delivering_ = true;
+    executor_.Execute("async-event-logger", [this]() { DeliverQueued(); });
+  }
+}
+
+void AsyncEventLogger::Flush() {
+  // DeliverQueued() tasks run in order, so once this one runs, all records
+  // queued before it have been delivered.
+  CountDownLatch latch(1);
+  executor_.Execute("async-event-logger-flush",
+                    [&latch]() { latch.CountDown(); });
+  latch.Await();
+}
+
+int AsyncEventLogger::GetDroppedCount() const {
+  MutexLock lock(&mutex_);
+  return dropped_count_;
+}
+
+bool AsyncEventLogger::MakeRoomLocked(const ConnectionsLog& connections_log) {
+  bool is_session_record = IsSessionRecord(connections_log);
+  auto oldest = queue_.end();
+  if (is_session_record ||
+      options_.overflow_policy == OverflowPolicy::kDropOldest) {
+    oldest = absl::c_find_if(queue_, [](const ConnectionsLog& queued) {
+      return !IsSessionRecord(queued);
+    });
+  }
+  // Only session records are queued: go over the bound for another one.
+  if (is_session_record && oldest == queue_.end()) return true;
+
+  if (dropped_count_++ == 0) {
+    NEARBY_LOGS(WARNING) << "AsyncEventLogger queue is full; dropping "
+                            "records until the EventLogger catches up.";
+  }
+  if (oldest == queue_.end()) return false;
+  queue_.erase(oldest);
+  return true;
+}
+
+void AsyncEventLogger::DeliverQueued() {
+  std::vector<ConnectionsLog> batch;
+  while (true) {
+    {
+      MutexLock lock(&mutex_);
+      if (queue_.empty()) {
+        delivering_ = false;
+        return;
+      }
+      while (!queue_.empty() &&
+             static_cast<int>(batch.size()) < options_.max_batch_size) {
+        batch.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+      }
+    }
+    event_logger_->LogBatch(batch);
+    batch.clear();
+  }
+}
+
+}  // namespace analytics
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,96 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ANALYTICS_ASYNC_EVENT_LOGGER_H_
+#define ANALYTICS_ASYNC_EVENT_LOGGER_H_
+
+#include <deque>
+#include <vector>
+
+#include "core/event_logger.h"
+#include "platform/public/mutex.h"
+#include "platform/public/single_thread_executor.h"
+#include "proto/analytics/connections_log.proto.h"
+
+namespace location {
+namespace nearby {
+namespace analytics {
+
+// An EventLogger that queues |ConnectionsLog|s and delivers them to another
+// EventLogger on a worker thread of its own, in batches. Log() never waits
+// for the other EventLogger, so a slow metrics sink adds no latency to the
+// flows that log.
+//
+// The queue is bounded: once it is full, records are dropped according to
+// OverflowPolicy. Session records (the start, stop and log of client and
+// strategy sessions) are never dropped: they take the place of the oldest
+// other record, or go over the bound if there is none. Records still queued
+// are delivered before destruction.
+class AsyncEventLogger : public EventLogger {
+ public:
+  enum class OverflowPolicy {
+    // Drops the oldest queued record to make room for the new one.
+    kDropOldest,
+    // Drops the new record, unless it is a session record.
+    kDropNewest,
+  };
+
+  struct Options {
+    int max_queue_size = 256;
+    int max_batch_size = 32;
+    OverflowPolicy overflow_policy = OverflowPolicy::kDropOldest;
+  };
+
+  // |event_logger| is not owned, and must outlive this.
+  explicit AsyncEventLogger(EventLogger* event_logger)
+      : AsyncEventLogger(event_logger, Options()) {}
+  AsyncEventLogger(EventLogger* event_logger, Options options);
+  ~AsyncEventLogger() override;
+
+  // Queues |connections_log| for delivery.
+  void Log(const proto::ConnectionsLog& connections_log) override
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  void Log(proto::ConnectionsLog&& connections_log) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Blocks until the records queued so far have been delivered.
+  void Flush();
+
+  // Returns how many records were dropped because the queue was full.
+  int GetDroppedCount() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  // Called when the queue is full, before |connections_log| is queued. Drops
+  // a record, and returns false if that is |connections_log|.
+  bool MakeRoomLocked(const proto::ConnectionsLog& connections_log)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Delivers batches until the queue is empty.
+  void DeliverQueued() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  EventLogger* event_logger_;
+  const Options options_;
+
+  mutable Mutex mutex_;
+  std::deque<proto::ConnectionsLog> queue_ ABSL_GUARDED_BY(mutex_);
+  // Whether a DeliverQueued() task is pending or running.
+  bool delivering_ ABSL_GUARDED_BY(mutex_) = false;
+  int dropped_count_ ABSL_GUARDED_BY(mutex_) = 0;
+
+  SingleThreadExecutor executor_;
+};
+
+}  // namespace analytics
+}  // namespace nearby
+}  // namespace location
+
+#endif  // ANALYTICS_ASYNC_EVENT_LOGGER_H_
@@ -0,0 +1,226 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "third_party/nearby_connections/cpp/analytics/async_event_logger.h"
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "platform/public/count_down_latch.h"
+#include "platform/public/mutex.h"
+#include "platform/public/mutex_lock.h"
+#include "proto/analytics/connections_log.proto.h"
+#include "proto/connections_enums.proto.h"
+
+namespace location {
+namespace nearby {
+namespace analytics {
+namespace {
+
+using ::location::nearby::analytics::proto::ConnectionsLog;
+using ::location::nearby::proto::connections::EventType;
+using ::testing::ElementsAre;
+
+constexpr absl::Duration kDefaultTimeout = absl::Milliseconds(1000);
+
+// Records the version of each record it gets, which tests use as an id. Once
+// blocked, it waits in LogBatch() until it is unblocked.
+class RecordingEventLogger : public EventLogger {
+ public:
+  void Log(const ConnectionsLog& connections_log) override {
+    MutexLock lock(&mutex_);
+    logged_.push_back(connections_log.version());
+  }
+
+  void LogBatch(const std::vector<ConnectionsLog>& connections_logs) override {
+    batch_started_.CountDown();
+    if (blocked_) unblocked_.Await();
+    {
+      MutexLock lock(&mutex_);
+      batch_sizes_.push_back(connections_logs.size());
+    }
+    EventLogger::LogBatch(connections_logs);
+  }
+
+  void Block() { blocked_ = true; }
+  void Unblock() { unblocked_.CountDown(); }
+  bool WaitForBatch() { return batch_started_.Await(kDefaultTimeout).result(); }
+
+  std::vector<std::string> GetLogged() {
+    MutexLock lock(&mutex_);
+    return logged_;
+  }
+
+  std::vector<int> GetBatchSizes() {
+    MutexLock lock(&mutex_);
+    return batch_sizes_;
+  }
+
+ private:
+  bool blocked_ = false;
+  CountDownLatch batch_started_{1};
+  CountDownLatch unblocked_{1};
+  Mutex mutex_;
+  std::vector<std::string> logged_;
+  std::vector<int> batch_sizes_;
+};
+
+ConnectionsLog MakeRecord(
+    int id,
+    EventType event_type = location::nearby::proto::connections::ERROR_CODE) {
+  ConnectionsLog connections_log;
+  connections_log.set_event_type(event_type);
+  connections_log.set_version(absl::StrCat(id));
+  return connections_log;
+}
+
+TEST(AsyncEventLoggerTest, DeliversInOrder) {
+  RecordingEventLogger event_logger;
+  AsyncEventLogger async_event_logger(&event_logger);
+
+  for (int i = 0; i < 5; i++) {
+    async_event_logger.Log(MakeRecord(i));
+  }
+  async_event_logger.Flush();
+
+  EXPECT_THAT(event_logger.GetLogged(), ElementsAre("0", "1", "2", "3", "4"));
+  EXPECT_EQ(async_event_logger.GetDroppedCount(), 0);
+}
+
+TEST(AsyncEventLoggerTest, LogDoesNotWaitForEventLogger) {
+  RecordingEventLogger event_logger;
+  event_logger.Block();
+  AsyncEventLogger async_event_logger(&event_logger);
+
+  async_event_logger.Log(MakeRecord(0));
+  ASSERT_TRUE(event_logger.WaitForBatch());
+  // The first record is stuck in delivery, and these queue up behind it.
+  async_event_logger.Log(MakeRecord(1));
+  async_event_logger.Log(MakeRecord(2));
+  EXPECT_TRUE(event_logger.GetLogged().empty());
+
+  event_logger.Unblock();
+  async_event_logger.Flush();
+  EXPECT_THAT(event_logger.GetLogged(), ElementsAre("0", "1", "2"));
+}
+
+TEST(AsyncEventLoggerTest, DeliversInBatches) {
+  RecordingEventLogger event_logger;
+  event_logger.Block();
+  AsyncEventLogger async_event_logger(&event_logger,
+                                      {.max_batch_size = 2});
+
+  async_event_logger.Log(MakeRecord(0));
+  ASSERT_TRUE(event_logger.WaitForBatch());
+  for (int i = 1; i < 6; i++) {
+    async_event_logger.Log(MakeRecord(i));
+  }
+  event_logger.Unblock();
+  async_event_logger.Flush();
+
+  EXPECT_THAT(event_logger.GetBatchSizes(), ElementsAre(1, 2, 2, 1));
+  EXPECT_THAT(event_logger.GetLogged(),
+              ElementsAre("0", "1", "2", "3", "4", "5"));
+}
+
+TEST(AsyncEventLoggerTest, DropsOldestWhenFull) {
+  RecordingEventLogger event_logger;
+  event_logger.Block();
+  AsyncEventLogger async_event_logger(
+      &event_logger,
+      {.max_queue_size = 2,
+       .overflow_policy = AsyncEventLogger::OverflowPolicy::kDropOldest});
+
+  async_event_logger.Log(MakeRecord(0));
+  ASSERT_TRUE(event_logger.WaitForBatch());
+  for (int i = 1; i < 5; i++) {
+    async_event_logger.Log(MakeRecord(i));
+  }
+  event_logger.Unblock();
+  async_event_logger.Flush();
+
+  EXPECT_THAT(event_logger.GetLogged(), ElementsAre("0", "3", "4"));
+  EXPECT_EQ(async_event_logger.GetDroppedCount(), 2);
+}
+
+TEST(AsyncEventLoggerTest, DropsNewestWhenFull) {
+  RecordingEventLogger event_logger;
+  event_logger.Block();
+  AsyncEventLogger async_event_logger(
+      &event_logger,
+      {.max_queue_size = 2,
+       .overflow_policy = AsyncEventLogger::OverflowPolicy::kDropNewest});
+
+  async_event_logger.Log(MakeRecord(0));
+  ASSERT_TRUE(event_logger.WaitForBatch());
+  for (int i = 1; i < 5; i++) {
+    async_event_logger.Log(MakeRecord(i));
+  }
+  event_logger.Unblock();
+  async_event_logger.Flush();
+
+  EXPECT_THAT(event_logger.GetLogged(), ElementsAre("0", "1", "2"));
+  EXPECT_EQ(async_event_logger.GetDroppedCount(), 2);
+}
+
+TEST(AsyncEventLoggerTest, NeverDropsSessionRecords) {
+  for (auto overflow_policy : {AsyncEventLogger::OverflowPolicy::kDropOldest,
+                               AsyncEventLogger::OverflowPolicy::kDropNewest}) {
+    RecordingEventLogger event_logger;
+    event_logger.Block();
+    AsyncEventLogger async_event_logger(
+        &event_logger,
+        {.max_queue_size = 2, .overflow_policy = overflow_policy});
+
+    async_event_logger.Log(MakeRecord(0));
+    ASSERT_TRUE(event_logger.WaitForBatch());
+    async_event_logger.Log(
+        MakeRecord(1, location::nearby::proto::connections::CLIENT_SESSION));
+    async_event_logger.Log(MakeRecord(2));
+    // Takes the place of record 2.
+    async_event_logger.Log(MakeRecord(
+        3, location::nearby::proto::connections::STOP_CLIENT_SESSION));
+    // Dropped: only session records are queued.
+    async_event_logger.Log(MakeRecord(4));
+    // Goes over the bound.
+    async_event_logger.Log(MakeRecord(
+        5, location::nearby::proto::connections::START_CLIENT_SESSION));
+    event_logger.Unblock();
+    async_event_logger.Flush();
+
+    EXPECT_THAT(event_logger.GetLogged(), ElementsAre("0", "1", "3", "5"));
+    EXPECT_EQ(async_event_logger.GetDroppedCount(), 2);
+  }
+}
+
+TEST(AsyncEventLoggerTest, DeliversQueuedOnDestruction) {
+  RecordingEventLogger event_logger;
+  {
+    AsyncEventLogger async_event_logger(&event_logger);
+    for (int i = 0; i < 3; i++) {
+      async_event_logger.Log(MakeRecord(i));
+    }
+  }
+
+  EXPECT_THAT(event_logger.GetLogged(), ElementsAre("0", "1", "2"));
+}
+
+}  // namespace
+}  // namespace analytics
+}  // namespace nearby
+}  // namespace location
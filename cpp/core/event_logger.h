@@ -15,6 +15,8 @@
 #ifndef CORE_EVENT_LOGGER_H_
 #define CORE_EVENT_LOGGER_H_
 
+#include <vector>
+
 #include "proto/analytics/connections_log.proto.h"
 
 namespace location {
@@ -30,6 +32,15 @@ class EventLogger {
   // Logs |ConnectionsLog| details. Might block to do I/O, e.g. upload
   // synchronously to some metrics server.
   virtual void Log(const proto::ConnectionsLog& connections_log) = 0;
+
+  // Logs several |ConnectionsLog|s, in order. Loggers that upload can
+  // override this to send them together.
+  virtual void LogBatch(
+      const std::vector<proto::ConnectionsLog>& connections_logs) {
+    for (const auto& connections_log : connections_logs) {
+      Log(connections_log);
+    }
+  }
 };
 
 }  // namespace analytics
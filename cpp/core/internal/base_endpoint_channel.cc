@@ -14,10 +14,15 @@
 
 #include "core/internal/base_endpoint_channel.h"
 
+#include <algorithm>
 #include <cassert>
+#include <string>
+#include <vector>
 
 #include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "core/internal/offline_frames.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/exception.h"
@@ -30,11 +35,11 @@ namespace location {
 namespace nearby {
 namespace connections {
 
-namespace {
+constexpr absl::Duration BaseEndpointChannel::kTargetWriteDuration;
 
-std::int32_t BytesToInt(const ByteArray& bytes) {
-  const char* int_bytes = bytes.data();
+namespace {
 
+std::int32_t BytesToInt(const char* int_bytes) {
   std::int32_t result = 0;
   result |= (static_cast<std::int32_t>(int_bytes[0]) & 0x0FF) << 24;
   result |= (static_cast<std::int32_t>(int_bytes[1]) & 0x0FF) << 16;
@@ -44,49 +49,42 @@ std::int32_t BytesToInt(const ByteArray& bytes) {
   return result;
 }
 
-ByteArray IntToBytes(std::int32_t value) {
-  char int_bytes[sizeof(std::int32_t)];
+void IntToBytes(std::int32_t value, char* int_bytes) {
   int_bytes[0] = static_cast<char>((value >> 24) & 0x0FF);
   int_bytes[1] = static_cast<char>((value >> 16) & 0x0FF);
   int_bytes[2] = static_cast<char>((value >> 8) & 0x0FF);
   int_bytes[3] = static_cast<char>((value)&0x0FF);
-
-  return ByteArray(int_bytes, sizeof(int_bytes));
 }
 
-ExceptionOr<ByteArray> ReadExactly(InputStream* reader, std::int64_t size) {
-  ByteArray buffer(size);
-  std::int64_t current_pos = 0;
+// Fills the whole of |buffer| with bytes read from |reader|.
+Exception ReadExactly(InputStream* reader, absl::Span<char> buffer) {
+  size_t current_pos = 0;
 
-  while (current_pos < size) {
-    ExceptionOr<ByteArray> read_bytes = reader->Read(size - current_pos);
-    if (!read_bytes.ok()) {
-      return read_bytes;
+  while (current_pos < buffer.size()) {
+    ExceptionOr<size_t> read_size =
+        reader->ReadInto(buffer.subspan(current_pos));
+    if (!read_size.ok()) {
+      return read_size.GetException();
     }
-    ByteArray result = read_bytes.result();
 
-    if (result.Empty()) {
+    if (read_size.result() == 0) {
       NEARBY_LOGS(WARNING) << __func__ << ": Empty result when reading bytes.";
-      return ExceptionOr<ByteArray>(Exception::kIo);
+      return {Exception::kIo};
     }
 
-    buffer.CopyAt(current_pos, result);
-    current_pos += result.size();
+    current_pos += read_size.result();
   }
 
-  return ExceptionOr<ByteArray>(std::move(buffer));
+  return {Exception::kSuccess};
 }
 
 ExceptionOr<std::int32_t> ReadInt(InputStream* reader) {
-  ExceptionOr<ByteArray> read_bytes = ReadExactly(reader, sizeof(std::int32_t));
-  if (!read_bytes.ok()) {
-    return ExceptionOr<std::int32_t>(read_bytes.exception());
+  char int_bytes[sizeof(std::int32_t)];
+  Exception read_exception = ReadExactly(reader, absl::MakeSpan(int_bytes));
+  if (read_exception.Raised()) {
+    return ExceptionOr<std::int32_t>(read_exception);
   }
-  return ExceptionOr<std::int32_t>(BytesToInt(std::move(read_bytes.result())));
-}
-
-Exception WriteInt(OutputStream* writer, std::int32_t value) {
-  return writer->Write(IntToBytes(value));
+  return ExceptionOr<std::int32_t>(BytesToInt(int_bytes));
 }
 
 }  // namespace
@@ -112,22 +110,23 @@ ExceptionOr<ByteArray> BaseEndpointChannel::Read() {
       return ExceptionOr<ByteArray>(Exception::kIo);
     }
 
-    ExceptionOr<ByteArray> read_bytes = ReadExactly(reader_, read_int.result());
-    if (!read_bytes.ok()) {
-      return read_bytes;
+    // The frame is read straight into its final buffer.
+    result = ByteArray(static_cast<size_t>(read_int.result()));
+    Exception read_exception =
+        ReadExactly(reader_, absl::MakeSpan(result.data(), result.size()));
+    if (read_exception.Raised()) {
+      return ExceptionOr<ByteArray>(read_exception);
     }
-    result = std::move(read_bytes.result());
-  }
 
-  {
-    MutexLock crypto_lock(&crypto_mutex_);
-    if (IsEncryptionEnabledLocked()) {
+    // Frames are decrypted in the order they are read, under the reader
+    // lock; the writer is not held up meanwhile.
+    std::shared_ptr<FrameCipher> cipher = GetCipher();
+    if (cipher) {
       // If encryption is enabled, decode the message.
       std::string input(std::move(result));
-      std::unique_ptr<std::string> decrypted_data =
-          crypto_context_->DecodeMessageFromPeer(input);
-      if (decrypted_data) {
-        result = ByteArray(std::move(*decrypted_data));
+      std::string decrypted_data;
+      if (cipher->Decrypt(input, &decrypted_data)) {
+        result = ByteArray(std::move(decrypted_data));
       } else {
         // It could be a protocol race, where remote party sends a KEEP_ALIVE
         // before encryption is setup on their side, and we receive it after
@@ -168,6 +167,16 @@ ExceptionOr<ByteArray> BaseEndpointChannel::Read() {
 }
 
 Exception BaseEndpointChannel::Write(const ByteArray& data) {
+  const absl::string_view frame(data.data(), data.size());
+  return WriteFrame(absl::MakeConstSpan(&frame, 1));
+}
+
+Exception BaseEndpointChannel::WriteChain(const ByteChain& data) {
+  return WriteFrame(data.AsStringViews());
+}
+
+Exception BaseEndpointChannel::WriteFrame(
+    absl::Span<const absl::string_view> frame) {
   {
     MutexLock pause_lock(&is_paused_mutex_);
     if (is_paused_) {
@@ -175,37 +184,38 @@ Exception BaseEndpointChannel::Write(const ByteArray& data) {
     }
   }
 
-  ByteArray encrypted_data;
-  const ByteArray* data_to_write = &data;
+  std::string encrypted_data;
+  absl::string_view encrypted_frame;
   {
-    // Holding both mutexes is necessary to prevent the keep alive and payload
-    // threads from writing encrypted messages out of order which causes a
-    // failure to decrypt on the reader side. However we need to release the
-    // crypto lock after encrypting to ensure read decryption is not blocked.
+    // Encrypting under the writer lock is necessary to prevent the keep alive
+    // and payload threads from writing encrypted messages out of order which
+    // causes a failure to decrypt on the reader side. Decryption is serialized
+    // separately, so the reader is not blocked meanwhile.
     MutexLock lock(&writer_mutex_);
-    {
-      MutexLock crypto_lock(&crypto_mutex_);
-      if (IsEncryptionEnabledLocked()) {
-        // If encryption is enabled, encode the message.
-        std::unique_ptr<std::string> encrypted =
-            crypto_context_->EncodeMessageToPeer(std::string(data));
-        if (!encrypted) {
-          NEARBY_LOGS(WARNING) << __func__ << ": Failed to encrypt data.";
-          return {Exception::kIo};
-        }
-        encrypted_data = ByteArray(std::move(*encrypted));
-        data_to_write = &encrypted_data;
+    std::shared_ptr<FrameCipher> cipher = GetCipher();
+    if (cipher) {
+      // If encryption is enabled, encode the message.
+      if (!cipher->Encrypt(frame, &encrypted_data)) {
+        NEARBY_LOGS(WARNING) << __func__ << ": Failed to encrypt data.";
+        return {Exception::kIo};
       }
+      encrypted_frame = encrypted_data;
+      frame = absl::MakeConstSpan(&encrypted_frame, 1);
     }
 
-    Exception write_exception =
-        WriteInt(writer_, static_cast<std::int32_t>(data_to_write->size()));
-    if (write_exception.Raised()) {
-      NEARBY_LOGS(WARNING) << __func__ << ": Failed to write header: "
-                           << write_exception.value;
-      return write_exception;
+    // The length prefix and the frame go out in a single gathered write.
+    size_t frame_size = 0;
+    for (const absl::string_view slice : frame) {
+      frame_size += slice.size();
     }
-    write_exception = writer_->Write(*data_to_write);
+    char size_bytes[sizeof(std::int32_t)];
+    IntToBytes(static_cast<std::int32_t>(frame_size), size_bytes);
+    std::vector<absl::string_view> buffers;
+    buffers.reserve(frame.size() + 1);
+    buffers.push_back(absl::string_view(size_bytes, sizeof(size_bytes)));
+    buffers.insert(buffers.end(), frame.begin(), frame.end());
+    absl::Time write_start = SystemClock::ElapsedRealtime();
+    Exception write_exception = writer_->WriteV(buffers);
     if (write_exception.Raised()) {
       NEARBY_LOGS(WARNING) << __func__ << ": Failed to write data: "
                            << write_exception.value;
@@ -217,6 +227,7 @@ Exception BaseEndpointChannel::Write(const ByteArray& data) {
                            << flush_exception.value;
       return flush_exception;
     }
+    RecordWrite(frame_size, SystemClock::ElapsedRealtime() - write_start);
   }
 
   return {Exception::kSuccess};
@@ -294,15 +305,45 @@ int BaseEndpointChannel::GetMaxTransmitPacketSize() const {
   return kDefaultMaxTransmitPacketSize;
 }
 
+int BaseEndpointChannel::GetAdaptiveTransmitPacketSize() const {
+  std::int64_t throughput = write_throughput_.load(std::memory_order_relaxed);
+  if (!throughput) return GetMaxTransmitPacketSize();
+  std::int64_t size =
+      throughput * absl::ToInt64Microseconds(kTargetWriteDuration) / 1000000;
+  int min_size = GetMaxTransmitPacketSize() / 4;
+  if (min_size < kMinAdaptiveTransmitPacketSize) {
+    min_size = kMinAdaptiveTransmitPacketSize;
+  }
+  if (size < min_size) return min_size;
+  int max_size = GetMaxAdaptiveTransmitPacketSize();
+  if (size > max_size) return max_size;
+  return static_cast<int>(size);
+}
+
+void BaseEndpointChannel::RecordWrite(size_t size, absl::Duration duration) {
+  // Small frames (keep-alives, control messages) are all latency; they say
+  // little about how fast payload chunks go out. Payload chunks are sized by
+  // GetAdaptiveTransmitPacketSize(), so compare against that rather than a
+  // fixed size, or chunks that shrank would never be sampled again.
+  if (size < static_cast<size_t>(GetAdaptiveTransmitPacketSize() / 2)) return;
+  std::int64_t micros =
+      std::max<std::int64_t>(absl::ToInt64Microseconds(duration), 1);
+  std::int64_t sample = static_cast<std::int64_t>(size) * 1000000 / micros;
+  std::int64_t throughput = write_throughput_.load(std::memory_order_relaxed);
+  // Moving average over roughly the last 8 writes.
+  throughput = throughput ? throughput + (sample - throughput) / 8 : sample;
+  write_throughput_.store(throughput, std::memory_order_relaxed);
+}
+
 void BaseEndpointChannel::EnableEncryption(
     std::shared_ptr<EncryptionContext> context) {
   MutexLock crypto_lock(&crypto_mutex_);
-  crypto_context_ = context;
+  cipher_ = std::make_shared<FrameCipher>(std::move(context));
 }
 
 void BaseEndpointChannel::DisableEncryption() {
   MutexLock crypto_lock(&crypto_mutex_);
-  crypto_context_.reset();
+  cipher_.reset();
 }
 
 bool BaseEndpointChannel::IsPaused() const {
@@ -327,7 +368,12 @@ absl::Time BaseEndpointChannel::GetLastReadTimestamp() const {
 }
 
 bool BaseEndpointChannel::IsEncryptionEnabledLocked() const {
-  return crypto_context_ != nullptr;
+  return cipher_ != nullptr;
+}
+
+std::shared_ptr<FrameCipher> BaseEndpointChannel::GetCipher() const {
+  MutexLock crypto_lock(&crypto_mutex_);
+  return cipher_;
 }
 
 void BaseEndpointChannel::BlockUntilUnpaused() {
@@ -15,15 +15,21 @@
 #ifndef CORE_INTERNAL_BASE_ENDPOINT_CHANNEL_H_
 #define CORE_INTERNAL_BASE_ENDPOINT_CHANNEL_H_
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <string>
 
 #include "securegcm/d2d_connection_context_v1.h"
 #include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "third_party/nearby_connections/cpp/analytics/analytics_recorder.h"
 #include "core/internal/endpoint_channel.h"
+#include "core/internal/frame_cipher.h"
 #include "platform/base/byte_array.h"
+#include "platform/base/byte_chain.h"
 #include "platform/base/input_stream.h"
 #include "platform/base/output_stream.h"
 #include "platform/public/atomic_reference.h"
@@ -48,6 +54,11 @@ class BaseEndpointChannel : public EndpointChannel {
   Exception Write(const ByteArray& data)
       ABSL_LOCKS_EXCLUDED(writer_mutex_, crypto_mutex_) override;
 
+  // Sends the slices of |data| without joining them first, unless encryption
+  // is enabled.
+  Exception WriteChain(const ByteChain& data)
+      ABSL_LOCKS_EXCLUDED(writer_mutex_, crypto_mutex_) override;
+
   // Closes this EndpointChannel, without tracking the closure in analytics.
   void Close() ABSL_LOCKS_EXCLUDED(is_paused_mutex_) override;
 
@@ -66,6 +77,12 @@ class BaseEndpointChannel : public EndpointChannel {
   // transport.
   int GetMaxTransmitPacketSize() const override;
 
+  // Returns a chunk size that takes about kTargetWriteDuration to write at
+  // the measured throughput, so that frames grow on fast links and shrink on
+  // slow ones. It stays between a quarter of GetMaxTransmitPacketSize() and
+  // GetMaxAdaptiveTransmitPacketSize().
+  int GetAdaptiveTransmitPacketSize() const override;
+
   // Enables encryption on the EndpointChannel.
   // Should be called after connection is accepted by both parties, and
   // before entering data phase, where Payloads may be exchanged.
@@ -95,6 +112,13 @@ class BaseEndpointChannel : public EndpointChannel {
  protected:
   virtual void CloseImpl() = 0;
 
+  // Returns the largest size GetAdaptiveTransmitPacketSize() grows to.
+  // Mediums with a small MTU, such as BLE and Bluetooth, cap it at their
+  // GetMaxTransmitPacketSize().
+  virtual int GetMaxAdaptiveTransmitPacketSize() const {
+    return kMaxAdaptiveTransmitPacketSize;
+  }
+
  private:
   // Used to sanity check that our frame sizes are reasonable.
   static constexpr std::int32_t kMaxAllowedReadBytes = 1048576;  // 1MB
@@ -102,12 +126,32 @@ class BaseEndpointChannel : public EndpointChannel {
   // The default maximum transmit unit/packet size.
   static constexpr int kDefaultMaxTransmitPacketSize = 65536;  // 64 KB
 
+  // Bounds for GetAdaptiveTransmitPacketSize(). The upper bound leaves room
+  // for framing and encryption under kMaxAllowedReadBytes.
+  static constexpr int kMaxAdaptiveTransmitPacketSize = 524288;  // 512 KB
+  static constexpr int kMinAdaptiveTransmitPacketSize = 128;
+  static constexpr absl::Duration kTargetWriteDuration = absl::Milliseconds(20);
+
+  // Updates |write_throughput_| with a write of |size| bytes that took
+  // |duration|.
+  void RecordWrite(size_t size, absl::Duration duration)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(writer_mutex_);
+
   bool IsEncryptionEnabledLocked() const
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(crypto_mutex_);
+  // Returns the cipher to encrypt or decrypt with, or null if encryption is
+  // not enabled.
+  std::shared_ptr<FrameCipher> GetCipher() const
+      ABSL_LOCKS_EXCLUDED(crypto_mutex_);
   void UnblockPausedWriter() ABSL_EXCLUSIVE_LOCKS_REQUIRED(is_paused_mutex_);
   void BlockUntilUnpaused() ABSL_EXCLUSIVE_LOCKS_REQUIRED(is_paused_mutex_);
   void CloseIo() ABSL_NO_THREAD_SAFETY_ANALYSIS;
 
+  // Encrypts (if enabled) the concatenation of |frame| and writes it out with
+  // a length prefix.
+  Exception WriteFrame(absl::Span<const absl::string_view> frame)
+      ABSL_LOCKS_EXCLUDED(writer_mutex_, crypto_mutex_);
+
   // We need a separate mutex to pritect read timestamp, because if a read
   // blocks on IO, we don't want timestamp read access to block too.
   mutable Mutex last_read_mutex_;
@@ -122,11 +166,15 @@ class BaseEndpointChannel : public EndpointChannel {
 
   Mutex writer_mutex_;
   OutputStream* writer_ ABSL_PT_GUARDED_BY(writer_mutex_);
+  // Moving average of the write throughput, in bytes per second; 0 until
+  // there is a measurement. Written under |writer_mutex_|.
+  std::atomic<std::int64_t> write_throughput_{0};
 
-  // An encryptor/decryptor. May be null.
+  // An encryptor/decryptor. May be null. It is only looked up under
+  // |crypto_mutex_|; encryption and decryption themselves are serialized by
+  // |writer_mutex_| and |reader_mutex_| respectively.
   mutable Mutex crypto_mutex_;
-  std::shared_ptr<EncryptionContext> crypto_context_
-      ABSL_GUARDED_BY(crypto_mutex_) ABSL_PT_GUARDED_BY(crypto_mutex_);
+  std::shared_ptr<FrameCipher> cipher_ ABSL_GUARDED_BY(crypto_mutex_);
 
   mutable Mutex is_paused_mutex_;
   ConditionVariable is_paused_cond_{&is_paused_mutex_};
@@ -27,6 +27,7 @@
 #include "core/internal/encryption_runner.h"
 #include "core/internal/offline_frames.h"
 #include "platform/base/byte_array.h"
+#include "platform/base/byte_chain.h"
 #include "platform/base/exception.h"
 #include "platform/base/input_stream.h"
 #include "platform/base/output_stream.h"
@@ -35,6 +36,7 @@
 #include "platform/public/multi_thread_executor.h"
 #include "platform/public/pipe.h"
 #include "platform/public/single_thread_executor.h"
+#include "platform/public/system_clock.h"
 #include "proto/connections_enums.pb.h"
 
 namespace location {
@@ -55,6 +57,35 @@ class TestEndpointChannel : public BaseEndpointChannel {
   MOCK_METHOD(void, CloseImpl, (), (override));
 };
 
+// Like BLE and Bluetooth, does not grow frames past its MTU.
+class SmallMtuEndpointChannel : public TestEndpointChannel {
+ public:
+  using TestEndpointChannel::TestEndpointChannel;
+
+ protected:
+  int GetMaxAdaptiveTransmitPacketSize() const override {
+    return GetMaxTransmitPacketSize();
+  }
+};
+
+// Drops everything written to it, taking |delay| for each flush.
+class SlowOutputStream : public OutputStream {
+ public:
+  void SetDelay(absl::Duration delay) { delay_ = delay; }
+
+  Exception Write(const ByteArray& data) override {
+    return {Exception::kSuccess};
+  }
+  Exception Flush() override {
+    SystemClock::Sleep(delay_);
+    return {Exception::kSuccess};
+  }
+  Exception Close() override { return {Exception::kSuccess}; }
+
+ private:
+  absl::Duration delay_ = absl::ZeroDuration();
+};
+
 std::function<void()> MakeDataPump(
     std::string label, InputStream* input, OutputStream* output,
     std::function<void(const ByteArray&)> monitor = nullptr) {
@@ -177,6 +208,73 @@ TEST(BaseEndpointChannelTest, ReadWrite) {
   EXPECT_EQ(rx_message, tx_message);
 }
 
+TEST(BaseEndpointChannelTest, WriteChainIsReadAsOneFrame) {
+  Pipe pipe_a;  // channel_a writes to pipe_a, reads from pipe_b.
+  Pipe pipe_b;  // channel_b writes to pipe_b, reads from pipe_a.
+  TestEndpointChannel channel_a(&pipe_b.GetInputStream(),
+                                &pipe_a.GetOutputStream());
+  TestEndpointChannel channel_b(&pipe_a.GetInputStream(),
+                                &pipe_b.GetOutputStream());
+  ByteChain tx_message(ByteArray(std::string("data ")));
+  tx_message.Append(ByteSlice(ByteArray(std::string("message"))));
+  EXPECT_TRUE(channel_a.WriteChain(tx_message).Ok());
+  ByteArray rx_message = std::move(channel_b.Read().result());
+  EXPECT_EQ(rx_message, ByteArray{"data message"});
+}
+
+TEST(BaseEndpointChannelTest, AdaptiveTransmitPacketSizeFollowsWrites) {
+  Pipe pipe;
+  TestEndpointChannel channel(&pipe.GetInputStream(), &pipe.GetOutputStream());
+  int default_size = channel.GetMaxTransmitPacketSize();
+  EXPECT_EQ(channel.GetAdaptiveTransmitPacketSize(), default_size);
+
+  // Small writes are not taken as samples.
+  EXPECT_TRUE(channel.Write(ByteArray{"data message"}).Ok());
+  EXPECT_EQ(channel.GetAdaptiveTransmitPacketSize(), default_size);
+
+  // A pipe takes full-sized writes much faster than the target write time.
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(channel.Write(ByteArray(default_size)).Ok());
+  }
+  EXPECT_GT(channel.GetAdaptiveTransmitPacketSize(), default_size);
+  EXPECT_LE(channel.GetAdaptiveTransmitPacketSize(), 512 * 1024);
+}
+
+TEST(BaseEndpointChannelTest, AdaptiveTransmitPacketSizeShrinksAndRecovers) {
+  Pipe pipe;
+  SlowOutputStream output;
+  TestEndpointChannel channel(&pipe.GetInputStream(), &output);
+  int default_size = channel.GetMaxTransmitPacketSize();
+
+  // A write that takes much longer than the target write time shrinks the
+  // chunks down to the floor.
+  output.SetDelay(absl::Milliseconds(200));
+  EXPECT_TRUE(channel.Write(ByteArray(default_size)).Ok());
+  int shrunk_size = channel.GetAdaptiveTransmitPacketSize();
+  EXPECT_EQ(shrunk_size, default_size / 4);
+
+  // Once the link is fast again, the shrunk chunks are still sampled, and
+  // grow back.
+  output.SetDelay(absl::ZeroDuration());
+  for (int i = 0; i < 32; i++) {
+    EXPECT_TRUE(
+        channel.Write(ByteArray(channel.GetAdaptiveTransmitPacketSize())).Ok());
+  }
+  EXPECT_GT(channel.GetAdaptiveTransmitPacketSize(), default_size);
+}
+
+TEST(BaseEndpointChannelTest, AdaptiveTransmitPacketSizeIsCappedPerMedium) {
+  Pipe pipe;
+  SlowOutputStream output;
+  SmallMtuEndpointChannel channel(&pipe.GetInputStream(), &output);
+  int default_size = channel.GetMaxTransmitPacketSize();
+
+  for (int i = 0; i < 8; i++) {
+    EXPECT_TRUE(channel.Write(ByteArray(default_size)).Ok());
+  }
+  EXPECT_EQ(channel.GetAdaptiveTransmitPacketSize(), default_size);
+}
+
 TEST(BaseEndpointChannelTest, NotEncryptedReadWriteCanBeIntercepted) {
   // Not encrypted IO; MITM scenario.
 
@@ -14,11 +14,13 @@
 
 #include "core/internal/base_pcp_handler.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cinttypes>
 #include <cstdlib>
 #include <limits>
 #include <memory>
+#include <vector>
 
 #include "securegcm/d2d_connection_context_v1.h"
 #include "securegcm/ukey2_handshake.h"
@@ -31,7 +33,12 @@
 #include "core/options.h"
 #include "platform/base/base64_utils.h"
 #include "platform/base/bluetooth_utils.h"
+#include "platform/base/feature_flags.h"
+#include "platform/public/condition_variable.h"
 #include "platform/public/logging.h"
+#include "platform/public/multi_thread_executor.h"
+#include "platform/public/mutex.h"
+#include "platform/public/mutex_lock.h"
 #include "platform/public/system_clock.h"
 
 namespace location {
@@ -41,8 +48,30 @@ namespace connections {
 using ::location::nearby::proto::connections::Medium;
 using ::securegcm::UKey2Handshake;
 
+namespace {
+
+// Owns an EndpointChannel that is passed along between tasks, and closes it
+// if no task takes it over, e.g. because an executor was shut down.
+class PendingChannel {
+ public:
+  explicit PendingChannel(std::unique_ptr<EndpointChannel> channel)
+      : channel_(std::move(channel)) {}
+  ~PendingChannel() {
+    if (channel_) channel_->Close();
+  }
+
+  EndpointChannel* get() const { return channel_.get(); }
+  std::unique_ptr<EndpointChannel> Take() { return std::move(channel_); }
+
+ private:
+  std::unique_ptr<EndpointChannel> channel_;
+};
+
+}  // namespace
+
 constexpr absl::Duration BasePcpHandler::kConnectionRequestReadTimeout;
 constexpr absl::Duration BasePcpHandler::kRejectedConnectionCloseDelay;
+constexpr absl::Duration BasePcpHandler::kConnectRaceCancelPollInterval;
 
 BasePcpHandler::BasePcpHandler(Mediums* mediums,
                                EndpointManager* endpoint_manager,
@@ -61,6 +90,7 @@ BasePcpHandler::~BasePcpHandler() {
   // Stop all the ongoing Runnables (as gracefully as possible).
   NEARBY_LOGS(INFO) << "BasePcpHandler(" << strategy_.GetName()
                     << ") is bringing down executors.";
+  connection_executor_.Shutdown();
   serial_executor_.Shutdown();
   alarm_executor_.Shutdown();
   NEARBY_LOGS(INFO) << "BasePcpHandler(" << strategy_.GetName()
@@ -74,6 +104,11 @@ void BasePcpHandler::DisconnectFromEndpointManager() {
   // Unregister ourselves from EPM message dispatcher.
   endpoint_manager_->UnregisterFrameProcessor(V1Frame::CONNECTION_RESPONSE,
                                               this);
+  // Connection workers run ConnectImpl(), which uses the state of the derived
+  // class, so wait for them before that is destroyed. Connection races wait
+  // for their attempts to be decided, so the race workers go down last.
+  connection_executor_.Shutdown();
+  connect_race_executor_.Shutdown();
 }
 
 Status BasePcpHandler::StartAdvertising(ClientProxy* client,
@@ -219,7 +254,11 @@ Status BasePcpHandler::StartDiscovery(ClientProxy* client,
 
         // Now that we've succeeded, mark the client as discovering and clear
         // out any old endpoints we had discovered.
+        discovered_endpoints_expiry_.Cancel();
+        discovery_generation_++;
+        discovering_clients_.insert(client);
         discovered_endpoints_.clear();
+        discovered_endpoint_ids_.clear();
         client->StartedDiscovery(service_id, GetStrategy(), listener,
                                  absl::MakeSpan(result.mediums),
                                  discovery_options);
@@ -235,6 +274,15 @@ void BasePcpHandler::StopDiscovery(ClientProxy* client) {
                         [this, client, &latch]() RUN_ON_PCP_HANDLER_THREAD() {
                           StopDiscoveryImpl(client);
                           client->StoppedDiscovery();
+                          discovering_clients_.erase(client);
+                          if (discovering_clients_.empty()) {
+                            // The mediums no longer report endpoints lost, so
+                            // there is no need to look them up by address.
+                            // The endpoints themselves are kept a while
+                            // longer, for RequestConnection().
+                            discovered_endpoint_ids_.clear();
+                            ScheduleDiscoveredEndpointsExpiry();
+                          }
                           latch.CountDown();
                         });
 
@@ -289,6 +337,11 @@ void BasePcpHandler::RunOnPcpHandlerThread(const std::string& name,
   serial_executor_.Execute(name, std::move(runnable));
 }
 
+void BasePcpHandler::RunOnConnectionWorker(const std::string& name,
+                                           Runnable runnable) {
+  connection_executor_.Execute(name, std::move(runnable));
+}
+
 EncryptionRunner::ResultListener BasePcpHandler::GetResultListener() {
   return {
       .on_success_cb =
@@ -448,13 +501,14 @@ Status BasePcpHandler::RequestConnection(ClientProxy* client,
                                          const ConnectionOptions& options) {
   auto result = std::make_shared<Future<Status>>();
   RunOnPcpHandlerThread(
-      "request-connection", [this, client, &info, options, endpoint_id,
+      "request-connection", [this, client, info, options, endpoint_id,
                              result]() RUN_ON_PCP_HANDLER_THREAD() {
         absl::Time start_time = SystemClock::ElapsedRealtime();
 
         // If we already have a pending connection, then we shouldn't allow any
         // more outgoing connections to this endpoint.
-        if (pending_connections_.count(endpoint_id)) {
+        if (pending_connections_.count(endpoint_id) ||
+            connecting_endpoints_.contains(endpoint_id)) {
           NEARBY_LOGS(INFO)
               << "In requestConnection(), connection requested with "
                  "endpoint(id="
@@ -483,6 +537,7 @@ Status BasePcpHandler::RequestConnection(ClientProxy* client,
           result->Set({Status::kEndpointUnknown});
           return;
         }
+        ByteArray remote_endpoint_info = endpoint->endpoint_info;
 
         auto remote_bluetooth_mac_address =
             BluetoothUtils::ToString(options.remote_bluetooth_mac_address);
@@ -498,92 +553,42 @@ Status BasePcpHandler::RequestConnection(ClientProxy* client,
         if (AppendWebRTCEndpoint(endpoint_id, client->GetDiscoveryOptions()))
           NEARBY_LOGS(INFO) << "Appended Web RTC endpoint.";
 
-        auto discovered_endpoints = GetDiscoveredEndpoints(endpoint_id);
-        std::unique_ptr<EndpointChannel> channel;
-        ConnectImplResult connect_impl_result;
-
-        for (auto connect_endpoint : discovered_endpoints) {
-          absl::Time connect_start_time = SystemClock::ElapsedRealtime();
-          if (!MediumSupportedByClientOptions(connect_endpoint->medium,
-                                              options))
-            continue;
-          connect_impl_result = ConnectImpl(client, connect_endpoint);
-          if (connect_impl_result.status.Ok()) {
-            channel = std::move(connect_impl_result.endpoint_channel);
-            break;
-          } else {
-            LogConnectionAttempt(client, connect_endpoint->medium,
-                                 connect_endpoint->endpoint_id,
-                                 /* is_incoming = */ false, connect_start_time);
+        // The connect itself runs on a connection worker, which keeps the
+        // endpoints alive even if they are lost in the meantime.
+        std::vector<std::shared_ptr<DiscoveredEndpoint>> connect_endpoints;
+        for (auto& connect_endpoint : ShareDiscoveredEndpoints(endpoint_id)) {
+          if (MediumSupportedByClientOptions(connect_endpoint->medium,
+                                             options)) {
+            connect_endpoints.push_back(std::move(connect_endpoint));
           }
         }
-
-        if (channel == nullptr) {
-          NEARBY_LOGS(INFO)
-              << "Endpoint channel not available: endpoint_id=" << endpoint_id;
-          ProcessPreConnectionInitiationFailure(
-              client, channel->GetMedium(), endpoint_id, channel.get(),
-              /* is_incoming = */ false, start_time, connect_impl_result.status,
-              result.get());
-          return;
-        }
-
-        NEARBY_LOGS(INFO)
-            << "In requestConnection(), wrote ConnectionRequestFrame "
-               "to endpoint_id="
-            << endpoint_id;
-        // Generate the nonce to use for this connection.
-        std::int32_t nonce = prng_.NextInt32();
-
-        // The first message we have to send, after connecting, is to tell the
-        // endpoint about ourselves.
-        Exception write_exception = WriteConnectionRequestFrame(
-            channel.get(), client->GetLocalEndpointId(), info.endpoint_info,
-            nonce, GetSupportedConnectionMediumsByPriority(options),
-            options.keep_alive_interval_millis,
-            options.keep_alive_timeout_millis);
-        if (!write_exception.Ok()) {
-          NEARBY_LOGS(INFO) << "Failed to send connection request: endpoint_id="
-                            << endpoint_id;
-          ProcessPreConnectionInitiationFailure(
-              client, channel->GetMedium(), endpoint_id, channel.get(),
-              /* is_incoming = */ false, start_time, {Status::kEndpointIoError},
-              result.get());
-          return;
+        connecting_endpoints_.emplace(endpoint_id, client);
+
+        auto connect = [this, client, info, options, endpoint_id,
+                        remote_endpoint_info, start_time, result,
+                        connect_endpoints = std::move(connect_endpoints)]() {
+          // Runnables must be copyable, so hand the result over in a
+          // shared_ptr.
+          auto connect_impl_result = std::make_shared<ConnectImplResult>(
+              ConnectToEndpoint(client, endpoint_id, connect_endpoints));
+          RunOnPcpHandlerThread(
+              "request-connection-connected",
+              [this, client, info, options, endpoint_id, remote_endpoint_info,
+               start_time, result,
+               connect_impl_result]() RUN_ON_PCP_HANDLER_THREAD() {
+                OnOutgoingConnectionConnected(
+                    client, endpoint_id, info, options, remote_endpoint_info,
+                    start_time, std::move(*connect_impl_result), result);
+              });
+        };
+        if (FeatureFlags::GetInstance()
+                .GetFlags()
+                .enable_parallel_connection_setup) {
+          RunOnConnectionWorker("request-connection-connect",
+                                std::move(connect));
+        } else {
+          connect();
         }
-
-        NEARBY_LOGS(INFO) << "Adding connection to pending set: endpoint_id="
-                          << endpoint_id;
-
-        // We've successfully connected to the device, and are now about to jump
-        // on to the EncryptionRunner thread to start running our encryption
-        // protocol. We'll mark ourselves as pending in case we get another call
-        // to RequestConnection or OnIncomingConnection, so that we can cancel
-        // the connection if needed.
-        // Not using designated initializers here since the VS C++ compiler
-        // errors out indicating that MediumSelector<bool> is not an aggregate
-        PendingConnectionInfo pendingConnectionInfo{};
-        pendingConnectionInfo.client = client;
-        pendingConnectionInfo.remote_endpoint_info = endpoint->endpoint_info;
-        pendingConnectionInfo.nonce = nonce;
-        pendingConnectionInfo.is_incoming = false;
-        pendingConnectionInfo.start_time = start_time;
-        pendingConnectionInfo.listener = info.listener;
-        pendingConnectionInfo.options = options;
-        pendingConnectionInfo.result = result;
-        pendingConnectionInfo.channel = std::move(channel);
-
-        EndpointChannel* endpoint_channel =
-            pending_connections_
-                .emplace(endpoint_id, std::move(pendingConnectionInfo))
-                .first->second.channel.get();
-
-        NEARBY_LOGS(INFO) << "Initiating secure connection: endpoint_id="
-                          << endpoint_id;
-        // Next, we'll set up encryption. When it's done, our future will return
-        // and RequestConnection() will finish.
-        encryption_runner_.StartClient(client, endpoint_id, endpoint_channel,
-                                       GetResultListener());
       });
   NEARBY_LOGS(INFO) << "Waiting for connection to complete: endpoint_id="
                     << endpoint_id;
@@ -595,6 +600,244 @@ Status BasePcpHandler::RequestConnection(ClientProxy* client,
   return status;
 }
 
+BasePcpHandler::ConnectImplResult BasePcpHandler::ConnectToEndpoint(
+    ClientProxy* client, const std::string& endpoint_id,
+    const std::vector<std::shared_ptr<DiscoveredEndpoint>>& endpoints) {
+  if (FeatureFlags::GetInstance().GetFlags().enable_connection_racing &&
+      endpoints.size() > 1) {
+    return RaceConnectImpl(client, endpoint_id, endpoints);
+  }
+  ConnectImplResult connect_impl_result;
+  for (const auto& connect_endpoint : endpoints) {
+    absl::Time connect_start_time = SystemClock::ElapsedRealtime();
+    connect_impl_result = ConnectImpl(client, connect_endpoint.get());
+    if (connect_impl_result.status.Ok()) break;
+    LogConnectionAttempt(client, connect_endpoint->medium,
+                         connect_endpoint->endpoint_id,
+                         /* is_incoming = */ false, connect_start_time);
+  }
+  return connect_impl_result;
+}
+
+void BasePcpHandler::OnOutgoingConnectionConnected(
+    ClientProxy* client, const std::string& endpoint_id,
+    const ConnectionRequestInfo& info, const ConnectionOptions& options,
+    const ByteArray& remote_endpoint_info, absl::Time start_time,
+    ConnectImplResult connect_impl_result,
+    std::shared_ptr<Future<Status>> result) {
+  connecting_endpoints_.erase(endpoint_id);
+
+  std::unique_ptr<EndpointChannel> channel;
+  if (connect_impl_result.status.Ok()) {
+    channel = std::move(connect_impl_result.endpoint_channel);
+  }
+  if (channel == nullptr) {
+    NEARBY_LOGS(INFO) << "Endpoint channel not available: endpoint_id="
+                      << endpoint_id;
+    ProcessConnectionAttemptFailure(
+        client, connect_impl_result.medium, endpoint_id, channel.get(),
+        /* is_incoming = */ false, start_time, connect_impl_result.status,
+        result.get());
+    return;
+  }
+
+  // The endpoint may have connected to us while we were connecting to it. We
+  // haven't told it about ourselves yet, so let its connection win.
+  if (pending_connections_.count(endpoint_id)) {
+    NEARBY_LOGS(INFO) << "In requestConnection(), connected to endpoint(id="
+                      << endpoint_id
+                      << "), but they connected to us in the meantime.";
+    channel->Close();
+    result->Set({Status::kAlreadyConnectedToEndpoint});
+    return;
+  }
+
+  NEARBY_LOGS(INFO) << "In requestConnection(), wrote ConnectionRequestFrame "
+                       "to endpoint_id="
+                    << endpoint_id;
+  // Generate the nonce to use for this connection.
+  std::int32_t nonce = prng_.NextInt32();
+
+  // The first message we have to send, after connecting, is to tell the
+  // endpoint about ourselves.
+  Exception write_exception = WriteConnectionRequestFrame(
+      channel.get(), client->GetLocalEndpointId(), info.endpoint_info, nonce,
+      GetSupportedConnectionMediumsByPriority(options),
+      options.keep_alive_interval_millis, options.keep_alive_timeout_millis);
+  if (!write_exception.Ok()) {
+    NEARBY_LOGS(INFO) << "Failed to send connection request: endpoint_id="
+                      << endpoint_id;
+    ProcessConnectionAttemptFailure(
+        client, channel->GetMedium(), endpoint_id, channel.get(),
+        /* is_incoming = */ false, start_time, {Status::kEndpointIoError},
+        result.get());
+    return;
+  }
+
+  NEARBY_LOGS(INFO) << "Adding connection to pending set: endpoint_id="
+                    << endpoint_id;
+
+  // We've successfully connected to the device, and are now about to jump on
+  // to the EncryptionRunner thread to start running our encryption protocol.
+  // We'll mark ourselves as pending in case we get another call to
+  // RequestConnection or OnIncomingConnection, so that we can cancel the
+  // connection if needed.
+  // Not using designated initializers here since the VS C++ compiler errors
+  // out indicating that MediumSelector<bool> is not an aggregate
+  PendingConnectionInfo pendingConnectionInfo{};
+  pendingConnectionInfo.client = client;
+  pendingConnectionInfo.remote_endpoint_info = remote_endpoint_info;
+  pendingConnectionInfo.nonce = nonce;
+  pendingConnectionInfo.is_incoming = false;
+  pendingConnectionInfo.start_time = start_time;
+  pendingConnectionInfo.listener = info.listener;
+  pendingConnectionInfo.options = options;
+  pendingConnectionInfo.result = result;
+  pendingConnectionInfo.channel = std::move(channel);
+
+  EndpointChannel* endpoint_channel =
+      pending_connections_
+          .emplace(endpoint_id, std::move(pendingConnectionInfo))
+          .first->second.channel.get();
+
+  NEARBY_LOGS(INFO) << "Initiating secure connection: endpoint_id="
+                    << endpoint_id;
+  // Next, we'll set up encryption. When it's done, our future will return and
+  // RequestConnection() will finish.
+  encryption_runner_.StartClient(client, endpoint_id, endpoint_channel,
+                                 GetResultListener());
+}
+
+BasePcpHandler::ConnectImplResult BasePcpHandler::RaceConnectImpl(
+    ClientProxy* client, const std::string& endpoint_id,
+    const std::vector<std::shared_ptr<DiscoveredEndpoint>>& endpoints) {
+  const FeatureFlags::Flags& flags = FeatureFlags::GetInstance().GetFlags();
+  const absl::Duration stagger =
+      absl::Milliseconds(flags.connection_race_stagger_millis);
+  const absl::Duration grace =
+      absl::Milliseconds(flags.connection_race_grace_millis);
+
+  struct Attempt {
+    std::shared_ptr<DiscoveredEndpoint> endpoint;
+    absl::Time start_time;
+    CancellationFlag cancellation_flag;
+    bool done = false;
+    ConnectImplResult result;
+  };
+  // Shared with the attempts, which may outlive the race.
+  struct Race {
+    Mutex mutex;
+    ConditionVariable cond{&mutex};
+    // Started attempts, in the same order as |endpoints|.
+    std::vector<std::unique_ptr<Attempt>> attempts;
+    int running = 0;
+    // Set once there is a winner, or the race is given up.
+    bool decided = false;
+  };
+  auto race = std::make_shared<Race>();
+  Attempt* winner = nullptr;
+
+  MutexLock lock(&race->mutex);
+  auto& attempts = race->attempts;
+  absl::Time next_start_time = SystemClock::ElapsedRealtime();
+  absl::Time grace_deadline = absl::InfiniteFuture();
+  while (!Cancelled(client, endpoint_id)) {
+    absl::Time now = SystemClock::ElapsedRealtime();
+    Attempt* best = nullptr;
+    bool preferred_in_flight = false;
+    for (auto& attempt : attempts) {
+      if (!attempt->done) {
+        preferred_in_flight = true;
+      } else if (attempt->result.status.Ok()) {
+        best = attempt.get();
+        break;
+      }
+    }
+    if (best != nullptr) {
+      if (grace_deadline == absl::InfiniteFuture()) {
+        grace_deadline = now + grace;
+      }
+      if (!preferred_in_flight || now >= grace_deadline) {
+        winner = best;
+        break;
+      }
+    } else if (attempts.size() == endpoints.size()) {
+      if (race->running == 0) break;
+    } else if (race->running == 0 || now >= next_start_time) {
+      // Start the next attempt. The ones not started yet are all less
+      // preferred than a success, so they are only started while there is
+      // none.
+      auto attempt = std::make_unique<Attempt>();
+      attempt->endpoint = endpoints[attempts.size()];
+      attempt->start_time = now;
+      Attempt* started = attempt.get();
+      attempts.push_back(std::move(attempt));
+      race->running++;
+      next_start_time = now + stagger;
+      NEARBY_LOGS(INFO) << "Racing connection to endpoint_id=" << endpoint_id
+                        << " over medium="
+                        << proto::connections::Medium_Name(
+                               started->endpoint->medium);
+      connect_race_executor_.Execute(
+          "connect-race", [this, client, race, started]() {
+            {
+              // Decided while this attempt was queued behind other races.
+              MutexLock lock(&race->mutex);
+              if (race->decided) {
+                race->running--;
+                return;
+              }
+            }
+            ConnectImplResult result = ConnectImpl(
+                client, started->endpoint.get(), &started->cancellation_flag);
+            MutexLock lock(&race->mutex);
+            race->running--;
+            if (race->decided) {
+              // Lost the race, which did not wait for this attempt.
+              if (result.status.Ok()) result.endpoint_channel->Close();
+              return;
+            }
+            started->result = std::move(result);
+            started->done = true;
+            race->cond.Notify();
+          });
+      continue;
+    }
+    // Wake up when the next attempt or the end of the grace period is due,
+    // and at least every |kConnectRaceCancelPollInterval| to notice the client
+    // cancelling the endpoint.
+    absl::Time deadline = now + kConnectRaceCancelPollInterval;
+    if (best != nullptr) {
+      deadline = std::min(deadline, grace_deadline);
+    } else if (attempts.size() < endpoints.size()) {
+      deadline = std::min(deadline, next_start_time);
+    }
+    race->cond.Wait(deadline - now);
+  }
+  race->decided = true;
+
+  ConnectImplResult failure;
+  for (auto& attempt : attempts) {
+    if (attempt.get() == winner) continue;
+    if (!attempt->done) {
+      attempt->cancellation_flag.Cancel();
+    } else if (attempt->result.status.Ok()) {
+      attempt->result.endpoint_channel->Close();
+    } else {
+      failure.medium = attempt->endpoint->medium;
+      failure.status = attempt->result.status;
+      LogConnectionAttempt(client, attempt->endpoint->medium, endpoint_id,
+                           /* is_incoming = */ false, attempt->start_time);
+    }
+  }
+  if (winner == nullptr) return failure;
+  NEARBY_LOGS(INFO) << "Connection race to endpoint_id=" << endpoint_id
+                    << " won over medium="
+                    << proto::connections::Medium_Name(
+                           winner->endpoint->medium);
+  return std::move(winner->result);
+}
+
 bool BasePcpHandler::MediumSupportedByClientOptions(
     const proto::connections::Medium& medium,
     const ConnectionOptions& client_options) const {
@@ -620,25 +863,60 @@ BasePcpHandler::GetSupportedConnectionMediumsByPriority(
   return supported_mediums_by_priority;
 }
 
-// Get any single discovered endpoint for a given endpoint_id.
 BasePcpHandler::DiscoveredEndpoint* BasePcpHandler::GetDiscoveredEndpoint(
     const std::string& endpoint_id) {
   auto it = discovered_endpoints_.find(endpoint_id);
   if (it == discovered_endpoints_.end()) {
     return nullptr;
   }
-  return it->second.get();
+  DiscoveredEndpoint* preferred = nullptr;
+  for (const auto& item : it->second) {
+    if (!preferred || IsPreferred(*item.second, *preferred)) {
+      preferred = item.second.get();
+    }
+  }
+  return preferred;
+}
+
+BasePcpHandler::DiscoveredEndpoint* BasePcpHandler::GetDiscoveredEndpoint(
+    proto::connections::Medium medium, const std::string& address) {
+  auto it = discovered_endpoint_ids_.find(std::make_pair(medium, address));
+  if (it == discovered_endpoint_ids_.end()) {
+    return nullptr;
+  }
+  auto endpoints = discovered_endpoints_.find(it->second);
+  if (endpoints == discovered_endpoints_.end()) {
+    return nullptr;
+  }
+  auto endpoint = endpoints->second.find(medium);
+  if (endpoint == endpoints->second.end()) {
+    return nullptr;
+  }
+  return endpoint->second.get();
 }
 
 std::vector<BasePcpHandler::DiscoveredEndpoint*>
 BasePcpHandler::GetDiscoveredEndpoints(const std::string& endpoint_id) {
   std::vector<BasePcpHandler::DiscoveredEndpoint*> result;
-  auto it = discovered_endpoints_.equal_range(endpoint_id);
-  for (auto item = it.first; item != it.second; item++) {
-    result.push_back(item->second.get());
+  for (const auto& endpoint : ShareDiscoveredEndpoints(endpoint_id)) {
+    result.push_back(endpoint.get());
+  }
+  return result;
+}
+
+std::vector<std::shared_ptr<BasePcpHandler::DiscoveredEndpoint>>
+BasePcpHandler::ShareDiscoveredEndpoints(const std::string& endpoint_id) {
+  std::vector<std::shared_ptr<DiscoveredEndpoint>> result;
+  auto it = discovered_endpoints_.find(endpoint_id);
+  if (it == discovered_endpoints_.end()) {
+    return result;
+  }
+  for (const auto& item : it->second) {
+    result.push_back(item.second);
   }
   std::sort(result.begin(), result.end(),
-            [this](DiscoveredEndpoint* a, DiscoveredEndpoint* b) -> bool {
+            [this](const std::shared_ptr<DiscoveredEndpoint>& a,
+                   const std::shared_ptr<DiscoveredEndpoint>& b) -> bool {
               return IsPreferred(*a, *b);
             });
 
@@ -650,8 +928,9 @@ BasePcpHandler::GetDiscoveredEndpoints(
     const proto::connections::Medium medium) {
   std::vector<BasePcpHandler::DiscoveredEndpoint*> result;
   for (const auto& item : discovered_endpoints_) {
-    if (item.second->medium == medium) {
-      result.push_back(item.second.get());
+    auto endpoint = item.second.find(medium);
+    if (endpoint != item.second.end()) {
+      result.push_back(endpoint->second.get());
     }
   }
   return result;
@@ -666,6 +945,9 @@ mediums::PeerId BasePcpHandler::CreatePeerIdFromAdvertisement(
 }
 
 bool BasePcpHandler::HasOutgoingConnections(ClientProxy* client) const {
+  for (const auto& item : connecting_endpoints_) {
+    if (item.second == client) return true;
+  }
   for (const auto& item : pending_connections_) {
     auto& connection = item.second;
     if (!connection.is_incoming) {
@@ -709,6 +991,18 @@ void BasePcpHandler::ProcessPreConnectionInitiationFailure(
     ClientProxy* client, Medium medium, const std::string& endpoint_id,
     EndpointChannel* channel, bool is_incoming, absl::Time start_time,
     Status status, Future<Status>* result) {
+  ProcessConnectionAttemptFailure(client, medium, endpoint_id, channel,
+                                  is_incoming, start_time, status, result);
+  // result is hold inside a swapper, and saved in PendingConnectionInfo.
+  // PendingConnectionInfo destructor will clear the memory of SettableFuture
+  // shared_ptr for result.
+  pending_connections_.erase(endpoint_id);
+}
+
+void BasePcpHandler::ProcessConnectionAttemptFailure(
+    ClientProxy* client, Medium medium, const std::string& endpoint_id,
+    EndpointChannel* channel, bool is_incoming, absl::Time start_time,
+    Status status, Future<Status>* result) {
   if (channel != nullptr) {
     channel->Close();
   }
@@ -719,10 +1013,6 @@ void BasePcpHandler::ProcessPreConnectionInitiationFailure(
   }
 
   LogConnectionAttempt(client, medium, endpoint_id, is_incoming, start_time);
-  // result is hold inside a swapper, and saved in PendingConnectionInfo.
-  // PendingConnectionInfo destructor will clear the memory of SettableFuture
-  // shared_ptr for result.
-  pending_connections_.erase(endpoint_id);
 }
 
 void BasePcpHandler::ProcessPreConnectionResultFailure(
@@ -948,39 +1238,38 @@ BluetoothDevice BasePcpHandler::GetRemoteBluetoothDevice(
 void BasePcpHandler::OnEndpointFound(
     ClientProxy* client, std::shared_ptr<DiscoveredEndpoint> endpoint) {
   // Check if we've seen this endpoint ID before.
-  std::string& endpoint_id = endpoint->endpoint_id;
+  const std::string endpoint_id = endpoint->endpoint_id;
   NEARBY_LOGS(INFO) << "OnEndpointFound: id=" << endpoint_id << " [enter]";
 
-  auto range = discovered_endpoints_.equal_range(endpoint->endpoint_id);
-
-  DiscoveredEndpoint* owned_endpoint = nullptr;
-  for (auto& item = range.first; item != range.second; ++item) {
-    auto& discovered_endpoint = item->second;
-    if (discovered_endpoint->medium != endpoint->medium) continue;
+  auto& endpoints = discovered_endpoints_[endpoint_id];
+  auto item = endpoints.find(endpoint->medium);
+  if (item != endpoints.end()) {
+    DiscoveredEndpoint& discovered_endpoint = *item->second;
     // Check if there was a info change. If there was, report the previous
-    // endpoint as lost.
-    if (discovered_endpoint->endpoint_info != endpoint->endpoint_info) {
-      OnEndpointLost(client, *discovered_endpoint);
-      discovered_endpoint = endpoint;  // Replace endpoint.
+    // endpoint as lost, and this one as found.
+    if (discovered_endpoint.endpoint_info != endpoint->endpoint_info) {
+      OnEndpointLost(client, discovered_endpoint);
       OnEndpointFound(client, std::move(endpoint));
       return;
-    } else {
-      owned_endpoint = endpoint.get();
-      break;
     }
+    // Nothing changed but, possibly, the medium address; the latest one is
+    // the one the endpoint can be reached at.
+    if (endpoint->GetMediumAddress() !=
+        discovered_endpoint.GetMediumAddress()) {
+      RemoveDiscoveredEndpointId(discovered_endpoint);
+      AddDiscoveredEndpoint(std::move(endpoint));
+    }
+    return;
   }
 
-  if (!owned_endpoint) {
-    owned_endpoint =
-        discovered_endpoints_.emplace(endpoint_id, std::move(endpoint))
-            ->second.get();
-  }
+  bool is_new_endpoint = endpoints.empty();
+  DiscoveredEndpoint* owned_endpoint =
+      AddDiscoveredEndpoint(std::move(endpoint));
 
-  // Range is empty: this is the first endpoint we discovered so far.
-  // Report this endpoint_id to client.
-  if (range.first == range.second) {
+  if (is_new_endpoint) {
     NEARBY_LOGS(INFO) << "Adding new endpoint: endpoint_id=" << endpoint_id;
-    // And, as it's the first time, report it to the client.
+    // This is the first medium we discovered the endpoint on, so report it to
+    // the client.
     client->OnEndpointFound(
         owned_endpoint->service_id, owned_endpoint->endpoint_id,
         owned_endpoint->endpoint_info, owned_endpoint->medium);
@@ -992,11 +1281,22 @@ void BasePcpHandler::OnEndpointFound(
 
 void BasePcpHandler::OnEndpointLost(
     ClientProxy* client, const BasePcpHandler::DiscoveredEndpoint& endpoint) {
+  // |endpoint| may be the one we're about to drop, so hold on to what we need.
+  const std::string endpoint_id = endpoint.endpoint_id;
+  const std::string service_id = endpoint.service_id;
+
   // Look up the DiscoveredEndpoint we have in our cache.
-  const auto* discovered_endpoint = GetDiscoveredEndpoint(endpoint.endpoint_id);
-  if (discovered_endpoint == nullptr) {
+  auto endpoints = discovered_endpoints_.find(endpoint_id);
+  if (endpoints == discovered_endpoints_.end()) {
     NEARBY_LOGS(INFO) << "No previous endpoint (nothing to lose): endpoint_id="
-                      << endpoint.endpoint_id;
+                      << endpoint_id;
+    return;
+  }
+  auto item = endpoints->second.find(endpoint.medium);
+  if (item == endpoints->second.end()) {
+    NEARBY_LOGS(INFO) << "No previous endpoint on medium (nothing to lose): "
+                         "endpoint_id="
+                      << endpoint_id << "; medium=" << endpoint.medium;
     return;
   }
 
@@ -1004,18 +1304,67 @@ void BasePcpHandler::OnEndpointLost(
   // onLost. If the info differs, then no-op. This likely means that the remote
   // device changed their info. We reported onFound for the new info and are
   // just now figuring out that we lost the old info.
-  if (discovered_endpoint->endpoint_info != endpoint.endpoint_info) {
+  const DiscoveredEndpoint& discovered_endpoint = *item->second;
+  if (discovered_endpoint.endpoint_info != endpoint.endpoint_info) {
     NEARBY_LOGS(INFO) << "Previous endpoint name mismatch; passed="
                       << absl::BytesToHexString(endpoint.endpoint_info.data())
                       << "; expected="
                       << absl::BytesToHexString(
-                             discovered_endpoint->endpoint_info.data());
+                             discovered_endpoint.endpoint_info.data());
     return;
   }
 
-  auto item = discovered_endpoints_.extract(endpoint.endpoint_id);
-  if (!discovered_endpoints_.count(endpoint.endpoint_id)) {
-    client->OnEndpointLost(endpoint.service_id, endpoint.endpoint_id);
+  RemoveDiscoveredEndpointId(discovered_endpoint);
+  endpoints->second.erase(item);
+  if (endpoints->second.empty()) {
+    discovered_endpoints_.erase(endpoints);
+    client->OnEndpointLost(service_id, endpoint_id);
+  }
+}
+
+BasePcpHandler::DiscoveredEndpoint* BasePcpHandler::AddDiscoveredEndpoint(
+    std::shared_ptr<DiscoveredEndpoint> endpoint) {
+  std::string address = endpoint->GetMediumAddress();
+  if (!address.empty()) {
+    discovered_endpoint_ids_[std::make_pair(endpoint->medium, address)] =
+        endpoint->endpoint_id;
+  }
+  auto& endpoints = discovered_endpoints_[endpoint->endpoint_id];
+  auto& owned_endpoint = endpoints[endpoint->medium];
+  owned_endpoint = std::move(endpoint);
+  return owned_endpoint.get();
+}
+
+void BasePcpHandler::ScheduleDiscoveredEndpointsExpiry() {
+  discovered_endpoints_expiry_.Cancel();
+  discovered_endpoints_expiry_ = CancelableAlarm(
+      "BasePcpHandler.StopDiscovery() endpoints expiry",
+      [this, generation = discovery_generation_]() {
+        RunOnPcpHandlerThread(
+            "expire-discovered-endpoints",
+            [this, generation]() RUN_ON_PCP_HANDLER_THREAD() {
+              if (generation != discovery_generation_) return;
+              NEARBY_LOGS(INFO) << "Dropping " << discovered_endpoints_.size()
+                                << " discovered endpoints";
+              discovered_endpoints_.clear();
+            });
+      },
+      absl::Milliseconds(FeatureFlags::GetInstance()
+                             .GetFlags()
+                             .discovered_endpoints_expiry_millis),
+      &alarm_executor_);
+}
+
+void BasePcpHandler::RemoveDiscoveredEndpointId(
+    const DiscoveredEndpoint& endpoint) {
+  std::string address = endpoint.GetMediumAddress();
+  if (address.empty()) return;
+  auto item =
+      discovered_endpoint_ids_.find(std::make_pair(endpoint.medium, address));
+  // The address may have moved on to another endpoint since.
+  if (item != discovered_endpoint_ids_.end() &&
+      item->second == endpoint.endpoint_id) {
+    discovered_endpoint_ids_.erase(item);
   }
 }
 
@@ -1055,6 +1404,44 @@ Exception BasePcpHandler::OnIncomingConnection(
     proto::connections::Medium medium) {
   absl::Time start_time = SystemClock::ElapsedRealtime();
 
+  if (!FeatureFlags::GetInstance()
+           .GetFlags()
+           .enable_parallel_connection_setup) {
+    // Endpoints connecting to us will always tell us about themselves first.
+    ExceptionOr<OfflineFrame> wrapped_frame =
+        ReadConnectionRequestFrame(channel.get());
+    return OnIncomingConnectionRequest(client, remote_endpoint_info,
+                                       std::move(channel), medium, start_time,
+                                       std::move(wrapped_frame));
+  }
+
+  // Reading the ConnectionRequestFrame may take up to
+  // kConnectionRequestReadTimeout, so do it on a connection worker. Runnables
+  // must be copyable, so the channel is shared until it is handed over.
+  auto pending_channel = std::make_shared<PendingChannel>(std::move(channel));
+  RunOnConnectionWorker(
+      "read-connection-request",
+      [this, client, remote_endpoint_info, pending_channel, medium,
+       start_time]() {
+        ExceptionOr<OfflineFrame> wrapped_frame =
+            ReadConnectionRequestFrame(pending_channel->get());
+        RunOnPcpHandlerThread(
+            "on-connection-request",
+            [this, client, remote_endpoint_info, pending_channel, medium,
+             start_time, wrapped_frame]() RUN_ON_PCP_HANDLER_THREAD() {
+              OnIncomingConnectionRequest(client, remote_endpoint_info,
+                                          pending_channel->Take(), medium,
+                                          start_time, wrapped_frame);
+            });
+      });
+  return {Exception::kSuccess};
+}
+
+Exception BasePcpHandler::OnIncomingConnectionRequest(
+    ClientProxy* client, const ByteArray& remote_endpoint_info,
+    std::unique_ptr<EndpointChannel> channel,
+    proto::connections::Medium medium, absl::Time start_time,
+    ExceptionOr<OfflineFrame> wrapped_frame) {
   //  Fixes an NPE in ClientProxy.OnConnectionAccepted. The crash happened when
   //  the client stopped advertising and we nulled out state, followed by an
   //  incoming connection where we attempted to check that state.
@@ -1067,10 +1454,6 @@ Exception BasePcpHandler::OnIncomingConnection(
     return {Exception::kIo};
   }
 
-  // Endpoints connecting to us will always tell us about themselves first.
-  ExceptionOr<OfflineFrame> wrapped_frame =
-      ReadConnectionRequestFrame(channel.get());
-
   if (!wrapped_frame.ok()) {
     if (wrapped_frame.exception()) {
       NEARBY_LOGS(ERROR)
@@ -1260,19 +1643,17 @@ bool BasePcpHandler::AppendRemoteBluetoothMacAddressEndpoint(
     return false;
   }
 
-  auto it = discovered_endpoints_.equal_range(endpoint_id);
-  if (it.first == it.second) {
+  auto endpoint = GetDiscoveredEndpoint(endpoint_id);
+  if (!endpoint) {
     return false;
   }
-  auto endpoint = it.first->second.get();
-  for (auto item = it.first; item != it.second; item++) {
-    if (item->second->medium == proto::connections::Medium::BLUETOOTH) {
-      NEARBY_LOGS(INFO)
-          << "Cannot append remote Bluetooth MAC Address endpoint, because "
-             "the endpoint has already been found over Bluetooth ["
-          << remote_bluetooth_mac_address << "]";
-      return false;
-    }
+  if (discovered_endpoints_[endpoint_id].contains(
+          proto::connections::Medium::BLUETOOTH)) {
+    NEARBY_LOGS(INFO)
+        << "Cannot append remote Bluetooth MAC Address endpoint, because "
+           "the endpoint has already been found over Bluetooth ["
+        << remote_bluetooth_mac_address << "]";
+    return false;
   }
 
   auto remote_bluetooth_device =
@@ -1292,7 +1673,7 @@ bool BasePcpHandler::AppendRemoteBluetoothMacAddressEndpoint(
           remote_bluetooth_device,
       });
 
-  discovered_endpoints_.emplace(endpoint_id, std::move(bluetooth_endpoint));
+  AddDiscoveredEndpoint(std::move(bluetooth_endpoint));
   return true;
 }
 
@@ -1304,11 +1685,10 @@ bool BasePcpHandler::AppendWebRTCEndpoint(
   }
 
   bool should_connect_web_rtc = false;
-  auto it = discovered_endpoints_.equal_range(endpoint_id);
-  if (it.first == it.second) return false;
-  auto endpoint = it.first->second.get();
-  for (auto item = it.first; item != it.second; item++) {
-    if (item->second->web_rtc_state != WebRtcState::kUnconnectable) {
+  auto endpoint = GetDiscoveredEndpoint(endpoint_id);
+  if (!endpoint) return false;
+  for (const auto& item : discovered_endpoints_[endpoint_id]) {
+    if (item.second->web_rtc_state != WebRtcState::kUnconnectable) {
       should_connect_web_rtc = true;
       break;
     }
@@ -1322,7 +1702,7 @@ bool BasePcpHandler::AppendWebRTCEndpoint(
                                     endpoint->endpoint_info),
   });
 
-  discovered_endpoints_.emplace(endpoint_id, std::move(webrtc_endpoint));
+  AddDiscoveredEndpoint(std::move(webrtc_endpoint));
   return true;
 }
 
@@ -18,12 +18,13 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "securegcm/d2d_connection_context_v1.h"
 #include "securegcm/ukey2_handshake.h"
-#include "absl/container/btree_map.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/time/time.h"
 #include "core/internal/bwu_manager.h"
 #include "core/internal/client_proxy.h"
@@ -38,12 +39,14 @@
 #include "core/options.h"
 #include "core/status.h"
 #include "platform/base/byte_array.h"
+#include "platform/base/cancellation_flag.h"
 #include "platform/base/prng.h"
 #include "platform/public/atomic_boolean.h"
 #include "platform/public/atomic_reference.h"
 #include "platform/public/cancelable_alarm.h"
 #include "platform/public/count_down_latch.h"
 #include "platform/public/future.h"
+#include "platform/public/multi_thread_executor.h"
 #include "platform/public/scheduled_executor.h"
 #include "platform/public/single_thread_executor.h"
 #include "platform/public/system_clock.h"
@@ -139,6 +142,9 @@ class BasePcpHandler : public PcpHandler,
 
   Pcp GetPcp() const override { return pcp_; }
   Strategy GetStrategy() const override { return strategy_; }
+  // Stops handling frames from the EndpointManager, and waits for the
+  // connection workers to finish. Classes that implement ConnectImpl() call it
+  // from their destructor, if it was not called already.
   void DisconnectFromEndpointManager();
 
  protected:
@@ -176,6 +182,11 @@ class BasePcpHandler : public PcpHandler,
           web_rtc_state(web_rtc_state) {}
     virtual ~DiscoveredEndpoint() = default;
 
+    // Returns what identifies the remote device on |medium|, e.g. its
+    // Bluetooth MAC address, so that it can be looked up again when the
+    // medium reports it lost; or empty, if there is nothing to look it up by.
+    virtual std::string GetMediumAddress() const { return {}; }
+
     std::string endpoint_id;
     ByteArray endpoint_info;
     std::string service_id;
@@ -188,6 +199,11 @@ class BasePcpHandler : public PcpHandler,
         : DiscoveredEndpoint(std::move(endpoint)),
           bluetooth_device(std::move(device)) {}
 
+    std::string GetMediumAddress() const override {
+      return bluetooth_device.IsValid() ? bluetooth_device.GetMacAddress()
+                                        : std::string();
+    }
+
     BluetoothDevice bluetooth_device;
   };
 
@@ -195,6 +211,12 @@ class BasePcpHandler : public PcpHandler,
     BleEndpoint(DiscoveredEndpoint endpoint, BlePeripheral peripheral)
         : DiscoveredEndpoint(std::move(endpoint)),
           ble_peripheral(std::move(peripheral)) {}
+
+    std::string GetMediumAddress() const override {
+      return ble_peripheral.IsValid() ? ble_peripheral.GetName()
+                                      : std::string();
+    }
+
     BlePeripheral ble_peripheral;
   };
 
@@ -203,6 +225,14 @@ class BasePcpHandler : public PcpHandler,
         : DiscoveredEndpoint(std::move(endpoint)),
           wifi_lan_service(std::move(service)) {}
 
+    // The service name, rather than the IP address and port: those may be
+    // missing from the NsdServiceInfo the medium reports as lost.
+    std::string GetMediumAddress() const override {
+      return wifi_lan_service.IsValid()
+                 ? wifi_lan_service.GetServiceInfo().GetServiceInfoName()
+                 : std::string();
+    }
+
     WifiLanService wifi_lan_service;
   };
 
@@ -211,6 +241,8 @@ class BasePcpHandler : public PcpHandler,
         : DiscoveredEndpoint(std::move(endpoint)),
           peer_id(std::move(peer_id)) {}
 
+    std::string GetMediumAddress() const override { return peer_id.GetId(); }
+
     mediums::PeerId peer_id;
   };
 
@@ -223,6 +255,13 @@ class BasePcpHandler : public PcpHandler,
 
   void RunOnPcpHandlerThread(const std::string& name, Runnable runnable);
 
+  // Runs |runnable| on one of the connection workers. Blocking connection
+  // setup work runs there rather than on the PCP handler thread, so that a
+  // slow endpoint holds up neither other endpoints nor the PCP handler thread.
+  // Tasks on connection workers must not touch state owned by the PCP handler
+  // thread; they post back to it with RunOnPcpHandlerThread() instead.
+  void RunOnConnectionWorker(const std::string& name, Runnable runnable);
+
   BluetoothDevice GetRemoteBluetoothDevice(
       const std::string& remote_bluetooth_mac_address);
 
@@ -236,10 +275,14 @@ class BasePcpHandler : public PcpHandler,
   void OnEndpointLost(ClientProxy* client, const DiscoveredEndpoint& endpoint)
       RUN_ON_PCP_HANDLER_THREAD();
 
+  // Reads the ConnectionRequestFrame from |endpoint_channel| on a connection
+  // worker, and then sets up the incoming connection on the PCP handler
+  // thread.
   Exception OnIncomingConnection(
       ClientProxy* client, const ByteArray& remote_endpoint_info,
       std::unique_ptr<EndpointChannel> endpoint_channel,
-      proto::connections::Medium medium);  // throws Exception::IO
+      proto::connections::Medium medium)
+      RUN_ON_PCP_HANDLER_THREAD();  // throws Exception::IO
 
   virtual bool HasOutgoingConnections(ClientProxy* client) const;
   virtual bool HasIncomingConnections(ClientProxy* client) const;
@@ -268,22 +311,45 @@ class BasePcpHandler : public PcpHandler,
                                     const OutOfBandConnectionMetadata& metadata)
       RUN_ON_PCP_HANDLER_THREAD() = 0;
 
+  // Connects to |endpoint|. This runs on a connection worker, while the PCP
+  // handler thread goes on with other work, so it must not touch state owned
+  // by the PCP handler thread. |endpoint| stays alive until it returns.
   virtual ConnectImplResult ConnectImpl(ClientProxy* client,
-                                        DiscoveredEndpoint* endpoint)
-      RUN_ON_PCP_HANDLER_THREAD() = 0;
+                                        DiscoveredEndpoint* endpoint) = 0;
+
+  // Like ConnectImpl(), but gives up once |cancellation_flag| is cancelled,
+  // rather than once the client cancels the endpoint. Racing connects call
+  // this to stop the attempts that lost the race. The default implementation
+  // ignores |cancellation_flag|.
+  virtual ConnectImplResult ConnectImpl(ClientProxy* client,
+                                        DiscoveredEndpoint* endpoint,
+                                        CancellationFlag* cancellation_flag) {
+    return ConnectImpl(client, endpoint);
+  }
 
   virtual std::vector<proto::connections::Medium>
   GetConnectionMediumsByPriority() = 0;
   virtual proto::connections::Medium GetDefaultUpgradeMedium() = 0;
 
-  // Returns the first discovered endpoint for the given endpoint_id.
+  // Returns the discovered endpoint for the given endpoint_id on its most
+  // preferred medium, or nullptr if there is none.
   DiscoveredEndpoint* GetDiscoveredEndpoint(const std::string& endpoint_id);
 
+  // Returns the endpoint discovered on |medium| at |address|, as returned by
+  // DiscoveredEndpoint::GetMediumAddress(), or nullptr if there is none.
+  DiscoveredEndpoint* GetDiscoveredEndpoint(proto::connections::Medium medium,
+                                            const std::string& address);
+
   // Returns a vector of discovered endpoints, sorted in order of decreasing
   // preference.
   std::vector<BasePcpHandler::DiscoveredEndpoint*> GetDiscoveredEndpoints(
       const std::string& endpoint_id);
 
+  // Like GetDiscoveredEndpoints(endpoint_id), but shares ownership of the
+  // endpoints, so that they can be used off the PCP handler thread.
+  std::vector<std::shared_ptr<DiscoveredEndpoint>> ShareDiscoveredEndpoints(
+      const std::string& endpoint_id);
+
   // Returns a vector of discovered endpoints that share a given Medium.
   std::vector<BasePcpHandler::DiscoveredEndpoint*> GetDiscoveredEndpoints(
       const proto::connections::Medium medium);
@@ -385,6 +451,11 @@ class BasePcpHandler : public PcpHandler,
       absl::Seconds(2);
   static constexpr absl::Duration kRejectedConnectionCloseDelay =
       absl::Seconds(2);
+  static constexpr absl::Duration kConnectRaceCancelPollInterval =
+      absl::Milliseconds(100);
+  static constexpr int kConnectionWorkerCount = 4;
+  // Each connection worker may race a few mediums at a time.
+  static constexpr int kConnectRaceWorkerCount = 2 * kConnectionWorkerCount;
   static constexpr int kConnectionTokenLength = 8;
 
   void OnConnectionResponse(ClientProxy* client, const std::string& endpoint_id,
@@ -394,6 +465,20 @@ class BasePcpHandler : public PcpHandler,
   bool IsPreferred(const BasePcpHandler::DiscoveredEndpoint& new_endpoint,
                    const BasePcpHandler::DiscoveredEndpoint& old_endpoint);
 
+  // Adds |endpoint| to discovered_endpoints_, in place of any endpoint found
+  // with the same id on the same medium, and to discovered_endpoint_ids_.
+  DiscoveredEndpoint* AddDiscoveredEndpoint(
+      std::shared_ptr<DiscoveredEndpoint> endpoint) RUN_ON_PCP_HANDLER_THREAD();
+
+  // Removes |endpoint| from discovered_endpoint_ids_, unless its medium
+  // address has been taken over by another endpoint since.
+  void RemoveDiscoveredEndpointId(const DiscoveredEndpoint& endpoint)
+      RUN_ON_PCP_HANDLER_THREAD();
+
+  // Drops all of discovered_endpoints_ once discovered_endpoints_expiry_millis
+  // have passed, unless discovery is started again before that.
+  void ScheduleDiscoveredEndpointsExpiry() RUN_ON_PCP_HANDLER_THREAD();
+
   // Returns true, if connection party should respect the specified topology.
   bool ShouldEnforceTopologyConstraints(
       const ConnectionOptions& local_advertising_options) const;
@@ -431,6 +516,13 @@ class BasePcpHandler : public PcpHandler,
       ClientProxy* client, Medium medium, const std::string& endpoint_id,
       EndpointChannel* channel, bool is_incoming, absl::Time start_time,
       Status status, Future<Status>* result);
+  // Closes |channel|, fails |result| and logs the attempt, without touching
+  // pending_connections_. Used where the endpoint may already be pending on
+  // another channel, such as an outgoing connect that lost to an incoming one.
+  void ProcessConnectionAttemptFailure(
+      ClientProxy* client, Medium medium, const std::string& endpoint_id,
+      EndpointChannel* channel, bool is_incoming, absl::Time start_time,
+      Status status, Future<Status>* result);
   void ProcessPreConnectionResultFailure(ClientProxy* client,
                                          const std::string& endpoint_id);
 
@@ -458,6 +550,46 @@ class BasePcpHandler : public PcpHandler,
                                    const std::string& endpoint_id,
                                    bool is_incoming, absl::Time start_time);
 
+  // Connects to the endpoint over several of |endpoints| concurrently, in the
+  // order given (which is the order of preference). Attempts start
+  // FeatureFlags::connection_race_stagger_millis apart, or right away once all
+  // attempts in flight have failed. The most preferred attempt to succeed wins,
+  // as soon as no more preferred attempt is in flight, or once
+  // FeatureFlags::connection_race_grace_millis have passed since the first
+  // success. The others are cancelled, but not waited for; attempts that
+  // finish after the race close their channels themselves.
+  ConnectImplResult RaceConnectImpl(
+      ClientProxy* client, const std::string& endpoint_id,
+      const std::vector<std::shared_ptr<DiscoveredEndpoint>>& endpoints);
+
+  // Connects to the endpoint over the first of |endpoints| that works, or
+  // races them if FeatureFlags::enable_connection_racing is set. Blocks, so it
+  // runs on a connection worker unless parallel connection setup is disabled.
+  ConnectImplResult ConnectToEndpoint(
+      ClientProxy* client, const std::string& endpoint_id,
+      const std::vector<std::shared_ptr<DiscoveredEndpoint>>& endpoints);
+
+  // Finishes RequestConnection() once ConnectToEndpoint() is done: sends the
+  // ConnectionRequestFrame over the new channel and starts encryption, or
+  // fails |result|.
+  void OnOutgoingConnectionConnected(ClientProxy* client,
+                                     const std::string& endpoint_id,
+                                     const ConnectionRequestInfo& info,
+                                     const ConnectionOptions& options,
+                                     const ByteArray& remote_endpoint_info,
+                                     absl::Time start_time,
+                                     ConnectImplResult connect_impl_result,
+                                     std::shared_ptr<Future<Status>> result)
+      RUN_ON_PCP_HANDLER_THREAD();
+
+  // Finishes OnIncomingConnection() once the ConnectionRequestFrame has been
+  // read from |channel|.
+  Exception OnIncomingConnectionRequest(
+      ClientProxy* client, const ByteArray& remote_endpoint_info,
+      std::unique_ptr<EndpointChannel> channel,
+      proto::connections::Medium medium, absl::Time start_time,
+      ExceptionOr<OfflineFrame> wrapped_frame) RUN_ON_PCP_HANDLER_THREAD();
+
   // Returns true if the client cancels the operation in progress through the
   // endpoint id. This is done by CancellationFlag.
   static bool Cancelled(ClientProxy* client, const std::string& endpoint_id);
@@ -487,6 +619,9 @@ class BasePcpHandler : public PcpHandler,
 
   ScheduledExecutor alarm_executor_;
   SingleThreadExecutor serial_executor_;
+  MultiThreadExecutor connection_executor_{kConnectionWorkerCount};
+  // Runs the connect attempts of RaceConnectImpl().
+  MultiThreadExecutor connect_race_executor_{kConnectRaceWorkerCount};
 
   // A map of endpoint id -> PendingConnectionInfo. Entries in this map imply
   // that there is an active connection to the endpoint and we're waiting for
@@ -494,9 +629,28 @@ class BasePcpHandler : public PcpHandler,
   // the connection is decided (either accepted or rejected), it should be
   // removed from this map.
   absl::flat_hash_map<std::string, PendingConnectionInfo> pending_connections_;
-  // A map of endpoint id -> DiscoveredEndpoint.
-  absl::btree_multimap<std::string, std::shared_ptr<DiscoveredEndpoint>>
+  // A map of endpoint id -> client, for the endpoints that
+  // RequestConnection() is connecting to on a connection worker. They get an
+  // entry in pending_connections_ once connected.
+  absl::flat_hash_map<std::string, ClientProxy*> connecting_endpoints_;
+  // A map of endpoint id -> medium -> DiscoveredEndpoint.
+  absl::flat_hash_map<
+      std::string,
+      absl::flat_hash_map<proto::connections::Medium,
+                          std::shared_ptr<DiscoveredEndpoint>>>
       discovered_endpoints_;
+  // A map of (medium, medium address) -> endpoint id, for the endpoints in
+  // discovered_endpoints_ that have a medium address.
+  absl::flat_hash_map<std::pair<proto::connections::Medium, std::string>,
+                      std::string>
+      discovered_endpoint_ids_;
+  // The clients that are discovering. Discovered endpoints only expire once
+  // none is left.
+  absl::flat_hash_set<ClientProxy*> discovering_clients_;
+  // Incremented by every StartDiscovery(), so that an expiry that was already
+  // due can tell that discovery has restarted since.
+  std::int64_t discovery_generation_ = 0;
+  CancelableAlarm discovered_endpoints_expiry_;
   // A map of endpoint id -> alarm. These alarms delay closing the
   // EndpointChannel to give the other side enough time to read the rejection
   // message. It's expected that the other side will close the connection
@@ -31,9 +31,11 @@
 #include "core/params.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/exception.h"
+#include "platform/base/feature_flags.h"
 #include "platform/base/medium_environment.h"
 #include "platform/public/count_down_latch.h"
 #include "platform/public/pipe.h"
+#include "platform/public/single_thread_executor.h"
 #include "proto/connections/offline_wire_formats.pb.h"
 #include "proto/connections_enums.pb.h"
 
@@ -104,6 +106,7 @@ class MockPcpHandler : public BasePcpHandler {
   MockPcpHandler(Mediums* m, EndpointManager* em, EndpointChannelManager* ecm,
                  BwuManager* bwu)
       : BasePcpHandler(m, em, ecm, bwu, Pcp::kP2pCluster) {}
+  ~MockPcpHandler() override { DisconnectFromEndpointManager(); }
 
   // Expose protected inner types of a base type for mocking.
   using BasePcpHandler::ConnectImplResult;
@@ -165,6 +168,13 @@ class MockPcpHandler : public BasePcpHandler {
       const std::string& endpoint_id) {
     return BasePcpHandler::GetDiscoveredEndpoints(endpoint_id);
   }
+  DiscoveredEndpoint* GetDiscoveredEndpoint(const std::string& endpoint_id) {
+    return BasePcpHandler::GetDiscoveredEndpoint(endpoint_id);
+  }
+  DiscoveredEndpoint* GetDiscoveredEndpoint(proto::connections::Medium medium,
+                                            const std::string& address) {
+    return BasePcpHandler::GetDiscoveredEndpoint(medium, address);
+  }
 
   std::vector<proto::connections::Medium> GetDiscoveryMediums(
       ClientProxy* client) {
@@ -198,10 +208,16 @@ class MockContext {
 };
 
 struct MockDiscoveredEndpoint : public MockPcpHandler::DiscoveredEndpoint {
-  MockDiscoveredEndpoint(DiscoveredEndpoint endpoint, MockContext context)
-      : DiscoveredEndpoint(std::move(endpoint)), context(std::move(context)) {}
+  MockDiscoveredEndpoint(DiscoveredEndpoint endpoint, MockContext context,
+                         std::string address = {})
+      : DiscoveredEndpoint(std::move(endpoint)),
+        context(std::move(context)),
+        address(std::move(address)) {}
+
+  std::string GetMediumAddress() const override { return address; }
 
   MockContext context;
+  std::string address;
 };
 
 class BasePcpHandlerTest
@@ -779,6 +795,537 @@ TEST_F(BasePcpHandlerTest, InjectEndpoint) {
   env_.Stop();
 }
 
+TEST_F(BasePcpHandlerTest, IndexesDiscoveredEndpointsByMediumAddress) {
+  env_.Start();
+  std::string service_id{"service"};
+  std::string endpoint_id{"ABCD"};
+  ClientProxy client;
+  Mediums m;
+  EndpointChannelManager ecm;
+  EndpointManager em(&ecm);
+  BwuManager bwu(m, em, ecm, {}, {});
+  MockPcpHandler pcp_handler(&m, &em, &ecm, &bwu);
+  BooleanMediumSelector allowed{
+      .bluetooth = true,
+      .ble = true,
+  };
+  EXPECT_CALL(pcp_handler, StartDiscoveryImpl(&client, service_id, _))
+      .WillOnce(Return(MockPcpHandler::StartOperationResult{
+          .status = {Status::kSuccess},
+          .mediums = allowed.GetMediums(true),
+      }));
+  EXPECT_EQ(pcp_handler.StartDiscovery(&client, service_id,
+                                       {.allowed = allowed},
+                                       discovery_listener_),
+            Status{Status::kSuccess});
+  auto make_endpoint = [&](Medium medium, const std::string& address) {
+    return std::make_shared<MockDiscoveredEndpoint>(MockDiscoveredEndpoint{
+        {
+            endpoint_id,
+            /*endpoint_info=*/ByteArray{"ABCD"},
+            service_id,
+            medium,
+            WebRtcState::kUndefined,
+        },
+        MockContext{nullptr},
+        address,
+    });
+  };
+
+  // The client hears of the endpoint once, however many mediums find it.
+  EXPECT_CALL(mock_discovery_listener_.endpoint_found_cb, Call).Times(1);
+  pcp_handler.OnEndpointFound(&client,
+                              make_endpoint(Medium::BLUETOOTH, "mac"));
+  pcp_handler.OnEndpointFound(&client, make_endpoint(Medium::BLE, "name"));
+  pcp_handler.OnEndpointFound(&client, make_endpoint(Medium::BLE, "name"));
+  EXPECT_EQ(pcp_handler.GetDiscoveredEndpoints(endpoint_id).size(), 2);
+  EXPECT_EQ(pcp_handler.GetDiscoveredEndpoint(Medium::BLE, "mac"), nullptr);
+  auto* ble_endpoint = pcp_handler.GetDiscoveredEndpoint(Medium::BLE, "name");
+  ASSERT_NE(ble_endpoint, nullptr);
+  EXPECT_EQ(ble_endpoint->medium, Medium::BLE);
+
+  // A new medium address replaces the old one.
+  pcp_handler.OnEndpointFound(&client,
+                              make_endpoint(Medium::BLE, "new name"));
+  EXPECT_EQ(pcp_handler.GetDiscoveredEndpoint(Medium::BLE, "name"), nullptr);
+  ble_endpoint = pcp_handler.GetDiscoveredEndpoint(Medium::BLE, "new name");
+  ASSERT_NE(ble_endpoint, nullptr);
+
+  // Losing the endpoint on one medium leaves it found on the other.
+  pcp_handler.OnEndpointLost(&client, *ble_endpoint);
+  EXPECT_EQ(pcp_handler.GetDiscoveredEndpoint(Medium::BLE, "new name"),
+            nullptr);
+  auto endpoints = pcp_handler.GetDiscoveredEndpoints(endpoint_id);
+  ASSERT_EQ(endpoints.size(), 1);
+  EXPECT_EQ(endpoints[0]->medium, Medium::BLUETOOTH);
+
+  EXPECT_CALL(mock_discovery_listener_.endpoint_lost_cb, Call).Times(1);
+  pcp_handler.OnEndpointLost(
+      &client, *pcp_handler.GetDiscoveredEndpoint(Medium::BLUETOOTH, "mac"));
+  EXPECT_TRUE(pcp_handler.GetDiscoveredEndpoints(endpoint_id).empty());
+  EXPECT_EQ(pcp_handler.GetDiscoveredEndpoint(Medium::BLUETOOTH, "mac"),
+            nullptr);
+  bwu.Shutdown();
+  env_.Stop();
+}
+
+TEST_F(BasePcpHandlerTest, GetDiscoveredEndpointPrefersMediumByPriority) {
+  env_.Start();
+  std::string service_id{"service"};
+  std::string endpoint_id{"ABCD"};
+  ClientProxy client;
+  Mediums m;
+  EndpointChannelManager ecm;
+  EndpointManager em(&ecm);
+  BwuManager bwu(m, em, ecm, {}, {});
+  MockPcpHandler pcp_handler(&m, &em, &ecm, &bwu);
+  StartDiscovery(&client, &pcp_handler,
+                 BooleanMediumSelector{
+                     .bluetooth = true,
+                     .ble = true,
+                     .wifi_lan = true,
+                 });
+  EXPECT_CALL(mock_discovery_listener_.endpoint_found_cb, Call).Times(1);
+  for (Medium medium : {Medium::BLE, Medium::WIFI_LAN, Medium::BLUETOOTH}) {
+    pcp_handler.OnEndpointFound(
+        &client,
+        std::make_shared<MockDiscoveredEndpoint>(MockDiscoveredEndpoint{
+            {
+                endpoint_id,
+                /*endpoint_info=*/ByteArray{"ABCD"},
+                service_id,
+                medium,
+                WebRtcState::kUndefined,
+            },
+            MockContext{nullptr},
+        }));
+  }
+
+  // Whatever the order the mediums found it in.
+  auto* endpoint = pcp_handler.GetDiscoveredEndpoint(endpoint_id);
+  ASSERT_NE(endpoint, nullptr);
+  EXPECT_EQ(endpoint->medium, Medium::WIFI_LAN);
+  bwu.Shutdown();
+  env_.Stop();
+}
+
+TEST_F(BasePcpHandlerTest, DiscoveredEndpointsExpireAfterStopDiscovery) {
+  FeatureFlags::Flags saved_flags = FeatureFlags::GetInstance().GetFlags();
+  FeatureFlags::Flags flags = saved_flags;
+  flags.discovered_endpoints_expiry_millis = 100;
+  env_.SetFeatureFlags(flags);
+  env_.Start();
+  std::string endpoint_id{"ABCD"};
+  ClientProxy client;
+  Mediums m;
+  EndpointChannelManager ecm;
+  EndpointManager em(&ecm);
+  BwuManager bwu(m, em, ecm, {}, {});
+  MockPcpHandler pcp_handler(&m, &em, &ecm, &bwu);
+  StartDiscovery(&client, &pcp_handler,
+                 BooleanMediumSelector{
+                     .bluetooth = true,
+                 });
+  EXPECT_CALL(mock_discovery_listener_.endpoint_found_cb, Call).Times(1);
+  pcp_handler.OnEndpointFound(
+      &client, std::make_shared<MockDiscoveredEndpoint>(MockDiscoveredEndpoint{
+                   {
+                       endpoint_id,
+                       /*endpoint_info=*/ByteArray{"ABCD"},
+                       "service",
+                       Medium::BLUETOOTH,
+                       WebRtcState::kUndefined,
+                   },
+                   MockContext{nullptr},
+               }));
+  EXPECT_CALL(pcp_handler, StopDiscoveryImpl(&client)).Times(1);
+  pcp_handler.StopDiscovery(&client);
+
+  // Still there for a connection request right after discovery stopped.
+  EXPECT_NE(pcp_handler.GetDiscoveredEndpoint(endpoint_id), nullptr);
+  SystemClock::Sleep(absl::Milliseconds(500));
+  EXPECT_EQ(pcp_handler.GetDiscoveredEndpoint(endpoint_id), nullptr);
+  bwu.Shutdown();
+  env_.Stop();
+  env_.SetFeatureFlags(saved_flags);
+}
+
+TEST_F(BasePcpHandlerTest, RacingConnectDoesNotWaitForPreferredMedium) {
+  FeatureFlags::Flags saved_flags = FeatureFlags::GetInstance().GetFlags();
+  FeatureFlags::Flags flags = saved_flags;
+  flags.enable_connection_racing = true;
+  flags.connection_race_stagger_millis = 10;
+  env_.SetFeatureFlags(flags);
+  env_.Start();
+  std::string endpoint_id{"1234"};
+  ClientProxy client;
+  Mediums m;
+  EndpointChannelManager ecm;
+  EndpointManager em(&ecm);
+  BwuManager bwu(m, em, ecm, {}, {});
+  MockPcpHandler pcp_handler(&m, &em, &ecm, &bwu);
+  StartDiscovery(&client, &pcp_handler,
+                 BooleanMediumSelector{
+                     .bluetooth = true,
+                     .wifi_lan = true,
+                 });
+  auto channel_pair = SetupConnection(pipe_a_, pipe_b_, Medium::BLUETOOTH);
+  auto& channel_a = channel_pair.first;
+  auto& channel_b = channel_pair.second;
+  EXPECT_CALL(*channel_a, CloseImpl).Times(1);
+  EXPECT_CALL(*channel_b, CloseImpl).Times(1);
+  EXPECT_CALL(mock_connection_listener_.initiated_cb, Call).Times(1);
+  EXPECT_CALL(mock_connection_listener_.rejected_cb, Call).Times(AtLeast(0));
+  EXPECT_CALL(mock_discovery_listener_.endpoint_found_cb, Call);
+  EXPECT_CALL(pcp_handler, CanSendOutgoingConnection)
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(pcp_handler, GetStrategy)
+      .WillRepeatedly(Return(Strategy::kP2pCluster));
+
+  // WIFI_LAN is preferred over BLUETOOTH, but its connect only fails once the
+  // one over BLUETOOTH has started. Trying one medium after the other, it
+  // would time out instead.
+  CountDownLatch bluetooth_started(1);
+  std::atomic_bool wifi_lan_saw_bluetooth = false;
+  EXPECT_CALL(pcp_handler, ConnectImpl)
+      .Times(2)
+      .WillRepeatedly(Invoke([&](ClientProxy* client,
+                                 MockPcpHandler::DiscoveredEndpoint* endpoint) {
+        if (endpoint->medium == Medium::WIFI_LAN) {
+          wifi_lan_saw_bluetooth =
+              bluetooth_started.Await(absl::Seconds(1)).result();
+          return MockPcpHandler::ConnectImplResult{
+              .medium = Medium::WIFI_LAN,
+              .status = {Status::kWifiLanError},
+          };
+        }
+        bluetooth_started.CountDown();
+        return MockPcpHandler::ConnectImplResult{
+            .medium = Medium::BLUETOOTH,
+            .status = {Status::kSuccess},
+            .endpoint_channel = std::move(channel_a),
+        };
+      }));
+
+  ConnectionRequestInfo info{
+      .endpoint_info = ByteArray{"ABCD"},
+      .listener = connection_listener_,
+  };
+  for (Medium medium : {Medium::WIFI_LAN, Medium::BLUETOOTH}) {
+    pcp_handler.OnEndpointFound(
+        &client,
+        std::make_shared<MockDiscoveredEndpoint>(MockDiscoveredEndpoint{
+            {
+                endpoint_id,
+                info.endpoint_info,
+                "service",
+                medium,
+                WebRtcState::kUndefined,
+            },
+            MockContext{nullptr},
+        }));
+  }
+  ClientProxy other_client;
+  EncryptionRunner encryption_runner;
+  encryption_runner.StartServer(&other_client, endpoint_id, channel_b.get(),
+                                {});
+  ConnectionOptions options{
+      .keep_alive_interval_millis = flags.keep_alive_interval_millis,
+      .keep_alive_timeout_millis = flags.keep_alive_timeout_millis,
+  };
+  EXPECT_EQ(pcp_handler.RequestConnection(&client, endpoint_id, info, options),
+            Status{Status::kSuccess});
+  EXPECT_TRUE(wifi_lan_saw_bluetooth);
+
+  channel_b->Close();
+  bwu.Shutdown();
+  pcp_handler.DisconnectFromEndpointManager();
+  env_.Stop();
+  env_.SetFeatureFlags(saved_flags);
+}
+
+TEST_F(BasePcpHandlerTest, RacingConnectDoesNotWaitForLosers) {
+  FeatureFlags::Flags saved_flags = FeatureFlags::GetInstance().GetFlags();
+  FeatureFlags::Flags flags = saved_flags;
+  flags.enable_connection_racing = true;
+  flags.connection_race_stagger_millis = 10;
+  env_.SetFeatureFlags(flags);
+  env_.Start();
+  std::string endpoint_id{"1234"};
+  ClientProxy client;
+  Mediums m;
+  EndpointChannelManager ecm;
+  EndpointManager em(&ecm);
+  BwuManager bwu(m, em, ecm, {}, {});
+  MockPcpHandler pcp_handler(&m, &em, &ecm, &bwu);
+  StartDiscovery(&client, &pcp_handler,
+                 BooleanMediumSelector{
+                     .bluetooth = true,
+                     .wifi_lan = true,
+                 });
+  auto channel_pair = SetupConnection(pipe_a_, pipe_b_, Medium::WIFI_LAN);
+  auto& channel_a = channel_pair.first;
+  auto& channel_b = channel_pair.second;
+  EXPECT_CALL(*channel_a, CloseImpl).Times(1);
+  EXPECT_CALL(*channel_b, CloseImpl).Times(1);
+  EXPECT_CALL(mock_connection_listener_.initiated_cb, Call).Times(1);
+  EXPECT_CALL(mock_connection_listener_.rejected_cb, Call).Times(AtLeast(0));
+  EXPECT_CALL(mock_discovery_listener_.endpoint_found_cb, Call);
+  EXPECT_CALL(pcp_handler, CanSendOutgoingConnection)
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(pcp_handler, GetStrategy)
+      .WillRepeatedly(Return(Strategy::kP2pCluster));
+
+  // WIFI_LAN is preferred, and wins once the connect over BLUETOOTH has
+  // started. That one only gives up after RequestConnection() returned, so
+  // the race must not wait for it.
+  CountDownLatch bluetooth_started(1);
+  CountDownLatch request_done(1);
+  CountDownLatch bluetooth_done(1);
+  std::atomic_bool bluetooth_outlived_race = false;
+  EXPECT_CALL(pcp_handler, ConnectImpl)
+      .Times(2)
+      .WillRepeatedly(Invoke([&](ClientProxy* client,
+                                 MockPcpHandler::DiscoveredEndpoint* endpoint) {
+        if (endpoint->medium == Medium::WIFI_LAN) {
+          bluetooth_started.Await(absl::Seconds(1));
+          return MockPcpHandler::ConnectImplResult{
+              .medium = Medium::WIFI_LAN,
+              .status = {Status::kSuccess},
+              .endpoint_channel = std::move(channel_a),
+          };
+        }
+        bluetooth_started.CountDown();
+        bluetooth_outlived_race =
+            request_done.Await(absl::Seconds(2)).result();
+        bluetooth_done.CountDown();
+        return MockPcpHandler::ConnectImplResult{
+            .medium = Medium::BLUETOOTH,
+            .status = {Status::kBluetoothError},
+        };
+      }));
+
+  ConnectionRequestInfo info{
+      .endpoint_info = ByteArray{"ABCD"},
+      .listener = connection_listener_,
+  };
+  for (Medium medium : {Medium::WIFI_LAN, Medium::BLUETOOTH}) {
+    pcp_handler.OnEndpointFound(
+        &client,
+        std::make_shared<MockDiscoveredEndpoint>(MockDiscoveredEndpoint{
+            {
+                endpoint_id,
+                info.endpoint_info,
+                "service",
+                medium,
+                WebRtcState::kUndefined,
+            },
+            MockContext{nullptr},
+        }));
+  }
+  ClientProxy other_client;
+  EncryptionRunner encryption_runner;
+  encryption_runner.StartServer(&other_client, endpoint_id, channel_b.get(),
+                                {});
+  ConnectionOptions options{
+      .keep_alive_interval_millis = flags.keep_alive_interval_millis,
+      .keep_alive_timeout_millis = flags.keep_alive_timeout_millis,
+  };
+  EXPECT_EQ(pcp_handler.RequestConnection(&client, endpoint_id, info, options),
+            Status{Status::kSuccess});
+  request_done.CountDown();
+  EXPECT_TRUE(bluetooth_done.Await(absl::Seconds(3)).result());
+  EXPECT_TRUE(bluetooth_outlived_race);
+
+  channel_b->Close();
+  bwu.Shutdown();
+  pcp_handler.DisconnectFromEndpointManager();
+  env_.Stop();
+  env_.SetFeatureFlags(saved_flags);
+}
+
+TEST_F(BasePcpHandlerTest, SlowConnectDoesNotHoldUpOtherRequests) {
+  env_.Start();
+  std::string endpoint_id{"1234"};
+  ClientProxy client;
+  Mediums m;
+  EndpointChannelManager ecm;
+  EndpointManager em(&ecm);
+  BwuManager bwu(m, em, ecm, {}, {});
+  MockPcpHandler pcp_handler(&m, &em, &ecm, &bwu);
+  BooleanMediumSelector allowed{
+      .bluetooth = true,
+  };
+  StartDiscovery(&client, &pcp_handler, allowed);
+  EXPECT_CALL(mock_discovery_listener_.endpoint_found_cb, Call);
+  EXPECT_CALL(pcp_handler, CanSendOutgoingConnection)
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(pcp_handler, GetStrategy)
+      .WillRepeatedly(Return(Strategy::kP2pCluster));
+
+  // The connect to the endpoint only fails once the other request is done.
+  // Were both set up on the PCP handler thread, it would time out instead.
+  CountDownLatch connect_started(1);
+  CountDownLatch other_request_done(1);
+  std::atomic_bool connect_saw_other_request = false;
+  EXPECT_CALL(pcp_handler, ConnectImpl)
+      .WillOnce(Invoke([&](ClientProxy* client,
+                           MockPcpHandler::DiscoveredEndpoint* endpoint) {
+        connect_started.CountDown();
+        connect_saw_other_request =
+            other_request_done.Await(absl::Seconds(1)).result();
+        return MockPcpHandler::ConnectImplResult{
+            .medium = Medium::BLUETOOTH,
+            .status = {Status::kBluetoothError},
+        };
+      }));
+
+  ConnectionRequestInfo info{
+      .endpoint_info = ByteArray{"ABCD"},
+      .listener = connection_listener_,
+  };
+  pcp_handler.OnEndpointFound(
+      &client, std::make_shared<MockDiscoveredEndpoint>(MockDiscoveredEndpoint{
+                   {
+                       endpoint_id,
+                       info.endpoint_info,
+                       "service",
+                       Medium::BLUETOOTH,
+                       WebRtcState::kUndefined,
+                   },
+                   MockContext{nullptr},
+               }));
+  ConnectionOptions options{
+      .allowed = allowed,
+  };
+  Status slow_status;
+  SingleThreadExecutor executor;
+  executor.Execute([&]() {
+    slow_status =
+        pcp_handler.RequestConnection(&client, endpoint_id, info, options);
+  });
+  ASSERT_TRUE(connect_started.Await(absl::Seconds(1)).result());
+  EXPECT_EQ(pcp_handler.RequestConnection(&client, "unknown", info, options),
+            Status{Status::kEndpointUnknown});
+  other_request_done.CountDown();
+  executor.Shutdown();
+  EXPECT_EQ(slow_status, Status{Status::kBluetoothError});
+  EXPECT_TRUE(connect_saw_other_request);
+
+  bwu.Shutdown();
+  pcp_handler.DisconnectFromEndpointManager();
+  env_.Stop();
+}
+
+TEST_F(BasePcpHandlerTest, FailedConnectKeepsIncomingConnectionPending) {
+  env_.Start();
+  // The connect to the endpoint only fails once the endpoint has connected to
+  // us and we are running encryption on its channel. The handler owns the
+  // incoming channel, so everything its mock touches must outlive it.
+  CountDownLatch connect_started(1);
+  CountDownLatch incoming_pending(1);
+  std::atomic_int reads = 0;
+  std::atomic_bool incoming_closed = false;
+  std::string endpoint_id{"1234"};
+  ClientProxy client;
+  Mediums m;
+  EndpointChannelManager ecm;
+  EndpointManager em(&ecm);
+  BwuManager bwu(m, em, ecm, {}, {});
+  MockPcpHandler pcp_handler(&m, &em, &ecm, &bwu);
+  BooleanMediumSelector allowed{
+      .bluetooth = true,
+  };
+  StartAdvertising(&client, &pcp_handler, allowed);
+  StartDiscovery(&client, &pcp_handler, allowed);
+  EXPECT_CALL(mock_discovery_listener_.endpoint_found_cb, Call);
+  EXPECT_CALL(mock_connection_listener_.rejected_cb, Call).Times(AtLeast(0));
+  EXPECT_CALL(pcp_handler, CanSendOutgoingConnection)
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(pcp_handler, CanReceiveIncomingConnection)
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(pcp_handler, GetStrategy)
+      .WillRepeatedly(Return(Strategy::kP2pCluster));
+
+  EXPECT_CALL(pcp_handler, ConnectImpl)
+      .WillOnce(Invoke([&](ClientProxy* client,
+                           MockPcpHandler::DiscoveredEndpoint* endpoint) {
+        connect_started.CountDown();
+        incoming_pending.Await(absl::Seconds(1));
+        return MockPcpHandler::ConnectImplResult{
+            .medium = Medium::BLUETOOTH,
+            .status = {Status::kBluetoothError},
+        };
+      }));
+
+  ConnectionRequestInfo info{
+      .endpoint_info = ByteArray{"ABCD"},
+      .listener = connection_listener_,
+  };
+  pcp_handler.OnEndpointFound(
+      &client, std::make_shared<MockDiscoveredEndpoint>(MockDiscoveredEndpoint{
+                   {
+                       endpoint_id,
+                       info.endpoint_info,
+                       "service",
+                       Medium::BLUETOOTH,
+                       WebRtcState::kUndefined,
+                   },
+                   MockContext{nullptr},
+               }));
+  ConnectionOptions options{
+      .allowed = allowed,
+  };
+  Status connect_status;
+  SingleThreadExecutor executor;
+  executor.Execute([&]() {
+    connect_status =
+        pcp_handler.RequestConnection(&client, endpoint_id, info, options);
+  });
+  ASSERT_TRUE(connect_started.Await(absl::Seconds(1)).result());
+
+  // The first read on the incoming channel is the ConnectionRequestFrame; the
+  // second one comes from the encryption server, once the incoming connection
+  // is pending.
+  auto channel_pair = SetupConnection(pipe_a_, pipe_b_, Medium::BLUETOOTH);
+  auto& channel_a = channel_pair.first;
+  auto& channel_b = channel_pair.second;
+  EXPECT_CALL(*channel_a, Read())
+      .WillRepeatedly(Invoke([&, channel = channel_a.get()]() {
+        if (++reads == 2) incoming_pending.CountDown();
+        return channel->DoRead();
+      }));
+  EXPECT_CALL(*channel_a, CloseImpl).WillRepeatedly(Invoke([&]() {
+    incoming_closed = true;
+  }));
+  EXPECT_TRUE(channel_b
+                  ->DoWrite(parser::ForConnectionRequest(
+                      endpoint_id, info.endpoint_info, /*nonce=*/1234,
+                      /*supports_5_ghz=*/false, /*bssid=*/"", {},
+                      /*keep_alive_interval_millis=*/0,
+                      /*keep_alive_timeout_millis=*/0))
+                  .Ok());
+  EXPECT_TRUE(pcp_handler
+                  .OnIncomingConnection(&client, info.endpoint_info,
+                                        std::move(channel_a),
+                                        Medium::BLUETOOTH)
+                  .Ok());
+  ASSERT_TRUE(incoming_pending.Await(absl::Seconds(1)).result());
+  executor.Shutdown();
+  EXPECT_EQ(connect_status, Status{Status::kBluetoothError});
+
+  // Wait for the failed connect to be handled on the PCP handler thread. It
+  // must not tear down the incoming connection under the encryption server.
+  EXPECT_EQ(pcp_handler.RequestConnection(&client, "unknown", info, options),
+            Status{Status::kEndpointUnknown});
+  EXPECT_FALSE(incoming_closed);
+
+  channel_b->Close();
+  bwu.Shutdown();
+  pcp_handler.DisconnectFromEndpointManager();
+  env_.Stop();
+}
+
 }  // namespace
 }  // namespace connections
 }  // namespace nearby
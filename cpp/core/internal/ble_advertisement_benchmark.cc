@@ -0,0 +1,111 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Serialization and parsing of BLE advertisements, across endpoint info
+// lengths.
+//
+// Run with:
+//   blaze run -c opt //core/internal:ble_advertisement_benchmark -- \
+//     --benchmark_filter=all
+
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "core/internal/ble_advertisement.h"
+#include "platform/base/allocation_counter.h"
+#include "platform/base/byte_array.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace {
+
+constexpr BleAdvertisement::Version kVersion = BleAdvertisement::Version::kV1;
+constexpr Pcp kPcp = Pcp::kP2pCluster;
+constexpr char kServiceIdHashBytes[] = "\x0a\x0b\x0c";
+constexpr char kEndpointId[] = "AB12";
+constexpr char kBluetoothMacAddress[] = "00:00:E6:88:64:13";
+
+// Returns an advertisement with |state.range(0)| bytes of endpoint info.
+BleAdvertisement MakeAdvertisement(benchmark::State& state) {
+  return BleAdvertisement(
+      kVersion, kPcp, ByteArray(std::string(kServiceIdHashBytes)),
+      kEndpointId, ByteArray(std::string(state.range(0), 'i')),
+      kBluetoothMacAddress, ByteArray{}, WebRtcState::kConnectable);
+}
+
+// Returns a fast advertisement with |state.range(0)| bytes of endpoint info.
+BleAdvertisement MakeFastAdvertisement(benchmark::State& state) {
+  return BleAdvertisement(kVersion, kPcp, kEndpointId,
+                          ByteArray(std::string(state.range(0), 'i')),
+                          ByteArray{});
+}
+
+void BM_Serialize(benchmark::State& state) {
+  BleAdvertisement advertisement = MakeAdvertisement(state);
+  AllocationCounter counter;
+  for (auto _ : state) {
+    ByteArray bytes(advertisement);
+    benchmark::DoNotOptimize(bytes.data());
+  }
+  SetAllocationCounters(state, counter);
+}
+BENCHMARK(BM_Serialize)
+    ->Arg(1)
+    ->Arg(16)
+    ->Arg(64)
+    ->Arg(BleAdvertisement::kMaxEndpointInfoLength);
+
+void BM_Parse(benchmark::State& state) {
+  ByteArray bytes(MakeAdvertisement(state));
+  AllocationCounter counter;
+  for (auto _ : state) {
+    BleAdvertisement advertisement(/*fast_advertisement=*/false, bytes);
+    if (!advertisement.IsValid()) {
+      state.SkipWithError("Failed to parse");
+      break;
+    }
+    benchmark::DoNotOptimize(advertisement);
+  }
+  SetAllocationCounters(state, counter);
+  state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_Parse)
+    ->Arg(1)
+    ->Arg(16)
+    ->Arg(64)
+    ->Arg(BleAdvertisement::kMaxEndpointInfoLength);
+
+void BM_ParseFast(benchmark::State& state) {
+  ByteArray bytes(MakeFastAdvertisement(state));
+  AllocationCounter counter;
+  for (auto _ : state) {
+    BleAdvertisement advertisement(/*fast_advertisement=*/true, bytes);
+    if (!advertisement.IsValid()) {
+      state.SkipWithError("Failed to parse");
+      break;
+    }
+    benchmark::DoNotOptimize(advertisement);
+  }
+  SetAllocationCounters(state, counter);
+  state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_ParseFast)
+    ->Arg(1)
+    ->Arg(BleAdvertisement::kMaxFastEndpointInfoLength);
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
@@ -35,6 +35,9 @@ class BleEndpointChannel final : public BaseEndpointChannel {
   static constexpr int kDefaultBleMaxTransmitPacketSize = 512;  // 512 bytes
 
   void CloseImpl() override;
+  int GetMaxAdaptiveTransmitPacketSize() const override {
+    return GetMaxTransmitPacketSize();
+  }
 
   BleSocket ble_socket_;
 };
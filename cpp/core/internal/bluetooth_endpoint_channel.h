@@ -38,6 +38,9 @@ class BluetoothEndpointChannel final : public BaseEndpointChannel {
   static constexpr int kDefaultBTMaxTransmitPacketSize = 1980;  // 990 * 2 Bytes
 
   void CloseImpl() override;
+  int GetMaxAdaptiveTransmitPacketSize() const override {
+    return GetMaxTransmitPacketSize();
+  }
 
   BluetoothSocket bluetooth_socket_;
 };
@@ -484,6 +484,10 @@ void BwuManager::RunUpgradeProtocol(
   }
   channel_manager_->ReplaceChannelForEndpoint(client, endpoint_id,
                                               std::move(new_channel));
+  // Payload chunks still queued for this endpoint now go out over the new
+  // channel; only wait for one that is being written to the old channel.
+  endpoint_manager_->WaitForPayloadWritesToChannel(endpoint_id,
+                                                   old_channel.get());
 
   // Next, initiate a clean shutdown for the previous EndpointChannel used for
   // this endpoint by telling the remote device that it will not receive any
@@ -391,6 +391,13 @@ BooleanMediumSelector ClientProxy::GetUpgradeMediums(
   return {};
 }
 
+bool ClientProxy::UsesAdaptiveChunkSize(const std::string& endpoint_id) const {
+  MutexLock lock(&mutex_);
+
+  const Connection* item = LookupConnection(endpoint_id);
+  return item != nullptr && item->connection_options.adaptive_chunk_size;
+}
+
 bool ClientProxy::IsConnectedToEndpoint(const std::string& endpoint_id) const {
   return ConnectionStatusMatches(endpoint_id, Connection::kConnected);
 }
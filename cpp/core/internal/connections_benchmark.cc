@@ -0,0 +1,542 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// End-to-end benchmarks of the offline connections stack, run between
+// OfflineSimulationUser pairs over the simulated mediums of
+// MediumEnvironment.
+//
+// Each of the 1..N endpoints is its own advertiser/discoverer pair on a
+// service id of its own, and all pairs run at the same time. Benchmarks are
+// parameterized by medium, strategy and, where it applies, endpoint count and
+// payload size; the label of each result names the medium and strategy.
+//
+// Results are machine-readable with --benchmark_format=json (or csv), e.g.:
+//   blaze run -c opt //core/internal:connections_benchmark -- \
+//     --benchmark_format=json --benchmark_out=/tmp/connections.json
+//
+// File payloads are not covered: in a single process, the sender and the
+// receiver of a payload share its file path.
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "securegcm/ukey2_handshake.h"
+#include "benchmark/benchmark.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "core/internal/base_endpoint_channel.h"
+#include "core/internal/client_proxy.h"
+#include "core/internal/encryption_runner.h"
+#include "core/internal/offline_simulation_user.h"
+#include "core/listeners.h"
+#include "core/options.h"
+#include "core/payload.h"
+#include "core/strategy.h"
+#include "platform/base/byte_array.h"
+#include "platform/base/input_stream.h"
+#include "platform/base/medium_environment.h"
+#include "platform/base/output_stream.h"
+#include "platform/public/count_down_latch.h"
+#include "platform/public/multi_thread_executor.h"
+#include "platform/public/pipe.h"
+#include "proto/connections_enums.pb.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace {
+
+constexpr absl::Duration kTimeout = absl::Seconds(10);
+constexpr std::int64_t kMegabyte = 1024 * 1024;
+constexpr char kServiceIdPrefix[] = "service-id-";
+// Setting up and tearing down the simulated endpoints takes seconds, so the
+// end-to-end benchmarks run a fixed number of iterations rather than
+// calibrating it.
+constexpr int kSetupIterations = 10;
+constexpr int kTransferIterations = 20;
+constexpr int kLatencyIterations = 200;
+
+// Medium and strategy benchmark arguments index these.
+constexpr const char* kMediumNames[] = {"bluetooth", "wifi_lan"};
+const Strategy* const kStrategies[] = {
+    &Strategy::kP2pCluster,
+    &Strategy::kP2pStar,
+    &Strategy::kP2pPointToPoint,
+};
+
+BooleanMediumSelector GetMedium(benchmark::State& state) {
+  return state.range(0) == 0 ? BooleanMediumSelector{.bluetooth = true}
+                             : BooleanMediumSelector{.wifi_lan = true};
+}
+
+const Strategy& GetStrategy(benchmark::State& state) {
+  return *kStrategies[state.range(1)];
+}
+
+void SetLabel(benchmark::State& state) {
+  state.SetLabel(absl::StrCat(kMediumNames[state.range(0)], "/",
+                              GetStrategy(state).GetName()));
+}
+
+// Returns a freshly started MediumEnvironment, without the mediums of any
+// previous run.
+MediumEnvironment& StartEnvironment() {
+  MediumEnvironment& env = MediumEnvironment::Instance();
+  env.Stop();
+  env.Start();
+  return env;
+}
+
+// Time spent in each phase of connecting a batch of discovered endpoints.
+struct SetupTimes {
+  absl::Duration connection;  // Includes the UKEY2 handshake.
+  absl::Duration acceptance;
+};
+
+// An advertiser that sends payloads to a discoverer that receives them.
+struct Link {
+  Link(int index, BooleanMediumSelector allowed, const Strategy& strategy)
+      : service_id(absl::StrCat(kServiceIdPrefix, index)),
+        advertiser(absl::StrCat("advertiser-", index), allowed, strategy),
+        discoverer(absl::StrCat("discoverer-", index), allowed, strategy) {}
+  ~Link() {
+    advertiser.Stop();
+    discoverer.Stop();
+  }
+
+  std::string service_id;
+  OfflineSimulationUser advertiser;
+  OfflineSimulationUser discoverer;
+};
+
+std::vector<std::unique_ptr<Link>> MakeLinks(benchmark::State& state,
+                                             int count) {
+  std::vector<std::unique_ptr<Link>> links;
+  links.reserve(count);
+  for (int i = 0; i < count; i++) {
+    links.push_back(
+        std::make_unique<Link>(i, GetMedium(state), GetStrategy(state)));
+  }
+  return links;
+}
+
+// Starts advertising and discovery on all |links| at the same time, and
+// waits until every discoverer has found its advertiser.
+bool Discover(const std::vector<std::unique_ptr<Link>>& links) {
+  CountDownLatch found_latch(links.size());
+  for (auto& link : links) {
+    if (!link->advertiser.StartAdvertising(link->service_id, nullptr).Ok() ||
+        !link->discoverer.StartDiscovery(link->service_id, &found_latch)
+             .Ok()) {
+      return false;
+    }
+  }
+  return found_latch.Await(kTimeout).result();
+}
+
+// Connects all discovered |links| at the same time. If |times| is not null,
+// adds how long each phase took to it.
+bool Connect(const std::vector<std::unique_ptr<Link>>& links,
+             SetupTimes* times) {
+  const int count = links.size();
+  CountDownLatch initiated_latch(2 * count);
+  CountDownLatch accept_latch(2 * count);
+
+  absl::Time start = absl::Now();
+  for (auto& link : links) {
+    link->advertiser.ExpectConnectionInitiated(initiated_latch);
+    if (!link->discoverer.RequestConnection(&initiated_latch).Ok()) {
+      return false;
+    }
+  }
+  if (!initiated_latch.Await(kTimeout).result()) return false;
+  absl::Time initiated = absl::Now();
+  for (auto& link : links) {
+    if (!link->advertiser.AcceptConnection(&accept_latch).Ok() ||
+        !link->discoverer.AcceptConnection(&accept_latch).Ok()) {
+      return false;
+    }
+  }
+  if (!accept_latch.Await(kTimeout).result()) return false;
+  absl::Time accepted = absl::Now();
+
+  if (times) {
+    times->connection += initiated - start;
+    times->acceptance += accepted - initiated;
+  }
+  return true;
+}
+
+// Runs |task| on all |links| at the same time, and waits for it to finish:
+// disconnecting and stopping endpoints takes a while, but they do not wait
+// for each other.
+void ForEachLink(std::vector<std::unique_ptr<Link>>& links,
+                 std::function<void(std::unique_ptr<Link>&)> task) {
+  MultiThreadExecutor executor(links.size());
+  CountDownLatch latch(links.size());
+  for (auto& link : links) {
+    executor.Execute([&task, &link, &latch]() {
+      task(link);
+      latch.CountDown();
+    });
+  }
+  latch.Await();
+}
+
+// Disconnects all connected |links|, and waits until both sides of each
+// have seen it.
+bool Disconnect(std::vector<std::unique_ptr<Link>>& links) {
+  CountDownLatch disconnect_latch(2 * links.size());
+  for (auto& link : links) {
+    link->advertiser.ExpectDisconnect(disconnect_latch);
+    link->discoverer.ExpectDisconnect(disconnect_latch);
+  }
+  ForEachLink(links, [](std::unique_ptr<Link>& link) {
+    link->discoverer.Disconnect();
+  });
+  return disconnect_latch.Await(kTimeout).result();
+}
+
+// Stops and destroys all |links|.
+void Destroy(std::vector<std::unique_ptr<Link>>& links) {
+  ForEachLink(links, [](std::unique_ptr<Link>& link) { link.reset(); });
+  links.clear();
+}
+
+// Makes |count| links, and connects them.
+std::vector<std::unique_ptr<Link>> MakeConnectedLinks(benchmark::State& state,
+                                                      int count) {
+  auto links = MakeLinks(state, count);
+  if (!Discover(links) || !Connect(links, nullptr)) {
+    state.SkipWithError("Failed to connect");
+  }
+  return links;
+}
+
+// Waits until |user| has received all of payload |payload_id|.
+bool WaitForPayload(OfflineSimulationUser& user, Payload::Id payload_id) {
+  return user.WaitForProgress(
+      [payload_id](const PayloadProgressInfo& info) {
+        return info.payload_id == payload_id &&
+               info.status == PayloadProgressInfo::Status::kSuccess;
+      },
+      kTimeout);
+}
+
+double Milliseconds(absl::Duration duration) {
+  return absl::ToDoubleMilliseconds(duration);
+}
+
+// Process CPU time, across all threads.
+double CpuMilliseconds() {
+  return 1000.0 * std::clock() / CLOCKS_PER_SEC;
+}
+
+// Reports the process CPU time spent per megabyte transferred.
+void SetCpuPerMegabyte(benchmark::State& state, double cpu_ms,
+                       std::int64_t bytes) {
+  if (bytes == 0) return;
+  state.counters["cpu_ms_per_mb"] = cpu_ms * kMegabyte / bytes;
+}
+
+// Registers the benchmark for every medium and strategy, with each of
+// |endpoints| and, if any, |sizes|.
+void MediumsAndStrategies(benchmark::internal::Benchmark* benchmark,
+                          const std::vector<std::int64_t>& endpoints,
+                          const std::vector<std::int64_t>& sizes) {
+  for (int medium = 0; medium < std::size(kMediumNames); medium++) {
+    for (int strategy = 0; strategy < std::size(kStrategies); strategy++) {
+      for (std::int64_t count : endpoints) {
+        if (sizes.empty()) {
+          benchmark->Args({medium, strategy, count});
+        }
+        for (std::int64_t size : sizes) {
+          benchmark->Args({medium, strategy, count, size});
+        }
+      }
+    }
+  }
+}
+
+// Args: medium, strategy, endpoints.
+//
+// The endpoints stay discovered between iterations: each iteration connects
+// and then disconnects all of them. Discovery is timed once, up front.
+void BM_ConnectionSetup(benchmark::State& state) {
+  SetLabel(state);
+  MediumEnvironment& env = StartEnvironment();
+  auto links = MakeLinks(state, state.range(2));
+  absl::Time start = absl::Now();
+  if (!Discover(links)) {
+    state.SkipWithError("Failed to discover");
+  }
+  absl::Duration discovery = absl::Now() - start;
+  SetupTimes total{};
+  for (auto _ : state) {
+    if (state.error_occurred()) break;
+    if (!Connect(links, &total)) {
+      state.SkipWithError("Failed to connect");
+      break;
+    }
+    state.PauseTiming();
+    if (!Disconnect(links)) {
+      state.SkipWithError("Failed to disconnect");
+    }
+    state.ResumeTiming();
+  }
+  using Counter = benchmark::Counter;
+  state.counters["discovery_ms"] = Milliseconds(discovery);
+  state.counters["connection_ms"] =
+      Counter(Milliseconds(total.connection), Counter::kAvgIterations);
+  state.counters["acceptance_ms"] =
+      Counter(Milliseconds(total.acceptance), Counter::kAvgIterations);
+  Destroy(links);
+  env.Stop();
+}
+BENCHMARK(BM_ConnectionSetup)
+    ->ArgNames({"medium", "strategy", "endpoints"})
+    ->Apply([](benchmark::internal::Benchmark* benchmark) {
+      MediumsAndStrategies(benchmark, {1, 2, 4}, {});
+    })
+    ->Iterations(kSetupIterations)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// A BaseEndpointChannel over a pair of pipes, for UKEY2 alone.
+class PipeEndpointChannel : public BaseEndpointChannel {
+ public:
+  PipeEndpointChannel(InputStream* input, OutputStream* output)
+      : BaseEndpointChannel("channel", input, output) {}
+
+  proto::connections::Medium GetMedium() const override {
+    return proto::connections::Medium::BLUETOOTH;
+  }
+
+ private:
+  void CloseImpl() override {}
+};
+
+// The UKEY2 handshake run by EncryptionRunner when a connection is set up,
+// without the medium: both sides exchange handshake frames through pipes.
+void BM_Ukey2Handshake(benchmark::State& state) {
+  Pipe pipe_a;  // channel_a writes to pipe_a, reads from pipe_b.
+  Pipe pipe_b;  // channel_b writes to pipe_b, reads from pipe_a.
+  PipeEndpointChannel channel_a(&pipe_b.GetInputStream(),
+                                &pipe_a.GetOutputStream());
+  PipeEndpointChannel channel_b(&pipe_a.GetInputStream(),
+                                &pipe_b.GetOutputStream());
+  ClientProxy client_a;
+  ClientProxy client_b;
+  EncryptionRunner runner_a;
+  EncryptionRunner runner_b;
+  for (auto _ : state) {
+    CountDownLatch latch(2);
+    int succeeded = 0;
+    auto make_listener = [&latch, &succeeded]() {
+      return EncryptionRunner::ResultListener{
+          .on_success_cb =
+              [&latch, &succeeded](
+                  const std::string& endpoint_id,
+                  std::unique_ptr<securegcm::UKey2Handshake> ukey2,
+                  const std::string& auth_token,
+                  const ByteArray& raw_auth_token) {
+                if (ukey2->VerifyHandshake()) succeeded++;
+                latch.CountDown();
+              },
+          .on_failure_cb =
+              [&latch](const std::string& endpoint_id,
+                       EndpointChannel* channel) { latch.CountDown(); },
+      };
+    };
+    runner_a.StartClient(&client_a, "endpoint-a", &channel_a,
+                         make_listener());
+    runner_b.StartServer(&client_b, "endpoint-b", &channel_b,
+                         make_listener());
+    if (!latch.Await(kTimeout).result() || succeeded != 2) {
+      state.SkipWithError("Handshake failed");
+      break;
+    }
+  }
+}
+BENCHMARK(BM_Ukey2Handshake)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Args: medium, strategy, endpoints, payload size.
+//
+// Every endpoint sends a bytes payload per iteration; the iteration ends
+// when all of them have been received.
+void BM_BytesThroughput(benchmark::State& state) {
+  SetLabel(state);
+  MediumEnvironment& env = StartEnvironment();
+  auto links = MakeConnectedLinks(state, state.range(2));
+  const ByteArray data(std::string(state.range(3), 'b'));
+  double cpu_ms = 0;
+  for (auto _ : state) {
+    if (state.error_occurred()) break;
+    double cpu_start = CpuMilliseconds();
+    std::vector<Payload::Id> payload_ids;
+    for (auto& link : links) {
+      Payload payload(data);
+      payload_ids.push_back(payload.GetId());
+      link->advertiser.SendPayload(std::move(payload));
+    }
+    for (int i = 0; i < links.size(); i++) {
+      if (!WaitForPayload(links[i]->discoverer, payload_ids[i])) {
+        state.SkipWithError("Payload was not received");
+        break;
+      }
+    }
+    cpu_ms += CpuMilliseconds() - cpu_start;
+  }
+  std::int64_t bytes = state.iterations() * links.size() * data.size();
+  state.SetBytesProcessed(bytes);
+  SetCpuPerMegabyte(state, cpu_ms, bytes);
+  Destroy(links);
+  env.Stop();
+}
+// A bytes payload is sent as a single frame, which has to fit in the 1 MB
+// that endpoint channels read at most.
+BENCHMARK(BM_BytesThroughput)
+    ->ArgNames({"medium", "strategy", "endpoints", "size"})
+    ->Apply([](benchmark::internal::Benchmark* benchmark) {
+      MediumsAndStrategies(benchmark, {1, 2, 4}, {64 * 1024, 512 * 1024});
+    })
+    ->Iterations(kTransferIterations)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Args: medium, strategy, endpoints, payload size.
+//
+// Every endpoint streams the given number of bytes per iteration, and the
+// receivers read all of them back from their payloads.
+void BM_StreamThroughput(benchmark::State& state) {
+  SetLabel(state);
+  MediumEnvironment& env = StartEnvironment();
+  auto links = MakeConnectedLinks(state, state.range(2));
+  const std::int64_t size = state.range(3);
+  const ByteArray chunk(std::string(Pipe::kChunkSize, 's'));
+  double cpu_ms = 0;
+  for (auto _ : state) {
+    if (state.error_occurred()) break;
+    double cpu_start = CpuMilliseconds();
+    std::vector<std::unique_ptr<CountDownLatch>> latches;
+    std::vector<Payload::Id> payload_ids;
+    for (auto& link : links) {
+      latches.push_back(std::make_unique<CountDownLatch>(1));
+      link->discoverer.ExpectPayload(*latches.back());
+      auto pipe = std::make_shared<Pipe>();
+      Payload payload([pipe]() -> InputStream& {
+        return pipe->GetInputStream();  // NOLINT
+      });
+      payload_ids.push_back(payload.GetId());
+      link->advertiser.SendPayload(std::move(payload));
+      OutputStream& tx = pipe->GetOutputStream();
+      for (std::int64_t sent = 0; sent < size; sent += chunk.size()) {
+        tx.Write(chunk);
+      }
+      tx.Close();
+    }
+    for (int i = 0; i < links.size(); i++) {
+      OfflineSimulationUser& receiver = links[i]->discoverer;
+      if (!latches[i]->Await(kTimeout).result()) {
+        state.SkipWithError("Payload was not received");
+        break;
+      }
+      InputStream* rx = receiver.GetPayload().AsStream();
+      std::int64_t received = 0;
+      while (rx && received < size) {
+        ExceptionOr<ByteArray> read = rx->Read(Pipe::kChunkSize);
+        if (!read.ok() || read.result().Empty()) break;
+        received += read.result().size();
+      }
+      if (received < size || !WaitForPayload(receiver, payload_ids[i])) {
+        state.SkipWithError("Stream was not received");
+        break;
+      }
+    }
+    cpu_ms += CpuMilliseconds() - cpu_start;
+  }
+  std::int64_t bytes = state.iterations() * links.size() * size;
+  state.SetBytesProcessed(bytes);
+  SetCpuPerMegabyte(state, cpu_ms, bytes);
+  Destroy(links);
+  env.Stop();
+}
+BENCHMARK(BM_StreamThroughput)
+    ->ArgNames({"medium", "strategy", "endpoints", "size"})
+    ->Apply([](benchmark::internal::Benchmark* benchmark) {
+      MediumsAndStrategies(benchmark, {1, 2, 4}, {1 * kMegabyte});
+    })
+    ->Iterations(kTransferIterations)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Args: medium, strategy, payload size.
+//
+// Sends one single-chunk bytes payload per iteration, and reports
+// percentiles of the time it takes to arrive.
+void BM_ChunkLatency(benchmark::State& state) {
+  SetLabel(state);
+  MediumEnvironment& env = StartEnvironment();
+  auto links = MakeConnectedLinks(state, 1);
+  const ByteArray data(std::string(state.range(2), 'c'));
+  std::vector<double> latencies_us;
+  for (auto _ : state) {
+    if (state.error_occurred()) break;
+    absl::Time start = absl::Now();
+    Payload payload(data);
+    Payload::Id payload_id = payload.GetId();
+    links[0]->advertiser.SendPayload(std::move(payload));
+    if (!WaitForPayload(links[0]->discoverer, payload_id)) {
+      state.SkipWithError("Payload was not received");
+      break;
+    }
+    latencies_us.push_back(absl::ToDoubleMicroseconds(absl::Now() - start));
+  }
+  if (!latencies_us.empty()) {
+    std::sort(latencies_us.begin(), latencies_us.end());
+    auto percentile = [&latencies_us](int p) {
+      return latencies_us[(latencies_us.size() - 1) * p / 100];
+    };
+    state.counters["p50_us"] = percentile(50);
+    state.counters["p90_us"] = percentile(90);
+    state.counters["p99_us"] = percentile(99);
+  }
+  Destroy(links);
+  env.Stop();
+}
+BENCHMARK(BM_ChunkLatency)
+    ->ArgNames({"medium", "strategy", "size"})
+    ->Apply([](benchmark::internal::Benchmark* benchmark) {
+      for (int medium = 0; medium < std::size(kMediumNames); medium++) {
+        for (int strategy = 0; strategy < std::size(kStrategies);
+             strategy++) {
+          benchmark->Args({medium, strategy, 1024});
+        }
+      }
+    })
+    ->Iterations(kLatencyIterations)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,59 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/discovery_cache.h"
+
+#include "platform/public/mutex_lock.h"
+#include "platform/public/system_clock.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+DiscoveryCache::DiscoveryCache(absl::Duration refresh) : refresh_(refresh) {}
+
+bool DiscoveryCache::ShouldProcess(std::int64_t client_id,
+                                   const std::string& service_id,
+                                   const std::string& peer,
+                                   const ByteArray& advertisement) {
+  if (refresh_ <= absl::ZeroDuration()) return true;
+
+  absl::Time now = SystemClock::ElapsedRealtime();
+  MutexLock lock(&mutex_);
+  Entry& entry = entries_[client_id][std::make_pair(service_id, peer)];
+  if (entry.advertisement == advertisement &&
+      now - entry.process_time < refresh_) {
+    return false;
+  }
+  entry = Entry{advertisement, now};
+  return true;
+}
+
+void DiscoveryCache::Forget(std::int64_t client_id,
+                            const std::string& service_id,
+                            const std::string& peer) {
+  MutexLock lock(&mutex_);
+  auto item = entries_.find(client_id);
+  if (item == entries_.end()) return;
+  item->second.erase(std::make_pair(service_id, peer));
+}
+
+void DiscoveryCache::Clear(std::int64_t client_id) {
+  MutexLock lock(&mutex_);
+  entries_.erase(client_id);
+}
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,83 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_INTERNAL_DISCOVERY_CACHE_H_
+#define CORE_INTERNAL_DISCOVERY_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/time/time.h"
+#include "platform/base/byte_array.h"
+#include "platform/public/mutex.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+// Remembers the last advertisement processed for each peer of a medium, so
+// that the discovery handlers can drop re-sightings that carry nothing new
+// before they are posted to the PCP handler thread.
+//
+// Sightings are tracked per discovering client and service id, since the PCP
+// handler is shared by all clients, and each of them has to hear of a peer.
+// A re-sighting is dropped if its advertisement is the same as the one last
+// processed for the peer, and that one was processed less than |refresh| ago.
+// A zero |refresh| drops nothing. Letting an unchanged advertisement through
+// every |refresh| bounds how long an endpoint lost through another path (e.g.
+// another medium) stays unreported.
+//
+// Thread-safe; the mediums report sightings from their own threads.
+class DiscoveryCache {
+ public:
+  explicit DiscoveryCache(absl::Duration refresh);
+
+  // Returns true if |advertisement| from |peer|, seen by the client
+  // discovering |service_id|, has to be processed, and records it as
+  // processed if so.
+  bool ShouldProcess(std::int64_t client_id, const std::string& service_id,
+                     const std::string& peer, const ByteArray& advertisement)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Forgets |peer| for the client discovering |service_id|, so that the next
+  // advertisement it sees from |peer| is processed.
+  void Forget(std::int64_t client_id, const std::string& service_id,
+              const std::string& peer) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Forgets all peers seen by the client.
+  void Clear(std::int64_t client_id) ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Entry {
+    ByteArray advertisement;
+    absl::Time process_time;
+  };
+  // Keyed by service id and peer.
+  using Entries =
+      absl::flat_hash_map<std::pair<std::string, std::string>, Entry>;
+
+  const absl::Duration refresh_;
+  Mutex mutex_;
+  // Keyed by client id.
+  absl::flat_hash_map<std::int64_t, Entries> entries_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
+
+#endif  // CORE_INTERNAL_DISCOVERY_CACHE_H_
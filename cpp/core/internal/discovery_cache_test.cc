@@ -0,0 +1,168 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/discovery_cache.h"
+
+#include <cstdint>
+
+#include "gtest/gtest.h"
+#include "absl/time/time.h"
+#include "platform/public/system_clock.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace {
+
+constexpr std::int64_t kClientId = 1;
+constexpr std::int64_t kOtherClientId = 2;
+constexpr char kServiceId[] = "service";
+constexpr char kOtherServiceId[] = "other service";
+constexpr char kPeer[] = "peer";
+constexpr char kOtherPeer[] = "other peer";
+const ByteArray kAdvertisement{"advertisement"};
+const ByteArray kOtherAdvertisement{"other advertisement"};
+
+TEST(DiscoveryCacheTest, ProcessesFirstSighting) {
+  DiscoveryCache cache(absl::Seconds(10));
+
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kOtherPeer,
+                                  kAdvertisement));
+}
+
+TEST(DiscoveryCacheTest, DropsUnchangedResighting) {
+  DiscoveryCache cache(absl::Seconds(10));
+
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+  EXPECT_FALSE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                   kAdvertisement));
+  EXPECT_FALSE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                   kAdvertisement));
+}
+
+TEST(DiscoveryCacheTest, ProcessesChangedAdvertisement) {
+  DiscoveryCache cache(absl::Seconds(10));
+
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kOtherAdvertisement));
+  EXPECT_FALSE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                   kOtherAdvertisement));
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+}
+
+TEST(DiscoveryCacheTest, ProcessesResightingAfterForget) {
+  DiscoveryCache cache(absl::Seconds(10));
+
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kOtherPeer,
+                                  kAdvertisement));
+  cache.Forget(kClientId, kServiceId, kPeer);
+
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+  EXPECT_FALSE(cache.ShouldProcess(kClientId, kServiceId, kOtherPeer,
+                                   kAdvertisement));
+}
+
+TEST(DiscoveryCacheTest, ProcessesResightingAfterClear) {
+  DiscoveryCache cache(absl::Seconds(10));
+
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kOtherPeer,
+                                  kAdvertisement));
+  cache.Clear(kClientId);
+
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kOtherPeer,
+                                  kAdvertisement));
+}
+
+TEST(DiscoveryCacheTest, ProcessesSightingForEachClient) {
+  DiscoveryCache cache(absl::Seconds(10));
+
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+  EXPECT_TRUE(cache.ShouldProcess(kOtherClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+  EXPECT_FALSE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                   kAdvertisement));
+  EXPECT_FALSE(cache.ShouldProcess(kOtherClientId, kServiceId, kPeer,
+                                   kAdvertisement));
+}
+
+TEST(DiscoveryCacheTest, ProcessesSightingForEachServiceId) {
+  DiscoveryCache cache(absl::Seconds(10));
+
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kOtherServiceId, kPeer,
+                                  kAdvertisement));
+  EXPECT_FALSE(cache.ShouldProcess(kClientId, kOtherServiceId, kPeer,
+                                   kAdvertisement));
+}
+
+TEST(DiscoveryCacheTest, ForgetAndClearOnlyAffectTheClient) {
+  DiscoveryCache cache(absl::Seconds(10));
+
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+  EXPECT_TRUE(cache.ShouldProcess(kOtherClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+  cache.Forget(kClientId, kServiceId, kPeer);
+
+  EXPECT_FALSE(cache.ShouldProcess(kOtherClientId, kServiceId, kPeer,
+                                   kAdvertisement));
+  cache.Clear(kClientId);
+
+  EXPECT_FALSE(cache.ShouldProcess(kOtherClientId, kServiceId, kPeer,
+                                   kAdvertisement));
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+}
+
+TEST(DiscoveryCacheTest, ProcessesUnchangedResightingAfterRefresh) {
+  DiscoveryCache cache(absl::Milliseconds(50));
+
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+  SystemClock::Sleep(absl::Milliseconds(100));
+
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+  EXPECT_FALSE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                   kAdvertisement));
+}
+
+TEST(DiscoveryCacheTest, ZeroRefreshProcessesEverySighting) {
+  DiscoveryCache cache(absl::ZeroDuration());
+
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+  EXPECT_TRUE(cache.ShouldProcess(kClientId, kServiceId, kPeer,
+                                  kAdvertisement));
+}
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
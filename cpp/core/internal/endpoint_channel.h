@@ -22,6 +22,7 @@
 #include "absl/time/clock.h"
 #include "third_party/nearby_connections/cpp/analytics/analytics_recorder.h"
 #include "platform/base/byte_array.h"
+#include "platform/base/byte_chain.h"
 #include "platform/base/exception.h"
 #include "platform/public/mutex.h"
 #include "proto/connections_enums.pb.h"
@@ -41,6 +42,13 @@ class EndpointChannel {
 
   virtual Exception Write(const ByteArray& data) = 0;  // throws Exception::IO
 
+  // Writes a frame made of several slices, e.g. a frame header followed by a
+  // payload body. Implementations that can send the slices as they are should
+  // override this; the default joins them and calls Write().
+  virtual Exception WriteChain(const ByteChain& data) {  // throws Exception::IO
+    return Write(data.Flatten());
+  }
+
   // Closes this EndpointChannel, without tracking the closure in analytics.
   virtual void Close() = 0;
 
@@ -61,6 +69,12 @@ class EndpointChannel {
   // transport.
   virtual int GetMaxTransmitPacketSize() const = 0;
 
+  // Returns the payload chunk size that suits the throughput measured on this
+  // channel so far. Defaults to GetMaxTransmitPacketSize().
+  virtual int GetAdaptiveTransmitPacketSize() const {
+    return GetMaxTransmitPacketSize();
+  }
+
   // Enables encryption on the EndpointChannel.
   virtual void EnableEncryption(std::shared_ptr<EncryptionContext> context) = 0;
 
@@ -14,12 +14,17 @@
 
 #include "core/internal/endpoint_manager.h"
 
+#include <deque>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "core/internal/endpoint_channel.h"
 #include "core/internal/offline_frames.h"
 #include "platform/base/exception.h"
+#include "platform/base/feature_flags.h"
+#include "platform/public/cancelable.h"
+#include "platform/public/condition_variable.h"
 #include "platform/public/count_down_latch.h"
 #include "platform/public/logging.h"
 #include "platform/public/mutex_lock.h"
@@ -33,6 +38,18 @@ using ::location::nearby::proto::connections::Medium;
 
 constexpr absl::Duration EndpointManager::kProcessEndpointDisconnectionTimeout;
 constexpr absl::Time EndpointManager::kInvalidTimestamp;
+constexpr int EndpointManager::kMaxConcurrentFanOutWrites;
+constexpr int EndpointManager::kMaxQueuedFanOutFrames;
+constexpr int EndpointManager::kMaxConcurrentKeepAlives;
+
+namespace {
+
+bool IsLastChunk(const PayloadTransferFrame::PayloadChunk& payload_chunk) {
+  return (payload_chunk.flags() &
+          PayloadTransferFrame::PayloadChunk::LAST_CHUNK) != 0;
+}
+
+}  // namespace
 
 class EndpointManager::LockedFrameProcessor {
  public:
@@ -91,6 +108,24 @@ void EndpointManager::EndpointChannelLoopRunnable(
   NEARBY_LOG(INFO, "Started worker loop name=%s, endpoint=%s",
              runnable_name.c_str(), endpoint_id.c_str());
   Medium last_failed_medium = Medium::UNKNOWN_MEDIUM;
+  while (RunEndpointChannelHandler(endpoint_id, handler,
+                                   &last_failed_medium)) {
+  }
+  // Indicate we're out of the loop and it is ok to schedule another instance
+  // if needed.
+  NEARBY_LOGS(INFO) << "Worker going down; worker name=" << runnable_name
+                    << "; endpoint_id=" << endpoint_id;
+  // Always clear out all state related to this endpoint before terminating
+  // this thread.
+  DiscardEndpoint(client, endpoint_id);
+  NEARBY_LOGS(INFO) << "Worker done; worker name=" << runnable_name
+                    << "; endpoint_id=" << endpoint_id;
+}
+
+bool EndpointManager::RunEndpointChannelHandler(
+    const std::string& endpoint_id,
+    const std::function<ExceptionOr<bool>(EndpointChannel*)>& handler,
+    Medium* last_failed_medium) {
   while (true) {
     // It's important to keep re-fetching the EndpointChannel for an endpoint
     // because it can be changed out from under us (for example, when we
@@ -99,16 +134,16 @@ void EndpointManager::EndpointChannelLoopRunnable(
         channel_manager_->GetChannelForEndpoint(endpoint_id);
     if (channel == nullptr) {
       NEARBY_LOG(INFO, "Endpoint channel is nullptr, bail out.");
-      break;
+      return false;
     }
 
     // If we're looping back around after a failure, and there's not a new
     // EndpointChannel for this endpoint, there's nothing more to do here.
-    if ((last_failed_medium != Medium::UNKNOWN_MEDIUM) &&
-        (channel->GetMedium() == last_failed_medium)) {
+    if ((*last_failed_medium != Medium::UNKNOWN_MEDIUM) &&
+        (channel->GetMedium() == *last_failed_medium)) {
       NEARBY_LOG(
           INFO, "No new endpoint channel is found after a failure, exit loop.");
-      break;
+      return false;
     }
 
     ExceptionOr<bool> keep_using_channel = handler(channel.get());
@@ -120,40 +155,32 @@ void EndpointManager::EndpointChannelLoopRunnable(
       // ensure we don't loop indefinitely. See crbug.com/1182031 for more
       // detail.
       if (exception.Raised(Exception::kInvalidProtocolBuffer)) {
-        last_failed_medium = channel->GetMedium();
+        *last_failed_medium = channel->GetMedium();
         NEARBY_LOGS(INFO)
             << "Received invalid protobuf message, re-fetching endpoint "
                "channel; last_failed_medium="
-            << proto::connections::Medium_Name(last_failed_medium);
+            << proto::connections::Medium_Name(*last_failed_medium);
         continue;
       }
       if (exception.Raised(Exception::kIo)) {
-        last_failed_medium = channel->GetMedium();
+        *last_failed_medium = channel->GetMedium();
         NEARBY_LOGS(INFO)
             << "Endpoint channel IO exception; last_failed_medium="
-            << proto::connections::Medium_Name(last_failed_medium);
+            << proto::connections::Medium_Name(*last_failed_medium);
         continue;
       }
       if (exception.Raised(Exception::kInterrupted)) {
-        break;
+        return false;
       }
     }
 
     if (!keep_using_channel.result()) {
       NEARBY_LOGS(INFO) << "Dropping current channel: last medium="
-                        << proto::connections::Medium_Name(last_failed_medium);
-      break;
+                        << proto::connections::Medium_Name(*last_failed_medium);
+      return false;
     }
+    return true;
   }
-  // Indicate we're out of the loop and it is ok to schedule another instance
-  // if needed.
-  NEARBY_LOGS(INFO) << "Worker going down; worker name=" << runnable_name
-                    << "; endpoint_id=" << endpoint_id;
-  // Always clear out all state related to this endpoint before terminating
-  // this thread.
-  DiscardEndpoint(client, endpoint_id);
-  NEARBY_LOGS(INFO) << "Worker done; worker name=" << runnable_name
-                    << "; endpoint_id=" << endpoint_id;
 }
 
 ExceptionOr<bool> EndpointManager::HandleData(
@@ -215,6 +242,27 @@ ExceptionOr<bool> EndpointManager::HandleData(
 ExceptionOr<bool> EndpointManager::HandleKeepAlive(
     EndpointChannel* endpoint_channel, absl::Duration keep_alive_interval,
     absl::Duration keep_alive_timeout) {
+  ExceptionOr<bool> keep_using_channel =
+      SendKeepAlive(endpoint_channel, keep_alive_timeout);
+  if (!keep_using_channel.ok() || !keep_using_channel.result()) {
+    return keep_using_channel;
+  }
+
+  // We sleep as the very last step because we want to minimize the caching of
+  // the EndpointChannel. If we do hold on to the EndpointChannel, and it's
+  // switched out from under us in BandwidthUpgradeManager, our write will
+  // trigger an erroneous write to the encryption context that will cascade
+  // into all our remote endpoint's future reads failing.
+  Exception sleep_exception = SystemClock::Sleep(keep_alive_interval);
+  if (!sleep_exception.Ok()) {
+    return ExceptionOr<bool>(sleep_exception);
+  }
+
+  return ExceptionOr<bool>(true);
+}
+
+ExceptionOr<bool> EndpointManager::SendKeepAlive(
+    EndpointChannel* endpoint_channel, absl::Duration keep_alive_timeout) {
   // Check if it has been too long since we received a frame from our
   // endpoint.
   auto last_read_time = endpoint_channel->GetLastReadTimestamp();
@@ -232,16 +280,6 @@ ExceptionOr<bool> EndpointManager::HandleKeepAlive(
     return ExceptionOr<bool>(write_exception);
   }
 
-  // We sleep as the very last step because we want to minimize the caching of
-  // the EndpointChannel. If we do hold on to the EndpointChannel, and it's
-  // switched out from under us in BandwidthUpgradeManager, our write will
-  // trigger an erroneous write to the encryption context that will cascade
-  // into all our remote endpoint's future reads failing.
-  Exception sleep_exception = SystemClock::Sleep(keep_alive_interval);
-  if (!sleep_exception.Ok()) {
-    return ExceptionOr<bool>(sleep_exception);
-  }
-
   return ExceptionOr<bool>(true);
 }
 
@@ -346,6 +384,7 @@ void EndpointManager::RemoveEndpointState(const std::string& endpoint_id) {
   } else {
     NEARBY_LOGS(INFO) << "EndpointState not found for endpoint " << endpoint_id;
   }
+  RemoveFanOutWriter(endpoint_id);
 }
 
 void EndpointManager::RegisterEndpoint(ClientProxy* client,
@@ -427,16 +466,43 @@ void EndpointManager::RegisterEndpoint(ClientProxy* client,
     // for the pong.
     NEARBY_LOGS(VERBOSE) << "EndpointManager enabling KeepAlive for endpoint "
                          << endpoint_id;
-    endpoint_state.StartEndpointKeepAliveManager(
-        [this, client, endpoint_id, keep_alive_interval, keep_alive_timeout]() {
-          EndpointChannelLoopRunnable(
-              "KeepAliveManager", client, endpoint_id,
-              [this, keep_alive_interval,
-               keep_alive_timeout](EndpointChannel* channel) {
-                return HandleKeepAlive(channel, keep_alive_interval,
-                                       keep_alive_timeout);
-              });
-        });
+    if (FeatureFlags::GetInstance()
+            .GetFlags()
+            .enable_shared_keep_alive_executor) {
+      // Each round of the KeepAliveManager is timed by the shared
+      // keep_alive_executor_, keep_alive_interval after the previous one,
+      // and runs on the shared keep_alive_runner_; no thread is held while
+      // waiting for the next round.
+      endpoint_state.StartEndpointKeepAliveTimer(
+          &keep_alive_executor_, &keep_alive_runner_, keep_alive_interval,
+          [this, client, endpoint_id, keep_alive_timeout,
+           last_failed_medium = Medium::UNKNOWN_MEDIUM]() mutable {
+            if (RunEndpointChannelHandler(
+                    endpoint_id,
+                    [this, keep_alive_timeout](EndpointChannel* channel) {
+                      return SendKeepAlive(channel, keep_alive_timeout);
+                    },
+                    &last_failed_medium)) {
+              return true;
+            }
+            NEARBY_LOGS(INFO) << "KeepAliveManager going down; endpoint_id="
+                              << endpoint_id;
+            DiscardEndpoint(client, endpoint_id);
+            return false;
+          });
+    } else {
+      endpoint_state.StartEndpointKeepAliveManager(
+          [this, client, endpoint_id, keep_alive_interval,
+           keep_alive_timeout]() {
+            EndpointChannelLoopRunnable(
+                "KeepAliveManager", client, endpoint_id,
+                [this, keep_alive_interval,
+                 keep_alive_timeout](EndpointChannel* channel) {
+                  return HandleKeepAlive(channel, keep_alive_interval,
+                                         keep_alive_timeout);
+                });
+          });
+    }
     NEARBY_LOGS(INFO) << "Registering endpoint " << endpoint_id
                       << ", workers started and notifying client.";
 
@@ -472,18 +538,46 @@ int EndpointManager::GetMaxTransmitPacketSize(const std::string& endpoint_id) {
   return channel->GetMaxTransmitPacketSize();
 }
 
+int EndpointManager::GetAdaptiveTransmitPacketSize(
+    const std::string& endpoint_id) {
+  std::shared_ptr<EndpointChannel> channel =
+      channel_manager_->GetChannelForEndpoint(endpoint_id);
+  if (channel == nullptr) {
+    return 0;
+  }
+
+  return channel->GetAdaptiveTransmitPacketSize();
+}
+
 std::vector<std::string> EndpointManager::SendPayloadChunk(
     const PayloadTransferFrame::PayloadHeader& payload_header,
     const PayloadTransferFrame::PayloadChunk& payload_chunk,
     const std::vector<std::string>& endpoint_ids) {
-  ByteArray bytes =
-      parser::ForDataPayloadTransfer(payload_header, payload_chunk);
+  ByteChain bytes(
+      parser::ForDataPayloadTransfer(payload_header, payload_chunk));
 
   return SendTransferFrameBytes(
       endpoint_ids, bytes, payload_header.id(),
       /*offset=*/payload_chunk.offset(),
       /*packet_type=*/
-      PayloadTransferFrame::PacketType_Name(PayloadTransferFrame::DATA));
+      PayloadTransferFrame::PacketType_Name(PayloadTransferFrame::DATA),
+      /*flush=*/IsLastChunk(payload_chunk));
+}
+
+std::vector<std::string> EndpointManager::SendPayloadChunk(
+    const PayloadTransferFrame::PayloadHeader& payload_header,
+    const PayloadTransferFrame::PayloadChunk& payload_chunk,
+    ByteSlice payload_chunk_body,
+    const std::vector<std::string>& endpoint_ids) {
+  ByteChain bytes = parser::ForDataPayloadTransfer(
+      payload_header, payload_chunk, std::move(payload_chunk_body));
+
+  return SendTransferFrameBytes(
+      endpoint_ids, bytes, payload_header.id(),
+      /*offset=*/payload_chunk.offset(),
+      /*packet_type=*/
+      PayloadTransferFrame::PacketType_Name(PayloadTransferFrame::DATA),
+      /*flush=*/IsLastChunk(payload_chunk));
 }
 
 // Designed to run asynchronously. It is called from IO thread pools, and
@@ -503,13 +597,14 @@ std::vector<std::string> EndpointManager::SendControlMessage(
     const PayloadTransferFrame::PayloadHeader& header,
     const PayloadTransferFrame::ControlMessage& control,
     const std::vector<std::string>& endpoint_ids) {
-  ByteArray bytes = parser::ForControlPayloadTransfer(header, control);
+  ByteChain bytes(parser::ForControlPayloadTransfer(header, control));
 
   return SendTransferFrameBytes(
       endpoint_ids, bytes, header.id(),
       /*offset=*/control.offset(),
       /*packet_type=*/
-      PayloadTransferFrame::PacketType_Name(PayloadTransferFrame::CONTROL));
+      PayloadTransferFrame::PacketType_Name(PayloadTransferFrame::CONTROL),
+      /*flush=*/true);
 }
 
 // @EndpointManagerThread
@@ -586,10 +681,12 @@ CountDownLatch EndpointManager::NotifyFrameProcessorsOnEndpointDisconnect(
 }
 
 std::vector<std::string> EndpointManager::SendTransferFrameBytes(
-    const std::vector<std::string>& endpoint_ids, const ByteArray& bytes,
+    const std::vector<std::string>& endpoint_ids, const ByteChain& bytes,
     std::int64_t payload_id, std::int64_t offset,
-    const std::string& packet_type) {
+    const std::string& packet_type, bool flush) {
   std::vector<std::string> failed_endpoint_ids;
+  std::vector<std::shared_ptr<EndpointChannel>> channels;
+  channels.reserve(endpoint_ids.size());
   for (const std::string& endpoint_id : endpoint_ids) {
     std::shared_ptr<EndpointChannel> channel =
         channel_manager_->GetChannelForEndpoint(endpoint_id);
@@ -602,32 +699,267 @@ std::vector<std::string> EndpointManager::SendTransferFrameBytes(
                          << packet_type << " at offset " << offset
                          << " of Payload " << payload_id << " to endpoint "
                          << endpoint_id;
+    }
+    channels.push_back(std::move(channel));
+  }
 
-      failed_endpoint_ids.push_back(endpoint_id);
-      continue;
+  std::vector<bool> written;
+  if (FeatureFlags::GetInstance().GetFlags().enable_parallel_fan_out_writes) {
+    written = FanOutWrite(endpoint_ids, channels, bytes, flush);
+  } else {
+    written.reserve(channels.size());
+    for (const auto& channel : channels) {
+      written.push_back(channel != nullptr && channel->WriteChain(bytes).Ok());
     }
+  }
 
-    Exception write_exception = channel->Write(bytes);
-    if (!write_exception.Ok()) {
-      failed_endpoint_ids.push_back(endpoint_id);
-      NEARBY_LOGS(INFO) << "Failed to send packet; endpoint_id=" << endpoint_id;
-      continue;
+  for (std::size_t i = 0; i < endpoint_ids.size(); ++i) {
+    if (written[i]) continue;
+    if (channels[i] != nullptr) {
+      NEARBY_LOGS(INFO) << "Failed to send packet; endpoint_id="
+                        << endpoint_ids[i];
     }
+    failed_endpoint_ids.push_back(endpoint_ids[i]);
   }
 
   return failed_endpoint_ids;
 }
 
+// Writes the frames of multi-endpoint sends to one endpoint, in order, on
+// |executor|. Every endpoint drains its own queue, so a slow endpoint does not
+// hold up the others, and only holds up the sender once
+// kMaxQueuedFanOutFrames of its frames are queued.
+// The channel to write to is looked up as each frame is written, so frames
+// still queued when the channel is replaced go out over the new channel.
+// Once a write failed, the frames queued after it are dropped, and every
+// later call fails, until the FanOutWriter is stopped with its endpoint; the
+// endpoint is discarded on the failure, so no frame follows the gap.
+class EndpointManager::FanOutWriter
+    : public std::enable_shared_from_this<FanOutWriter> {
+ public:
+  FanOutWriter(MultiThreadExecutor* executor,
+               EndpointChannelManager* channel_manager,
+               const std::string& endpoint_id)
+      : executor_(executor),
+        channel_manager_(channel_manager),
+        endpoint_id_(endpoint_id) {}
+
+  // Queues |bytes| to be written, waiting while the queue is full. Returns
+  // false, without queueing it, if an earlier write failed.
+  bool Write(const ByteChain& bytes) {
+    MutexLock lock(&mutex_);
+    while (!failed_ && queue_.size() >= kMaxQueuedFanOutFrames) {
+      cond_.Wait();
+    }
+    if (failed_) return false;
+    queue_.push_back(bytes);
+    if (!draining_) {
+      draining_ = true;
+      executor_->Execute("fan-out-write",
+                         [self = shared_from_this()]() { self->Drain(); });
+    }
+    return true;
+  }
+
+  // Waits for the queued frames to be written. Returns false if a write
+  // failed.
+  bool Flush() {
+    MutexLock lock(&mutex_);
+    while (draining_) cond_.Wait();
+    return !failed_;
+  }
+
+  // Drops the queued frames and fails every later call. Once this returns,
+  // no channel is looked up for a frame, so none of them goes out over a
+  // channel registered for the endpoint later on.
+  void Stop() {
+    MutexLock lock(&mutex_);
+    failed_ = true;
+    queue_.clear();
+    cond_.Notify();
+  }
+
+  // Waits until no frame is being written to |channel|.
+  void WaitForWritesTo(const EndpointChannel* channel) {
+    MutexLock lock(&mutex_);
+    while (writing_to_ == channel) cond_.Wait();
+  }
+
+ private:
+  void Drain() {
+    while (true) {
+      ByteChain bytes;
+      std::shared_ptr<EndpointChannel> channel;
+      {
+        MutexLock lock(&mutex_);
+        if (failed_ || queue_.empty()) {
+          // Once a write failed, the frames after it are not written either.
+          queue_.clear();
+          draining_ = false;
+          cond_.Notify();
+          return;
+        }
+        bytes = std::move(queue_.front());
+        queue_.pop_front();
+        // Looked up under |mutex_|, so that WaitForWritesTo() sees every
+        // write to a channel that was current before it was replaced.
+        channel = channel_manager_->GetChannelForEndpoint(endpoint_id_);
+        writing_to_ = channel.get();
+        cond_.Notify();
+      }
+      bool written = channel != nullptr && channel->WriteChain(bytes).Ok();
+      MutexLock lock(&mutex_);
+      writing_to_ = nullptr;
+      if (!written) failed_ = true;
+      cond_.Notify();
+    }
+  }
+
+  MultiThreadExecutor* const executor_;
+  EndpointChannelManager* const channel_manager_;
+  const std::string endpoint_id_;
+  Mutex mutex_;
+  ConditionVariable cond_{&mutex_};
+  std::deque<ByteChain> queue_ ABSL_GUARDED_BY(mutex_);
+  bool draining_ ABSL_GUARDED_BY(mutex_) = false;
+  bool failed_ ABSL_GUARDED_BY(mutex_) = false;
+  // The channel of the frame being written, if any.
+  const EndpointChannel* writing_to_ ABSL_GUARDED_BY(mutex_) = nullptr;
+};
+
+std::vector<bool> EndpointManager::FanOutWrite(
+    const std::vector<std::string>& endpoint_ids,
+    const std::vector<std::shared_ptr<EndpointChannel>>& channels,
+    const ByteChain& bytes, bool flush) {
+  std::vector<bool> written(channels.size(), false);
+  if (channels.size() == 1) {
+    if (channels[0] == nullptr) return written;
+    std::shared_ptr<FanOutWriter> writer =
+        GetFanOutWriter(endpoint_ids[0], /*create=*/false);
+    written[0] =
+        (!writer || writer->Flush()) && channels[0]->WriteChain(bytes).Ok();
+    return written;
+  }
+
+  std::vector<std::shared_ptr<FanOutWriter>> writers(channels.size());
+  for (std::size_t i = 0; i < channels.size(); ++i) {
+    if (channels[i] == nullptr) continue;
+    writers[i] = GetFanOutWriter(endpoint_ids[i], /*create=*/true);
+    written[i] = writers[i]->Write(bytes);
+  }
+  if (flush) {
+    for (std::size_t i = 0; i < writers.size(); ++i) {
+      if (written[i]) written[i] = writers[i]->Flush();
+    }
+  }
+  return written;
+}
+
+void EndpointManager::WaitForPayloadWritesToChannel(
+    const std::string& endpoint_id, const EndpointChannel* old_channel) {
+  std::shared_ptr<FanOutWriter> writer =
+      GetFanOutWriter(endpoint_id, /*create=*/false);
+  if (writer) writer->WaitForWritesTo(old_channel);
+}
+
+std::shared_ptr<EndpointManager::FanOutWriter> EndpointManager::GetFanOutWriter(
+    const std::string& endpoint_id, bool create) {
+  MutexLock lock(&fan_out_writers_mutex_);
+  auto item = fan_out_writers_.find(endpoint_id);
+  if (item != fan_out_writers_.end()) return item->second;
+  if (!create) return nullptr;
+  auto writer = std::make_shared<FanOutWriter>(&fan_out_executor_,
+                                               channel_manager_, endpoint_id);
+  fan_out_writers_.emplace(endpoint_id, writer);
+  return writer;
+}
+
+void EndpointManager::RemoveFanOutWriter(const std::string& endpoint_id) {
+  MutexLock lock(&fan_out_writers_mutex_);
+  auto item = fan_out_writers_.find(endpoint_id);
+  if (item == fan_out_writers_.end()) return;
+  item->second->Stop();
+  fan_out_writers_.erase(item);
+}
+
+// Runs a task on |runner|, then again after a fixed interval for as long as
+// the task returns true, until stopped. |timer| only posts the task to
+// |runner| when it is due, so a task that blocks never delays the tasks of
+// other KeepAliveTimers sharing |timer|. The next run is only scheduled once
+// the task returns, so runs of one KeepAliveTimer never overlap, even on a
+// |runner| with several threads.
+class EndpointManager::EndpointState::KeepAliveTimer
+    : public std::enable_shared_from_this<KeepAliveTimer> {
+ public:
+  KeepAliveTimer(ScheduledExecutor* timer, MultiThreadExecutor* runner,
+                 absl::Duration interval, std::function<bool()> tick)
+      : timer_(timer),
+        runner_(runner),
+        interval_(interval),
+        tick_(std::move(tick)) {}
+
+  void Start() { Run(); }
+
+  // Cancels the next run of the task, or waits for it to finish if it is
+  // already running. The task is not run or scheduled again after this.
+  void Stop() {
+    Cancelable next_run;
+    {
+      MutexLock lock(&mutex_);
+      stopped_ = true;
+      next_run = next_run_;
+    }
+    next_run.Cancel();
+    MutexLock lock(&mutex_);
+    while (running_) cond_.Wait();
+  }
+
+ private:
+  void Run() {
+    // Posting under the lock, so that |runner| is not used after Stop().
+    MutexLock lock(&mutex_);
+    if (stopped_) return;
+    runner_->Execute("keep-alive", [self = shared_from_this()]() {
+      {
+        MutexLock lock(&self->mutex_);
+        if (self->stopped_) return;
+        self->running_ = true;
+      }
+      bool again = self->tick_();
+      MutexLock lock(&self->mutex_);
+      self->running_ = false;
+      self->cond_.Notify();
+      if (again && !self->stopped_) {
+        self->next_run_ = self->timer_->Schedule(
+            [self]() { self->Run(); }, self->interval_);
+      }
+    });
+  }
+
+  ScheduledExecutor* timer_;
+  MultiThreadExecutor* runner_;
+  const absl::Duration interval_;
+  std::function<bool()> tick_;
+  Mutex mutex_;
+  ConditionVariable cond_{&mutex_};
+  bool stopped_ ABSL_GUARDED_BY(mutex_) = false;
+  bool running_ ABSL_GUARDED_BY(mutex_) = false;
+  Cancelable next_run_ ABSL_GUARDED_BY(mutex_);
+};
+
 EndpointManager::EndpointState::~EndpointState() {
   // We must unregister the endpoint first to signal the runnables
   // that they should exit their loops. SingleThreadExecutor destructors will
-  // wait for the workers to finish.
+  // wait for the workers to finish, and so does stopping the KeepAliveTimer.
   // |channel_manager_| is null when we moved from this object (in move
   // constructor) which prevents unregistering the channel prematurely.
   if (channel_manager_ != nullptr) {
     NEARBY_LOG(VERBOSE, "EndpointState destructor %s", endpoint_id_.c_str());
     channel_manager_->UnregisterChannelForEndpoint(endpoint_id_);
   }
+  if (keep_alive_timer_ != nullptr) {
+    keep_alive_timer_->Stop();
+  }
 }
 
 void EndpointManager::EndpointState::StartEndpointReader(Runnable&& runnable) {
@@ -636,7 +968,16 @@ void EndpointManager::EndpointState::StartEndpointReader(Runnable&& runnable) {
 
 void EndpointManager::EndpointState::StartEndpointKeepAliveManager(
     Runnable&& runnable) {
-  keep_alive_thread_.Execute("keep-alive", std::move(runnable));
+  keep_alive_thread_ = std::make_unique<SingleThreadExecutor>();
+  keep_alive_thread_->Execute("keep-alive", std::move(runnable));
+}
+
+void EndpointManager::EndpointState::StartEndpointKeepAliveTimer(
+    ScheduledExecutor* timer, MultiThreadExecutor* runner,
+    absl::Duration interval, std::function<bool()> tick) {
+  keep_alive_timer_ = std::make_shared<KeepAliveTimer>(timer, runner, interval,
+                                                       std::move(tick));
+  keep_alive_timer_->Start();
 }
 
 void EndpointManager::RunOnEndpointManagerThread(const std::string& name,
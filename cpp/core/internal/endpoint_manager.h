@@ -16,7 +16,9 @@
 #define CORE_INTERNAL_ENDPOINT_MANAGER_H_
 
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
@@ -27,9 +29,12 @@
 #include "core/internal/endpoint_channel_manager.h"
 #include "core/listeners.h"
 #include "platform/base/byte_array.h"
+#include "platform/base/byte_chain.h"
 #include "platform/base/runnable.h"
 #include "platform/public/count_down_latch.h"
 #include "platform/public/multi_thread_executor.h"
+#include "platform/public/mutex.h"
+#include "platform/public/scheduled_executor.h"
 #include "platform/public/single_thread_executor.h"
 #include "platform/public/system_clock.h"
 
@@ -112,6 +117,10 @@ class EndpointManager {
   // Returns the maximum supported transmit packet size(MTU) for the underlying
   // transport.
   int GetMaxTransmitPacketSize(const std::string& endpoint_id);
+  // Returns the packet size that the underlying transport currently writes
+  // out in a reasonable time; see
+  // EndpointChannel::GetAdaptiveTransmitPacketSize().
+  int GetAdaptiveTransmitPacketSize(const std::string& endpoint_id);
 
   // Returns the list of endpoints to which sending this chunk failed.
   //
@@ -120,11 +129,26 @@ class EndpointManager {
       const PayloadTransferFrame::PayloadHeader& payload_header,
       const PayloadTransferFrame::PayloadChunk& payload_chunk,
       const std::vector<std::string>& endpoint_ids);
+  // Same as above, but the chunk body is given separately, and is written out
+  // to the endpoints without being copied into the frame.
+  std::vector<std::string> SendPayloadChunk(
+      const PayloadTransferFrame::PayloadHeader& payload_header,
+      const PayloadTransferFrame::PayloadChunk& payload_chunk,
+      ByteSlice payload_chunk_body,
+      const std::vector<std::string>& endpoint_ids);
   std::vector<std::string> SendControlMessage(
       const PayloadTransferFrame::PayloadHeader& payload_header,
       const PayloadTransferFrame::ControlMessage& control_message,
       const std::vector<std::string>& endpoint_ids);
 
+  // Waits until no queued payload chunk is being written to |old_channel| of
+  // |endpoint_id|. Called once |old_channel| has been replaced, and before
+  // its last frame is written to it, so that no payload chunk follows that
+  // frame over |old_channel|. Chunks queued after the replacement go out over
+  // the new channel.
+  void WaitForPayloadWritesToChannel(const std::string& endpoint_id,
+                                     const EndpointChannel* old_channel);
+
   // Called when we internally want to get rid of the endpoint, without the
   // client directly telling us to. For example...
   //    a) We failed to read from the endpoint in its dedicated reader thread.
@@ -152,23 +176,40 @@ class EndpointManager {
         : endpoint_id_{std::move(other.endpoint_id_)},
           channel_manager_{std::exchange(other.channel_manager_, nullptr)},
           reader_thread_{std::move(other.reader_thread_)},
-          keep_alive_thread_{std::move(other.keep_alive_thread_)} {}
+          keep_alive_thread_{std::move(other.keep_alive_thread_)},
+          keep_alive_timer_{std::move(other.keep_alive_timer_)} {}
     EndpointState& operator=(const EndpointState&) = delete;
     EndpointState&& operator=(EndpointState&&) = delete;
     ~EndpointState();
 
     void StartEndpointReader(Runnable&& runnable);
     void StartEndpointKeepAliveManager(Runnable&& runnable);
+    // Runs |tick| on |runner| right away, and then again every |interval|
+    // for as long as it returns true. |timer| only keeps time.
+    void StartEndpointKeepAliveTimer(ScheduledExecutor* timer,
+                                     MultiThreadExecutor* runner,
+                                     absl::Duration interval,
+                                     std::function<bool()> tick);
 
    private:
+    class KeepAliveTimer;
+
     const std::string endpoint_id_;
     EndpointChannelManager* channel_manager_;
+    // Every endpoint keeps a reader thread of its own: EndpointChannel::Read()
+    // blocks until a frame arrives, and no medium tells us when a channel is
+    // readable, so a shared pool of readers would need one thread per
+    // endpoint all the same. Only the KeepAlive workers share threads.
     SingleThreadExecutor reader_thread_;
-    SingleThreadExecutor keep_alive_thread_;
+    // Only created by StartEndpointKeepAliveManager(); see
+    // FeatureFlags::Flags::enable_shared_keep_alive_executor.
+    std::unique_ptr<SingleThreadExecutor> keep_alive_thread_;
+    std::shared_ptr<KeepAliveTimer> keep_alive_timer_;
   };
 
   // RAII accessor for FrameProcessor
   class LockedFrameProcessor;
+  class FanOutWriter;
 
   // Provides a mutex per FrameProcessor to prevent unregistering (and
   // destroying) a FrameProcessor when it's in use.
@@ -193,6 +234,12 @@ class EndpointManager {
                                     absl::Duration keep_alive_interval,
                                     absl::Duration keep_alive_timeout);
 
+  // Sends a KeepAlive frame, unless nothing has been read from the endpoint
+  // within |keep_alive_timeout|. Unlike HandleKeepAlive(), does not wait for
+  // the next keep-alive interval.
+  ExceptionOr<bool> SendKeepAlive(EndpointChannel* endpoint_channel,
+                                  absl::Duration keep_alive_timeout);
+
   // Waits for a given endpoint EndpointChannelLoopRunnable() workers to
   // terminate.
   // Is called from RegisterEndpoint to avoid races; also called from
@@ -205,6 +252,15 @@ class EndpointManager {
       const std::string& endpoint_id,
       std::function<ExceptionOr<bool>(EndpointChannel*)> handler);
 
+  // A single iteration of EndpointChannelLoopRunnable(): calls |handler| on
+  // the current channel of the endpoint, moving on to a replacement channel
+  // if the current one fails. Returns true if |handler| should be called
+  // again; false if the worker is done.
+  bool RunEndpointChannelHandler(
+      const std::string& endpoint_id,
+      const std::function<ExceptionOr<bool>(EndpointChannel*)>& handler,
+      proto::connections::Medium* last_failed_medium);
+
   static void WaitForLatch(const std::string& method_name,
                            CountDownLatch* latch);
   static void WaitForLatch(const std::string& method_name,
@@ -212,6 +268,16 @@ class EndpointManager {
 
   static constexpr absl::Duration kProcessEndpointDisconnectionTimeout =
       absl::Milliseconds(2000);
+  // Upper bound on the number of endpoints that may be written to at once by
+  // multi-endpoint sends.
+  static constexpr int kMaxConcurrentFanOutWrites = 8;
+  // Number of frames of multi-endpoint sends that may be queued for one
+  // endpoint before the sender waits for it.
+  static constexpr int kMaxQueuedFanOutFrames = 4;
+  // Number of threads that send the KeepAlive frames of all endpoints. Every
+  // endpoint sends one frame at a time, so a write that blocks only holds up
+  // other endpoints once this many endpoints are blocked.
+  static constexpr int kMaxConcurrentKeepAlives = 4;
   static constexpr absl::Time kInvalidTimestamp = absl::InfinitePast();
 
   // It should be noted that this method may be called multiple times (because
@@ -229,10 +295,35 @@ class EndpointManager {
   CountDownLatch NotifyFrameProcessorsOnEndpointDisconnect(
       ClientProxy* client, const std::string& endpoint_id);
 
+  // If |flush| is true, only returns once the frame has been written to all
+  // of |endpoint_ids|; otherwise it may still be queued for some of them, and
+  // a failure to write it is reported by every later call for that endpoint,
+  // until the endpoint is removed.
   std::vector<std::string> SendTransferFrameBytes(
       const std::vector<std::string>& endpoint_ids,
-      const ByteArray& payload_transfer_frame_bytes, std::int64_t payload_id,
-      std::int64_t offset, const std::string& packet_type);
+      const ByteChain& payload_transfer_frame_bytes, std::int64_t payload_id,
+      std::int64_t offset, const std::string& packet_type, bool flush);
+
+  // Queues |bytes| on the FanOutWriter of every endpoint in |endpoint_ids|,
+  // so that each endpoint is written at its own pace, and a slow one only
+  // holds up the sender once its queue is full. A frame for a single endpoint
+  // is written right away, after the frames queued for it.
+  // Returns, for each entry of |channels|, whether the write succeeded, or
+  // the frame was queued.
+  std::vector<bool> FanOutWrite(
+      const std::vector<std::string>& endpoint_ids,
+      const std::vector<std::shared_ptr<EndpointChannel>>& channels,
+      const ByteChain& bytes, bool flush);
+  // Returns the FanOutWriter of |endpoint_id|, creating it if |create| is
+  // true; returns null otherwise.
+  std::shared_ptr<FanOutWriter> GetFanOutWriter(const std::string& endpoint_id,
+                                                bool create)
+      ABSL_LOCKS_EXCLUDED(fan_out_writers_mutex_);
+  // Stops the FanOutWriter of |endpoint_id|, dropping the frames queued on
+  // it, so that none of them goes out over a channel registered for
+  // |endpoint_id| later on.
+  void RemoveFanOutWriter(const std::string& endpoint_id)
+      ABSL_LOCKS_EXCLUDED(fan_out_writers_mutex_);
 
   // Executes all jobs sequentially, on a serial_executor_.
   void RunOnEndpointManagerThread(const std::string& name, Runnable runnable);
@@ -247,6 +338,19 @@ class EndpointManager {
   absl::flat_hash_map<std::string, EndpointState> endpoints_;
 
   SingleThreadExecutor serial_executor_;
+
+  // Drains the queues of the FanOutWriters.
+  MultiThreadExecutor fan_out_executor_{kMaxConcurrentFanOutWrites};
+  Mutex fan_out_writers_mutex_;
+  absl::flat_hash_map<std::string, std::shared_ptr<FanOutWriter>>
+      fan_out_writers_ ABSL_GUARDED_BY(fan_out_writers_mutex_);
+
+  // Keeps time for the KeepAlive workers of all endpoints, so that no
+  // per-endpoint thread sleeps between KeepAlive frames.
+  ScheduledExecutor keep_alive_executor_;
+  // Sends the KeepAlive frames of all endpoints, so that the number of
+  // keep-alive threads does not grow with the number of endpoints.
+  MultiThreadExecutor keep_alive_runner_{kMaxConcurrentKeepAlives};
 };
 
 // Operator overloads when comparing FrameProcessor*.
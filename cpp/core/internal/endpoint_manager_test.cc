@@ -44,6 +44,7 @@ using ::location::nearby::proto::connections::DisconnectionReason;
 using ::location::nearby::proto::connections::Medium;
 using ::testing::_;
 using ::testing::MockFunction;
+using ::testing::NiceMock;
 using ::testing::Return;
 using ::testing::StrictMock;
 
@@ -262,6 +263,258 @@ TEST_F(EndpointManagerTest, SendControlMessageWorks) {
   NEARBY_LOG(INFO, "Will call destructors now");
 }
 
+TEST_F(EndpointManagerTest, SendPayloadChunkReportsFailedEndpoints) {
+  auto good_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  auto bad_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  EXPECT_CALL(*good_channel, Write(_))
+      .WillOnce(Return(Exception{Exception::kSuccess}));
+  EXPECT_CALL(*bad_channel, Write(_))
+      .WillOnce(Return(Exception{Exception::kIo}));
+  ecm_.RegisterChannelForEndpoint(&client_, "good", std::move(good_channel));
+  ecm_.RegisterChannelForEndpoint(&client_, "bad", std::move(bad_channel));
+  PayloadTransferFrame::PayloadHeader header;
+  PayloadTransferFrame::PayloadChunk chunk;
+  header.set_id(12345);
+  header.set_type(PayloadTransferFrame::PayloadHeader::BYTES);
+  header.set_total_size(4);
+  chunk.set_offset(0);
+  chunk.set_flags(PayloadTransferFrame::PayloadChunk::LAST_CHUNK);
+  chunk.set_body("data");
+
+  auto failed_ids = em_.SendPayloadChunk(
+      header, chunk, std::vector<std::string>{"good", "bad", "unknown"});
+
+  EXPECT_EQ(failed_ids, (std::vector<std::string>{"bad", "unknown"}));
+}
+
+TEST_F(EndpointManagerTest, SendPayloadChunkWritesToEndpointsConcurrently) {
+  // Each write only completes once every endpoint has started its own write,
+  // which can not happen if writes are done one endpoint after another.
+  CountDownLatch all_writes_started(2);
+  auto write = [&all_writes_started](const ByteArray& data) {
+    all_writes_started.CountDown();
+    if (!all_writes_started.Await(absl::Milliseconds(1000)).result()) {
+      return Exception{Exception::kIo};
+    }
+    return Exception{Exception::kSuccess};
+  };
+  auto first_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  auto second_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  EXPECT_CALL(*first_channel, Write(_)).WillOnce(write);
+  EXPECT_CALL(*second_channel, Write(_)).WillOnce(write);
+  ecm_.RegisterChannelForEndpoint(&client_, "first", std::move(first_channel));
+  ecm_.RegisterChannelForEndpoint(&client_, "second",
+                                  std::move(second_channel));
+  PayloadTransferFrame::PayloadHeader header;
+  PayloadTransferFrame::PayloadChunk chunk;
+  header.set_id(12345);
+  header.set_type(PayloadTransferFrame::PayloadHeader::BYTES);
+  header.set_total_size(4);
+  chunk.set_offset(0);
+  chunk.set_flags(PayloadTransferFrame::PayloadChunk::LAST_CHUNK);
+  chunk.set_body("data");
+
+  auto failed_ids = em_.SendPayloadChunk(
+      header, chunk, std::vector<std::string>{"first", "second"});
+
+  EXPECT_EQ(failed_ids, std::vector<std::string>{});
+}
+
+TEST_F(EndpointManagerTest, SlowEndpointDoesNotHoldUpOtherEndpoints) {
+  CountDownLatch slow_unblocked(1);
+  CountDownLatch fast_written(3);
+  auto slow_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  auto fast_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  EXPECT_CALL(*slow_channel, Write(_))
+      .Times(4)
+      .WillRepeatedly([&slow_unblocked](const ByteArray& data) {
+        if (!slow_unblocked.Await(absl::Milliseconds(1000)).result()) {
+          return Exception{Exception::kIo};
+        }
+        return Exception{Exception::kSuccess};
+      });
+  EXPECT_CALL(*fast_channel, Write(_))
+      .Times(4)
+      .WillRepeatedly([&fast_written](const ByteArray& data) {
+        fast_written.CountDown();
+        return Exception{Exception::kSuccess};
+      });
+  ecm_.RegisterChannelForEndpoint(&client_, "slow", std::move(slow_channel));
+  ecm_.RegisterChannelForEndpoint(&client_, "fast", std::move(fast_channel));
+  PayloadTransferFrame::PayloadHeader header;
+  PayloadTransferFrame::PayloadChunk chunk;
+  header.set_id(12345);
+  header.set_type(PayloadTransferFrame::PayloadHeader::BYTES);
+  header.set_total_size(16);
+  chunk.set_body("data");
+
+  // The first chunks are only queued for the slow endpoint, and the fast one
+  // gets them all while the slow one is still writing the first.
+  for (int offset = 0; offset < 12; offset += 4) {
+    chunk.set_offset(offset);
+    EXPECT_EQ(em_.SendPayloadChunk(header, chunk,
+                                   std::vector<std::string>{"slow", "fast"}),
+              std::vector<std::string>{});
+  }
+  EXPECT_TRUE(fast_written.Await(absl::Milliseconds(500)).result());
+
+  // The last chunk waits for both endpoints to have it.
+  slow_unblocked.CountDown();
+  chunk.set_offset(12);
+  chunk.set_flags(PayloadTransferFrame::PayloadChunk::LAST_CHUNK);
+  EXPECT_EQ(em_.SendPayloadChunk(header, chunk,
+                                 std::vector<std::string>{"slow", "fast"}),
+            std::vector<std::string>{});
+}
+
+TEST_F(EndpointManagerTest, FailedFanOutWriteFailsLaterSendsToEndpoint) {
+  auto bad_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  auto good_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  // Nothing is written to the endpoint after the failed write, so the
+  // receiver never gets a payload with a gap in it.
+  EXPECT_CALL(*bad_channel, Write(_))
+      .WillOnce(Return(Exception{Exception::kIo}));
+  EXPECT_CALL(*good_channel, Write(_))
+      .Times(4)
+      .WillRepeatedly(Return(Exception{Exception::kSuccess}));
+  ecm_.RegisterChannelForEndpoint(&client_, "bad", std::move(bad_channel));
+  ecm_.RegisterChannelForEndpoint(&client_, "good", std::move(good_channel));
+  PayloadTransferFrame::PayloadHeader header;
+  PayloadTransferFrame::PayloadChunk chunk;
+  header.set_id(12345);
+  header.set_type(PayloadTransferFrame::PayloadHeader::BYTES);
+  header.set_total_size(12);
+  chunk.set_body("data");
+
+  // The failed write is reported by the send of the last chunk at the latest.
+  for (int offset = 0; offset < 8; offset += 4) {
+    chunk.set_offset(offset);
+    em_.SendPayloadChunk(header, chunk,
+                         std::vector<std::string>{"bad", "good"});
+  }
+  chunk.set_offset(8);
+  chunk.set_flags(PayloadTransferFrame::PayloadChunk::LAST_CHUNK);
+  EXPECT_EQ(em_.SendPayloadChunk(header, chunk,
+                                 std::vector<std::string>{"bad", "good"}),
+            std::vector<std::string>{"bad"});
+
+  // It is still reported, to one endpoint or many, until the endpoint is
+  // removed.
+  header.set_id(67890);
+  header.set_total_size(4);
+  chunk.set_offset(0);
+  EXPECT_EQ(em_.SendPayloadChunk(header, chunk,
+                                 std::vector<std::string>{"bad", "good"}),
+            std::vector<std::string>{"bad"});
+  EXPECT_EQ(em_.SendPayloadChunk(header, chunk, std::vector<std::string>{"bad"}),
+            std::vector<std::string>{"bad"});
+}
+
+TEST_F(EndpointManagerTest, QueuedChunksGoOutOverReplacementChannel) {
+  CountDownLatch old_write_started(1);
+  CountDownLatch old_write_unblocked(1);
+  auto old_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  auto new_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  auto other_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  EXPECT_CALL(*old_channel, Write(_))
+      .WillOnce([&](const ByteArray& data) {
+        old_write_started.CountDown();
+        old_write_unblocked.Await(absl::Milliseconds(1000));
+        return Exception{Exception::kSuccess};
+      });
+  EXPECT_CALL(*new_channel, Write(_))
+      .Times(3)
+      .WillRepeatedly(Return(Exception{Exception::kSuccess}));
+  EXPECT_CALL(*other_channel, Write(_))
+      .WillRepeatedly(Return(Exception{Exception::kSuccess}));
+  const EndpointChannel* old_channel_ptr = old_channel.get();
+  ecm_.RegisterChannelForEndpoint(&client_, "upgraded",
+                                  std::move(old_channel));
+  ecm_.RegisterChannelForEndpoint(&client_, "other",
+                                  std::move(other_channel));
+  PayloadTransferFrame::PayloadHeader header;
+  PayloadTransferFrame::PayloadChunk chunk;
+  header.set_id(12345);
+  header.set_type(PayloadTransferFrame::PayloadHeader::BYTES);
+  header.set_total_size(16);
+  chunk.set_body("data");
+  for (int offset = 0; offset < 12; offset += 4) {
+    chunk.set_offset(offset);
+    EXPECT_EQ(em_.SendPayloadChunk(header, chunk,
+                                   std::vector<std::string>{"upgraded",
+                                                            "other"}),
+              std::vector<std::string>{});
+  }
+  EXPECT_TRUE(old_write_started.Await(absl::Milliseconds(1000)).result());
+
+  // Like BwuManager: replace the channel, and wait for the chunk being
+  // written to the old one before writing anything else to it.
+  ecm_.ReplaceChannelForEndpoint(&client_, "upgraded", std::move(new_channel));
+  old_write_unblocked.CountDown();
+  em_.WaitForPayloadWritesToChannel("upgraded", old_channel_ptr);
+
+  chunk.set_offset(12);
+  chunk.set_flags(PayloadTransferFrame::PayloadChunk::LAST_CHUNK);
+  EXPECT_EQ(em_.SendPayloadChunk(header, chunk,
+                                 std::vector<std::string>{"upgraded", "other"}),
+            std::vector<std::string>{});
+}
+
+TEST_F(EndpointManagerTest, QueuedChunksAreDroppedWithTheirEndpoint) {
+  CountDownLatch old_write_started(1);
+  CountDownLatch old_write_unblocked(1);
+  auto old_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  auto new_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  auto other_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  EXPECT_CALL(*old_channel, Write(_))
+      .WillOnce([&](const ByteArray& data) {
+        old_write_started.CountDown();
+        old_write_unblocked.Await(absl::Milliseconds(1000));
+        return Exception{Exception::kSuccess};
+      })
+      .WillOnce(Return(Exception{Exception::kSuccess}));  // Disconnection.
+  // Only the chunk sent after the endpoint is registered again.
+  EXPECT_CALL(*new_channel, Write(_))
+      .WillOnce(Return(Exception{Exception::kSuccess}));
+  EXPECT_CALL(*other_channel, Write(_))
+      .WillRepeatedly(Return(Exception{Exception::kSuccess}));
+  ecm_.RegisterChannelForEndpoint(&client_, "reregistered",
+                                  std::move(old_channel));
+  ecm_.RegisterChannelForEndpoint(&client_, "other",
+                                  std::move(other_channel));
+  PayloadTransferFrame::PayloadHeader header;
+  PayloadTransferFrame::PayloadChunk chunk;
+  header.set_id(12345);
+  header.set_type(PayloadTransferFrame::PayloadHeader::BYTES);
+  header.set_total_size(16);
+  chunk.set_body("data");
+  for (int offset = 0; offset < 12; offset += 4) {
+    chunk.set_offset(offset);
+    EXPECT_EQ(em_.SendPayloadChunk(header, chunk,
+                                   std::vector<std::string>{"reregistered",
+                                                            "other"}),
+              std::vector<std::string>{});
+  }
+  EXPECT_TRUE(old_write_started.Await(absl::Milliseconds(1000)).result());
+
+  em_.UnregisterEndpoint(&client_, "reregistered");
+  ecm_.RegisterChannelForEndpoint(&client_, "reregistered",
+                                  std::move(new_channel));
+  old_write_unblocked.CountDown();
+  // Were the chunks queued for the old endpoint still queued, they would be
+  // written to the new channel by now.
+  absl::SleepFor(absl::Milliseconds(100));
+
+  header.set_id(67890);
+  header.set_total_size(4);
+  chunk.set_offset(0);
+  chunk.set_flags(PayloadTransferFrame::PayloadChunk::LAST_CHUNK);
+  EXPECT_EQ(em_.SendPayloadChunk(header, chunk,
+                                 std::vector<std::string>{"reregistered",
+                                                          "other"}),
+            std::vector<std::string>{});
+}
+
 TEST_F(EndpointManagerTest, SingleReadOnInvalidPayload) {
   auto endpoint_channel = std::make_unique<MockEndpointChannel>();
   EXPECT_CALL(*endpoint_channel, Read())
@@ -273,6 +526,60 @@ TEST_F(EndpointManagerTest, SingleReadOnInvalidPayload) {
   RegisterEndpoint(std::move(endpoint_channel));
 }
 
+TEST_F(EndpointManagerTest, KeepAliveIsSentEveryInterval) {
+  options_.keep_alive_interval_millis = 10;
+  CountDownLatch keep_alives_sent(3);
+  auto endpoint_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  ON_CALL(*endpoint_channel, Write(_))
+      .WillByDefault([&keep_alives_sent](const ByteArray& data) {
+        keep_alives_sent.CountDown();
+        return Exception{Exception::kSuccess};
+      });
+  // Keep the endpoint connected until enough KeepAlive frames were sent.
+  ON_CALL(*endpoint_channel, Read()).WillByDefault([&keep_alives_sent]() {
+    keep_alives_sent.Await(absl::Milliseconds(1000));
+    return ExceptionOr<ByteArray>(Exception::kIo);
+  });
+  RegisterEndpoint(std::move(endpoint_channel));
+  EXPECT_TRUE(keep_alives_sent.Await(absl::ZeroDuration()).result());
+}
+
+TEST_F(EndpointManagerTest, BlockedKeepAliveDoesNotDelayOtherEndpoints) {
+  options_.keep_alive_interval_millis = 10;
+  CountDownLatch keep_alives_sent(3);
+  auto blocked_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  auto other_channel = std::make_unique<NiceMock<MockEndpointChannel>>();
+  // Like a stalled socket, the blocked endpoint does not complete its first
+  // KeepAlive write before the other endpoint sent several of its own.
+  ON_CALL(*blocked_channel, Write(_))
+      .WillByDefault([&keep_alives_sent](const ByteArray& data) {
+        keep_alives_sent.Await(absl::Milliseconds(1000));
+        return Exception{Exception::kSuccess};
+      });
+  ON_CALL(*other_channel, Write(_))
+      .WillByDefault([&keep_alives_sent](const ByteArray& data) {
+        keep_alives_sent.CountDown();
+        return Exception{Exception::kSuccess};
+      });
+  // Keep both endpoints connected until enough KeepAlive frames were sent.
+  auto read = [&keep_alives_sent]() {
+    keep_alives_sent.Await(absl::Milliseconds(1000));
+    return ExceptionOr<ByteArray>(Exception::kIo);
+  };
+  ON_CALL(*blocked_channel, Read()).WillByDefault(read);
+  ON_CALL(*other_channel, Read()).WillByDefault(read);
+  CountDownLatch closed(2);
+  auto close = [&closed](DisconnectionReason reason) { closed.CountDown(); };
+  ON_CALL(*blocked_channel, Close(_)).WillByDefault(close);
+  ON_CALL(*other_channel, Close(_)).WillByDefault(close);
+  endpoint_id_ = "blocked";
+  RegisterEndpoint(std::move(blocked_channel), /*should_close=*/false);
+  endpoint_id_ = "other";
+  RegisterEndpoint(std::move(other_channel), /*should_close=*/false);
+  EXPECT_TRUE(closed.Await(absl::Milliseconds(2000)).result());
+  EXPECT_TRUE(keep_alives_sent.Await(absl::ZeroDuration()).result());
+}
+
 }  // namespace
 }  // namespace connections
 }  // namespace nearby
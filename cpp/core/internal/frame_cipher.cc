@@ -0,0 +1,55 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/frame_cipher.h"
+
+#include <utility>
+
+#include "platform/public/mutex_lock.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+FrameCipher::FrameCipher(std::shared_ptr<EncryptionContext> context)
+    : context_(std::move(context)) {}
+
+bool FrameCipher::Encrypt(absl::Span<const absl::string_view> frame,
+                          std::string* message) {
+  MutexLock lock(&encrypt_mutex_);
+  // clear() keeps the capacity, so after the first few frames this no longer
+  // allocates.
+  plaintext_.clear();
+  for (const absl::string_view slice : frame) {
+    plaintext_.append(slice.data(), slice.size());
+  }
+  std::unique_ptr<std::string> encrypted =
+      context_->EncodeMessageToPeer(plaintext_);
+  if (!encrypted) return false;
+  message->swap(*encrypted);
+  return true;
+}
+
+bool FrameCipher::Decrypt(const std::string& message, std::string* frame) {
+  MutexLock lock(&decrypt_mutex_);
+  std::unique_ptr<std::string> decrypted =
+      context_->DecodeMessageFromPeer(message);
+  if (!decrypted) return false;
+  frame->swap(*decrypted);
+  return true;
+}
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,68 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_INTERNAL_FRAME_CIPHER_H_
+#define CORE_INTERNAL_FRAME_CIPHER_H_
+
+#include <memory>
+#include <string>
+
+#include "securegcm/d2d_connection_context_v1.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "platform/public/mutex.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+// Encrypts the frames written to, and decrypts the frames read from, an
+// endpoint channel.
+//
+// The encryption context keeps a separate sequence number per direction, so
+// encryption and decryption are serialized independently of each other: a
+// writer encrypting a large frame does not hold up the reader.
+class FrameCipher {
+ public:
+  using EncryptionContext = ::securegcm::D2DConnectionContextV1;
+
+  explicit FrameCipher(std::shared_ptr<EncryptionContext> context);
+
+  // Encrypts the concatenation of |frame| into |message|. The slices are
+  // gathered into a buffer that is kept for the next call. Returns false if
+  // the frame could not be encrypted.
+  bool Encrypt(absl::Span<const absl::string_view> frame, std::string* message)
+      ABSL_LOCKS_EXCLUDED(encrypt_mutex_);
+
+  // Decrypts |message| into |frame|. Returns false if |message| is not the
+  // next message encrypted by the peer.
+  bool Decrypt(const std::string& message, std::string* frame)
+      ABSL_LOCKS_EXCLUDED(decrypt_mutex_);
+
+ private:
+  const std::shared_ptr<EncryptionContext> context_;
+
+  Mutex encrypt_mutex_;
+  // Gathers the slices of a frame before it is encrypted.
+  std::string plaintext_ ABSL_GUARDED_BY(encrypt_mutex_);
+
+  Mutex decrypt_mutex_;
+};
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
+
+#endif  // CORE_INTERNAL_FRAME_CIPHER_H_
@@ -0,0 +1,117 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Encryption and decryption throughput of endpoint channel frames.
+//
+// Run with:
+//   blaze run -c opt //core/internal:frame_cipher_benchmark -- \
+//     --benchmark_filter=all
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "securegcm/ukey2_handshake.h"
+#include "benchmark/benchmark.h"
+#include "core/internal/frame_cipher.h"
+#include "platform/base/byte_array.h"
+#include "platform/base/byte_chain.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace {
+
+using EncryptionContext = FrameCipher::EncryptionContext;
+using Handshake = ::securegcm::UKey2Handshake;
+
+constexpr auto kCipher = Handshake::HandshakeCipher::P256_SHA512;
+// Frames decrypted per batch in the decryption benchmark.
+constexpr int kBatchSize = 16;
+
+// Returns the client and server ciphers of a completed key exchange.
+std::pair<std::unique_ptr<FrameCipher>, std::unique_ptr<FrameCipher>>
+MakeCipherPair() {
+  auto client = Handshake::ForInitiator(kCipher);
+  auto server = Handshake::ForResponder(kCipher);
+  server->ParseHandshakeMessage(*client->GetNextHandshakeMessage());
+  client->ParseHandshakeMessage(*server->GetNextHandshakeMessage());
+  server->ParseHandshakeMessage(*client->GetNextHandshakeMessage());
+  client->GetVerificationString(32);
+  server->GetVerificationString(32);
+  client->VerifyHandshake();
+  server->VerifyHandshake();
+  return std::make_pair(
+      std::make_unique<FrameCipher>(
+          std::shared_ptr<EncryptionContext>(client->ToConnectionContext())),
+      std::make_unique<FrameCipher>(
+          std::shared_ptr<EncryptionContext>(server->ToConnectionContext())));
+}
+
+// A frame of |size| bytes, split like a DATA payload transfer frame into a
+// small header and the chunk body.
+ByteChain MakeFrame(std::int64_t size) {
+  ByteChain frame(ByteArray(std::string(32, 'h')));
+  frame.Append(ByteSlice(ByteArray(std::string(size - 32, 'b'))));
+  return frame;
+}
+
+void BM_Encrypt(benchmark::State& state) {
+  auto ciphers = MakeCipherPair();
+  ByteChain frame = MakeFrame(state.range(0));
+  std::vector<absl::string_view> slices = frame.AsStringViews();
+  std::string message;
+  for (auto _ : state) {
+    if (!ciphers.first->Encrypt(slices, &message)) {
+      state.SkipWithError("Failed to encrypt");
+      break;
+    }
+    benchmark::DoNotOptimize(message.data());
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Encrypt)->Range(1 << 10, 1 << 19);
+
+void BM_Decrypt(benchmark::State& state) {
+  auto ciphers = MakeCipherPair();
+  ByteChain frame = MakeFrame(state.range(0));
+  std::vector<absl::string_view> slices = frame.AsStringViews();
+  std::vector<std::string> messages(kBatchSize);
+  std::string decrypted;
+  for (auto _ : state) {
+    // Messages have to be decrypted in sequence, so every batch is freshly
+    // encrypted, outside of the measurement.
+    state.PauseTiming();
+    for (auto& message : messages) {
+      ciphers.first->Encrypt(slices, &message);
+    }
+    state.ResumeTiming();
+    for (const auto& message : messages) {
+      if (!ciphers.second->Decrypt(message, &decrypted)) {
+        state.SkipWithError("Failed to decrypt");
+        break;
+      }
+      benchmark::DoNotOptimize(decrypted.data());
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * kBatchSize * state.range(0));
+}
+BENCHMARK(BM_Decrypt)->Range(1 << 10, 1 << 19);
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
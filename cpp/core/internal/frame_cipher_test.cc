@@ -0,0 +1,127 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/frame_cipher.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "securegcm/ukey2_handshake.h"
+#include "gtest/gtest.h"
+#include "platform/public/count_down_latch.h"
+#include "platform/public/single_thread_executor.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace {
+
+using EncryptionContext = FrameCipher::EncryptionContext;
+using Handshake = ::securegcm::UKey2Handshake;
+
+constexpr auto kCipher = Handshake::HandshakeCipher::P256_SHA512;
+
+// Returns the client and server ciphers of a completed key exchange.
+std::pair<std::unique_ptr<FrameCipher>, std::unique_ptr<FrameCipher>>
+MakeCipherPair() {
+  auto client = Handshake::ForInitiator(kCipher);
+  auto server = Handshake::ForResponder(kCipher);
+  EXPECT_TRUE(
+      server->ParseHandshakeMessage(*client->GetNextHandshakeMessage())
+          .success);
+  EXPECT_TRUE(
+      client->ParseHandshakeMessage(*server->GetNextHandshakeMessage())
+          .success);
+  EXPECT_TRUE(
+      server->ParseHandshakeMessage(*client->GetNextHandshakeMessage())
+          .success);
+  EXPECT_NE(client->GetVerificationString(32), nullptr);
+  EXPECT_NE(server->GetVerificationString(32), nullptr);
+  EXPECT_TRUE(client->VerifyHandshake());
+  EXPECT_TRUE(server->VerifyHandshake());
+  return std::make_pair(
+      std::make_unique<FrameCipher>(
+          std::shared_ptr<EncryptionContext>(client->ToConnectionContext())),
+      std::make_unique<FrameCipher>(
+          std::shared_ptr<EncryptionContext>(server->ToConnectionContext())));
+}
+
+TEST(FrameCipherTest, DecryptsWhatPeerEncrypts) {
+  auto ciphers = MakeCipherPair();
+  const absl::string_view frame[] = {"data ", "message"};
+  std::string message;
+  std::string decrypted;
+
+  ASSERT_TRUE(ciphers.first->Encrypt(frame, &message));
+  EXPECT_NE(message, "data message");
+  ASSERT_TRUE(ciphers.second->Decrypt(message, &decrypted));
+  EXPECT_EQ(decrypted, "data message");
+}
+
+TEST(FrameCipherTest, RejectsMessageOutOfSequence) {
+  auto ciphers = MakeCipherPair();
+  const absl::string_view first[] = {"first"};
+  const absl::string_view second[] = {"second"};
+  std::string first_message;
+  std::string second_message;
+  std::string decrypted;
+  ASSERT_TRUE(ciphers.first->Encrypt(first, &first_message));
+  ASSERT_TRUE(ciphers.first->Encrypt(second, &second_message));
+
+  EXPECT_FALSE(ciphers.second->Decrypt(second_message, &decrypted));
+}
+
+TEST(FrameCipherTest, EncryptsAndDecryptsConcurrently) {
+  auto ciphers = MakeCipherPair();
+  FrameCipher& client = *ciphers.first;
+  FrameCipher& server = *ciphers.second;
+  constexpr int kFrameCount = 100;
+  const std::string data(64, 'x');
+  const absl::string_view frame[] = {data};
+  // Messages the server encrypted ahead of time, for the client to decrypt
+  // while it is encrypting its own.
+  std::vector<std::string> server_messages(kFrameCount);
+  for (auto& message : server_messages) {
+    ASSERT_TRUE(server.Encrypt(frame, &message));
+  }
+  SingleThreadExecutor executor;
+  CountDownLatch done(1);
+
+  executor.Execute([&]() {
+    std::string decrypted;
+    for (const auto& message : server_messages) {
+      EXPECT_TRUE(client.Decrypt(message, &decrypted));
+      EXPECT_EQ(decrypted, data);
+    }
+    done.CountDown();
+  });
+  std::vector<std::string> client_messages(kFrameCount);
+  for (auto& message : client_messages) {
+    EXPECT_TRUE(client.Encrypt(frame, &message));
+  }
+  EXPECT_TRUE(done.Await().Ok());
+
+  std::string decrypted;
+  for (const auto& message : client_messages) {
+    EXPECT_TRUE(server.Decrypt(message, &decrypted));
+    EXPECT_EQ(decrypted, data);
+  }
+}
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
@@ -21,6 +21,7 @@
 #include "core/payload.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/exception.h"
+#include "platform/base/feature_flags.h"
 #include "platform/public/condition_variable.h"
 #include "platform/public/file.h"
 #include "platform/public/logging.h"
@@ -142,8 +143,12 @@ class OutgoingStreamInternalPayload : public InternalPayload {
 
 class IncomingStreamInternalPayload : public InternalPayload {
  public:
-  IncomingStreamInternalPayload(Payload payload, OutputStream& output_stream)
-      : InternalPayload(std::move(payload)), output_stream_(&output_stream) {}
+  // Shares ownership of |pipe| with the Payload: the client may drop the
+  // Payload before this is closed.
+  IncomingStreamInternalPayload(Payload payload, std::shared_ptr<Pipe> pipe)
+      : InternalPayload(std::move(payload)),
+        pipe_(std::move(pipe)),
+        output_stream_(&pipe_->GetOutputStream()) {}
 
   PayloadTransferFrame::PayloadHeader::PayloadType GetType() const override {
     return PayloadTransferFrame::PayloadHeader::STREAM;
@@ -173,6 +178,7 @@ class IncomingStreamInternalPayload : public InternalPayload {
   void Close() override { output_stream_->Close(); }
 
  private:
+  std::shared_ptr<Pipe> pipe_;
   OutputStream* output_stream_;
 };
 
@@ -323,14 +329,21 @@ std::unique_ptr<InternalPayload> CreateIncomingInternalPayload(
     }
 
     case PayloadTransferFrame::PayloadHeader::STREAM: {
-      auto pipe = std::make_shared<Pipe>();
+      const FeatureFlags::Flags& flags = FeatureFlags::GetInstance().GetFlags();
+      // A stalled app fails its stream payload rather than holding up the
+      // reader thread of the endpoint until the endpoint times out.
+      auto pipe = flags.incoming_stream_pipe_capacity > 0
+                      ? std::make_shared<Pipe>(
+                            flags.incoming_stream_pipe_capacity,
+                            flags.incoming_stream_pipe_write_timeout)
+                      : std::make_shared<Pipe>();
 
       return absl::make_unique<IncomingStreamInternalPayload>(
           Payload(payload_id,
                   [pipe]() -> InputStream& {
                     return pipe->GetInputStream();  // NOLINT
                   }),
-          pipe->GetOutputStream());
+          pipe);
     }
 
     case PayloadTransferFrame::PayloadHeader::FILE: {
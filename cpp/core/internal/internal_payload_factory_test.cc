@@ -19,8 +19,13 @@
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "core/internal/offline_frames.h"
 #include "platform/base/byte_array.h"
+#include "platform/base/exception.h"
+#include "platform/base/feature_flags.h"
+#include "platform/base/medium_environment.h"
 #include "platform/public/pipe.h"
 #include "proto/connections/offline_wire_formats.pb.h"
 
@@ -109,6 +114,39 @@ TEST(InternalPayloadFActoryTest, CanCreateIternalPayloadFromStreamMessage) {
   EXPECT_EQ(payload.GetType(), Payload::Type::kStream);
 }
 
+TEST(InternalPayloadFActoryTest, IncomingStreamFailsWhileAppDoesNotRead) {
+  MediumEnvironment& env = MediumEnvironment::Instance();
+  FeatureFlags::Flags saved_flags = FeatureFlags::GetInstance().GetFlags();
+  FeatureFlags::Flags flags = saved_flags;
+  flags.incoming_stream_pipe_capacity = 4;
+  flags.incoming_stream_pipe_write_timeout = absl::Milliseconds(100);
+  env.SetFeatureFlags(flags);
+  PayloadTransferFrame frame;
+  frame.set_packet_type(PayloadTransferFrame::DATA);
+  auto& header = *frame.mutable_payload_header();
+  header.set_type(PayloadTransferFrame::PayloadHeader::STREAM);
+  header.set_id(12345);
+  header.set_total_size(0);
+  std::unique_ptr<InternalPayload> internal_payload =
+      CreateIncomingInternalPayload(frame);
+  env.SetFeatureFlags(saved_flags);
+  ASSERT_NE(internal_payload, nullptr);
+  Payload payload = internal_payload->ReleasePayload();
+
+  // The first chunk fills the pipe. The app does not read it, so the next one
+  // gives up, instead of blocking the reader thread of the endpoint for good.
+  EXPECT_TRUE(
+      internal_payload->AttachNextChunk(ByteArray(std::string("ABCD"))).Ok());
+  absl::Time start = absl::Now();
+  EXPECT_EQ(internal_payload->AttachNextChunk(ByteArray(std::string("EFGH"))),
+            Exception{Exception::kTimeout});
+  EXPECT_LT(absl::Now() - start, absl::Seconds(1));
+
+  ExceptionOr<ByteArray> read_data = payload.AsStream()->Read(Pipe::kChunkSize);
+  ASSERT_TRUE(read_data.ok());
+  EXPECT_EQ(std::string(read_data.result()), "ABCD");
+}
+
 TEST(InternalPayloadFActoryTest, CanCreateIternalPayloadFromFileMessage) {
   PayloadTransferFrame frame;
   frame.set_packet_type(PayloadTransferFrame::DATA);
@@ -127,6 +165,25 @@ TEST(InternalPayloadFActoryTest, CanCreateIternalPayloadFromFileMessage) {
   EXPECT_EQ(payload.GetId(), payload.AsFile()->GetPayloadId());
 }
 
+TEST(InternalPayloadFActoryTest,
+     IncomingStreamPayloadOutlivesDroppedClientPayload) {
+  PayloadTransferFrame frame;
+  frame.set_packet_type(PayloadTransferFrame::DATA);
+  auto& header = *frame.mutable_payload_header();
+  header.set_type(PayloadTransferFrame::PayloadHeader::STREAM);
+  header.set_id(12345);
+  header.set_total_size(0);
+  std::unique_ptr<InternalPayload> internal_payload =
+      CreateIncomingInternalPayload(frame);
+  ASSERT_NE(internal_payload, nullptr);
+  // The client may drop the stream Payload before the transfer is over.
+  internal_payload->ReleasePayload();
+
+  EXPECT_TRUE(internal_payload->AttachNextChunk(ByteArray(kText)).Ok());
+  EXPECT_TRUE(internal_payload->AttachNextChunk(ByteArray()).Ok());
+  internal_payload->Close();
+}
+
 void CreateFileWithContents(Payload::Id payload_id, const ByteArray& contents) {
   OutputFile file(payload_id);
   EXPECT_TRUE(file.Write(contents).Ok());
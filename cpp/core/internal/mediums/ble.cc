@@ -20,6 +20,7 @@
 
 #include "absl/strings/escaping.h"
 #include "core/internal/mediums/ble_v2/ble_advertisement.h"
+#include "core/internal/mediums/service_id_hash_registry.h"
 #include "core/internal/mediums/utils.h"
 #include "platform/base/prng.h"
 #include "platform/public/logging.h"
@@ -30,7 +31,7 @@ namespace nearby {
 namespace connections {
 
 ByteArray Ble::GenerateHash(const std::string& source, size_t size) {
-  return Utils::Sha256Hash(source, size);
+  return ServiceIdHashRegistry::GetInstance().GetHash(source, size);
 }
 
 ByteArray Ble::GenerateDeviceToken() {
@@ -0,0 +1,66 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Insertions into and lookups in the bloom filter that BLE advertisements
+// carry, across element lengths.
+//
+// Run with:
+//   blaze run -c opt //core/internal/mediums:bloom_filter_benchmark -- \
+//     --benchmark_filter=all
+
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "core/internal/mediums/bloom_filter.h"
+#include "platform/base/allocation_counter.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace mediums {
+namespace {
+
+// The length of the service id bloom filter in BLE advertisement headers.
+constexpr int kCapacityInBytes = 10;
+
+void BM_Add(benchmark::State& state) {
+  BloomFilter<kCapacityInBytes> bloom_filter;
+  std::string element(state.range(0), 'e');
+  AllocationCounter counter;
+  for (auto _ : state) {
+    bloom_filter.Add(element);
+  }
+  SetAllocationCounters(state, counter);
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Add)->Range(8, 256);
+
+void BM_PossiblyContains(benchmark::State& state) {
+  BloomFilter<kCapacityInBytes> bloom_filter;
+  std::string element(state.range(0), 'e');
+  bloom_filter.Add(element);
+  AllocationCounter counter;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(bloom_filter.PossiblyContains(element));
+  }
+  SetAllocationCounters(state, counter);
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PossiblyContains)->Range(8, 256);
+
+}  // namespace
+}  // namespace mediums
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
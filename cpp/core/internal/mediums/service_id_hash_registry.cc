@@ -0,0 +1,47 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/mediums/service_id_hash_registry.h"
+
+#include "core/internal/mediums/utils.h"
+#include "platform/public/mutex_lock.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+ServiceIdHashRegistry& ServiceIdHashRegistry::GetInstance() {
+  static ServiceIdHashRegistry* instance = new ServiceIdHashRegistry();
+  return *instance;
+}
+
+ByteArray ServiceIdHashRegistry::GetHash(const std::string& service_id,
+                                         size_t length) {
+  auto key = std::make_pair(service_id, length);
+  {
+    MutexLock lock(&mutex_);
+    auto item = hashes_.find(key);
+    if (item != hashes_.end()) return item->second;
+  }
+
+  // Hashed without the lock, so that lookups of other service ids don't wait.
+  ByteArray hash = Utils::Sha256Hash(service_id, length);
+  MutexLock lock(&mutex_);
+  if (hashes_.size() < kMaxEntries) hashes_.emplace(key, hash);
+  return hash;
+}
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
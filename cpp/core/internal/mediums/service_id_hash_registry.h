@@ -0,0 +1,64 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_INTERNAL_MEDIUMS_SERVICE_ID_HASH_REGISTRY_H_
+#define CORE_INTERNAL_MEDIUMS_SERVICE_ID_HASH_REGISTRY_H_
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "platform/base/byte_array.h"
+#include "platform/public/mutex.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+// Caches the truncated SHA-256 hashes of service ids, which advertisements
+// carry and discovery matches against, so that each one is computed once per
+// service id and length rather than once per advertisement.
+//
+// Service ids are expected to be few; once kMaxEntries hashes are cached, the
+// hashes of further service ids are computed every time.
+class ServiceIdHashRegistry {
+ public:
+  static constexpr int kMaxEntries = 256;
+
+  // Returns the registry shared by the whole process.
+  static ServiceIdHashRegistry& GetInstance();
+
+  ServiceIdHashRegistry() = default;
+  ServiceIdHashRegistry(const ServiceIdHashRegistry&) = delete;
+  ServiceIdHashRegistry& operator=(const ServiceIdHashRegistry&) = delete;
+
+  // Returns the first |length| bytes of the SHA-256 hash of |service_id|; the
+  // same as Utils::Sha256Hash().
+  ByteArray GetHash(const std::string& service_id, size_t length)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  Mutex mutex_;
+  // Keyed by service id and hash length.
+  absl::flat_hash_map<std::pair<std::string, size_t>, ByteArray> hashes_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
+
+#endif  // CORE_INTERNAL_MEDIUMS_SERVICE_ID_HASH_REGISTRY_H_
@@ -0,0 +1,57 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/mediums/service_id_hash_registry.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
+#include "core/internal/mediums/utils.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace {
+
+constexpr char kServiceId[] = "service";
+
+TEST(ServiceIdHashRegistryTest, GetHashMatchesSha256Hash) {
+  ServiceIdHashRegistry registry;
+
+  for (size_t length : {3, 4, 32}) {
+    EXPECT_EQ(registry.GetHash(kServiceId, length),
+              Utils::Sha256Hash(kServiceId, length));
+    // The second time around it comes from the table.
+    EXPECT_EQ(registry.GetHash(kServiceId, length),
+              Utils::Sha256Hash(kServiceId, length));
+  }
+}
+
+TEST(ServiceIdHashRegistryTest, GetHashKeepsWorkingWhenFull) {
+  ServiceIdHashRegistry registry;
+
+  for (int i = 0; i < ServiceIdHashRegistry::kMaxEntries; i++) {
+    registry.GetHash(absl::StrCat("service ", i), 3);
+  }
+
+  EXPECT_EQ(registry.GetHash(kServiceId, 3), Utils::Sha256Hash(kServiceId, 3));
+  EXPECT_EQ(registry.GetHash("service 0", 3),
+            Utils::Sha256Hash("service 0", 3));
+}
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
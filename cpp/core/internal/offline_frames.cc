@@ -14,13 +14,16 @@
 
 #include "core/internal/offline_frames.h"
 
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <utility>
 
 #include "core/internal/message_lite.h"
 #include "core/internal/offline_frames_validator.h"
 #include "core/status.h"
 #include "platform/base/byte_array.h"
+#include "platform/base/byte_chain.h"
 
 namespace location {
 namespace nearby {
@@ -38,12 +41,117 @@ ByteArray ToBytes(OfflineFrame&& frame) {
   return bytes;
 }
 
+// Protocol buffer wire format primitives, used to encode DATA payload
+// transfer frames without building (and copying the body into) an
+// OfflineFrame. See
+// https://developers.google.com/protocol-buffers/docs/encoding
+constexpr std::uint32_t kWireTypeVarint = 0;
+constexpr std::uint32_t kWireTypeLengthDelimited = 2;
+
+size_t VarintSize(std::uint64_t value) {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+void AppendVarint(std::uint64_t value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+void AppendTag(std::uint32_t field_number, std::uint32_t wire_type,
+               std::string* out) {
+  AppendVarint((field_number << 3) | wire_type, out);
+}
+
+// Negative int32 and int64 values are sign-extended to 64 bits.
+void AppendVarintField(std::uint32_t field_number, std::int64_t value,
+                       std::string* out) {
+  AppendTag(field_number, kWireTypeVarint, out);
+  AppendVarint(static_cast<std::uint64_t>(value), out);
+}
+
+void AppendLengthDelimitedTag(std::uint32_t field_number, size_t length,
+                              std::string* out) {
+  AppendTag(field_number, kWireTypeLengthDelimited, out);
+  AppendVarint(length, out);
+}
+
+// All field numbers we encode are below 16, so every tag takes one byte.
+size_t VarintFieldSize(std::int64_t value) {
+  return 1 + VarintSize(static_cast<std::uint64_t>(value));
+}
+
+size_t LengthDelimitedFieldSize(size_t length) {
+  return 1 + VarintSize(length) + length;
+}
+
+// Returns the encoding of a DATA OfflineFrame, up to and including the tag and
+// length of the chunk body; the body itself (if any) must follow.
+std::string EncodeDataPayloadTransferPrefix(
+    const PayloadTransferFrame::PayloadHeader& header,
+    const PayloadTransferFrame::PayloadChunk& chunk, bool has_body,
+    size_t body_size) {
+  std::string chunk_fields;
+  if (chunk.has_flags()) {
+    AppendVarintField(PayloadTransferFrame::PayloadChunk::kFlagsFieldNumber,
+                      chunk.flags(), &chunk_fields);
+  }
+  if (chunk.has_offset()) {
+    AppendVarintField(PayloadTransferFrame::PayloadChunk::kOffsetFieldNumber,
+                      chunk.offset(), &chunk_fields);
+  }
+  const std::string header_bytes = header.SerializeAsString();
+
+  const size_t chunk_size =
+      chunk_fields.size() +
+      (has_body ? LengthDelimitedFieldSize(body_size) : 0);
+  const size_t payload_transfer_size =
+      VarintFieldSize(PayloadTransferFrame::DATA) +
+      LengthDelimitedFieldSize(header_bytes.size()) +
+      LengthDelimitedFieldSize(chunk_size);
+  const size_t v1_size = VarintFieldSize(V1Frame::PAYLOAD_TRANSFER) +
+                         LengthDelimitedFieldSize(payload_transfer_size);
+  const size_t frame_size = VarintFieldSize(OfflineFrame::V1) +
+                            LengthDelimitedFieldSize(v1_size);
+
+  std::string prefix;
+  prefix.reserve(frame_size - body_size);
+  AppendVarintField(OfflineFrame::kVersionFieldNumber, OfflineFrame::V1,
+                    &prefix);
+  AppendLengthDelimitedTag(OfflineFrame::kV1FieldNumber, v1_size, &prefix);
+  AppendVarintField(V1Frame::kTypeFieldNumber, V1Frame::PAYLOAD_TRANSFER,
+                    &prefix);
+  AppendLengthDelimitedTag(V1Frame::kPayloadTransferFieldNumber,
+                           payload_transfer_size, &prefix);
+  AppendVarintField(PayloadTransferFrame::kPacketTypeFieldNumber,
+                    PayloadTransferFrame::DATA, &prefix);
+  AppendLengthDelimitedTag(PayloadTransferFrame::kPayloadHeaderFieldNumber,
+                           header_bytes.size(), &prefix);
+  prefix.append(header_bytes);
+  AppendLengthDelimitedTag(PayloadTransferFrame::kPayloadChunkFieldNumber,
+                           chunk_size, &prefix);
+  prefix.append(chunk_fields);
+  if (has_body) {
+    AppendLengthDelimitedTag(
+        PayloadTransferFrame::PayloadChunk::kBodyFieldNumber, body_size,
+        &prefix);
+  }
+  return prefix;
+}
+
 }  // namespace
 
 ExceptionOrOfflineFrame FromBytes(const ByteArray& bytes) {
   OfflineFrame frame;
 
-  if (frame.ParseFromString(std::string(bytes))) {
+  if (frame.ParseFromArray(bytes.data(), bytes.size())) {
     Exception validation_exception = EnsureValidOfflineFrame(frame);
     if (validation_exception.Raised()) {
       return ExceptionOrOfflineFrame(validation_exception);
@@ -123,17 +231,20 @@ ByteArray ForConnectionResponse(std::int32_t status) {
 ByteArray ForDataPayloadTransfer(
     const PayloadTransferFrame::PayloadHeader& header,
     const PayloadTransferFrame::PayloadChunk& chunk) {
-  OfflineFrame frame;
-
-  frame.set_version(OfflineFrame::V1);
-  auto* v1_frame = frame.mutable_v1();
-  v1_frame->set_type(V1Frame::PAYLOAD_TRANSFER);
-  auto* sub_frame = v1_frame->mutable_payload_transfer();
-  sub_frame->set_packet_type(PayloadTransferFrame::DATA);
-  *sub_frame->mutable_payload_header() = header;
-  *sub_frame->mutable_payload_chunk() = chunk;
+  std::string bytes = EncodeDataPayloadTransferPrefix(
+      header, chunk, chunk.has_body(), chunk.body().size());
+  bytes.reserve(bytes.size() + chunk.body().size());
+  bytes.append(chunk.body());
+  return ByteArray(std::move(bytes));
+}
 
-  return ToBytes(std::move(frame));
+ByteChain ForDataPayloadTransfer(
+    const PayloadTransferFrame::PayloadHeader& header,
+    const PayloadTransferFrame::PayloadChunk& chunk, ByteSlice body) {
+  ByteChain bytes(ByteArray(EncodeDataPayloadTransferPrefix(
+      header, chunk, !body.Empty(), body.size())));
+  bytes.Append(std::move(body));
+  return bytes;
 }
 
 ByteArray ForControlPayloadTransfer(
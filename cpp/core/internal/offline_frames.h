@@ -20,6 +20,7 @@
 
 #include "core/options.h"
 #include "platform/base/byte_array.h"
+#include "platform/base/byte_chain.h"
 #include "platform/base/exception.h"
 #include "proto/connections/offline_wire_formats.pb.h"
 
@@ -35,6 +36,8 @@ using UpgradePathInfo = BandwidthUpgradeNegotiationFrame::UpgradePathInfo;
 // Parses incoming message.
 // Returns OfflineFrame if parser was able to understand it, or
 // Exception::kInvalidProtocolBuffer, if parser failed.
+// The message is parsed in place, but the body of a DATA payload transfer is
+// still copied into the PayloadChunk of the result.
 ExceptionOr<OfflineFrame> FromBytes(const ByteArray& offline_frame_bytes);
 
 // Returns FrameType of a parsed message, or
@@ -52,9 +55,16 @@ ByteArray ForConnectionRequest(const std::string& endpoint_id,
 ByteArray ForConnectionResponse(std::int32_t status);
 
 // Builds Payload transfer messages.
+// DATA messages are encoded directly, without building an OfflineFrame; the
+// chunk body is copied only once, into the end of the message.
 ByteArray ForDataPayloadTransfer(
     const PayloadTransferFrame::PayloadHeader& header,
     const PayloadTransferFrame::PayloadChunk& chunk);
+// Same as above, but the message is made of the encoded fields followed by
+// |body|, which is not copied. |chunk| must not have a body of its own.
+ByteChain ForDataPayloadTransfer(
+    const PayloadTransferFrame::PayloadHeader& header,
+    const PayloadTransferFrame::PayloadChunk& chunk, ByteSlice body);
 ByteArray ForControlPayloadTransfer(
     const PayloadTransferFrame::PayloadHeader& header,
     const PayloadTransferFrame::ControlMessage& control);
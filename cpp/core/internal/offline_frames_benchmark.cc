@@ -0,0 +1,143 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Encoding and parsing of offline frames, from 32 byte control frames up to
+// 1 MB payload chunks.
+//
+// Run with:
+//   blaze run -c opt //core/internal:offline_frames_benchmark -- \
+//     --benchmark_filter=all
+
+#include <cstdint>
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "core/internal/offline_frames.h"
+#include "platform/base/allocation_counter.h"
+#include "platform/base/byte_array.h"
+#include "platform/base/byte_chain.h"
+#include "proto/connections/offline_wire_formats.pb.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace parser {
+namespace {
+
+constexpr std::int64_t kMinSize = 32;
+constexpr std::int64_t kMaxSize = 1 << 20;
+
+PayloadTransferFrame::PayloadHeader MakeHeader() {
+  PayloadTransferFrame::PayloadHeader header;
+  header.set_id(1234567890123456789);
+  header.set_type(PayloadTransferFrame::PayloadHeader::FILE);
+  header.set_total_size(64 * kMaxSize);
+  return header;
+}
+
+PayloadTransferFrame::PayloadChunk MakeChunk() {
+  PayloadTransferFrame::PayloadChunk chunk;
+  chunk.set_offset(16 * kMaxSize);
+  chunk.set_flags(0);
+  return chunk;
+}
+
+void BM_ForDataPayloadTransfer(benchmark::State& state) {
+  PayloadTransferFrame::PayloadHeader header = MakeHeader();
+  PayloadTransferFrame::PayloadChunk chunk = MakeChunk();
+  chunk.set_body(std::string(state.range(0), 'b'));
+  AllocationCounter counter;
+  for (auto _ : state) {
+    ByteArray bytes = ForDataPayloadTransfer(header, chunk);
+    benchmark::DoNotOptimize(bytes.data());
+  }
+  SetAllocationCounters(state, counter);
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ForDataPayloadTransfer)->RangeMultiplier(8)->Range(kMinSize,
+                                                                 kMaxSize);
+
+// The variant that leaves the chunk body where it is.
+void BM_ForDataPayloadTransferChain(benchmark::State& state) {
+  PayloadTransferFrame::PayloadHeader header = MakeHeader();
+  PayloadTransferFrame::PayloadChunk chunk = MakeChunk();
+  ByteSlice body(ByteArray(std::string(state.range(0), 'b')));
+  AllocationCounter counter;
+  for (auto _ : state) {
+    ByteChain bytes = ForDataPayloadTransfer(header, chunk, body);
+    benchmark::DoNotOptimize(bytes.size());
+  }
+  SetAllocationCounters(state, counter);
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ForDataPayloadTransferChain)
+    ->RangeMultiplier(8)
+    ->Range(kMinSize, kMaxSize);
+
+void BM_FromBytesData(benchmark::State& state) {
+  PayloadTransferFrame::PayloadChunk chunk = MakeChunk();
+  chunk.set_body(std::string(state.range(0), 'b'));
+  ByteArray bytes = ForDataPayloadTransfer(MakeHeader(), chunk);
+  AllocationCounter counter;
+  for (auto _ : state) {
+    ExceptionOr<OfflineFrame> frame = FromBytes(bytes);
+    if (!frame.ok()) {
+      state.SkipWithError("Failed to parse");
+      break;
+    }
+    benchmark::DoNotOptimize(frame.result());
+  }
+  SetAllocationCounters(state, counter);
+  state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_FromBytesData)->RangeMultiplier(8)->Range(kMinSize, kMaxSize);
+
+void BM_FromBytesControl(benchmark::State& state) {
+  PayloadTransferFrame::ControlMessage control;
+  control.set_event(PayloadTransferFrame::ControlMessage::PAYLOAD_CANCELED);
+  control.set_offset(16 * kMaxSize);
+  ByteArray bytes = ForControlPayloadTransfer(MakeHeader(), control);
+  AllocationCounter counter;
+  for (auto _ : state) {
+    ExceptionOr<OfflineFrame> frame = FromBytes(bytes);
+    if (!frame.ok()) {
+      state.SkipWithError("Failed to parse");
+      break;
+    }
+    benchmark::DoNotOptimize(frame.result());
+  }
+  SetAllocationCounters(state, counter);
+}
+BENCHMARK(BM_FromBytesControl);
+
+void BM_FromBytesKeepAlive(benchmark::State& state) {
+  ByteArray bytes = ForKeepAlive();
+  AllocationCounter counter;
+  for (auto _ : state) {
+    ExceptionOr<OfflineFrame> frame = FromBytes(bytes);
+    if (!frame.ok()) {
+      state.SkipWithError("Failed to parse");
+      break;
+    }
+    benchmark::DoNotOptimize(frame.result());
+  }
+  SetAllocationCounters(state, counter);
+}
+BENCHMARK(BM_FromBytesKeepAlive);
+
+}  // namespace
+}  // namespace parser
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
@@ -16,12 +16,14 @@
 
 #include <array>
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "platform/base/byte_array.h"
+#include "platform/base/byte_chain.h"
 #include "proto/connections/offline_wire_formats.pb.h"
 
 namespace location {
@@ -187,6 +189,61 @@ TEST(OfflineFramesTest, CanGenerateDataPayloadTransfer) {
   EXPECT_THAT(message, EqualsProto(kExpected));
 }
 
+TEST(OfflineFramesTest, DataPayloadTransferMatchesProtoEncoding) {
+  PayloadTransferFrame::PayloadHeader header;
+  PayloadTransferFrame::PayloadChunk chunk;
+  header.set_id(-12345);
+  header.set_type(PayloadTransferFrame::PayloadHeader::FILE);
+  header.set_total_size(1 << 20);
+  header.set_file_name("file.bin");
+  chunk.set_body(std::string(300, 'x'));
+  chunk.set_offset(1 << 18);
+  chunk.set_flags(0);
+
+  OfflineFrame frame;
+  frame.set_version(OfflineFrame::V1);
+  auto* v1_frame = frame.mutable_v1();
+  v1_frame->set_type(V1Frame::PAYLOAD_TRANSFER);
+  auto* sub_frame = v1_frame->mutable_payload_transfer();
+  sub_frame->set_packet_type(PayloadTransferFrame::DATA);
+  *sub_frame->mutable_payload_header() = header;
+  *sub_frame->mutable_payload_chunk() = chunk;
+
+  EXPECT_EQ(std::string(ForDataPayloadTransfer(header, chunk)),
+            frame.SerializeAsString());
+
+  // Last chunk: no body at all.
+  chunk.clear_body();
+  chunk.set_flags(PayloadTransferFrame::PayloadChunk::LAST_CHUNK);
+  *sub_frame->mutable_payload_chunk() = chunk;
+
+  EXPECT_EQ(std::string(ForDataPayloadTransfer(header, chunk)),
+            frame.SerializeAsString());
+}
+
+TEST(OfflineFramesTest, DataPayloadTransferKeepsSeparateBody) {
+  PayloadTransferFrame::PayloadHeader header;
+  PayloadTransferFrame::PayloadChunk chunk;
+  header.set_id(12345);
+  header.set_type(PayloadTransferFrame::PayloadHeader::BYTES);
+  header.set_total_size(1024);
+  chunk.set_offset(150);
+  chunk.set_flags(0);
+  ByteSlice body(ByteArray(std::string(1024, 'x')));
+  const char* body_data = body.data();
+
+  ByteChain bytes = ForDataPayloadTransfer(header, chunk, body);
+
+  // The body is shared, not copied.
+  EXPECT_EQ(bytes.slices().back().data(), body_data);
+  chunk.set_body(std::string(body.AsStringView()));
+  EXPECT_EQ(bytes.Flatten(), ForDataPayloadTransfer(header, chunk));
+  auto response = FromBytes(bytes.Flatten());
+  ASSERT_TRUE(response.ok());
+  EXPECT_EQ(response.result().v1().payload_transfer().payload_chunk().body(),
+            chunk.body());
+}
+
 TEST(OfflineFramesTest, CanGenerateBwuWifiHotspotPathAvailable) {
   constexpr char kExpected[] =
       R"pb(
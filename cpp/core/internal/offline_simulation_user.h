@@ -49,7 +49,8 @@ class OfflineSimulationUser {
 
   explicit OfflineSimulationUser(
       absl::string_view device_name,
-      BooleanMediumSelector allowed = BooleanMediumSelector())
+      BooleanMediumSelector allowed = BooleanMediumSelector(),
+      Strategy strategy = Strategy::kP2pCluster)
       : connection_options_{
             .keep_alive_interval_millis = FeatureFlags::GetInstance()
                                               .GetFlags()
@@ -60,7 +61,7 @@ class OfflineSimulationUser {
         },
         info_{ByteArray{std::string(device_name)}},
         options_{
-            .strategy = Strategy::kP2pCluster,
+            .strategy = strategy,
             .allowed = allowed,
         } {}
   virtual ~OfflineSimulationUser() = default;
@@ -112,6 +113,12 @@ class OfflineSimulationUser {
     reject_latch_ = &latch;
   }
 
+  // Synchronizes on the next initiated_cb callback, in place of the latch
+  // given to StartAdvertising() or RequestConnection().
+  void ExpectConnectionInitiated(CountDownLatch& latch) {
+    initiated_latch_ = &latch;
+  }
+
   void ExpectPayload(CountDownLatch& latch) { payload_latch_ = &latch; }
   void ExpectDisconnect(CountDownLatch& latch) { disconnect_latch_ = &latch; }
 
@@ -16,15 +16,18 @@
 
 #include "absl/functional/bind_front.h"
 #include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
 #include "core/internal/base_pcp_handler.h"
 #include "core/internal/ble_advertisement.h"
 #include "core/internal/ble_endpoint_channel.h"
 #include "core/internal/bluetooth_endpoint_channel.h"
 #include "core/internal/bwu_manager.h"
+#include "core/internal/mediums/service_id_hash_registry.h"
 #include "core/internal/mediums/utils.h"
 #include "core/internal/mediums/webrtc/webrtc_socket_wrapper.h"
 #include "core/internal/webrtc_endpoint_channel.h"
 #include "core/internal/wifi_lan_endpoint_channel.h"
+#include "platform/base/feature_flags.h"
 #include "platform/base/nsd_service_info.h"
 #include "platform/base/types.h"
 #include "platform/public/crypto.h"
@@ -34,9 +37,18 @@ namespace location {
 namespace nearby {
 namespace connections {
 
+namespace {
+
+absl::Duration GetDiscoveryCacheRefresh() {
+  return absl::Milliseconds(
+      FeatureFlags::GetInstance().GetFlags().discovery_cache_refresh_millis);
+}
+
+}  // namespace
+
 ByteArray P2pClusterPcpHandler::GenerateHash(const std::string& source,
                                              size_t size) {
-  return Utils::Sha256Hash(source, size);
+  return ServiceIdHashRegistry::GetInstance().GetHash(source, size);
 }
 
 bool P2pClusterPcpHandler::ShouldAdvertiseBluetoothMacOverBle(
@@ -60,7 +72,16 @@ P2pClusterPcpHandler::P2pClusterPcpHandler(
       ble_medium_(mediums->GetBle()),
       wifi_lan_medium_(mediums->GetWifiLan()),
       webrtc_medium_(mediums->GetWebRtc()),
-      injected_bluetooth_device_store_(injected_bluetooth_device_store) {}
+      injected_bluetooth_device_store_(injected_bluetooth_device_store),
+      bluetooth_discovery_cache_(GetDiscoveryCacheRefresh()),
+      ble_discovery_cache_(GetDiscoveryCacheRefresh()),
+      wifi_lan_discovery_cache_(GetDiscoveryCacheRefresh()) {}
+
+P2pClusterPcpHandler::~P2pClusterPcpHandler() {
+  // ConnectImpl() may still be running on a connection worker, using the
+  // mediums of this class; stop it before they are destroyed.
+  DisconnectFromEndpointManager();
+}
 
 // Returns a vector or mediums sorted in order or decreasing priority for
 // all the supported mediums.
@@ -208,6 +229,11 @@ bool P2pClusterPcpHandler::IsRecognizedBluetoothEndpoint(
 void P2pClusterPcpHandler::BluetoothDeviceDiscoveredHandler(
     ClientProxy* client, const std::string& service_id,
     BluetoothDevice device) {
+  if (!bluetooth_discovery_cache_.ShouldProcess(
+          client->GetClientId(), service_id, device.GetMacAddress(),
+          ByteArray(device.GetName()))) {
+    return;
+  }
   RunOnPcpHandlerThread(
       "p2p-bt-device-discovered",
       [this, client, service_id, device]()
@@ -254,6 +280,11 @@ void P2pClusterPcpHandler::BluetoothDeviceDiscoveredHandler(
 void P2pClusterPcpHandler::BluetoothNameChangedHandler(
     ClientProxy* client, const std::string& service_id,
     BluetoothDevice device) {
+  if (!bluetooth_discovery_cache_.ShouldProcess(
+          client->GetClientId(), service_id, device.GetMacAddress(),
+          ByteArray(device.GetName()))) {
+    return;
+  }
   RunOnPcpHandlerThread(
       "p2p-bt-name-changed",
       [this, client, service_id, device]() RUN_ON_PCP_HANDLER_THREAD() {
@@ -274,33 +305,18 @@ void P2pClusterPcpHandler::BluetoothNameChangedHandler(
                           << "]: processing new name " << device_name_string;
 
         // By this point, the BluetoothDevice passed to us has a different name
-        // than what we may have discovered before. We need to iterate over the
-        // found BluetoothEndpoints and compare their addresses to see the
-        // devices are the same. We are not guaranteed to discover a match,
-        // since the old name may not have been formatted for Nearby
+        // than what we may have discovered before. We look up the endpoint we
+        // found at the same MAC address, if any; we are not guaranteed to find
+        // one, since the old name may not have been formatted for Nearby
         // Connections.
-        for (auto endpoint :
-             GetDiscoveredEndpoints(proto::connections::Medium::BLUETOOTH)) {
-          BluetoothEndpoint* bluetoothEndpoint =
-              static_cast<BluetoothEndpoint*>(endpoint);
-          NEARBY_LOGS(INFO)
-              << "BT discovery handler (CHANGED) [client_id="
-              << client->GetClientId() << ", service_id=" << service_id
-              << "]: comparing MAC addresses with existing endpoint "
-              << bluetoothEndpoint->bluetooth_device.GetName()
-              << ". They have MAC address "
-              << bluetoothEndpoint->bluetooth_device.GetMacAddress()
-              << " and the new endpoint has MAC address "
-              << device.GetMacAddress();
-          if (bluetoothEndpoint->bluetooth_device.GetMacAddress() ==
-              device.GetMacAddress()) {
-            // Report the BluetoothEndpoint as lost to the client.
-            NEARBY_LOGS(INFO) << "Reporting lost BluetoothDevice "
-                              << bluetoothEndpoint->bluetooth_device.GetName()
-                              << ", due to device name change.";
-            OnEndpointLost(client, *endpoint);
-            break;
-          }
+        auto* endpoint = static_cast<BluetoothEndpoint*>(GetDiscoveredEndpoint(
+            proto::connections::Medium::BLUETOOTH, device.GetMacAddress()));
+        if (endpoint != nullptr) {
+          // Report the BluetoothEndpoint as lost to the client.
+          NEARBY_LOGS(INFO) << "Reporting lost BluetoothDevice "
+                            << endpoint->bluetooth_device.GetName()
+                            << ", due to device name change.";
+          OnEndpointLost(client, *endpoint);
         }
 
         // Make sure the Bluetooth device name points to a valid
@@ -335,9 +351,13 @@ void P2pClusterPcpHandler::BluetoothDeviceLostHandler(
     ClientProxy* client, const std::string& service_id,
     BluetoothDevice& device) {
   const std::string& device_name_string = device.GetName();
+  const std::string mac_address = device.GetMacAddress();
+  bluetooth_discovery_cache_.Forget(client->GetClientId(), service_id,
+                                    mac_address);
   RunOnPcpHandlerThread(
-      "p2p-bt-device-lost", [this, client, service_id,
-                             device_name_string]() RUN_ON_PCP_HANDLER_THREAD() {
+      "p2p-bt-device-lost",
+      [this, client, device_name_string,
+       mac_address]() RUN_ON_PCP_HANDLER_THREAD() {
         // Make sure we are still discovering before proceeding.
         if (!client->IsDiscovering()) {
           NEARBY_LOGS(WARNING)
@@ -347,23 +367,16 @@ void P2pClusterPcpHandler::BluetoothDeviceLostHandler(
           return;
         }
 
-        // Parse the Bluetooth device name.
-        BluetoothDeviceName device_name(device_name_string);
-
-        // Make sure the Bluetooth device name points to a valid
-        // endpoint we're discovering.
-        if (!IsRecognizedBluetoothEndpoint(device_name_string, service_id,
-                                           device_name))
-          return;
+        // Look up the endpoint we found at this MAC address; if there is
+        // none, the device wasn't a valid endpoint we're discovering.
+        DiscoveredEndpoint* endpoint = GetDiscoveredEndpoint(
+            proto::connections::Medium::BLUETOOTH, mac_address);
+        if (endpoint == nullptr) return;
 
         // Report the BluetoothEndpoint as lost to the client.
         NEARBY_LOGS(INFO) << "Processing lost BluetoothDeviceName "
                           << device_name_string;
-        OnEndpointLost(client, DiscoveredEndpoint{
-                                   device_name.GetEndpointId(),
-                                   device_name.GetEndpointInfo(), service_id,
-                                   proto::connections::Medium::BLUETOOTH,
-                                   WebRtcState::kUndefined});
+        OnEndpointLost(client, *endpoint);
       });
 }
 
@@ -415,6 +428,11 @@ void P2pClusterPcpHandler::BlePeripheralDiscoveredHandler(
     ClientProxy* client, BlePeripheral& peripheral,
     const std::string& service_id, const ByteArray& advertisement_bytes,
     bool fast_advertisement) {
+  if (!ble_discovery_cache_.ShouldProcess(client->GetClientId(), service_id,
+                                          peripheral.GetName(),
+                                          advertisement_bytes)) {
+    return;
+  }
   RunOnPcpHandlerThread(
       "p2p-ble-device-discovered",
       [this, client, &peripheral, service_id, advertisement_bytes,
@@ -435,14 +453,6 @@ void P2pClusterPcpHandler::BlePeripheralDiscoveredHandler(
         // endpoint we're discovering.
         if (!IsRecognizedBleEndpoint(service_id, advertisement)) return;
 
-        // Store all the state we need to be able to re-create a BleEndpoint
-        // in BlePeripheralLostHandler, since that isn't privy to
-        // the bytes of the ble advertisement itself.
-        found_ble_endpoints_.emplace(
-            peripheral.GetName(),
-            BleEndpointState(advertisement.GetEndpointId(),
-                             advertisement.GetEndpointInfo()));
-
         // Report the discovered endpoint to the client.
         NEARBY_LOGS(INFO) << "Found BleAdvertisement "
                           << absl::BytesToHexString(advertisement_bytes.data())
@@ -500,39 +510,31 @@ void P2pClusterPcpHandler::BlePeripheralLostHandler(
   std::string peripheral_name = peripheral.GetName();
   NEARBY_LOG(INFO, "Ble: [LOST, SCHED] peripheral_name=%s",
              peripheral_name.c_str());
+  ble_discovery_cache_.Forget(client->GetClientId(), service_id,
+                              peripheral_name);
   RunOnPcpHandlerThread(
       "p2p-ble-device-lost",
-      [this, client, service_id, &peripheral]() RUN_ON_PCP_HANDLER_THREAD() {
+      [this, client, peripheral_name]() RUN_ON_PCP_HANDLER_THREAD() {
         // Make sure we are still discovering before proceeding.
         if (!client->IsDiscovering()) {
           NEARBY_LOGS(WARNING)
-              << "Ignoring lost BlePeripheral " << peripheral.GetName()
+              << "Ignoring lost BlePeripheral " << peripheral_name
               << " because we are no longer discovering.";
           return;
         }
 
-        // Remove this BlePeripheral from found_ble_endpoints_, and
-        // report the endpoint as lost to the client.
-        auto item = found_ble_endpoints_.find(peripheral.GetName());
-        if (item != found_ble_endpoints_.end()) {
-          BleEndpointState ble_endpoint_state(item->second);
-          found_ble_endpoints_.erase(item);
-
-          // Report the discovered endpoint to the client.
-          NEARBY_LOGS(INFO)
-              << "Lost BleEndpoint for BlePeripheral " << peripheral.GetName()
-              << " (with endpoint_id=" << ble_endpoint_state.endpoint_id
-              << " and endpoint_info="
-              << absl::BytesToHexString(ble_endpoint_state.endpoint_info.data())
-              << ").";
-          OnEndpointLost(client, DiscoveredEndpoint{
-                                     ble_endpoint_state.endpoint_id,
-                                     ble_endpoint_state.endpoint_info,
-                                     service_id,
-                                     proto::connections::Medium::BLE,
-                                     WebRtcState::kUndefined,
-                                 });
-        }
+        // Look up the endpoint we found on this BlePeripheral, if any, and
+        // report it as lost to the client.
+        DiscoveredEndpoint* endpoint = GetDiscoveredEndpoint(
+            proto::connections::Medium::BLE, peripheral_name);
+        if (endpoint == nullptr) return;
+
+        NEARBY_LOGS(INFO)
+            << "Lost BleEndpoint for BlePeripheral " << peripheral_name
+            << " (with endpoint_id=" << endpoint->endpoint_id
+            << " and endpoint_info="
+            << absl::BytesToHexString(endpoint->endpoint_info.data()) << ").";
+        OnEndpointLost(client, *endpoint);
       });
 }
 
@@ -570,6 +572,19 @@ bool P2pClusterPcpHandler::IsRecognizedWifiLanEndpoint(
 void P2pClusterPcpHandler::WifiLanServiceDiscoveredHandler(
     ClientProxy* client, WifiLanService& wifi_lan_service,
     const std::string& service_id) {
+  // The service name is the advertisement, apart from the endpoint info and
+  // the address the service is reachable at.
+  NsdServiceInfo nsd_service_info = wifi_lan_service.GetServiceInfo();
+  std::pair<std::string, int> address = nsd_service_info.GetServiceAddress();
+  if (!wifi_lan_discovery_cache_.ShouldProcess(
+          client->GetClientId(), service_id,
+          nsd_service_info.GetServiceInfoName(),
+          ByteArray(absl::StrCat(
+              nsd_service_info.GetTxtRecord(
+                  std::string(WifiLanServiceInfo::kKeyEndpointInfo)),
+              "@", address.first, ":", address.second)))) {
+    return;
+  }
   RunOnPcpHandlerThread(
       "p2p-wifi-service-discovered",
       [this, client, service_id, &wifi_lan_service]()
@@ -619,42 +634,35 @@ void P2pClusterPcpHandler::WifiLanServiceLostHandler(
   NEARBY_LOG(INFO,
              "WifiLan: [LOST, SCHED] wifi_lan_service=%p, service_info_name=%s",
              &wifi_lan_service, nsd_service_info.GetServiceInfoName().c_str());
+  wifi_lan_discovery_cache_.Forget(client->GetClientId(), service_id,
+                                   nsd_service_info.GetServiceInfoName());
   RunOnPcpHandlerThread(
       "p2p-wifi-service-lost",
-      [this, client, service_id, nsd_service_info]()
-          RUN_ON_PCP_HANDLER_THREAD() {
-            // Make sure we are still discovering before proceeding.
-            if (!client->IsDiscovering()) {
-              NEARBY_LOGS(WARNING) << "Ignoring lost NsdServiceInfo "
-                                   << nsd_service_info.GetServiceInfoName()
-                                   << " because we are no longer "
-                                      "discovering.";
-              return;
-            }
-
-            // Parse the WifiLanServiceInfo.
-            WifiLanServiceInfo service_info(nsd_service_info);
-
-            // Make sure the WifiLan service name points to a valid
-            // endpoint we're discovering.
-            if (!IsRecognizedWifiLanEndpoint(service_id, service_info)) return;
+      [this, client, nsd_service_info]() RUN_ON_PCP_HANDLER_THREAD() {
+        // Make sure we are still discovering before proceeding.
+        if (!client->IsDiscovering()) {
+          NEARBY_LOGS(WARNING) << "Ignoring lost NsdServiceInfo "
+                               << nsd_service_info.GetServiceInfoName()
+                               << " because we are no longer "
+                                  "discovering.";
+          return;
+        }
 
-            // Report the lost endpoint to the client.
-            NEARBY_LOGS(INFO)
-                << "Lost NsdServiceInfo "
-                << nsd_service_info.GetServiceInfoName()
-                << " (with endpoint_id=" << service_info.GetEndpointId()
-                << " and endpoint_info="
-                << absl::BytesToHexString(service_info.GetEndpointInfo().data())
-                << ").";
-            OnEndpointLost(client, DiscoveredEndpoint{
-                                       service_info.GetEndpointId(),
-                                       service_info.GetEndpointInfo(),
-                                       service_id,
-                                       proto::connections::Medium::WIFI_LAN,
-                                       WebRtcState::kUndefined,
-                                   });
-          });
+        // Look up the endpoint we found on this service; if there is none,
+        // the service wasn't a valid endpoint we're discovering.
+        DiscoveredEndpoint* endpoint =
+            GetDiscoveredEndpoint(proto::connections::Medium::WIFI_LAN,
+                                  nsd_service_info.GetServiceInfoName());
+        if (endpoint == nullptr) return;
+
+        // Report the lost endpoint to the client.
+        NEARBY_LOGS(INFO)
+            << "Lost NsdServiceInfo " << nsd_service_info.GetServiceInfoName()
+            << " (with endpoint_id=" << endpoint->endpoint_id
+            << " and endpoint_info="
+            << absl::BytesToHexString(endpoint->endpoint_info.data()) << ").";
+        OnEndpointLost(client, *endpoint);
+      });
 }
 
 BasePcpHandler::StartOperationResult P2pClusterPcpHandler::StartDiscoveryImpl(
@@ -667,6 +675,12 @@ BasePcpHandler::StartOperationResult P2pClusterPcpHandler::StartDiscoveryImpl(
             .mediums = options.allowed.GetMediums(true)};
   }
 
+  // Sightings that came in since the client's previous discovery session,
+  // after it stopped discovering, were dropped; they have to be processed anew.
+  bluetooth_discovery_cache_.Clear(client->GetClientId());
+  ble_discovery_cache_.Clear(client->GetClientId());
+  wifi_lan_discovery_cache_.Clear(client->GetClientId());
+
   std::vector<proto::connections::Medium> mediums_started_successfully;
 
   if (options.allowed.wifi_lan) {
@@ -753,6 +767,9 @@ Status P2pClusterPcpHandler::StopDiscoveryImpl(ClientProxy* client) {
   }
 
   ble_medium_.StopScanning(client->GetDiscoveryServiceId());
+  bluetooth_discovery_cache_.Clear(client->GetClientId());
+  ble_discovery_cache_.Clear(client->GetClientId());
+  wifi_lan_discovery_cache_.Clear(client->GetClientId());
   return {Status::kSuccess};
 }
 
@@ -789,25 +806,39 @@ BasePcpHandler::ConnectImplResult P2pClusterPcpHandler::ConnectImpl(
         .status = {Status::kError},
     };
   }
+  return ConnectImpl(client, endpoint,
+                     client->GetCancellationFlag(endpoint->endpoint_id));
+}
+
+BasePcpHandler::ConnectImplResult P2pClusterPcpHandler::ConnectImpl(
+    ClientProxy* client, BasePcpHandler::DiscoveredEndpoint* endpoint,
+    CancellationFlag* cancellation_flag) {
+  if (!endpoint) {
+    return BasePcpHandler::ConnectImplResult{
+        .status = {Status::kError},
+    };
+  }
   switch (endpoint->medium) {
     case proto::connections::Medium::BLUETOOTH: {
       auto* bluetooth_endpoint = down_cast<BluetoothEndpoint*>(endpoint);
       if (bluetooth_endpoint) {
-        return BluetoothConnectImpl(client, bluetooth_endpoint);
+        return BluetoothConnectImpl(client, bluetooth_endpoint,
+                                    cancellation_flag);
       }
       break;
     }
     case proto::connections::Medium::BLE: {
       auto* ble_endpoint = down_cast<BleEndpoint*>(endpoint);
       if (ble_endpoint) {
-        return BleConnectImpl(client, ble_endpoint);
+        return BleConnectImpl(client, ble_endpoint, cancellation_flag);
       }
       break;
     }
     case proto::connections::Medium::WIFI_LAN: {
       auto* wifi_lan_endpoint = down_cast<WifiLanEndpoint*>(endpoint);
       if (wifi_lan_endpoint) {
-        return WifiLanConnectImpl(client, wifi_lan_endpoint);
+        return WifiLanConnectImpl(client, wifi_lan_endpoint,
+                                  cancellation_flag);
       }
       break;
     }
@@ -947,15 +978,15 @@ proto::connections::Medium P2pClusterPcpHandler::StartBluetoothDiscovery(
 }
 
 BasePcpHandler::ConnectImplResult P2pClusterPcpHandler::BluetoothConnectImpl(
-    ClientProxy* client, BluetoothEndpoint* endpoint) {
+    ClientProxy* client, BluetoothEndpoint* endpoint,
+    CancellationFlag* cancellation_flag) {
   NEARBY_LOGS(VERBOSE) << "Client " << client->GetClientId()
                        << " is attempting to connect to endpoint(id="
                        << endpoint->endpoint_id << ") over Bluetooth Classic.";
   BluetoothDevice& device = endpoint->bluetooth_device;
 
   BluetoothSocket bluetooth_socket = bluetooth_medium_.Connect(
-      device, endpoint->service_id,
-      client->GetCancellationFlag(endpoint->endpoint_id));
+      device, endpoint->service_id, cancellation_flag);
   if (!bluetooth_socket.IsValid()) {
     NEARBY_LOGS(ERROR)
         << "In BluetoothConnectImpl(), failed to connect to Bluetooth device "
@@ -1175,7 +1206,8 @@ proto::connections::Medium P2pClusterPcpHandler::StartBleScanning(
 }
 
 BasePcpHandler::ConnectImplResult P2pClusterPcpHandler::BleConnectImpl(
-    ClientProxy* client, BleEndpoint* endpoint) {
+    ClientProxy* client, BleEndpoint* endpoint,
+    CancellationFlag* cancellation_flag) {
   NEARBY_LOGS(VERBOSE) << "Client " << client->GetClientId()
                        << " is attempting to connect to endpoint(id="
                        << endpoint->endpoint_id << ") over BLE.";
@@ -1183,8 +1215,7 @@ BasePcpHandler::ConnectImplResult P2pClusterPcpHandler::BleConnectImpl(
   BlePeripheral& peripheral = endpoint->ble_peripheral;
 
   BleSocket ble_socket =
-      ble_medium_.Connect(peripheral, endpoint->service_id,
-                          client->GetCancellationFlag(endpoint->endpoint_id));
+      ble_medium_.Connect(peripheral, endpoint->service_id, cancellation_flag);
   if (!ble_socket.IsValid()) {
     NEARBY_LOGS(ERROR)
         << "In BleConnectImpl(), failed to connect to BLE device "
@@ -1327,15 +1358,15 @@ proto::connections::Medium P2pClusterPcpHandler::StartWifiLanDiscovery(
 }
 
 BasePcpHandler::ConnectImplResult P2pClusterPcpHandler::WifiLanConnectImpl(
-    ClientProxy* client, WifiLanEndpoint* endpoint) {
+    ClientProxy* client, WifiLanEndpoint* endpoint,
+    CancellationFlag* cancellation_flag) {
   NEARBY_LOGS(VERBOSE) << "Client " << client->GetClientId()
                        << " is attempting to connect to endpoint(id="
                        << endpoint->endpoint_id << ") over WifiLan.";
   WifiLanService& wifi_lan_service = endpoint->wifi_lan_service;
 
   WifiLanSocket wifi_lan_socket = wifi_lan_medium_.Connect(
-      wifi_lan_service, endpoint->service_id,
-      client->GetCancellationFlag(endpoint->endpoint_id));
+      wifi_lan_service, endpoint->service_id, cancellation_flag);
   if (!wifi_lan_socket.IsValid()) {
     NEARBY_LOGS(ERROR)
         << "In WifiLanConnectImpl(), failed to connect to service "
@@ -23,6 +23,7 @@
 #include "core/internal/bluetooth_device_name.h"
 #include "core/internal/bwu_manager.h"
 #include "core/internal/client_proxy.h"
+#include "core/internal/discovery_cache.h"
 #include "core/internal/endpoint_channel_manager.h"
 #include "core/internal/endpoint_manager.h"
 #include "core/internal/injected_bluetooth_device_store.h"
@@ -35,6 +36,7 @@
 #include "core/options.h"
 #include "core/strategy.h"
 #include "platform/base/byte_array.h"
+#include "platform/base/cancellation_flag.h"
 #include "platform/public/bluetooth_classic.h"
 #include "platform/public/wifi_lan.h"
 
@@ -56,7 +58,7 @@ class P2pClusterPcpHandler : public BasePcpHandler {
       EndpointChannelManager* channel_manager, BwuManager* bwu_manager,
       InjectedBluetoothDeviceStore& injected_bluetooth_device_store,
       Pcp pcp = Pcp::kP2pCluster);
-  ~P2pClusterPcpHandler() override = default;
+  ~P2pClusterPcpHandler() override;
 
  protected:
   std::vector<proto::connections::Medium> GetConnectionMediumsByPriority()
@@ -86,25 +88,14 @@ class P2pClusterPcpHandler : public BasePcpHandler {
       ClientProxy* client, const std::string& service_id,
       const OutOfBandConnectionMetadata& metadata) override;
 
-  // @PCPHandlerThread
   BasePcpHandler::ConnectImplResult ConnectImpl(
       ClientProxy* client,
       BasePcpHandler::DiscoveredEndpoint* endpoint) override;
+  BasePcpHandler::ConnectImplResult ConnectImpl(
+      ClientProxy* client, BasePcpHandler::DiscoveredEndpoint* endpoint,
+      CancellationFlag* cancellation_flag) override;
 
  private:
-  // Holds the state required to re-create a BleEndpoint we see on a
-  // BlePeripheral, so BlePeripheralLostHandler can call
-  // BasePcpHandler::OnEndpointLost() with the same information as was passed
-  // in to BasePCPHandler::onEndpointFound().
-  struct BleEndpointState {
-   public:
-    BleEndpointState(const string& endpoint_id, const ByteArray& endpoint_info)
-        : endpoint_id(endpoint_id), endpoint_info(endpoint_info) {}
-
-    std::string endpoint_id;
-    ByteArray endpoint_info;
-  };
-
   using BluetoothDiscoveredDeviceCallback =
       BluetoothClassic::DiscoveredDeviceCallback;
   using BleDiscoveredPeripheralCallback = Ble::DiscoveredPeripheralCallback;
@@ -143,11 +134,10 @@ class P2pClusterPcpHandler : public BasePcpHandler {
       BluetoothDiscoveredDeviceCallback callback, ClientProxy* client,
       const std::string& service_id);
   BasePcpHandler::ConnectImplResult BluetoothConnectImpl(
-      ClientProxy* client, BluetoothEndpoint* endpoint);
+      ClientProxy* client, BluetoothEndpoint* endpoint,
+      CancellationFlag* cancellation_flag);
 
   // Ble
-  // Maps a BlePeripheral to its corresponding BleEndpointState.
-  absl::flat_hash_map<std::string, BleEndpointState> found_ble_endpoints_;
   bool IsRecognizedBleEndpoint(const std::string& service_id,
                                const BleAdvertisement& advertisement) const;
   void BlePeripheralDiscoveredHandler(ClientProxy* client,
@@ -166,8 +156,9 @@ class P2pClusterPcpHandler : public BasePcpHandler {
       BleDiscoveredPeripheralCallback callback, ClientProxy* client,
       const std::string& service_id,
       const std::string& fast_advertisement_service_uuid);
-  BasePcpHandler::ConnectImplResult BleConnectImpl(ClientProxy* client,
-                                                   BleEndpoint* endpoint);
+  BasePcpHandler::ConnectImplResult BleConnectImpl(
+      ClientProxy* client, BleEndpoint* endpoint,
+      CancellationFlag* cancellation_flag);
 
   // WifiLan
   bool IsRecognizedWifiLanEndpoint(
@@ -186,7 +177,8 @@ class P2pClusterPcpHandler : public BasePcpHandler {
       WifiLanDiscoveredServiceCallback callback, ClientProxy* client,
       const std::string& service_id);
   BasePcpHandler::ConnectImplResult WifiLanConnectImpl(
-      ClientProxy* client, WifiLanEndpoint* endpoint);
+      ClientProxy* client, WifiLanEndpoint* endpoint,
+      CancellationFlag* cancellation_flag);
 
   // WebRtc
   proto::connections::Medium StartListeningForWebRtcConnections(
@@ -204,6 +196,11 @@ class P2pClusterPcpHandler : public BasePcpHandler {
   InjectedBluetoothDeviceStore& injected_bluetooth_device_store_;
   std::int64_t bluetooth_classic_discoverer_client_id_{0};
   std::int64_t bluetooth_classic_advertiser_client_id_{0};
+  // Last advertisement processed per peer: BluetoothDevice MAC address,
+  // BlePeripheral name and NsdServiceInfo name, respectively.
+  DiscoveryCache bluetooth_discovery_cache_;
+  DiscoveryCache ble_discovery_cache_;
+  DiscoveryCache wifi_lan_discovery_cache_;
 };
 
 }  // namespace connections
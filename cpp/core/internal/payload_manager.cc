@@ -24,6 +24,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/time/time.h"
 #include "core/internal/internal_payload_factory.h"
+#include "platform/base/byte_chain.h"
 #include "platform/public/count_down_latch.h"
 #include "platform/public/mutex_lock.h"
 #include "platform/public/single_thread_executor.h"
@@ -40,7 +41,8 @@ constexpr const absl::Duration PayloadManager::kWaitCloseTimeout;
 bool PayloadManager::SendPayloadLoop(
     ClientProxy* client, PendingPayload& pending_payload,
     PayloadTransferFrame::PayloadHeader& payload_header,
-    std::int64_t& next_chunk_offset, size_t resume_offset) {
+    std::int64_t& next_chunk_offset, size_t resume_offset,
+    PayloadReadAhead* read_ahead) {
   // in lieu of structured binding:
   auto pair = GetAvailableAndUnavailableEndpoints(pending_payload);
   const EndpointIds& available_endpoint_ids =
@@ -105,9 +107,11 @@ bool PayloadManager::SendPayloadLoop(
 
   // This will block if there is no data to transfer.
   // It will resume when new data arrives, or if Close() is called.
-  int chunk_size = GetOptimalChunkSize(available_endpoint_ids);
+  int chunk_size = GetOptimalChunkSize(client, available_endpoint_ids);
   ByteArray next_chunk =
-      pending_payload.GetInternalPayload()->DetachNextChunk(chunk_size);
+      read_ahead
+          ? read_ahead->DetachNextChunk(chunk_size)
+          : pending_payload.GetInternalPayload()->DetachNextChunk(chunk_size);
   if (shutdown_.Get()) return false;
   // Save chunk size. We'll need it after we move next_chunk.
   auto next_chunk_size = next_chunk.size();
@@ -127,10 +131,11 @@ bool PayloadManager::SendPayloadLoop(
   // used to decide if the received chunk is the initial payload chunk.
   // In other cases, the offset should only be used in both side logs when error
   // happened.
-  PayloadTransferFrame::PayloadChunk payload_chunk(CreatePayloadChunk(
-      next_chunk_offset - resume_offset, std::move(next_chunk)));
+  PayloadTransferFrame::PayloadChunk payload_chunk(
+      CreatePayloadChunk(next_chunk_offset - resume_offset, next_chunk_size));
   const EndpointIds& failed_endpoint_ids = endpoint_manager_->SendPayloadChunk(
-      payload_header, payload_chunk, available_endpoint_ids);
+      payload_header, payload_chunk, ByteSlice(std::move(next_chunk)),
+      available_endpoint_ids);
   // Check whether at least one endpoint failed.
   if (!failed_endpoint_ids.empty()) {
     NEARBY_LOGS(INFO) << "Payload xfer: endpoints failed: payload_id="
@@ -150,7 +155,7 @@ bool PayloadManager::SendPayloadLoop(
                     endpoint_id) == failed_endpoint_ids.end()) {
         HandleSuccessfulOutgoingChunk(
             client, endpoint_id, payload_header, payload_chunk.flags(),
-            payload_chunk.offset(), payload_chunk.body().size());
+            payload_chunk.offset(), next_chunk_size);
       }
     }
     NEARBY_LOGS(VERBOSE) << "PayloadManager done sending chunk at offset "
@@ -268,7 +273,14 @@ Payload::Id PayloadManager::CreateOutgoingPayload(
 }
 
 PayloadManager::PayloadManager(EndpointManager& endpoint_manager)
-    : endpoint_manager_(&endpoint_manager) {
+    : progress_aggregator_(
+          absl::Milliseconds(FeatureFlags::GetInstance()
+                                 .GetFlags()
+                                 .payload_progress_interval_millis),
+          FeatureFlags::GetInstance()
+              .GetFlags()
+              .payload_progress_interval_bytes),
+      endpoint_manager_(&endpoint_manager) {
   endpoint_manager_->RegisterFrameProcessor(V1Frame::PAYLOAD_TRANSFER, this);
 }
 
@@ -312,6 +324,9 @@ PayloadManager::~PayloadManager() {
   bytes_payload_executor_.Shutdown();
   stream_payload_executor_.Shutdown();
   file_payload_executor_.Shutdown();
+  payload_scheduler_.Shutdown();
+  // Only after the payload senders, which may still be waiting on it.
+  file_read_ahead_executor_.Shutdown();
 
   CountDownLatch stop_latch(1);
   // Clear our tracked pending payloads.
@@ -330,6 +345,7 @@ PayloadManager::~PayloadManager() {
 
   NEARBY_LOG(INFO, "PayloadManager: turn down notification executor; self=%p",
              this);
+  progress_executor_.Shutdown();
   // Stop all the ongoing Runnables (as gracefully as possible).
   payload_status_update_executor_.Shutdown();
 
@@ -381,10 +397,6 @@ void PayloadManager::SendPayload(ClientProxy* client,
     return;
   }
 
-  // Each payload is sent in FCFS order within each Payload type, blocking any
-  // other payload of the same type from even starting until this one is
-  // completely done with. If we ever want to provide isolation across
-  // ClientProxy objects this will need to be significantly re-architected.
   Payload::Type payload_type = payload.GetType();
   size_t resume_offset =
       FeatureFlags::GetInstance().GetFlags().enable_send_payload_offset
@@ -393,44 +405,106 @@ void PayloadManager::SendPayload(ClientProxy* client,
 
   Payload::Id payload_id =
       CreateOutgoingPayload(std::move(payload), endpoint_ids);
-  executor->Execute(
-      "send-payload", [this, client, endpoint_ids, payload_id, payload_type,
-                       resume_offset, payload_total_size]() {
-        if (shutdown_.Get()) return;
-        PendingPayload* pending_payload = GetPayload(payload_id);
-        if (!pending_payload) {
-          RecordInvalidPayloadAnalytics(client, endpoint_ids, payload_id,
+  // Sends the next chunk of the payload; returns false once it is done.
+  auto outgoing_payload = std::make_shared<OutgoingPayload>();
+  PayloadScheduler::SendChunk send_chunk =
+      [this, client, endpoint_ids, payload_id, payload_type, resume_offset,
+       payload_total_size, outgoing_payload]() {
+        OutgoingPayload& outgoing = *outgoing_payload;
+        if (!outgoing.pending_payload) {
+          if (shutdown_.Get()) return false;
+          PendingPayload* pending_payload = GetPayload(payload_id);
+          if (!pending_payload) {
+            RecordInvalidPayloadAnalytics(client, endpoint_ids, payload_id,
+                                          payload_type, resume_offset,
+                                          payload_total_size);
+            NEARBY_LOGS(INFO) << "PayloadManager failed to create "
+                                 "InternalPayload for outgoing payload_id="
+                              << payload_id
+                              << ", payload_type=" << ToString(payload_type)
+                              << ", aborting sendPayload().";
+            return false;
+          }
+          auto* internal_payload = pending_payload->GetInternalPayload();
+          if (!internal_payload) return false;
+
+          RecordPayloadStartedAnalytics(client, endpoint_ids, payload_id,
                                         payload_type, resume_offset,
-                                        payload_total_size);
-          NEARBY_LOGS(INFO)
-              << "PayloadManager failed to create InternalPayload for outgoing "
-                 "payload_id="
-              << payload_id << ", payload_type=" << ToString(payload_type)
-              << ", aborting sendPayload().";
-          return;
+                                        internal_payload->GetTotalSize());
+
+          outgoing.pending_payload = pending_payload;
+          outgoing.payload_header =
+              CreatePayloadHeader(*internal_payload, resume_offset);
+          // File chunks are read ahead while the previous chunk is being
+          // sent; the other payload types are already in memory, or are fed
+          // by the app as it goes.
+          int read_ahead_chunks = FeatureFlags::GetInstance()
+                                      .GetFlags()
+                                      .file_payload_read_ahead_chunks;
+          if (payload_type == Payload::Type::kFile && read_ahead_chunks > 0) {
+            outgoing.read_ahead = std::make_unique<PayloadReadAhead>(
+                internal_payload, &file_read_ahead_executor_,
+                read_ahead_chunks);
+          }
         }
-        auto* internal_payload = pending_payload->GetInternalPayload();
-        if (!internal_payload) return;
-
-        RecordPayloadStartedAnalytics(client, endpoint_ids, payload_id,
-                                      payload_type, resume_offset,
-                                      internal_payload->GetTotalSize());
-
-        PayloadTransferFrame::PayloadHeader payload_header{
-            CreatePayloadHeader(*internal_payload, resume_offset)};
-        bool should_continue = true;
-        std::int64_t next_chunk_offset = 0;
-        while (should_continue && !shutdown_.Get()) {
-          should_continue =
-              SendPayloadLoop(client, *pending_payload, payload_header,
-                              next_chunk_offset, resume_offset);
+
+        if (!shutdown_.Get() &&
+            SendPayloadLoop(client, *outgoing.pending_payload,
+                            outgoing.payload_header, outgoing.next_chunk_offset,
+                            resume_offset, outgoing.read_ahead.get())) {
+          return true;
         }
+        outgoing.read_ahead.reset();
         RunOnStatusUpdateThread("destroy-payload",
                                 [this, payload_id]()
                                     RUN_ON_PAYLOAD_STATUS_UPDATE_THREAD() {
                                       DestroyPendingPayload(payload_id);
                                     });
-      });
+        return false;
+      };
+
+  // Fails the payload for the endpoints it has not finished for, if it is
+  // dropped before it is done.
+  PayloadScheduler::Drop drop = [this, client, payload_id, resume_offset,
+                                 outgoing_payload]() {
+    OutgoingPayload& outgoing = *outgoing_payload;
+    outgoing.read_ahead.reset();
+    PendingPayload* pending_payload = outgoing.pending_payload
+                                          ? outgoing.pending_payload
+                                          : GetPayload(payload_id);
+    if (pending_payload && pending_payload->GetInternalPayload()) {
+      if (!outgoing.pending_payload) {
+        outgoing.payload_header = CreatePayloadHeader(
+            *pending_payload->GetInternalPayload(), resume_offset);
+      }
+      HandleFinishedOutgoingPayload(
+          client, EndpointsToEndpointIds(pending_payload->GetEndpoints()),
+          outgoing.payload_header, outgoing.next_chunk_offset,
+          proto::connections::PayloadStatus::LOCAL_CANCELLATION);
+    }
+    RunOnStatusUpdateThread(
+        "destroy-payload",
+        [this, payload_id]() RUN_ON_PAYLOAD_STATUS_UPDATE_THREAD() {
+          DestroyPendingPayload(payload_id);
+        });
+  };
+
+  // Bytes and file payloads are interleaved chunk by chunk, so that a large
+  // payload does not hold back the ones after it to other endpoints, or of the
+  // other type; see PayloadScheduler. Stream payloads block on the app for
+  // their data, so they are sent in FCFS order on their own executor, as are
+  // all payloads if interleaving is disabled.
+  bool interleave =
+      FeatureFlags::GetInstance().GetFlags().enable_interleaved_payload_sends;
+  if (payload_type == Payload::Type::kStream || !interleave) {
+    executor->Execute("send-payload", [send_chunk]() {
+      while (send_chunk()) {
+      }
+    });
+  } else {
+    payload_scheduler_.Add(payload_type, endpoint_ids, std::move(send_chunk),
+                           std::move(drop));
+  }
   NEARBY_LOGS(INFO) << "PayloadManager: xfer scheduled: self=" << this
                     << "; payload_id=" << payload_id
                     << ", payload_type=" << ToString(payload_type);
@@ -528,6 +602,8 @@ void PayloadManager::OnEndpointDisconnect(ClientProxy* client,
               // Send a client notification of a payload transfer failure.
               client->OnPayloadProgress(endpoint_id, update);
 
+              RecordUndeliveredProgress(client, endpoint_id, payload_id,
+                                        pending_payload->IsIncoming());
               if (pending_payload->IsIncoming()) {
                 client->GetAnalyticsRecorder().OnIncomingPayloadDone(
                     endpoint_id, pending_payload->GetId(),
@@ -599,11 +675,15 @@ SingleThreadExecutor* PayloadManager::GetOutgoingPayloadExecutor(
   }
 }
 
-int PayloadManager::GetOptimalChunkSize(EndpointIds endpoint_ids) {
+int PayloadManager::GetOptimalChunkSize(ClientProxy* client,
+                                        EndpointIds endpoint_ids) {
   int minChunkSize = std::numeric_limits<int>::max();
   for (const auto& endpoint_id : endpoint_ids) {
     minChunkSize = std::min(
-        minChunkSize, endpoint_manager_->GetMaxTransmitPacketSize(endpoint_id));
+        minChunkSize,
+        client->UsesAdaptiveChunkSize(endpoint_id)
+            ? endpoint_manager_->GetAdaptiveTransmitPacketSize(endpoint_id)
+            : endpoint_manager_->GetMaxTransmitPacketSize(endpoint_id));
   }
   return minChunkSize;
 }
@@ -624,14 +704,12 @@ PayloadTransferFrame::PayloadHeader PayloadManager::CreatePayloadHeader(
 }
 
 PayloadTransferFrame::PayloadChunk PayloadManager::CreatePayloadChunk(
-    std::int64_t payload_chunk_offset, ByteArray payload_chunk_body) {
+    std::int64_t payload_chunk_offset, size_t payload_chunk_body_size) {
   PayloadTransferFrame::PayloadChunk payload_chunk;
 
   payload_chunk.set_offset(payload_chunk_offset);
   payload_chunk.set_flags(0);
-  if (!payload_chunk_body.Empty()) {
-    payload_chunk.set_body(std::string(std::move(payload_chunk_body)));
-  } else {
+  if (payload_chunk_body_size == 0) {
     payload_chunk.set_flags(payload_chunk.flags() |
                             PayloadTransferFrame::PayloadChunk::LAST_CHUNK);
   }
@@ -688,6 +766,8 @@ void PayloadManager::SendClientCallbacksForFinishedOutgoingPayload(
           client->OnPayloadProgress(endpoint_id, update);
 
           // Mark this payload as done for analytics.
+          RecordUndeliveredProgress(client, endpoint_id, payload_header.id(),
+                                    /*is_incoming=*/false);
           client->GetAnalyticsRecorder().OnOutgoingPayloadDone(
               endpoint_id, payload_header.id(), status);
         }
@@ -723,6 +803,8 @@ void PayloadManager::SendClientCallbacksForFinishedIncomingPayload(
             PayloadManager::PayloadStatusToTransferUpdateStatus(status),
             payload_header.total_size(), offset_bytes};
         NotifyClientOfIncomingPayloadProgressInfo(client, endpoint_id, update);
+        RecordUndeliveredProgress(client, endpoint_id, payload_header.id(),
+                                  /*is_incoming=*/true);
         DestroyPendingPayload(payload_header.id());
 
         // Analyze
@@ -819,11 +901,25 @@ void PayloadManager::HandleSuccessfulOutgoingChunk(
     const PayloadTransferFrame::PayloadHeader& payload_header,
     std::int32_t payload_chunk_flags, std::int64_t payload_chunk_offset,
     std::int64_t payload_chunk_body_size) {
+  bool is_last_chunk = (payload_chunk_flags &
+                        PayloadTransferFrame::PayloadChunk::LAST_CHUNK) != 0;
+  PayloadProgressInfo update{
+      payload_header.id(),
+      is_last_chunk ? PayloadProgressInfo::Status::kSuccess
+                    : PayloadProgressInfo::Status::kInProgress,
+      payload_header.total_size(),
+      is_last_chunk ? payload_chunk_offset
+                    : payload_chunk_offset + payload_chunk_body_size};
+  if (!is_last_chunk) {
+    AddProgressUpdate(client, endpoint_id, update, payload_chunk_body_size,
+                      /*is_incoming=*/false);
+    return;
+  }
+
   RunOnStatusUpdateThread(
       "outgoing-chunk-success",
-      [this, client, endpoint_id, payload_header, payload_chunk_flags,
-       payload_chunk_offset,
-       payload_chunk_body_size]() RUN_ON_PAYLOAD_STATUS_UPDATE_THREAD() {
+      [this, client, endpoint_id, payload_header,
+       update]() RUN_ON_PAYLOAD_STATUS_UPDATE_THREAD() {
         // Make sure we're still tracking this payload and its associated
         // endpoint.
         PendingPayload* pending_payload = GetPayload(payload_header.id());
@@ -835,38 +931,108 @@ void PayloadManager::HandleSuccessfulOutgoingChunk(
           return;
         }
 
-        bool is_last_chunk =
-            (payload_chunk_flags &
-             PayloadTransferFrame::PayloadChunk::LAST_CHUNK) != 0;
-        PayloadProgressInfo update{
-            payload_header.id(),
-            is_last_chunk ? PayloadProgressInfo::Status::kSuccess
-                          : PayloadProgressInfo::Status::kInProgress,
-            payload_header.total_size(),
-            is_last_chunk ? payload_chunk_offset
-                          : payload_chunk_offset + payload_chunk_body_size};
-
         // Notify the client.
         client->OnPayloadProgress(endpoint_id, update);
 
-        if (is_last_chunk) {
-          client->GetAnalyticsRecorder().OnOutgoingPayloadDone(
-              endpoint_id, payload_header.id(), proto::connections::SUCCESS);
+        RecordUndeliveredProgress(client, endpoint_id, payload_header.id(),
+                                  /*is_incoming=*/false);
+        client->GetAnalyticsRecorder().OnOutgoingPayloadDone(
+            endpoint_id, payload_header.id(), proto::connections::SUCCESS);
 
-          // Stop tracking this endpoint.
-          pending_payload->RemoveEndpoints({endpoint_id});
+        // Stop tracking this endpoint.
+        pending_payload->RemoveEndpoints({endpoint_id});
 
-          // Close the payload if no endpoints remain.
-          if (pending_payload->GetEndpoints().empty()) {
-            pending_payload->Close();
-          }
-        } else {
-          client->GetAnalyticsRecorder().OnPayloadChunkSent(
-              endpoint_id, payload_header.id(), payload_chunk_body_size);
+        // Close the payload if no endpoints remain.
+        if (pending_payload->GetEndpoints().empty()) {
+          pending_payload->Close();
         }
       });
 }
 
+void PayloadManager::AddProgressUpdate(ClientProxy* client,
+                                       const std::string& endpoint_id,
+                                       const PayloadProgressInfo& update,
+                                       std::int64_t chunk_size,
+                                       bool is_incoming) {
+  absl::Duration delay;
+  if (!progress_aggregator_.Add(endpoint_id, update, chunk_size, &delay)) {
+    // Merged into an update that is already on its way.
+    return;
+  }
+  Payload::Id payload_id = update.payload_id;
+  Runnable deliver = [this, client, endpoint_id, payload_id, is_incoming]() {
+    RunOnStatusUpdateThread(
+        "payload-progress",
+        [this, client, endpoint_id, payload_id,
+         is_incoming]() RUN_ON_PAYLOAD_STATUS_UPDATE_THREAD() {
+          DeliverProgressUpdate(client, endpoint_id, payload_id, is_incoming);
+        });
+  };
+  if (delay == absl::ZeroDuration()) {
+    deliver();
+  } else {
+    progress_executor_.Schedule(std::move(deliver), delay);
+  }
+}
+
+// @PayloadManagerStatusUpdateThread
+void PayloadManager::DeliverProgressUpdate(ClientProxy* client,
+                                           const std::string& endpoint_id,
+                                           Payload::Id payload_id,
+                                           bool is_incoming) {
+  absl::optional<PayloadProgressAggregator::Progress> progress =
+      progress_aggregator_.Take(endpoint_id, payload_id);
+  // Nothing new, or the payload finished in the meantime.
+  if (!progress) return;
+
+  // Make sure we're still tracking this payload (and, when sending, its
+  // associated endpoint).
+  PendingPayload* pending_payload = GetPayload(payload_id);
+  if (!pending_payload) return;
+  EndpointInfo* endpoint = pending_payload->GetEndpoint(endpoint_id);
+  if (is_incoming) {
+    NotifyClientOfIncomingPayloadProgressInfo(client, endpoint_id,
+                                              progress->info);
+  } else {
+    if (!endpoint) return;
+    client->OnPayloadProgress(endpoint_id, progress->info);
+  }
+  if (!endpoint) {
+    // An incoming payload that no longer tracks its endpoint.
+    client->GetAnalyticsRecorder().OnPayloadChunkReceived(
+        endpoint_id, payload_id, progress->num_bytes, progress->num_chunks);
+    return;
+  }
+  // Look the analytics counter up once, rather than for every update.
+  if (!endpoint->chunk_counter.IsValid()) {
+    endpoint->chunk_counter =
+        is_incoming ? client->GetAnalyticsRecorder().GetIncomingChunkCounter(
+                          endpoint_id, payload_id)
+                    : client->GetAnalyticsRecorder().GetOutgoingChunkCounter(
+                          endpoint_id, payload_id);
+  }
+  endpoint->chunk_counter.Add(progress->num_bytes, progress->num_chunks);
+}
+
+// @PayloadManagerStatusUpdateThread
+void PayloadManager::RecordUndeliveredProgress(ClientProxy* client,
+                                               const std::string& endpoint_id,
+                                               Payload::Id payload_id,
+                                               bool is_incoming) {
+  absl::optional<PayloadProgressAggregator::Progress> progress =
+      progress_aggregator_.Remove(endpoint_id, payload_id);
+  if (!progress) return;
+  // The client gets the terminal update instead; only analytics needs to hear
+  // about the chunks.
+  if (is_incoming) {
+    client->GetAnalyticsRecorder().OnPayloadChunkReceived(
+        endpoint_id, payload_id, progress->num_bytes, progress->num_chunks);
+  } else {
+    client->GetAnalyticsRecorder().OnPayloadChunkSent(
+        endpoint_id, payload_id, progress->num_bytes, progress->num_chunks);
+  }
+}
+
 // @PayloadManagerStatusUpdateThread
 void PayloadManager::DestroyPendingPayload(Payload::Id payload_id) {
   bool is_incoming = false;
@@ -882,6 +1048,7 @@ void PayloadManager::DestroyPendingPayload(Payload::Id payload_id) {
     pending->Close();
     pending.reset();
   }
+  progress_aggregator_.RemovePayload(payload_id);
   if (!is_incoming) NotifyShutdown();
 }
 
@@ -890,39 +1057,39 @@ void PayloadManager::HandleSuccessfulIncomingChunk(
     const PayloadTransferFrame::PayloadHeader& payload_header,
     std::int32_t payload_chunk_flags, std::int64_t payload_chunk_offset,
     std::int64_t payload_chunk_body_size) {
+  bool is_last_chunk = (payload_chunk_flags &
+                        PayloadTransferFrame::PayloadChunk::LAST_CHUNK) != 0;
+  PayloadProgressInfo update{
+      payload_header.id(),
+      is_last_chunk ? PayloadProgressInfo::Status::kSuccess
+                    : PayloadProgressInfo::Status::kInProgress,
+      payload_header.total_size(),
+      is_last_chunk ? payload_chunk_offset
+                    : payload_chunk_offset + payload_chunk_body_size};
+  if (!is_last_chunk) {
+    AddProgressUpdate(client, endpoint_id, update, payload_chunk_body_size,
+                      /*is_incoming=*/true);
+    return;
+  }
+
   RunOnStatusUpdateThread(
       "incoming-chunk-success",
-      [this, client, endpoint_id, payload_header, payload_chunk_flags,
-       payload_chunk_offset,
-       payload_chunk_body_size]() RUN_ON_PAYLOAD_STATUS_UPDATE_THREAD() {
+      [this, client, endpoint_id, payload_header,
+       update]() RUN_ON_PAYLOAD_STATUS_UPDATE_THREAD() {
         // Make sure we're still tracking this payload.
         PendingPayload* pending_payload = GetPayload(payload_header.id());
         if (!pending_payload) {
           return;
         }
 
-        bool is_last_chunk =
-            (payload_chunk_flags &
-             PayloadTransferFrame::PayloadChunk::LAST_CHUNK) != 0;
-        PayloadProgressInfo update{
-            payload_header.id(),
-            is_last_chunk ? PayloadProgressInfo::Status::kSuccess
-                          : PayloadProgressInfo::Status::kInProgress,
-            payload_header.total_size(),
-            is_last_chunk ? payload_chunk_offset
-                          : payload_chunk_offset + payload_chunk_body_size};
-
         // Notify the client of this update.
         NotifyClientOfIncomingPayloadProgressInfo(client, endpoint_id, update);
 
         // Analyze the success.
-        if (is_last_chunk) {
-          client->GetAnalyticsRecorder().OnIncomingPayloadDone(
-              endpoint_id, payload_header.id(), proto::connections::SUCCESS);
-        } else {
-          client->GetAnalyticsRecorder().OnPayloadChunkReceived(
-              endpoint_id, payload_header.id(), payload_chunk_body_size);
-        }
+        RecordUndeliveredProgress(client, endpoint_id, payload_header.id(),
+                                  /*is_incoming=*/true);
+        client->GetAnalyticsRecorder().OnIncomingPayloadDone(
+            endpoint_id, payload_header.id(), proto::connections::SUCCESS);
       });
 }
 
@@ -24,6 +24,9 @@
 #include "core/internal/client_proxy.h"
 #include "core/internal/endpoint_manager.h"
 #include "core/internal/internal_payload.h"
+#include "core/internal/payload_progress_aggregator.h"
+#include "core/internal/payload_read_ahead.h"
+#include "core/internal/payload_scheduler.h"
 #include "core/listeners.h"
 #include "core/payload.h"
 #include "core/status.h"
@@ -32,6 +35,7 @@
 #include "platform/public/atomic_reference.h"
 #include "platform/public/count_down_latch.h"
 #include "platform/public/mutex.h"
+#include "platform/public/scheduled_executor.h"
 
 namespace location {
 namespace nearby {
@@ -87,6 +91,9 @@ class PayloadManager : public EndpointManager::FrameProcessor {
     std::string id;
     AtomicReference<Status> status{Status::kUnknown};
     std::int64_t offset = 0;
+    // Counts the chunks delivered in progress updates for analytics. Set and
+    // used on the status update thread only.
+    analytics::AnalyticsRecorder::ChunkCounter chunk_counter;
   };
 
   // Tracks state for an InternalPayload and the endpoints associated with it.
@@ -171,6 +178,14 @@ class PayloadManager : public EndpointManager::FrameProcessor {
         pending_payloads_ ABSL_GUARDED_BY(mutex_);
   };
 
+  // State of an outgoing payload, kept between its chunks.
+  struct OutgoingPayload {
+    PendingPayload* pending_payload = nullptr;
+    PayloadTransferFrame::PayloadHeader payload_header;
+    std::int64_t next_chunk_offset = 0;
+    std::unique_ptr<PayloadReadAhead> read_ahead;
+  };
+
   using Endpoints = std::vector<const EndpointInfo*>;
   static std::string ToString(const EndpointIds& endpoint_ids);
   static std::string ToString(const Endpoints& endpoints);
@@ -189,7 +204,8 @@ class PayloadManager : public EndpointManager::FrameProcessor {
 
   bool SendPayloadLoop(ClientProxy* client, PendingPayload& pending_payload,
                        PayloadTransferFrame::PayloadHeader& payload_header,
-                       std::int64_t& next_chunk_offset, size_t resume_offset);
+                       std::int64_t& next_chunk_offset, size_t resume_offset,
+                       PayloadReadAhead* read_ahead);
   void SendClientCallbacksForFinishedIncomingPayloadRunnable(
       ClientProxy* client, const std::string& endpoint_id,
       const PayloadTransferFrame::PayloadHeader& payload_header,
@@ -208,12 +224,14 @@ class PayloadManager : public EndpointManager::FrameProcessor {
   static PayloadProgressInfo::Status PayloadStatusToTransferUpdateStatus(
       proto::connections::PayloadStatus status);
 
-  int GetOptimalChunkSize(EndpointIds endpoint_ids);
+  int GetOptimalChunkSize(ClientProxy* client, EndpointIds endpoint_ids);
 
   PayloadTransferFrame::PayloadHeader CreatePayloadHeader(
       const InternalPayload& payload, size_t offset);
+  // Returns the chunk fields for a body of |body_size| bytes; the body itself
+  // is handed to EndpointManager::SendPayloadChunk() separately.
   PayloadTransferFrame::PayloadChunk CreatePayloadChunk(std::int64_t offset,
-                                                        ByteArray body);
+                                                        size_t body_size);
 
   PendingPayload* CreateIncomingPayload(const PayloadTransferFrame& frame,
                                         const std::string& endpoint_id)
@@ -270,6 +288,22 @@ class PayloadManager : public EndpointManager::FrameProcessor {
                             const std::string& from_endpoint_id,
                             PayloadTransferFrame& payload_transfer_frame);
 
+  // Merges an in-progress update into the pending one for the payload and
+  // endpoint, and makes sure it gets delivered.
+  void AddProgressUpdate(ClientProxy* client, const std::string& endpoint_id,
+                         const PayloadProgressInfo& update,
+                         std::int64_t chunk_size, bool is_incoming);
+  void DeliverProgressUpdate(ClientProxy* client,
+                             const std::string& endpoint_id,
+                             Payload::Id payload_id, bool is_incoming)
+      RUN_ON_PAYLOAD_STATUS_UPDATE_THREAD();
+  // Records the chunks of an update that was not delivered before the
+  // payload finished for the endpoint, and stops tracking its progress.
+  void RecordUndeliveredProgress(ClientProxy* client,
+                                 const std::string& endpoint_id,
+                                 Payload::Id payload_id, bool is_incoming)
+      RUN_ON_PAYLOAD_STATUS_UPDATE_THREAD();
+
   void NotifyClientOfIncomingPayloadProgressInfo(
       ClientProxy* client, const std::string& endpoint_id,
       const PayloadProgressInfo& payload_transfer_update)
@@ -309,8 +343,15 @@ class PayloadManager : public EndpointManager::FrameProcessor {
   PendingPayloads pending_payloads_ ABSL_GUARDED_BY(mutex_);
   SingleThreadExecutor bytes_payload_executor_;
   SingleThreadExecutor file_payload_executor_;
+  // Sends bytes and file payloads, unless interleaving is disabled.
+  PayloadScheduler payload_scheduler_;
+  // Reads file payload chunks ahead of the sender.
+  SingleThreadExecutor file_read_ahead_executor_;
   SingleThreadExecutor stream_payload_executor_;
   SingleThreadExecutor payload_status_update_executor_;
+  PayloadProgressAggregator progress_aggregator_;
+  // Delivers the progress updates that are not due yet.
+  ScheduledExecutor progress_executor_;
 
   EndpointManager* endpoint_manager_;
 };
@@ -0,0 +1,102 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/payload_progress_aggregator.h"
+
+#include "platform/public/mutex_lock.h"
+#include "platform/public/system_clock.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+PayloadProgressAggregator::PayloadProgressAggregator(
+    absl::Duration interval, std::int64_t interval_bytes)
+    : interval_(interval), interval_bytes_(interval_bytes) {}
+
+bool PayloadProgressAggregator::Add(const std::string& endpoint_id,
+                                    const PayloadProgressInfo& info,
+                                    std::int64_t chunk_size,
+                                    absl::Duration* delay) {
+  MutexLock lock(&mutex_);
+  Entry& entry = entries_[Key(endpoint_id, info.payload_id)];
+  entry.progress.info = info;
+  entry.progress.num_chunks++;
+  entry.progress.num_bytes += chunk_size;
+  if (entry.scheduled) return false;
+
+  bool has_interval = interval_ > absl::ZeroDuration();
+  bool has_interval_bytes = interval_bytes_ > 0;
+  absl::Duration since_last_delivery =
+      SystemClock::ElapsedRealtime() - entry.last_delivery_time;
+  if ((!has_interval && !has_interval_bytes) ||
+      (has_interval && since_last_delivery >= interval_) ||
+      (has_interval_bytes && info.bytes_transferred -
+                                     entry.last_delivery_bytes >=
+                                 interval_bytes_)) {
+    *delay = absl::ZeroDuration();
+  } else if (has_interval) {
+    *delay = interval_ - since_last_delivery;
+  } else {
+    // Not enough bytes yet; a later chunk will get there.
+    return false;
+  }
+  entry.scheduled = true;
+  return true;
+}
+
+absl::optional<PayloadProgressAggregator::Progress>
+PayloadProgressAggregator::Take(const std::string& endpoint_id,
+                                Payload::Id payload_id) {
+  MutexLock lock(&mutex_);
+  auto it = entries_.find(Key(endpoint_id, payload_id));
+  if (it == entries_.end()) return absl::nullopt;
+  Entry& entry = it->second;
+  entry.scheduled = false;
+  if (!entry.progress.num_chunks) return absl::nullopt;
+
+  Progress progress = entry.progress;
+  entry.progress.num_chunks = 0;
+  entry.progress.num_bytes = 0;
+  entry.last_delivery_time = SystemClock::ElapsedRealtime();
+  entry.last_delivery_bytes = progress.info.bytes_transferred;
+  return progress;
+}
+
+absl::optional<PayloadProgressAggregator::Progress>
+PayloadProgressAggregator::Remove(const std::string& endpoint_id,
+                                  Payload::Id payload_id) {
+  MutexLock lock(&mutex_);
+  auto it = entries_.find(Key(endpoint_id, payload_id));
+  if (it == entries_.end()) return absl::nullopt;
+  absl::optional<Progress> progress;
+  if (it->second.progress.num_chunks) progress = it->second.progress;
+  entries_.erase(it);
+  return progress;
+}
+
+void PayloadProgressAggregator::RemovePayload(Payload::Id payload_id) {
+  MutexLock lock(&mutex_);
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (it->first.second == payload_id) {
+      entries_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
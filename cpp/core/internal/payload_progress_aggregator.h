@@ -0,0 +1,101 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_INTERNAL_PAYLOAD_PROGRESS_AGGREGATOR_H_
+#define CORE_INTERNAL_PAYLOAD_PROGRESS_AGGREGATOR_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "core/listeners.h"
+#include "core/payload.h"
+#include "platform/public/mutex.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+// Merges the in-progress updates of a payload transfer, per endpoint, so that
+// they can be delivered at a steady cadence rather than once per chunk.
+//
+// An update is due once |interval| has passed, or |interval_bytes| more bytes
+// have been transferred, since the previous delivery; a zero threshold is
+// ignored. With both thresholds zero, every update is due right away, and
+// updates are only merged while a delivery is still queued.
+//
+// Terminal updates do not go through here; the caller delivers them directly,
+// after calling Remove() to pick up what was left.
+class PayloadProgressAggregator {
+ public:
+  // Progress accumulated since the previous delivery.
+  struct Progress {
+    // The most recent update.
+    PayloadProgressInfo info;
+    // Chunks transferred, and their size in bytes.
+    std::int32_t num_chunks = 0;
+    std::int64_t num_bytes = 0;
+  };
+
+  PayloadProgressAggregator(absl::Duration interval,
+                            std::int64_t interval_bytes);
+
+  // Records that a chunk of |chunk_size| bytes was transferred, with |info|
+  // as the resulting update. Returns true if the caller has to schedule a
+  // call to Take() in |delay| (possibly zero); returns false if one is
+  // already scheduled.
+  bool Add(const std::string& endpoint_id, const PayloadProgressInfo& info,
+           std::int64_t chunk_size, absl::Duration* delay)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the progress accumulated for the payload and endpoint since the
+  // last call, if any, and marks it delivered.
+  absl::optional<Progress> Take(const std::string& endpoint_id,
+                                Payload::Id payload_id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Stops tracking the payload for the endpoint, and returns the progress
+  // that was not delivered yet, if any.
+  absl::optional<Progress> Remove(const std::string& endpoint_id,
+                                  Payload::Id payload_id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Stops tracking the payload for all endpoints.
+  void RemovePayload(Payload::Id payload_id) ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Entry {
+    Progress progress;
+    // Set between Add() asking for a Take() and that Take().
+    bool scheduled = false;
+    absl::Time last_delivery_time = absl::InfinitePast();
+    std::int64_t last_delivery_bytes = 0;
+  };
+  using Key = std::pair<std::string, Payload::Id>;
+
+  const absl::Duration interval_;
+  const std::int64_t interval_bytes_;
+  Mutex mutex_;
+  absl::flat_hash_map<Key, Entry> entries_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
+
+#endif  // CORE_INTERNAL_PAYLOAD_PROGRESS_AGGREGATOR_H_
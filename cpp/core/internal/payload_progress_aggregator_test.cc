@@ -0,0 +1,119 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/payload_progress_aggregator.h"
+
+#include "gtest/gtest.h"
+#include "absl/time/time.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace {
+
+constexpr char kEndpointId[] = "ABCD";
+constexpr Payload::Id kPayloadId = 1234;
+
+PayloadProgressInfo InProgress(std::int64_t bytes_transferred) {
+  return {kPayloadId, PayloadProgressInfo::Status::kInProgress, 1000,
+          bytes_transferred};
+}
+
+TEST(PayloadProgressAggregatorTest, FirstUpdateIsDueRightAway) {
+  PayloadProgressAggregator aggregator(absl::Seconds(1), 0);
+  absl::Duration delay = absl::InfiniteDuration();
+
+  EXPECT_TRUE(aggregator.Add(kEndpointId, InProgress(10), 10, &delay));
+  EXPECT_EQ(delay, absl::ZeroDuration());
+}
+
+TEST(PayloadProgressAggregatorTest, MergesUpdatesUntilTaken) {
+  PayloadProgressAggregator aggregator(absl::Seconds(1), 0);
+  absl::Duration delay;
+
+  EXPECT_TRUE(aggregator.Add(kEndpointId, InProgress(10), 10, &delay));
+  EXPECT_FALSE(aggregator.Add(kEndpointId, InProgress(30), 20, &delay));
+  auto progress = aggregator.Take(kEndpointId, kPayloadId);
+
+  ASSERT_TRUE(progress.has_value());
+  EXPECT_EQ(progress->info.bytes_transferred, 30);
+  EXPECT_EQ(progress->num_chunks, 2);
+  EXPECT_EQ(progress->num_bytes, 30);
+  EXPECT_FALSE(aggregator.Take(kEndpointId, kPayloadId).has_value());
+}
+
+TEST(PayloadProgressAggregatorTest, DelaysUpdatesWithinInterval) {
+  PayloadProgressAggregator aggregator(absl::Seconds(10), 0);
+  absl::Duration delay;
+  EXPECT_TRUE(aggregator.Add(kEndpointId, InProgress(10), 10, &delay));
+  EXPECT_TRUE(aggregator.Take(kEndpointId, kPayloadId).has_value());
+
+  EXPECT_TRUE(aggregator.Add(kEndpointId, InProgress(20), 10, &delay));
+  EXPECT_GT(delay, absl::ZeroDuration());
+  EXPECT_LE(delay, absl::Seconds(10));
+}
+
+TEST(PayloadProgressAggregatorTest, DeliversAfterIntervalBytes) {
+  PayloadProgressAggregator aggregator(absl::ZeroDuration(), 100);
+  absl::Duration delay;
+
+  EXPECT_FALSE(aggregator.Add(kEndpointId, InProgress(50), 50, &delay));
+  EXPECT_TRUE(aggregator.Add(kEndpointId, InProgress(100), 50, &delay));
+  EXPECT_EQ(delay, absl::ZeroDuration());
+  auto progress = aggregator.Take(kEndpointId, kPayloadId);
+  ASSERT_TRUE(progress.has_value());
+  EXPECT_EQ(progress->num_chunks, 2);
+
+  EXPECT_FALSE(aggregator.Add(kEndpointId, InProgress(150), 50, &delay));
+}
+
+TEST(PayloadProgressAggregatorTest, WithoutThresholdsEveryUpdateIsDue) {
+  PayloadProgressAggregator aggregator(absl::ZeroDuration(), 0);
+  absl::Duration delay;
+
+  EXPECT_TRUE(aggregator.Add(kEndpointId, InProgress(10), 10, &delay));
+  EXPECT_TRUE(aggregator.Take(kEndpointId, kPayloadId).has_value());
+  EXPECT_TRUE(aggregator.Add(kEndpointId, InProgress(20), 10, &delay));
+  EXPECT_EQ(delay, absl::ZeroDuration());
+}
+
+TEST(PayloadProgressAggregatorTest, RemoveReturnsUndeliveredProgress) {
+  PayloadProgressAggregator aggregator(absl::Seconds(1), 0);
+  absl::Duration delay;
+  aggregator.Add(kEndpointId, InProgress(10), 10, &delay);
+
+  auto progress = aggregator.Remove(kEndpointId, kPayloadId);
+
+  ASSERT_TRUE(progress.has_value());
+  EXPECT_EQ(progress->num_bytes, 10);
+  EXPECT_FALSE(aggregator.Take(kEndpointId, kPayloadId).has_value());
+  EXPECT_FALSE(aggregator.Remove(kEndpointId, kPayloadId).has_value());
+}
+
+TEST(PayloadProgressAggregatorTest, RemovePayloadForgetsAllEndpoints) {
+  PayloadProgressAggregator aggregator(absl::Seconds(1), 0);
+  absl::Duration delay;
+  aggregator.Add("A", InProgress(10), 10, &delay);
+  aggregator.Add("B", InProgress(10), 10, &delay);
+
+  aggregator.RemovePayload(kPayloadId);
+
+  EXPECT_FALSE(aggregator.Take("A", kPayloadId).has_value());
+  EXPECT_FALSE(aggregator.Take("B", kPayloadId).has_value());
+}
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
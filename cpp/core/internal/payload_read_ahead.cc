@@ -0,0 +1,81 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/payload_read_ahead.h"
+
+#include <utility>
+
+#include "platform/public/mutex_lock.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+PayloadReadAhead::PayloadReadAhead(InternalPayload* internal_payload,
+                                   SingleThreadExecutor* executor,
+                                   int max_chunks)
+    : internal_payload_(internal_payload),
+      executor_(executor),
+      max_chunks_(max_chunks > 0 ? max_chunks : 1) {}
+
+PayloadReadAhead::~PayloadReadAhead() {
+  MutexLock lock(&mutex_);
+  stopped_ = true;
+  while (reading_) cond_.Wait();
+}
+
+ByteArray PayloadReadAhead::DetachNextChunk(int chunk_size) {
+  MutexLock lock(&mutex_);
+  chunk_size_ = chunk_size;
+  while (chunks_.empty()) {
+    if (done_) return {};
+    if (!reading_) StartReading();
+    cond_.Wait();
+  }
+  ByteArray chunk = std::move(chunks_.front());
+  chunks_.pop_front();
+  // Refill the window while the caller sends this chunk.
+  if (!reading_ && !done_) StartReading();
+  return chunk;
+}
+
+void PayloadReadAhead::StartReading() {
+  reading_ = true;
+  executor_->Execute("payload-read-ahead", [this]() { ReadChunks(); });
+}
+
+void PayloadReadAhead::ReadChunks() {
+  while (true) {
+    int chunk_size;
+    {
+      MutexLock lock(&mutex_);
+      chunk_size = chunk_size_;
+    }
+    // Read without holding the lock, so the sender can take what is ready.
+    ByteArray chunk = internal_payload_->DetachNextChunk(chunk_size);
+    MutexLock lock(&mutex_);
+    if (chunk.Empty()) done_ = true;
+    chunks_.push_back(std::move(chunk));
+    if (stopped_ || done_ || chunks_.size() >= max_chunks_) {
+      reading_ = false;
+      cond_.Notify();
+      return;
+    }
+    cond_.Notify();
+  }
+}
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
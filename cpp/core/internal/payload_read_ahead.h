@@ -0,0 +1,78 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_INTERNAL_PAYLOAD_READ_AHEAD_H_
+#define CORE_INTERNAL_PAYLOAD_READ_AHEAD_H_
+
+#include <deque>
+
+#include "absl/base/thread_annotations.h"
+#include "core/internal/internal_payload.h"
+#include "platform/base/byte_array.h"
+#include "platform/public/condition_variable.h"
+#include "platform/public/mutex.h"
+#include "platform/public/single_thread_executor.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+// Reads the chunks of an outgoing payload on a separate executor, ahead of
+// the sender, so that reading chunk N+1 overlaps with sending chunk N. At most
+// |max_chunks| chunks are buffered at a time.
+//
+// Nothing is read before the first call to DetachNextChunk(), so the payload
+// may still be repositioned (see InternalPayload::SkipToOffset()) until then.
+class PayloadReadAhead {
+ public:
+  // |internal_payload| and |executor| must outlive this object.
+  PayloadReadAhead(InternalPayload* internal_payload,
+                   SingleThreadExecutor* executor, int max_chunks);
+  // Waits for an in-flight read, if there is one.
+  ~PayloadReadAhead();
+  PayloadReadAhead(const PayloadReadAhead&) = delete;
+  PayloadReadAhead& operator=(const PayloadReadAhead&) = delete;
+
+  // Returns the next chunk of the payload, blocking until it has been read.
+  // As with InternalPayload::DetachNextChunk(), an empty chunk marks the end
+  // of the payload, or a read error.
+  // Chunks not read yet are read with |chunk_size|; the ones already buffered
+  // keep the size that was current when they were read.
+  ByteArray DetachNextChunk(int chunk_size) ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  void StartReading() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void ReadChunks() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  InternalPayload* internal_payload_;
+  SingleThreadExecutor* executor_;
+  const size_t max_chunks_;
+
+  Mutex mutex_;
+  ConditionVariable cond_{&mutex_};
+  std::deque<ByteArray> chunks_ ABSL_GUARDED_BY(mutex_);
+  // The size of the next chunk to read, as last asked for by the sender.
+  int chunk_size_ ABSL_GUARDED_BY(mutex_) = 0;
+  // True while ReadChunks() is scheduled or running.
+  bool reading_ ABSL_GUARDED_BY(mutex_) = false;
+  // True once the last (empty) chunk has been read.
+  bool done_ ABSL_GUARDED_BY(mutex_) = false;
+  bool stopped_ ABSL_GUARDED_BY(mutex_) = false;
+};
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
+
+#endif  // CORE_INTERNAL_PAYLOAD_READ_AHEAD_H_
@@ -0,0 +1,112 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/payload_read_ahead.h"
+
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "core/internal/internal_payload_factory.h"
+#include "core/payload.h"
+#include "platform/base/byte_array.h"
+#include "platform/public/file.h"
+#include "platform/public/single_thread_executor.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace {
+
+std::unique_ptr<InternalPayload> CreateFilePayload(const ByteArray& contents) {
+  Payload::Id payload_id = Payload::GenerateId();
+  {
+    OutputFile file(payload_id);
+    EXPECT_TRUE(file.Write(contents).Ok());
+    EXPECT_TRUE(file.Close().Ok());
+  }
+  return CreateOutgoingInternalPayload(
+      Payload{payload_id, InputFile(payload_id, contents.size())});
+}
+
+TEST(PayloadReadAheadTest, ReturnsChunksInOrder) {
+  std::unique_ptr<InternalPayload> internal_payload =
+      CreateFilePayload(ByteArray("0123456789"));
+  ASSERT_NE(internal_payload, nullptr);
+  SingleThreadExecutor executor;
+  PayloadReadAhead read_ahead(internal_payload.get(), &executor, 2);
+
+  EXPECT_EQ(read_ahead.DetachNextChunk(3), ByteArray("012"));
+  EXPECT_EQ(read_ahead.DetachNextChunk(3), ByteArray("345"));
+  EXPECT_EQ(read_ahead.DetachNextChunk(3), ByteArray("678"));
+  EXPECT_EQ(read_ahead.DetachNextChunk(3), ByteArray("9"));
+  EXPECT_TRUE(read_ahead.DetachNextChunk(3).Empty());
+  // Stays at the end of the payload.
+  EXPECT_TRUE(read_ahead.DetachNextChunk(3).Empty());
+}
+
+TEST(PayloadReadAheadTest, ReadsNothingBeforeFirstChunkIsRequested) {
+  std::unique_ptr<InternalPayload> internal_payload =
+      CreateFilePayload(ByteArray("0123456789"));
+  ASSERT_NE(internal_payload, nullptr);
+  SingleThreadExecutor executor;
+  PayloadReadAhead read_ahead(internal_payload.get(), &executor, 2);
+
+  ASSERT_TRUE(internal_payload->SkipToOffset(4).ok());
+
+  EXPECT_EQ(read_ahead.DetachNextChunk(4), ByteArray("4567"));
+  EXPECT_EQ(read_ahead.DetachNextChunk(4), ByteArray("89"));
+  EXPECT_TRUE(read_ahead.DetachNextChunk(4).Empty());
+}
+
+TEST(PayloadReadAheadTest, ReadsWithTheCurrentChunkSize) {
+  std::string contents;
+  for (char c = 'a'; c <= 'z'; ++c) contents += std::string(4, c);
+  std::unique_ptr<InternalPayload> internal_payload =
+      CreateFilePayload(ByteArray(contents));
+  ASSERT_NE(internal_payload, nullptr);
+  SingleThreadExecutor executor;
+  PayloadReadAhead read_ahead(internal_payload.get(), &executor, 2);
+
+  std::string read = std::string(read_ahead.DetachNextChunk(8));
+  // Only the chunks that were already read ahead keep the old size.
+  int old_size_chunks = 0;
+  while (true) {
+    ByteArray chunk = read_ahead.DetachNextChunk(2);
+    if (chunk.Empty()) break;
+    if (chunk.size() > 2) old_size_chunks++;
+    read += std::string(chunk);
+  }
+  EXPECT_LE(old_size_chunks, 2);
+  EXPECT_EQ(read, contents);
+}
+
+TEST(PayloadReadAheadTest, CanBeDestroyedWhileReading) {
+  std::unique_ptr<InternalPayload> internal_payload =
+      CreateFilePayload(ByteArray(std::string(1024, 'x')));
+  ASSERT_NE(internal_payload, nullptr);
+  SingleThreadExecutor executor;
+  {
+    PayloadReadAhead read_ahead(internal_payload.get(), &executor, 4);
+    EXPECT_EQ(read_ahead.DetachNextChunk(16).size(), 16);
+  }
+  // The destructor waited for the read-ahead task, so the payload is not in
+  // use anymore.
+  internal_payload.reset();
+}
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,215 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/payload_scheduler.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "platform/public/mutex_lock.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+PayloadScheduler::PayloadScheduler(int max_parallelism)
+    : max_parallelism_(max_parallelism), executor_(max_parallelism) {}
+
+PayloadScheduler::~PayloadScheduler() { Shutdown(); }
+
+bool PayloadScheduler::Add(Payload::Type type,
+                           const std::vector<std::string>& endpoint_ids,
+                           SendChunk send_chunk, Drop drop) {
+  MutexLock lock(&mutex_);
+  Queue* queue = GetQueue(type);
+  if (shutdown_ || !queue) return false;
+  if (queue->transfers.empty()) {
+    queue->pass = std::max(queue->pass, current_pass_);
+  }
+  std::int64_t sequence = next_sequence_++;
+  for (const auto& endpoint_id : endpoint_ids) {
+    queue->lines[endpoint_id].push_back(sequence);
+  }
+  queue->transfers.push_back(absl::WrapUnique(new Transfer{
+      type, endpoint_ids, std::move(send_chunk), std::move(drop), sequence}));
+  Dispatch();
+  return true;
+}
+
+void PayloadScheduler::Shutdown() {
+  std::vector<std::unique_ptr<Transfer>> dropped;
+  {
+    MutexLock lock(&mutex_);
+    shutdown_ = true;
+    // The chunks being sent put their payloads back in line if they are not
+    // done, so that those are dropped too.
+    while (running_ > 0) idle_.Wait();
+    for (Queue* queue : {&bytes_queue_, &file_queue_}) {
+      for (auto& transfer : queue->transfers) {
+        dropped.push_back(std::move(transfer));
+      }
+      queue->transfers.clear();
+      queue->lines.clear();
+    }
+  }
+  for (const auto& transfer : dropped) {
+    if (transfer->drop) transfer->drop();
+  }
+  executor_.Shutdown();
+}
+
+PayloadScheduler::Queue* PayloadScheduler::GetQueue(Payload::Type type) {
+  switch (type) {
+    case Payload::Type::kBytes:
+      return &bytes_queue_;
+    case Payload::Type::kFile:
+      return &file_queue_;
+    default:
+      return nullptr;
+  }
+}
+
+void PayloadScheduler::Dispatch() {
+  absl::flat_hash_set<std::string> reserved;
+  for (Queue* queue : {&bytes_queue_, &file_queue_}) {
+    for (const auto& transfer : queue->transfers) {
+      // A transfer that is not first in line can not send anyway, and must
+      // not hold up the ones ahead of it.
+      if (transfer->passed_over < kMaxPassedOver ||
+          !IsFirstInLine(*queue, *transfer)) {
+        continue;
+      }
+      reserved.insert(transfer->endpoint_ids.begin(),
+                      transfer->endpoint_ids.end());
+    }
+  }
+
+  while (!shutdown_ && running_ < max_parallelism_) {
+    Queue* queues[] = {&bytes_queue_, &file_queue_};
+    if (queues[1]->pass < queues[0]->pass) std::swap(queues[0], queues[1]);
+
+    Queue* queue = nullptr;
+    std::unique_ptr<Transfer> transfer;
+    for (Queue* candidate : queues) {
+      transfer = TakeReadyTransfer(*candidate, reserved);
+      if (transfer) {
+        queue = candidate;
+        break;
+      }
+    }
+    if (!transfer) return;
+
+    current_pass_ = queue->pass;
+    queue->pass += kStride / queue->weight;
+    for (const auto& endpoint_id : transfer->endpoint_ids) {
+      busy_endpoints_.insert(endpoint_id);
+    }
+    transfer->passed_over = 0;
+    const auto& taken = transfer->endpoint_ids;
+    for (Queue* waiting : {&bytes_queue_, &file_queue_}) {
+      for (auto& other : waiting->transfers) {
+        if (IsFirstInLine(*waiting, *other) &&
+            std::any_of(
+                other->endpoint_ids.begin(), other->endpoint_ids.end(),
+                [&taken](const std::string& endpoint_id) {
+                  return std::find(taken.begin(), taken.end(), endpoint_id) !=
+                         taken.end();
+                })) {
+          other->passed_over++;
+        }
+      }
+    }
+    running_++;
+    // Owned by RunChunk() from here on.
+    Transfer* running_transfer = transfer.release();
+    executor_.Execute("send-payload-chunk", [this, running_transfer]() {
+      RunChunk(running_transfer);
+    });
+  }
+}
+
+bool PayloadScheduler::IsFirstInLine(const Queue& queue,
+                                     const Transfer& transfer) {
+  return std::all_of(transfer.endpoint_ids.begin(), transfer.endpoint_ids.end(),
+                     [&queue, &transfer](const std::string& endpoint_id) {
+                       auto line = queue.lines.find(endpoint_id);
+                       return line != queue.lines.end() &&
+                              line->second.front() == transfer.sequence;
+                     });
+}
+
+void PayloadScheduler::LeaveLines(Queue& queue, const Transfer& transfer) {
+  for (const auto& endpoint_id : transfer.endpoint_ids) {
+    auto line = queue.lines.find(endpoint_id);
+    if (line == queue.lines.end()) continue;
+    auto& sequences = line->second;
+    sequences.erase(
+        std::remove(sequences.begin(), sequences.end(), transfer.sequence),
+        sequences.end());
+    if (sequences.empty()) queue.lines.erase(line);
+  }
+}
+
+std::unique_ptr<PayloadScheduler::Transfer>
+PayloadScheduler::TakeReadyTransfer(
+    Queue& queue, const absl::flat_hash_set<std::string>& reserved) {
+  for (auto it = queue.transfers.begin(); it != queue.transfers.end(); ++it) {
+    if (!IsFirstInLine(queue, **it)) continue;
+    const auto& endpoint_ids = (*it)->endpoint_ids;
+    // A transfer that reserved its endpoints only waits for them to be idle.
+    bool starving = (*it)->passed_over >= kMaxPassedOver;
+    if (std::none_of(endpoint_ids.begin(), endpoint_ids.end(),
+                     [this, &reserved,
+                      starving](const std::string& endpoint_id) {
+                       return busy_endpoints_.contains(endpoint_id) ||
+                              (!starving && reserved.contains(endpoint_id));
+                     })) {
+      std::unique_ptr<Transfer> transfer = std::move(*it);
+      queue.transfers.erase(it);
+      return transfer;
+    }
+  }
+  return nullptr;
+}
+
+void PayloadScheduler::RunChunk(Transfer* running_transfer) {
+  std::unique_ptr<Transfer> transfer(running_transfer);
+  bool more = transfer->send_chunk();
+
+  // Declared before |lock|, so a finished transfer is destroyed unlocked.
+  std::unique_ptr<Transfer> finished;
+  MutexLock lock(&mutex_);
+  running_--;
+  for (const auto& endpoint_id : transfer->endpoint_ids) {
+    busy_endpoints_.erase(endpoint_id);
+  }
+  Queue* queue = GetQueue(transfer->type);
+  if (more) {
+    // Let the payloads to other endpoints that were waiting go first.
+    if (queue->transfers.empty()) {
+      queue->pass = std::max(queue->pass, current_pass_);
+    }
+    queue->transfers.push_back(std::move(transfer));
+  } else {
+    LeaveLines(*queue, *transfer);
+    finished = std::move(transfer);
+  }
+  Dispatch();
+  idle_.Notify();
+}
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,154 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CORE_INTERNAL_PAYLOAD_SCHEDULER_H_
+#define CORE_INTERNAL_PAYLOAD_SCHEDULER_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "core/payload.h"
+#include "platform/public/condition_variable.h"
+#include "platform/public/multi_thread_executor.h"
+#include "platform/public/mutex.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+
+// Interleaves the chunks of several outgoing payloads, so that a large payload
+// does not hold back the ones that are queued after it.
+//
+// A payload is sent one chunk at a time, by calling its SendChunk function
+// until that returns false. Chunks of different payloads are sent
+// concurrently, on up to |max_parallelism| threads, as long as they are not
+// addressed to the same endpoint: every endpoint has at most one chunk in
+// flight. Payloads of one type to the same endpoint are still sent in the
+// order they were added, one after another; only payloads to different
+// endpoints, or of different types, take turns. A payload that has been
+// passed over by others too often reserves its endpoints, so that one sent to
+// several endpoints is not starved by payloads that keep one of them busy.
+//
+// Payload types share the threads by weight: a bytes payload gets several
+// chunks sent for every file chunk, so small messages are not stuck behind
+// large files.
+//
+// Stream payloads are not supported: reading a stream chunk blocks until the
+// app writes it, which would hold up the endpoint for every other payload.
+class PayloadScheduler {
+ public:
+  // Sends the next chunk of a payload. Returns false once the payload is
+  // done, successfully or not.
+  using SendChunk = std::function<bool()>;
+  // Fails a payload that is dropped by Shutdown() before it is done.
+  using Drop = std::function<void()>;
+
+  static constexpr int kDefaultMaxParallelism = 4;
+
+  explicit PayloadScheduler(int max_parallelism = kDefaultMaxParallelism);
+  ~PayloadScheduler();
+  PayloadScheduler(const PayloadScheduler&) = delete;
+  PayloadScheduler& operator=(const PayloadScheduler&) = delete;
+
+  // Starts sending a bytes or file payload to |endpoint_ids|. |send_chunk| is
+  // never called concurrently with itself, or with the SendChunk of another
+  // payload to any of |endpoint_ids|. Returns false if |type| is not
+  // supported, or after Shutdown(). |drop|, if set, is called instead of
+  // |send_chunk| if the payload is dropped.
+  bool Add(Payload::Type type, const std::vector<std::string>& endpoint_ids,
+           SendChunk send_chunk, Drop drop = nullptr)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Waits for the chunks being sent, and then drops the payloads that are not
+  // done yet.
+  void Shutdown() ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Transfer {
+    Payload::Type type;
+    std::vector<std::string> endpoint_ids;
+    SendChunk send_chunk;
+    Drop drop;
+    // Order in which the transfer was added.
+    std::int64_t sequence;
+    // Number of times another payload took one of |endpoint_ids| while this
+    // one was waiting.
+    int passed_over = 0;
+  };
+
+  // The payloads of one type. Queues take turns by stride scheduling: the
+  // queue with the lowest |pass| sends next, and then advances it by a stride
+  // inversely proportional to its weight.
+  struct Queue {
+    explicit Queue(int weight) : weight(weight) {}
+    const int weight;
+    std::int64_t pass = 0;
+    std::deque<std::unique_ptr<Transfer>> transfers;
+    // The |sequence| of the transfers that are not done yet, per endpoint, in
+    // the order they were added. Only a transfer that is first in line for
+    // all of its endpoints may send.
+    absl::flat_hash_map<std::string, std::deque<std::int64_t>> lines;
+  };
+
+  static constexpr std::int64_t kStride = 1 << 16;
+  static constexpr int kBytesWeight = 4;
+  static constexpr int kFileWeight = 1;
+  // Once passed over this often, a waiting payload reserves its endpoints.
+  static constexpr int kMaxPassedOver = 8;
+
+  // Returns null for unsupported payload types.
+  Queue* GetQueue(Payload::Type type) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Starts sending as many chunks as there are threads and idle endpoints for.
+  void Dispatch() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Returns true if |transfer| is first in line for all of its endpoints.
+  static bool IsFirstInLine(const Queue& queue, const Transfer& transfer);
+  // Takes |transfer| out of line, once it is done or dropped.
+  static void LeaveLines(Queue& queue, const Transfer& transfer);
+  // Removes and returns the first transfer in |queue| that is first in line,
+  // and whose endpoints are all idle, and not reserved by another transfer;
+  // returns null if there is none.
+  std::unique_ptr<Transfer> TakeReadyTransfer(
+      Queue& queue, const absl::flat_hash_set<std::string>& reserved)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void RunChunk(Transfer* transfer) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  const int max_parallelism_;
+  Mutex mutex_;
+  ConditionVariable idle_{&mutex_};
+  bool shutdown_ ABSL_GUARDED_BY(mutex_) = false;
+  // Number of chunks being sent.
+  int running_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Endpoints with a chunk in flight.
+  absl::flat_hash_set<std::string> busy_endpoints_ ABSL_GUARDED_BY(mutex_);
+  // The |pass| of the queue that sent last; a queue that was empty starts
+  // from here, rather than from the credit it built up while it was idle.
+  std::int64_t current_pass_ ABSL_GUARDED_BY(mutex_) = 0;
+  std::int64_t next_sequence_ ABSL_GUARDED_BY(mutex_) = 0;
+  Queue bytes_queue_ ABSL_GUARDED_BY(mutex_){kBytesWeight};
+  Queue file_queue_ ABSL_GUARDED_BY(mutex_){kFileWeight};
+  MultiThreadExecutor executor_;
+};
+
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
+
+#endif  // CORE_INTERNAL_PAYLOAD_SCHEDULER_H_
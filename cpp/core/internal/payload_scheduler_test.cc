@@ -0,0 +1,224 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/internal/payload_scheduler.h"
+
+#include <atomic>
+
+#include "gtest/gtest.h"
+#include "absl/time/time.h"
+#include "platform/public/count_down_latch.h"
+#include "platform/public/system_clock.h"
+
+namespace location {
+namespace nearby {
+namespace connections {
+namespace {
+
+constexpr absl::Duration kDefaultTimeout = absl::Seconds(5);
+
+TEST(PayloadSchedulerTest, SendsAllChunks) {
+  PayloadScheduler scheduler;
+  CountDownLatch done(1);
+  int chunks = 0;
+
+  EXPECT_TRUE(scheduler.Add(Payload::Type::kFile, {"A"}, [&]() {
+    if (++chunks < 10) return true;
+    done.CountDown();
+    return false;
+  }));
+
+  EXPECT_TRUE(done.Await(kDefaultTimeout).result());
+  EXPECT_EQ(chunks, 10);
+}
+
+TEST(PayloadSchedulerTest, RejectsStreamPayloads) {
+  PayloadScheduler scheduler;
+
+  EXPECT_FALSE(
+      scheduler.Add(Payload::Type::kStream, {"A"}, []() { return false; }));
+}
+
+TEST(PayloadSchedulerTest, SendsOneChunkAtATimePerEndpoint) {
+  PayloadScheduler scheduler;
+  CountDownLatch done(3);
+  std::atomic_int in_flight = 0;
+  std::atomic_bool overlapped = false;
+  auto send_chunk = [&](std::shared_ptr<int> chunks) {
+    return [&, chunks]() {
+      if (++in_flight > 1) overlapped = true;
+      SystemClock::Sleep(absl::Milliseconds(1));
+      --in_flight;
+      if (++*chunks < 10) return true;
+      done.CountDown();
+      return false;
+    };
+  };
+
+  scheduler.Add(Payload::Type::kFile, {"A"},
+                send_chunk(std::make_shared<int>(0)));
+  scheduler.Add(Payload::Type::kFile, {"A", "B"},
+                send_chunk(std::make_shared<int>(0)));
+  scheduler.Add(Payload::Type::kBytes, {"A"},
+                send_chunk(std::make_shared<int>(0)));
+
+  EXPECT_TRUE(done.Await(kDefaultTimeout).result());
+  EXPECT_FALSE(overlapped);
+}
+
+TEST(PayloadSchedulerTest, SendsToDifferentEndpointsConcurrently) {
+  PayloadScheduler scheduler;
+  // Each payload only finishes once the other one has started.
+  CountDownLatch started(2);
+  CountDownLatch done(2);
+  auto send_chunk = [&]() {
+    started.CountDown();
+    EXPECT_TRUE(started.Await(kDefaultTimeout).result());
+    done.CountDown();
+    return false;
+  };
+
+  scheduler.Add(Payload::Type::kFile, {"A"}, send_chunk);
+  scheduler.Add(Payload::Type::kFile, {"B"}, send_chunk);
+
+  EXPECT_TRUE(done.Await(kDefaultTimeout).result());
+}
+
+TEST(PayloadSchedulerTest, SmallPayloadIsNotStuckBehindLargeOne) {
+  PayloadScheduler scheduler;
+  CountDownLatch bytes_done(1);
+  std::atomic_bool file_done = false;
+  std::atomic_bool file_done_first = false;
+
+  scheduler.Add(Payload::Type::kFile, {"A"}, [&, chunks = 0]() mutable {
+    SystemClock::Sleep(absl::Milliseconds(1));
+    if (++chunks < 1000) return true;
+    file_done = true;
+    return false;
+  });
+  scheduler.Add(Payload::Type::kBytes, {"A"}, [&]() {
+    file_done_first = file_done.load();
+    bytes_done.CountDown();
+    return false;
+  });
+
+  EXPECT_TRUE(bytes_done.Await(kDefaultTimeout).result());
+  EXPECT_FALSE(file_done_first);
+}
+
+TEST(PayloadSchedulerTest, SendsPayloadsToSameEndpointInOrder) {
+  PayloadScheduler scheduler;
+  CountDownLatch done(3);
+  std::atomic_bool large_done = false;
+  std::atomic_bool small_done_first = false;
+  std::atomic_bool other_done_first = false;
+
+  scheduler.Add(Payload::Type::kBytes, {"A"}, [&, chunks = 0]() mutable {
+    SystemClock::Sleep(absl::Milliseconds(1));
+    if (++chunks < 100) return true;
+    large_done = true;
+    done.CountDown();
+    return false;
+  });
+  scheduler.Add(Payload::Type::kBytes, {"A", "B"}, [&]() {
+    small_done_first = !large_done;
+    done.CountDown();
+    return false;
+  });
+  // Not in line behind the large payload, since it goes to another endpoint.
+  scheduler.Add(Payload::Type::kBytes, {"C"}, [&]() {
+    other_done_first = !large_done;
+    done.CountDown();
+    return false;
+  });
+
+  EXPECT_TRUE(done.Await(kDefaultTimeout).result());
+  EXPECT_FALSE(small_done_first);
+  EXPECT_TRUE(other_done_first);
+}
+
+TEST(PayloadSchedulerTest, MultiEndpointPayloadIsNotStarved) {
+  PayloadScheduler scheduler;
+  CountDownLatch both_done(1);
+  std::atomic_bool stop = false;
+  // Keeps |A| or |B| busy, so that the two are never idle at the same time.
+  auto send_chunk = [&]() {
+    SystemClock::Sleep(absl::Milliseconds(1));
+    return !stop;
+  };
+
+  scheduler.Add(Payload::Type::kFile, {"A"}, send_chunk);
+  scheduler.Add(Payload::Type::kFile, {"B"}, send_chunk);
+  // Of another type, so that it is not in line behind the two above.
+  scheduler.Add(Payload::Type::kBytes, {"A", "B"}, [&]() {
+    both_done.CountDown();
+    return false;
+  });
+
+  EXPECT_TRUE(both_done.Await(kDefaultTimeout).result());
+  stop = true;
+}
+
+TEST(PayloadSchedulerTest, ShutdownDropsPayloadsThatAreNotDone) {
+  std::atomic_int chunks = 0;
+  std::atomic_int dropped = 0;
+  auto drop = [&]() { ++dropped; };
+  {
+    PayloadScheduler scheduler(1);
+    scheduler.Add(
+        Payload::Type::kFile, {"A"},
+        [&]() {
+          ++chunks;
+          SystemClock::Sleep(absl::Milliseconds(100));
+          return true;
+        },
+        drop);
+    scheduler.Add(
+        Payload::Type::kFile, {"B"},
+        [&]() {
+          ++chunks;
+          return true;
+        },
+        drop);
+    SystemClock::Sleep(absl::Milliseconds(10));
+    scheduler.Shutdown();
+
+    EXPECT_FALSE(
+        scheduler.Add(Payload::Type::kBytes, {"C"}, []() { return false; }));
+  }
+  EXPECT_EQ(chunks, 1);
+  EXPECT_EQ(dropped, 2);
+}
+
+TEST(PayloadSchedulerTest, ShutdownDoesNotDropFinishedPayloads) {
+  std::atomic_int dropped = 0;
+  {
+    PayloadScheduler scheduler(1);
+    scheduler.Add(
+        Payload::Type::kFile, {"A"},
+        []() {
+          SystemClock::Sleep(absl::Milliseconds(100));
+          return false;
+        },
+        [&]() { ++dropped; });
+    SystemClock::Sleep(absl::Milliseconds(10));
+    scheduler.Shutdown();
+  }
+  EXPECT_EQ(dropped, 0);
+}
+
+}  // namespace
+}  // namespace connections
+}  // namespace nearby
+}  // namespace location
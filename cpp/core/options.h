@@ -103,6 +103,9 @@ struct ConnectionOptions {
   std::string fast_advertisement_service_uuid;
   int keep_alive_interval_millis = 0;
   int keep_alive_timeout_millis = 0;
+  // Whether payload chunks are sized from the measured throughput of the
+  // connection, rather than fixed per medium.
+  bool adaptive_chunk_size = false;
   // Verify if  ConnectionOptions is in a not-initialized (Empty) state.
   bool Empty() const { return strategy.IsNone(); }
   // Bring  ConnectionOptions to a not-initialized (Empty) state.
@@ -0,0 +1,83 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/base/allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace location {
+namespace nearby {
+namespace {
+
+std::atomic<std::int64_t> total_allocations{0};
+std::atomic<std::int64_t> total_bytes{0};
+
+void* Allocate(std::size_t size) {
+  total_allocations.fetch_add(1, std::memory_order_relaxed);
+  total_bytes.fetch_add(size, std::memory_order_relaxed);
+  // malloc(0) may return nullptr, which operator new must not.
+  void* ptr = std::malloc(size > 0 ? size : 1);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+}  // namespace
+
+void AllocationCounter::Reset() {
+  allocations_start_ = total_allocations.load(std::memory_order_relaxed);
+  bytes_start_ = total_bytes.load(std::memory_order_relaxed);
+}
+
+std::int64_t AllocationCounter::GetAllocations() const {
+  return total_allocations.load(std::memory_order_relaxed) -
+         allocations_start_;
+}
+
+std::int64_t AllocationCounter::GetAllocatedBytes() const {
+  return total_bytes.load(std::memory_order_relaxed) - bytes_start_;
+}
+
+void SetAllocationCounters(benchmark::State& state,
+                           const AllocationCounter& counter) {
+  using Counter = benchmark::Counter;
+  state.counters["allocs"] =
+      Counter(counter.GetAllocations(), Counter::kAvgIterations);
+  state.counters["alloc_bytes"] =
+      Counter(counter.GetAllocatedBytes(), Counter::kAvgIterations);
+}
+
+}  // namespace nearby
+}  // namespace location
+
+// The replaceable allocation functions. The nothrow forms of operator new
+// call these, and over-aligned allocations are not counted.
+void* operator new(std::size_t size) {
+  return location::nearby::Allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+  return location::nearby::Allocate(size);
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t size) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr, std::size_t size) noexcept {
+  std::free(ptr);
+}
@@ -0,0 +1,54 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_BASE_ALLOCATION_COUNTER_H_
+#define PLATFORM_BASE_ALLOCATION_COUNTER_H_
+
+#include <cstdint>
+
+#include "benchmark/benchmark.h"
+
+namespace location {
+namespace nearby {
+
+// Counts heap allocations made with operator new, by all threads, since the
+// counter was created or last reset.
+//
+// Linking this in replaces the global operator new and operator delete of
+// the binary, so it is meant for benchmarks only.
+class AllocationCounter {
+ public:
+  AllocationCounter() { Reset(); }
+
+  void Reset();
+
+  // Number of allocations made.
+  std::int64_t GetAllocations() const;
+  // Total size of these allocations, in bytes.
+  std::int64_t GetAllocatedBytes() const;
+
+ private:
+  std::int64_t allocations_start_;
+  std::int64_t bytes_start_;
+};
+
+// Reports the allocations counted by |counter| as the "allocs" and
+// "alloc_bytes" counters of |state|, averaged per iteration.
+void SetAllocationCounters(benchmark::State& state,
+                           const AllocationCounter& counter);
+
+}  // namespace nearby
+}  // namespace location
+
+#endif  // PLATFORM_BASE_ALLOCATION_COUNTER_H_
@@ -0,0 +1,67 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Base64 encoding and decoding, from endpoint ids up to 1 MB of bytes.
+//
+// Run with:
+//   blaze run -c opt //platform/base:base64_utils_benchmark -- \
+//     --benchmark_filter=all
+
+#include <cstdint>
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "platform/base/allocation_counter.h"
+#include "platform/base/base64_utils.h"
+#include "platform/base/byte_array.h"
+
+namespace location {
+namespace nearby {
+namespace {
+
+constexpr std::int64_t kMinSize = 32;
+constexpr std::int64_t kMaxSize = 1 << 20;
+
+void BM_Encode(benchmark::State& state) {
+  ByteArray bytes(std::string(state.range(0), 'b'));
+  AllocationCounter counter;
+  for (auto _ : state) {
+    std::string base64 = Base64Utils::Encode(bytes);
+    benchmark::DoNotOptimize(base64.data());
+  }
+  SetAllocationCounters(state, counter);
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Encode)->RangeMultiplier(8)->Range(kMinSize, kMaxSize);
+
+void BM_Decode(benchmark::State& state) {
+  std::string base64 =
+      Base64Utils::Encode(ByteArray(std::string(state.range(0), 'b')));
+  AllocationCounter counter;
+  for (auto _ : state) {
+    ByteArray bytes = Base64Utils::Decode(base64);
+    if (bytes.size() != state.range(0)) {
+      state.SkipWithError("Failed to decode");
+      break;
+    }
+    benchmark::DoNotOptimize(bytes.data());
+  }
+  SetAllocationCounters(state, counter);
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Decode)->RangeMultiplier(8)->Range(kMinSize, kMaxSize);
+
+}  // namespace
+}  // namespace nearby
+}  // namespace location
@@ -14,6 +14,11 @@
 
 #include "platform/base/base_pipe.h"
 
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "absl/time/clock.h"
 #include "platform/base/base_mutex_lock.h"
 #include "platform/base/input_stream.h"
 #include "platform/base/output_stream.h"
@@ -24,56 +29,121 @@ namespace nearby {
 ExceptionOr<ByteArray> BasePipe::Read(size_t size) {
   BaseMutexLock lock(mutex_.get());
 
-  // We're done reading all the chunks that were written before the OutputStream
-  // was closed, so there's nothing to do here other than return an empty chunk
-  // to serve as an EOF indication to callers.
-  if (read_all_chunks_) {
+  if (ring_) {
+    ExceptionOr<size_t> available = WaitForRingDataLocked();
+    if (!available.ok()) {
+      return ExceptionOr<ByteArray>{available.exception()};
+    }
+    ByteArray bytes(std::min(size, available.result()));
+    TakeFromRingLocked(absl::MakeSpan(bytes.data(), bytes.size()));
+    return ExceptionOr<ByteArray>{std::move(bytes)};
+  }
+
+  ExceptionOr<bool> has_chunk = WaitForChunkLocked();
+  if (!has_chunk.ok()) {
+    return ExceptionOr<ByteArray>{has_chunk.exception()};
+  }
+  // Return an empty chunk to serve as an EOF indication to callers.
+  if (!has_chunk.result()) {
     return ExceptionOr<ByteArray>{ByteArray{}};
   }
 
-  while (buffer_.empty() && !input_stream_closed_) {
-    Exception wait_exception = cond_->Wait();
+  ByteSlice& first_chunk = buffer_.front();
 
-    if (wait_exception.Raised()) {
-      return ExceptionOr<ByteArray>{wait_exception};
-    }
+  // If the whole of first_chunk is small enough to not overshoot the requested
+  // 'size', hand it over as is; this does not copy unless a part of the chunk
+  // has already been read.
+  if (first_chunk.size() <= size) {
+    ByteArray next_chunk = std::move(first_chunk).ToByteArray();
+    buffer_.pop_front();
+    return ExceptionOr<ByteArray>{std::move(next_chunk)};
   }
 
-  if (input_stream_closed_) {
-    return ExceptionOr<ByteArray>{Exception::kIo};
-  }
+  // Otherwise, return the first 'size' bytes of first_chunk; the rest of it
+  // stays at the head of the queue, to be served up in the next call to
+  // read().
+  ByteArray next_chunk = first_chunk.Subslice(0, size).ToByteArray();
+  ConsumeLocked(size);
+  return ExceptionOr<ByteArray>{std::move(next_chunk)};
+}
 
-  ByteArray first_chunk{buffer_.front()};
-  buffer_.pop_front();
+ExceptionOr<size_t> BasePipe::ReadInto(absl::Span<char> buffer) {
+  BaseMutexLock lock(mutex_.get());
 
-  // If we received our sentinel chunk, mark the fact that there cannot
-  // possibly be any more chunks to read here on in, and return an empty chunk
-  // to serve as an EOF indication to callers.
-  if (first_chunk.Empty()) {
-    read_all_chunks_ = true;
-    return ExceptionOr<ByteArray>{ByteArray{}};
+  if (ring_) {
+    ExceptionOr<size_t> available = WaitForRingDataLocked();
+    if (!available.ok()) {
+      return available;
+    }
+    size_t read_size = std::min(buffer.size(), available.result());
+    TakeFromRingLocked(buffer.subspan(0, read_size));
+    return ExceptionOr<size_t>{read_size};
   }
 
-  // If first_chunk is small enough to not overshoot the requested 'size', just
-  // return that.
-  if (first_chunk.size() <= size) {
-    return ExceptionOr<ByteArray>{first_chunk};
-  } else {
-    // Break first_chunk into 2 parts -- the first one of which (next_chunk)
-    // will be 'size' bytes long, and will be returned, and the second one of
-    // which (overflow_chunk) will be re-inserted into buffer_, at the head of
-    // the queue, to be served up in the next call to read().
-    ByteArray next_chunk(first_chunk.data(), size);
-    buffer_.push_front(
-        ByteArray(first_chunk.data() + size, first_chunk.size() - size));
-    return ExceptionOr<ByteArray>{next_chunk};
+  ExceptionOr<bool> has_chunk = WaitForChunkLocked();
+  if (!has_chunk.ok()) {
+    return ExceptionOr<size_t>{has_chunk.exception()};
+  }
+  if (!has_chunk.result()) {
+    return ExceptionOr<size_t>{0};
   }
+
+  const ByteSlice& first_chunk = buffer_.front();
+  size_t read_size = std::min(buffer.size(), first_chunk.size());
+  memcpy(buffer.data(), first_chunk.data(), read_size);
+  ConsumeLocked(read_size);
+  return ExceptionOr<size_t>{read_size};
 }
 
 Exception BasePipe::Write(const ByteArray& data) {
+  if (ring_) {
+    BaseMutexLock lock(mutex_.get());
+
+    return PutIntoRingLocked(absl::string_view(data.data(), data.size()));
+  }
+
+  ByteSlice chunk(data);
+
   BaseMutexLock lock(mutex_.get());
 
-  return WriteLocked(data);
+  return WriteLocked(std::move(chunk));
+}
+
+Exception BasePipe::WriteV(absl::Span<const absl::string_view> buffers) {
+  if (ring_) {
+    BaseMutexLock lock(mutex_.get());
+
+    for (const absl::string_view buffer : buffers) {
+      Exception write_exception = PutIntoRingLocked(buffer);
+      if (write_exception.Raised()) {
+        return write_exception;
+      }
+    }
+    return {Exception::kSuccess};
+  }
+
+  // Gather all buffers into one chunk, so that the reader gets them back in one
+  // piece.
+  size_t total_size = 0;
+  for (const absl::string_view buffer : buffers) {
+    total_size += buffer.size();
+  }
+  ByteArray chunk(total_size);
+  size_t position = 0;
+  for (const absl::string_view buffer : buffers) {
+    memcpy(chunk.data() + position, buffer.data(), buffer.size());
+    position += buffer.size();
+  }
+
+  BaseMutexLock lock(mutex_.get());
+
+  // An empty chunk is the EOF sentinel; there is nothing to write.
+  if (chunk.Empty()) {
+    return (input_stream_closed_ || output_stream_closed_)
+               ? Exception{Exception::kIo}
+               : Exception{Exception::kSuccess};
+  }
+  return WriteLocked(ByteSlice(std::move(chunk)));
 }
 
 void BasePipe::MarkInputStreamClosed() {
@@ -89,21 +159,133 @@ void BasePipe::MarkOutputStreamClosed() {
   BaseMutexLock lock(mutex_.get());
 
   // Write a sentinel null chunk before marking output_stream_closed as true.
-  WriteLocked(ByteArray{});
+  // A bounded pipe has no chunks; its reader stops once the ring buffer is
+  // empty and the output stream is closed.
+  if (!ring_) WriteLocked(ByteSlice{});
   output_stream_closed_ = true;
+  // Unblock a potentially-blocked call to read() or write().
+  cond_->Notify();
 }
 
-Exception BasePipe::WriteLocked(const ByteArray& data) {
+Exception BasePipe::WriteLocked(ByteSlice data) {
   if (input_stream_closed_ || output_stream_closed_) {
     return {Exception::kIo};
   }
 
-  buffer_.push_back(data);
+  buffer_.push_back(std::move(data));
   // Trigger cond_ to unblock a potentially-blocked call to read(), now that
   // there's more data for it to consume.
   cond_->Notify();
   return {Exception::kSuccess};
 }
 
+ExceptionOr<bool> BasePipe::WaitForChunkLocked() {
+  // We're done reading all the chunks that were written before the OutputStream
+  // was closed, so there's nothing to do here other than report EOF.
+  if (read_all_chunks_) {
+    return ExceptionOr<bool>{false};
+  }
+
+  while (buffer_.empty() && !input_stream_closed_) {
+    Exception wait_exception = cond_->Wait();
+
+    if (wait_exception.Raised()) {
+      return ExceptionOr<bool>{wait_exception};
+    }
+  }
+
+  if (input_stream_closed_) {
+    return ExceptionOr<bool>{Exception::kIo};
+  }
+
+  // If we received our sentinel chunk, mark the fact that there cannot
+  // possibly be any more chunks to read here on in.
+  if (buffer_.front().Empty()) {
+    buffer_.pop_front();
+    read_all_chunks_ = true;
+    return ExceptionOr<bool>{false};
+  }
+
+  return ExceptionOr<bool>{true};
+}
+
+ExceptionOr<size_t> BasePipe::WaitForRingDataLocked() {
+  while (ring_size_ == 0 && !input_stream_closed_ && !output_stream_closed_) {
+    Exception wait_exception = cond_->Wait();
+
+    if (wait_exception.Raised()) {
+      return ExceptionOr<size_t>{wait_exception};
+    }
+  }
+
+  if (input_stream_closed_) {
+    return ExceptionOr<size_t>{Exception::kIo};
+  }
+
+  return ExceptionOr<size_t>{ring_size_};
+}
+
+void BasePipe::TakeFromRingLocked(absl::Span<char> buffer) {
+  size_t first_part = std::min(buffer.size(), capacity_ - ring_start_);
+  memcpy(buffer.data(), ring_.get() + ring_start_, first_part);
+  memcpy(buffer.data() + first_part, ring_.get(), buffer.size() - first_part);
+  ring_start_ = (ring_start_ + buffer.size()) % capacity_;
+  ring_size_ -= buffer.size();
+  // Let a potentially-blocked call to write() know there's room now.
+  cond_->Notify();
+}
+
+Exception BasePipe::PutIntoRingLocked(absl::string_view data) {
+  if (input_stream_closed_ || output_stream_closed_) {
+    return {Exception::kIo};
+  }
+
+  while (!data.empty()) {
+    const absl::Time deadline = absl::Now() + write_timeout_;
+    while (ring_size_ == capacity_ && !input_stream_closed_ &&
+           !output_stream_closed_) {
+      Exception wait_exception;
+      if (write_timeout_ == absl::InfiniteDuration()) {
+        wait_exception = cond_->Wait();
+      } else {
+        absl::Duration remaining = deadline - absl::Now();
+        if (remaining <= absl::ZeroDuration()) {
+          return {Exception::kTimeout};
+        }
+        wait_exception = cond_->Wait(remaining);
+      }
+
+      if (wait_exception.Raised()) {
+        return wait_exception;
+      }
+    }
+
+    if (input_stream_closed_ || output_stream_closed_) {
+      return {Exception::kIo};
+    }
+
+    size_t write_position = (ring_start_ + ring_size_) % capacity_;
+    size_t count = std::min({data.size(), capacity_ - ring_size_,
+                             capacity_ - write_position});
+    memcpy(ring_.get() + write_position, data.data(), count);
+    ring_size_ += count;
+    data.remove_prefix(count);
+    // Trigger cond_ to unblock a potentially-blocked call to read(), now that
+    // there's more data for it to consume.
+    cond_->Notify();
+  }
+
+  return {Exception::kSuccess};
+}
+
+void BasePipe::ConsumeLocked(size_t size) {
+  ByteSlice& first_chunk = buffer_.front();
+  if (size < first_chunk.size()) {
+    first_chunk = first_chunk.Subslice(size, first_chunk.size() - size);
+  } else {
+    buffer_.pop_front();
+  }
+}
+
 }  // namespace nearby
 }  // namespace location
@@ -20,9 +20,13 @@
 #include <memory>
 
 #include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "platform/api/condition_variable.h"
 #include "platform/api/mutex.h"
 #include "platform/base/byte_array.h"
+#include "platform/base/byte_chain.h"
 #include "platform/base/exception.h"
 #include "platform/base/input_stream.h"
 #include "platform/base/output_stream.h"
@@ -46,6 +50,15 @@ namespace nearby {
 //   DerivedPipe(DerivedPipe&&) = default;
 //   DerivedPipe& operator=(DerivedPipe&&) = default;
 // };
+//
+// By default a pipe is unbounded: every write is queued as a chunk, and reads
+// never return more than one chunk. A pipe set up with a non-zero capacity
+// instead keeps its data in a fixed ring buffer of that many bytes, and writers
+// block while it is full, so a slow reader throttles the writer. Writes that
+// do not fit are done in parts as space frees up, so concurrent writers of a
+// bounded pipe must be serialized by the caller. A bounded pipe may also be
+// given a write timeout: a write fails with Exception::kTimeout once the
+// reader has made no room for that long.
 class BasePipe {
  public:
   static constexpr const size_t kChunkSize = 64 * 1024;
@@ -66,9 +79,14 @@ class BasePipe {
   BasePipe() = default;
 
   void Setup(std::unique_ptr<api::Mutex> mutex,
-             std::unique_ptr<api::ConditionVariable> cond) {
+             std::unique_ptr<api::ConditionVariable> cond,
+             size_t capacity = 0,
+             absl::Duration write_timeout = absl::InfiniteDuration()) {
     mutex_ = std::move(mutex);
     cond_ = std::move(cond);
+    capacity_ = capacity;
+    write_timeout_ = write_timeout;
+    if (capacity_ > 0) ring_ = std::make_unique<char[]>(capacity_);
   }
 
  private:
@@ -80,6 +98,9 @@ class BasePipe {
     ExceptionOr<ByteArray> Read(std::int64_t size) override {
       return pipe_->Read(size);
     }
+    ExceptionOr<size_t> ReadInto(absl::Span<char> buffer) override {
+      return pipe_->ReadInto(buffer);
+    }
     Exception Close() override { return DoClose(); }
 
    private:
@@ -97,6 +118,9 @@ class BasePipe {
     Exception Write(const ByteArray& data) override {
       return pipe_->Write(data);
     }
+    Exception WriteV(absl::Span<const absl::string_view> buffers) override {
+      return pipe_->WriteV(buffers);
+    }
     Exception Flush() override { return {Exception::kSuccess}; }
     Exception Close() override { return DoClose(); }
 
@@ -109,13 +133,35 @@ class BasePipe {
   };
 
   ExceptionOr<ByteArray> Read(size_t size) ABSL_LOCKS_EXCLUDED(mutex_);
+  ExceptionOr<size_t> ReadInto(absl::Span<char> buffer)
+      ABSL_LOCKS_EXCLUDED(mutex_);
   Exception Write(const ByteArray& data) ABSL_LOCKS_EXCLUDED(mutex_);
+  Exception WriteV(absl::Span<const absl::string_view> buffers)
+      ABSL_LOCKS_EXCLUDED(mutex_);
 
   void MarkInputStreamClosed() ABSL_LOCKS_EXCLUDED(mutex_);
   void MarkOutputStreamClosed() ABSL_LOCKS_EXCLUDED(mutex_);
 
-  Exception WriteLocked(const ByteArray& data)
+  Exception WriteLocked(ByteSlice data) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Bounded mode helpers.
+  // Blocks until the ring buffer has data; returns the number of bytes
+  // available, or 0 once the writer is closed and everything has been read.
+  ExceptionOr<size_t> WaitForRingDataLocked()
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Moves buffer.size() bytes out of the ring buffer into |buffer|.
+  void TakeFromRingLocked(absl::Span<char> buffer)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Copies |data| into the ring buffer, blocking while it is full, for at
+  // most write_timeout_ at a time.
+  Exception PutIntoRingLocked(absl::string_view data)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Blocks until there is a chunk to read at the head of buffer_.
+  // Returns false if all chunks have been read (end of stream).
+  ExceptionOr<bool> WaitForChunkLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Marks |size| bytes of the head chunk as consumed.
+  void ConsumeLocked(size_t size) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   // Order of declaration matters:
   // - mutex must be defined before condvar;
@@ -124,7 +170,18 @@ class BasePipe {
   bool output_stream_closed_ ABSL_GUARDED_BY(mutex_) = false;
   bool read_all_chunks_ ABSL_GUARDED_BY(mutex_) = false;
 
-  std::deque<ByteArray> ABSL_GUARDED_BY(mutex_) buffer_;
+  // Partially read chunks are trimmed in place; slicing does not copy.
+  std::deque<ByteSlice> ABSL_GUARDED_BY(mutex_) buffer_;
+
+  // Bounded mode storage, used instead of buffer_ when capacity_ > 0.
+  // Set once in Setup().
+  size_t capacity_ = 0;
+  absl::Duration write_timeout_ = absl::InfiniteDuration();
+  std::unique_ptr<char[]> ring_;
+  // Position of the first unread byte, and the number of unread bytes.
+  size_t ring_start_ ABSL_GUARDED_BY(mutex_) = 0;
+  size_t ring_size_ ABSL_GUARDED_BY(mutex_) = 0;
+
   std::unique_ptr<api::Mutex> mutex_;
   std::unique_ptr<api::ConditionVariable> cond_;
 
@@ -0,0 +1,123 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/base/byte_chain.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace location {
+namespace nearby {
+
+ByteSlice::ByteSlice(ByteArray&& bytes) : size_(bytes.size()) {
+  if (size_) buffer_ = std::make_shared<ByteArray>(std::move(bytes));
+}
+
+ByteSlice::ByteSlice(const ByteArray& bytes)
+    : ByteSlice(bytes.data(), bytes.size()) {}
+
+ByteSlice::ByteSlice(const char* data, size_t size)
+    : ByteSlice(ByteArray(data, size)) {}
+
+ByteSlice ByteSlice::Subslice(size_t offset, size_t length) const {
+  ByteSlice slice;
+  if (offset >= size_) return slice;
+  slice.buffer_ = buffer_;
+  slice.offset_ = offset_ + offset;
+  slice.size_ = std::min(length, size_ - offset);
+  return slice;
+}
+
+ByteArray ByteSlice::ToByteArray() const& { return ByteArray(data(), size_); }
+
+ByteArray ByteSlice::ToByteArray() && {
+  if (buffer_ && buffer_.use_count() == 1 && offset_ == 0 &&
+      size_ == buffer_->size()) {
+    ByteArray bytes = std::move(*buffer_);
+    buffer_.reset();
+    size_ = 0;
+    return bytes;
+  }
+  return ByteArray(data(), size_);
+}
+
+void ByteChain::Append(ByteSlice slice) {
+  if (slice.Empty()) return;
+  size_ += slice.size();
+  slices_.push_back(std::move(slice));
+}
+
+void ByteChain::Append(const ByteChain& chain) {
+  slices_.reserve(slices_.size() + chain.slices_.size());
+  for (const auto& slice : chain.slices_) Append(slice);
+}
+
+ByteChain ByteChain::Subchain(size_t offset, size_t length) const {
+  ByteChain chain;
+  for (const auto& slice : slices_) {
+    if (length == 0) break;
+    if (offset >= slice.size()) {
+      offset -= slice.size();
+      continue;
+    }
+    ByteSlice part = slice.Subslice(offset, length);
+    offset = 0;
+    length -= part.size();
+    chain.Append(std::move(part));
+  }
+  return chain;
+}
+
+std::vector<absl::string_view> ByteChain::AsStringViews() const {
+  std::vector<absl::string_view> buffers;
+  buffers.reserve(slices_.size());
+  for (const auto& slice : slices_) buffers.push_back(slice.AsStringView());
+  return buffers;
+}
+
+size_t ByteChain::CopyTo(absl::Span<char> buffer) const {
+  size_t copied = 0;
+  for (const auto& slice : slices_) {
+    if (copied == buffer.size()) break;
+    size_t count = std::min(slice.size(), buffer.size() - copied);
+    std::memcpy(buffer.data() + copied, slice.data(), count);
+    copied += count;
+  }
+  return copied;
+}
+
+ByteArray ByteChain::Flatten() const& {
+  ByteArray bytes(size_);
+  CopyTo(absl::MakeSpan(bytes.data(), bytes.size()));
+  return bytes;
+}
+
+ByteArray ByteChain::Flatten() && {
+  if (slices_.size() == 1) {
+    ByteArray bytes = std::move(slices_.front()).ToByteArray();
+    slices_.clear();
+    size_ = 0;
+    return bytes;
+  }
+  return static_cast<const ByteChain&>(*this).Flatten();
+}
+
+bool operator==(const ByteChain& lhs, const ByteChain& rhs) {
+  if (lhs.size() != rhs.size()) return false;
+  return lhs.Flatten() == rhs.Flatten();
+}
+
+}  // namespace nearby
+}  // namespace location
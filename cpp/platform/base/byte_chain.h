@@ -0,0 +1,133 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_BASE_BYTE_CHAIN_H_
+#define PLATFORM_BASE_BYTE_CHAIN_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "platform/base/byte_array.h"
+
+namespace location {
+namespace nearby {
+
+// Immutable view of a range of bytes in a reference-counted buffer.
+// Copying a ByteSlice or taking a sub-slice of it never copies the bytes; the
+// buffer is released when the last slice referring to it goes away.
+class ByteSlice {
+ public:
+  ByteSlice() = default;
+  ByteSlice(const ByteSlice&) = default;
+  ByteSlice& operator=(const ByteSlice&) = default;
+  ByteSlice(ByteSlice&&) = default;
+  ByteSlice& operator=(ByteSlice&&) = default;
+
+  // Takes ownership of the contents of |bytes| without copying them.
+  explicit ByteSlice(ByteArray&& bytes);
+
+  // Creates a slice holding a copy of |bytes|.
+  explicit ByteSlice(const ByteArray& bytes);
+  ByteSlice(const char* data, size_t size);
+
+  // Returns a slice of at most |length| bytes, starting at |offset|.
+  // The result is clamped to the bounds of this slice.
+  ByteSlice Subslice(size_t offset, size_t length) const;
+
+  const char* data() const { return size_ ? buffer_->data() + offset_ : ""; }
+  size_t size() const { return size_; }
+  bool Empty() const { return size_ == 0; }
+
+  absl::string_view AsStringView() const {
+    return absl::string_view(data(), size_);
+  }
+
+  // Returns a copy of the slice as ByteArray.
+  ByteArray ToByteArray() const&;
+
+  // Returns the slice as ByteArray. If this is the only reference to the
+  // underlying buffer and it spans the whole buffer, no copy is made.
+  ByteArray ToByteArray() &&;
+
+ private:
+  std::shared_ptr<ByteArray> buffer_;
+  size_t offset_ = 0;
+  size_t size_ = 0;
+};
+
+// Sequence of ByteSlice objects that reads as one contiguous byte string.
+// The bytes themselves are never modified; a chain only grows by appending
+// slices. Appending and sub-chaining copy slice handles, never bytes, so a
+// frame can be assembled from a header and a payload body without moving the
+// body around.
+//
+// So far, BasePipe keeps its chunks as slices, and payload chunks are sent
+// down to the endpoint channel as chains. Other paths still copy: encrypted
+// frames are gathered into one buffer to be encrypted (see FrameCipher), and
+// received frames and BLE packets are plain ByteArrays.
+class ByteChain {
+ public:
+  ByteChain() = default;
+  ByteChain(const ByteChain&) = default;
+  ByteChain& operator=(const ByteChain&) = default;
+  ByteChain(ByteChain&&) = default;
+  ByteChain& operator=(ByteChain&&) = default;
+
+  explicit ByteChain(ByteSlice slice) { Append(std::move(slice)); }
+  explicit ByteChain(ByteArray&& bytes)
+      : ByteChain(ByteSlice(std::move(bytes))) {}
+
+  // Adds |slice| (or every slice of |chain|) to the end of this chain.
+  void Append(ByteSlice slice);
+  void Append(const ByteChain& chain);
+
+  // Returns a chain of at most |length| bytes, starting at |offset|.
+  ByteChain Subchain(size_t offset, size_t length) const;
+
+  size_t size() const { return size_; }
+  bool Empty() const { return size_ == 0; }
+  const std::vector<ByteSlice>& slices() const { return slices_; }
+
+  // Returns views of all slices, in order; suitable for
+  // OutputStream::WriteV(). Views are valid while the chain is alive.
+  std::vector<absl::string_view> AsStringViews() const;
+
+  // Copies up to buffer.size() bytes into |buffer|; returns the number of
+  // bytes copied.
+  size_t CopyTo(absl::Span<char> buffer) const;
+
+  // Returns the contents as a single contiguous ByteArray. A chain made of a
+  // single, exclusively owned slice is converted without copying.
+  ByteArray Flatten() const&;
+  ByteArray Flatten() &&;
+
+  friend bool operator==(const ByteChain& lhs, const ByteChain& rhs);
+  friend bool operator!=(const ByteChain& lhs, const ByteChain& rhs) {
+    return !(lhs == rhs);
+  }
+
+ private:
+  std::vector<ByteSlice> slices_;
+  size_t size_ = 0;
+};
+
+}  // namespace nearby
+}  // namespace location
+
+#endif  // PLATFORM_BASE_BYTE_CHAIN_H_
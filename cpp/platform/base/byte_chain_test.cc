@@ -0,0 +1,121 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/base/byte_chain.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "absl/types/span.h"
+
+namespace {
+
+using location::nearby::ByteArray;
+using location::nearby::ByteChain;
+using location::nearby::ByteSlice;
+
+TEST(ByteSliceTest, DefaultIsEmpty) {
+  ByteSlice slice;
+  EXPECT_TRUE(slice.Empty());
+  EXPECT_EQ(0, slice.size());
+  EXPECT_EQ("", slice.AsStringView());
+}
+
+TEST(ByteSliceTest, AdoptsByteArrayWithoutCopy) {
+  // Long enough to not fit in a small string buffer.
+  const std::string text(1024, 'x');
+  ByteArray bytes(text);
+  const char* data = bytes.data();
+  ByteSlice slice(std::move(bytes));
+  EXPECT_EQ(data, slice.data());
+  EXPECT_EQ(text, slice.AsStringView());
+}
+
+TEST(ByteSliceTest, SubsliceSharesBuffer) {
+  ByteSlice slice(ByteArray(std::string("0123456789")));
+  ByteSlice sub = slice.Subslice(2, 5);
+  EXPECT_EQ(slice.data() + 2, sub.data());
+  EXPECT_EQ("23456", sub.AsStringView());
+  EXPECT_EQ("45", sub.Subslice(2, 2).AsStringView());
+}
+
+TEST(ByteSliceTest, SubsliceIsClamped) {
+  ByteSlice slice(ByteArray(std::string("0123456789")));
+  EXPECT_EQ("789", slice.Subslice(7, 100).AsStringView());
+  EXPECT_TRUE(slice.Subslice(10, 1).Empty());
+  EXPECT_TRUE(slice.Subslice(20, 1).Empty());
+}
+
+TEST(ByteSliceTest, ReleasesUniqueBufferWithoutCopy) {
+  const std::string text(1024, 'x');
+  ByteSlice slice{ByteArray(text)};
+  const char* data = slice.data();
+  ByteArray bytes = std::move(slice).ToByteArray();
+  EXPECT_EQ(data, bytes.data());
+  EXPECT_EQ(ByteArray(text), bytes);
+}
+
+TEST(ByteSliceTest, CopiesSharedBuffer) {
+  ByteSlice slice(ByteArray(std::string("0123456789")));
+  ByteSlice other = slice;
+  ByteArray bytes = std::move(slice).ToByteArray();
+  EXPECT_NE(other.data(), bytes.data());
+  EXPECT_EQ("0123456789", other.AsStringView());
+  EXPECT_EQ(ByteArray(std::string("0123456789")), bytes);
+}
+
+TEST(ByteChainTest, AppendConcatenatesSlices) {
+  ByteChain chain(ByteArray(std::string("012")));
+  chain.Append(ByteSlice());
+  chain.Append(ByteSlice(ByteArray(std::string("3456"))));
+  ByteChain tail(ByteArray(std::string("789")));
+  chain.Append(tail);
+
+  EXPECT_EQ(10, chain.size());
+  EXPECT_EQ(3, chain.slices().size());
+  EXPECT_EQ(ByteArray(std::string("0123456789")), chain.Flatten());
+}
+
+TEST(ByteChainTest, SubchainSpansSlices) {
+  ByteChain chain(ByteArray(std::string("012")));
+  chain.Append(ByteSlice(ByteArray(std::string("3456"))));
+  chain.Append(ByteSlice(ByteArray(std::string("789"))));
+
+  ByteChain sub = chain.Subchain(2, 6);
+  EXPECT_EQ(6, sub.size());
+  EXPECT_EQ(3, sub.slices().size());
+  EXPECT_EQ(ByteArray(std::string("234567")), sub.Flatten());
+  EXPECT_EQ(ByteArray(std::string("789")), chain.Subchain(7, 10).Flatten());
+  EXPECT_TRUE(chain.Subchain(10, 1).Empty());
+}
+
+TEST(ByteChainTest, CopyToStopsAtBufferEnd) {
+  ByteChain chain(ByteArray(std::string("012")));
+  chain.Append(ByteSlice(ByteArray(std::string("3456"))));
+
+  char buffer[5];
+  EXPECT_EQ(5, chain.CopyTo(absl::MakeSpan(buffer)));
+  EXPECT_EQ("01234", std::string(buffer, 5));
+}
+
+TEST(ByteChainTest, EqualityIgnoresSliceBoundaries) {
+  ByteChain lhs(ByteArray(std::string("0123")));
+  ByteChain rhs(ByteArray(std::string("01")));
+  rhs.Append(ByteSlice(ByteArray(std::string("23"))));
+  EXPECT_EQ(lhs, rhs);
+  rhs.Append(ByteSlice(ByteArray(std::string("4"))));
+  EXPECT_NE(lhs, rhs);
+}
+
+}  // namespace
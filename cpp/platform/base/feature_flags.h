@@ -42,6 +42,61 @@ class FeatureFlags {
     absl::Duration bwu_retry_exp_backoff_maximum_delay = absl::Seconds(300);
     // Support sending file and stream payloads starting from a non-zero offset.
     bool enable_send_payload_offset = true;
+    // Queue the frames addressed to several endpoints per endpoint, so that
+    // each endpoint is written at its own pace, rather than one endpoint after
+    // another.
+    bool enable_parallel_fan_out_writes = true;
+    // Capacity in bytes of the pipe behind an incoming stream payload. If
+    // non-zero, the pipe is bounded and receiving blocks while the app is
+    // behind on reading; 0 keeps the pipe unbounded.
+    std::int32_t incoming_stream_pipe_capacity = 0;
+    // How long receiving waits for the app to make room in a bounded incoming
+    // stream pipe before the stream payload fails. Receiving blocks the reader
+    // thread of the endpoint, which reads no other frame meanwhile, so this
+    // must stay well below the keep-alive timeout.
+    absl::Duration incoming_stream_pipe_write_timeout = absl::Seconds(10);
+    // Run the KeepAlive workers of all endpoints on a small shared thread
+    // pool. If false, every endpoint gets a dedicated keep-alive thread
+    // instead. Reads always use a dedicated thread per endpoint.
+    bool enable_shared_keep_alive_executor = true;
+    // Number of file payload chunks read ahead of the one being sent, so that
+    // disk reads overlap with network writes. 0 disables read-ahead.
+    std::int32_t file_payload_read_ahead_chunks = 2;
+    // Interleave the chunks of outgoing bytes and file payloads to different
+    // endpoints, and of different types, rather than sending the payloads of
+    // each type one after another. Payloads of one type to the same endpoint
+    // are sent in order either way.
+    bool enable_interleaved_payload_sends = true;
+    // Minimum time, and minimum number of bytes, between two in-progress
+    // payload updates to the client; updates in between are merged. Either
+    // may be 0. With both at 0, every chunk is still reported, and updates are
+    // only merged while the client is behind. Terminal updates are always
+    // delivered right away.
+    std::int32_t payload_progress_interval_millis = 0;
+    std::int64_t payload_progress_interval_bytes = 0;
+    // Race the connects to an endpoint over its discovered mediums, rather
+    // than trying the mediums one after another. A new attempt starts every
+    // connection_race_stagger_millis, or as soon as all attempts in flight
+    // have failed. After the first success, more preferred attempts still in
+    // flight get up to connection_race_grace_millis to succeed as well. Losing
+    // attempts are stopped through their CancellationFlag, so this works best
+    // together with enable_cancellation_flag.
+    bool enable_connection_racing = false;
+    std::int32_t connection_race_stagger_millis = 250;
+    std::int32_t connection_race_grace_millis = 100;
+    // Set up connections on a pool of connection workers, so that connecting
+    // to, or reading the connection request of, one endpoint doesn't hold up
+    // other endpoints or the PCP handler thread. If false, all of it runs on
+    // the PCP handler thread.
+    bool enable_parallel_connection_setup = true;
+    // Drop discovery re-sightings whose advertisement is unchanged since the
+    // last one processed for the same peer, unless that one was processed at
+    // least discovery_cache_refresh_millis ago. 0 processes every sighting.
+    std::int32_t discovery_cache_refresh_millis = 10000;
+    // How long the endpoints found by discovery can still be connected to
+    // after the last client stopped discovering. They are then all dropped at
+    // once.
+    std::int32_t discovered_endpoints_expiry_millis = 30000;
   };
 
   static const FeatureFlags& GetInstance() {
@@ -17,6 +17,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 #include "platform/base/byte_array.h"
 #include "platform/base/exception.h"
@@ -27,6 +28,17 @@ namespace {
 constexpr size_t kSkipBufferSize = 64 * 1024;
 }  // namespace
 
+ExceptionOr<size_t> InputStream::ReadInto(absl::Span<char> buffer) {
+  ExceptionOr<ByteArray> result = Read(buffer.size());
+  if (!result.ok()) {
+    return result.GetException();
+  }
+  const ByteArray& bytes = result.result();
+  size_t size = std::min(bytes.size(), buffer.size());
+  memcpy(buffer.data(), bytes.data(), size);
+  return ExceptionOr<size_t>(size);
+}
+
 ExceptionOr<size_t> InputStream::Skip(size_t offset) {
   size_t bytes_left = offset;
   while (bytes_left > 0) {
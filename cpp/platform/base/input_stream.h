@@ -17,6 +17,7 @@
 
 #include <cstdint>
 
+#include "absl/types/span.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/exception.h"
 
@@ -33,6 +34,13 @@ class InputStream {
   // throws Exception::kIo
   virtual ExceptionOr<ByteArray> Read(std::int64_t size) = 0;
 
+  // Reads at most buffer.size() bytes straight into |buffer|, and returns the
+  // number of bytes read; 0 means end of stream.
+  // The default implementation copies the result of Read(). Streams that can
+  // fill caller-provided memory directly should override this.
+  // throws Exception::kIo
+  virtual ExceptionOr<size_t> ReadInto(absl::Span<char> buffer);
+
   // throws Exception::kIo
   virtual ExceptionOr<size_t> Skip(size_t offset);
 
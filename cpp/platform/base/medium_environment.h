@@ -18,6 +18,7 @@
 #include <atomic>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/node_hash_map.h"
 #include "absl/strings/string_view.h"
 #include "platform/api/bluetooth_adapter.h"
 #include "platform/api/bluetooth_classic.h"
@@ -307,7 +308,9 @@ class MediumEnvironment {
   // executor_ thread.
   absl::flat_hash_map<api::BluetoothAdapter*, api::BluetoothDevice*>
       bluetooth_adapters_;
-  absl::flat_hash_map<api::BluetoothClassicMedium*, BluetoothMediumContext>
+  // Node-based, since queued discovery notifications refer to a context while
+  // other mediums may be registered.
+  absl::node_hash_map<api::BluetoothClassicMedium*, BluetoothMediumContext>
       bluetooth_mediums_;
 
   absl::flat_hash_map<api::BleMedium*, BleMediumContext> ble_mediums_;
@@ -0,0 +1,52 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/base/output_stream.h"
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#include "platform/base/byte_array.h"
+#include "platform/base/exception.h"
+
+namespace location {
+namespace nearby {
+
+namespace {
+// Buffers up to this size are joined with their neighbours into one Write().
+constexpr size_t kMaxJoinedBufferSize = 4096;
+}  // namespace
+
+Exception OutputStream::WriteV(absl::Span<const absl::string_view> buffers) {
+  std::string joined;
+  for (const absl::string_view buffer : buffers) {
+    if (buffer.size() <= kMaxJoinedBufferSize) {
+      joined.append(buffer.data(), buffer.size());
+      continue;
+    }
+    if (!joined.empty()) {
+      Exception exception = Write(ByteArray(std::move(joined)));
+      if (exception.Raised()) return exception;
+      joined.clear();
+    }
+    Exception exception = Write(ByteArray(buffer.data(), buffer.size()));
+    if (exception.Raised()) return exception;
+  }
+  if (!joined.empty()) return Write(ByteArray(std::move(joined)));
+  return {Exception::kSuccess};
+}
+
+}  // namespace nearby
+}  // namespace location
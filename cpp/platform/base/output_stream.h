@@ -15,6 +15,8 @@
 #ifndef PLATFORM_BASE_OUTPUT_STREAM_H_
 #define PLATFORM_BASE_OUTPUT_STREAM_H_
 
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "platform/base/byte_array.h"
 #include "platform/base/exception.h"
 
@@ -29,6 +31,16 @@ class OutputStream {
   virtual ~OutputStream() = default;
 
   virtual Exception Write(const ByteArray& data) = 0;  // throws Exception::kIo
+
+  // Writes |buffers| back to back, as if they were a single buffer
+  // (scatter/gather write, like writev(2)).
+  // The default implementation joins consecutive small buffers, such as a
+  // length prefix and a frame header, into one Write() call, and writes
+  // large buffers on their own, so that every byte is copied only once.
+  // Streams that can hand several buffers to the transport at once should
+  // override this.
+  // throws Exception::kIo
+  virtual Exception WriteV(absl::Span<const absl::string_view> buffers);
   virtual Exception Flush() = 0;                       // throws Exception::kIo
   virtual Exception Close() = 0;                       // throws Exception::kIo
 };
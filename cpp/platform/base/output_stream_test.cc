@@ -0,0 +1,82 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/base/output_stream.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/strings/string_view.h"
+#include "platform/base/byte_array.h"
+#include "platform/base/exception.h"
+
+namespace location {
+namespace nearby {
+namespace {
+
+// Records every Write() call; fails the write at |fail_at|, if set.
+class RecordingOutputStream : public OutputStream {
+ public:
+  explicit RecordingOutputStream(int fail_at = -1) : fail_at_(fail_at) {}
+
+  Exception Write(const ByteArray& data) override {
+    if (static_cast<int>(writes_.size()) == fail_at_) {
+      return {Exception::kIo};
+    }
+    writes_.push_back(std::string(data));
+    return {Exception::kSuccess};
+  }
+  Exception Flush() override { return {Exception::kSuccess}; }
+  Exception Close() override { return {Exception::kSuccess}; }
+
+  const std::vector<std::string>& writes() const { return writes_; }
+
+ private:
+  const int fail_at_;
+  std::vector<std::string> writes_;
+};
+
+TEST(OutputStreamTest, WriteVJoinsSmallBuffers) {
+  RecordingOutputStream stream;
+  const absl::string_view buffers[] = {"AB", "", "CDE"};
+
+  EXPECT_TRUE(stream.WriteV(buffers).Ok());
+
+  EXPECT_EQ(stream.writes(), std::vector<std::string>{"ABCDE"});
+}
+
+TEST(OutputStreamTest, WriteVWritesLargeBuffersOnTheirOwn) {
+  RecordingOutputStream stream;
+  const std::string body(64 * 1024, 'x');
+  const absl::string_view buffers[] = {"AB", "CD", body, "EF"};
+
+  EXPECT_TRUE(stream.WriteV(buffers).Ok());
+
+  EXPECT_EQ(stream.writes(), (std::vector<std::string>{"ABCD", body, "EF"}));
+}
+
+TEST(OutputStreamTest, WriteVStopsAtFirstFailedWrite) {
+  RecordingOutputStream stream(/*fail_at=*/1);
+  const std::string body(64 * 1024, 'x');
+  const absl::string_view buffers[] = {"AB", body, "EF"};
+
+  EXPECT_TRUE(stream.WriteV(buffers).Raised(Exception::kIo));
+
+  EXPECT_EQ(stream.writes(), std::vector<std::string>{"AB"});
+}
+
+}  // namespace
+}  // namespace nearby
+}  // namespace location
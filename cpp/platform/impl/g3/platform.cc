@@ -49,7 +49,7 @@
 #include "platform/impl/g3/single_thread_executor.h"
 #include "platform/impl/g3/webrtc.h"
 #include "platform/impl/g3/wifi_lan.h"
-#include "platform/impl/shared/file.h"
+#include "platform/impl/shared/posix_file.h"
 
 namespace location {
 namespace nearby {
@@ -103,13 +103,13 @@ std::unique_ptr<AtomicBoolean> ImplementationPlatform::CreateAtomicBoolean(
 
 std::unique_ptr<InputFile> ImplementationPlatform::CreateInputFile(
     PayloadId payload_id, std::int64_t total_size) {
-  return absl::make_unique<shared::InputFile>(GetPayloadPath(payload_id),
-                                              total_size);
+  return absl::make_unique<posix::InputFile>(GetPayloadPath(payload_id),
+                                             total_size);
 }
 
 std::unique_ptr<OutputFile> ImplementationPlatform::CreateOutputFile(
     PayloadId payload_id) {
-  return absl::make_unique<shared::OutputFile>(GetPayloadPath(payload_id));
+  return absl::make_unique<posix::OutputFile>(GetPayloadPath(payload_id));
 }
 
 std::unique_ptr<LogMessage> ImplementationPlatform::CreateLogMessage(
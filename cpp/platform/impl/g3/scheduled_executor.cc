@@ -17,9 +17,12 @@
 #include <atomic>
 #include <memory>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/clock.h"
 #include "platform/api/cancelable.h"
 #include "platform/base/runnable.h"
+#include "platform/impl/shared/timer_wheel.h"
 
 namespace location {
 namespace nearby {
@@ -29,7 +32,13 @@ namespace {
 
 class ScheduledCancelable : public api::Cancelable {
  public:
+  void SetTimer(std::shared_ptr<api::Cancelable> timer) {
+    timer_ = std::move(timer);
+  }
+
   bool Cancel() override {
+    // Drop the task from the timer wheel, if it is still waiting there.
+    if (timer_) timer_->Cancel();
     Status expected = kNotRun;
     while (expected == kNotRun) {
       if (status_.compare_exchange_strong(expected, kCanceled)) {
@@ -55,22 +64,72 @@ class ScheduledCancelable : public api::Cancelable {
     kCanceled,
   };
   std::atomic<Status> status_ = kNotRun;
+  std::shared_ptr<api::Cancelable> timer_;
 };
 
+shared::TimerWheel& GetTimerWheel() {
+  static shared::TimerWheel* timer_wheel = new shared::TimerWheel();
+  return *timer_wheel;
+}
+
 }  // namespace
 
+// Hands due tasks over to the executor, for as long as it exists.
+class ScheduledExecutor::ExpiryTarget {
+ public:
+  explicit ExpiryTarget(SingleThreadExecutor* executor) : executor_(executor) {}
+
+  void Execute(Runnable&& runnable) {
+    absl::MutexLock lock(&mutex_);
+    if (executor_ != nullptr) executor_->Execute(std::move(runnable));
+  }
+
+  void Detach() {
+    absl::MutexLock lock(&mutex_);
+    executor_ = nullptr;
+  }
+
+ private:
+  absl::Mutex mutex_;
+  SingleThreadExecutor* executor_ ABSL_GUARDED_BY(mutex_);
+};
+
+ScheduledExecutor::ScheduledExecutor()
+    : expiry_target_(std::make_shared<ExpiryTarget>(&executor_)) {}
+
+ScheduledExecutor::~ScheduledExecutor() {
+  expiry_target_->Detach();
+  executor_.Shutdown();
+}
+
 std::shared_ptr<api::Cancelable> ScheduledExecutor::Schedule(
     Runnable&& runnable, absl::Duration delay) {
   auto scheduled_cancelable = std::make_shared<ScheduledCancelable>();
   if (executor_.InShutdown()) {
     return scheduled_cancelable;
   }
-  executor_.ScheduleAfter(
-      delay, [this, scheduled_cancelable, runnable(std::move(runnable))]() {
-        if (!executor_.InShutdown() && scheduled_cancelable->MarkExecuted()) {
-          runnable();
-        }
-      });
+  if (delay <= absl::ZeroDuration()) {
+    // Already due: skip the timer wheel, and its tick.
+    executor_.Execute([this, scheduled_cancelable,
+                       runnable = std::move(runnable)]() {
+      if (!executor_.InShutdown() && scheduled_cancelable->MarkExecuted()) {
+        runnable();
+      }
+    });
+    return scheduled_cancelable;
+  }
+  scheduled_cancelable->SetTimer(GetTimerWheel().Schedule(
+      [this, target = expiry_target_, scheduled_cancelable,
+       runnable = std::move(runnable)]() mutable {
+        target->Execute([this, scheduled_cancelable,
+                         runnable = std::move(runnable)]() {
+          if (!executor_.InShutdown() &&
+              scheduled_cancelable->MarkExecuted()) {
+            runnable();
+          }
+        });
+      },
+      delay));
   return scheduled_cancelable;
 }
 
@@ -31,10 +31,14 @@ namespace g3 {
 
 // An Executor that reuses a fixed number of threads operating off a shared
 // unbounded queue.
+//
+// Delayed tasks wait in a timer wheel that is shared by all
+// ScheduledExecutors, and are handed over to the executor's own thread once
+// they are due. Tasks without a delay go to that thread right away.
 class ScheduledExecutor final : public api::ScheduledExecutor {
  public:
-  ScheduledExecutor() = default;
-  ~ScheduledExecutor() override { executor_.Shutdown(); }
+  ScheduledExecutor();
+  ~ScheduledExecutor() override;
 
   void Execute(Runnable&& runnable) override {
     executor_.Execute(std::move(runnable));
@@ -44,7 +48,11 @@ class ScheduledExecutor final : public api::ScheduledExecutor {
   void Shutdown() override { executor_.Shutdown(); }
 
  private:
+  class ExpiryTarget;
+
   SingleThreadExecutor executor_;
+  // Shared with the pending timers, which may outlive this executor.
+  std::shared_ptr<ExpiryTarget> expiry_target_;
 };
 
 }  // namespace g3
@@ -15,17 +15,17 @@
 #ifndef PLATFORM_IMPL_G3_SINGLE_THREAD_EXECUTOR_H_
 #define PLATFORM_IMPL_G3_SINGLE_THREAD_EXECUTOR_H_
 
-#include "platform/impl/g3/multi_thread_executor.h"
+#include "platform/impl/shared/single_thread_executor.h"
 
 namespace location {
 namespace nearby {
 namespace g3 {
 
 // An Executor that uses a single worker thread operating off an unbounded
-// queue.
-class SingleThreadExecutor final : public MultiThreadExecutor {
+// queue. Posting tasks does not take a lock; see shared::SingleThreadExecutor.
+class SingleThreadExecutor final : public shared::SingleThreadExecutor {
  public:
-  SingleThreadExecutor() : MultiThreadExecutor(1) {}
+  SingleThreadExecutor() = default;
   ~SingleThreadExecutor() override = default;
 };
 
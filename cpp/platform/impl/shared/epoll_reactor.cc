@@ -0,0 +1,146 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/impl/shared/epoll_reactor.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+namespace location {
+namespace nearby {
+namespace posix {
+
+// Registration
+
+bool EpollReactor::Registration::WaitReadable(absl::Duration timeout) {
+  return Wait(&readable_, timeout);
+}
+
+bool EpollReactor::Registration::WaitWritable(absl::Duration timeout) {
+  return Wait(&writable_, timeout);
+}
+
+void EpollReactor::Registration::Cancel() {
+  absl::MutexLock lock(&mutex_);
+  cancelled_ = true;
+}
+
+bool EpollReactor::Registration::IsCancelled() const {
+  absl::MutexLock lock(&mutex_);
+  return cancelled_;
+}
+
+void EpollReactor::Registration::OnEvents(std::uint32_t events) {
+  absl::MutexLock lock(&mutex_);
+  // Errors and hang-ups wake up both sides; their next read or write reports
+  // what happened.
+  if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) readable_ = true;
+  if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) writable_ = true;
+}
+
+bool EpollReactor::Registration::Wait(bool* ready, absl::Duration timeout) {
+  absl::MutexLock lock(&mutex_);
+  auto ready_or_cancelled = [this, ready]() {
+    mutex_.AssertHeld();
+    return *ready || cancelled_;
+  };
+  mutex_.AwaitWithTimeout(absl::Condition(&ready_or_cancelled), timeout);
+  if (cancelled_ || !*ready) return false;
+  *ready = false;
+  return true;
+}
+
+// EpollReactor
+
+EpollReactor::EpollReactor()
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      wake_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = wake_fd_;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+  thread_ = std::thread([this]() { Loop(); });
+}
+
+EpollReactor::~EpollReactor() {
+  std::uint64_t value = 1;
+  while (write(wake_fd_, &value, sizeof(value)) < 0 && errno == EINTR) {
+  }
+  thread_.join();
+  {
+    absl::MutexLock lock(&mutex_);
+    for (auto& item : registrations_) {
+      item.second->Cancel();
+    }
+    registrations_.clear();
+  }
+  close(wake_fd_);
+  close(epoll_fd_);
+}
+
+std::shared_ptr<EpollReactor::Registration> EpollReactor::Register(int fd) {
+  auto registration = std::make_shared<Registration>();
+  absl::MutexLock lock(&mutex_);
+  epoll_event event{};
+  event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  event.data.fd = fd;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) return nullptr;
+  registrations_[fd] = registration;
+  return registration;
+}
+
+void EpollReactor::Unregister(int fd) {
+  std::shared_ptr<Registration> registration;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = registrations_.find(fd);
+    if (it == registrations_.end()) return;
+    registration = std::move(it->second);
+    registrations_.erase(it);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+  }
+  registration->Cancel();
+}
+
+void EpollReactor::Loop() {
+  epoll_event events[kMaxEvents];
+  while (true) {
+    int count = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    for (int i = 0; i < count; i++) {
+      if (events[i].data.fd == wake_fd_) return;
+      std::shared_ptr<Registration> registration;
+      {
+        // A descriptor may have been unregistered, and even reused, since
+        // epoll_wait() returned. The worst that can happen is a spurious
+        // wake-up, which waiters handle anyway.
+        absl::MutexLock lock(&mutex_);
+        auto it = registrations_.find(events[i].data.fd);
+        if (it == registrations_.end()) continue;
+        registration = it->second;
+      }
+      registration->OnEvents(events[i].events);
+    }
+  }
+}
+
+}  // namespace posix
+}  // namespace nearby
+}  // namespace location
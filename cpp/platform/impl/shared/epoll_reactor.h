@@ -0,0 +1,103 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_IMPL_SHARED_EPOLL_REACTOR_H_
+#define PLATFORM_IMPL_SHARED_EPOLL_REACTOR_H_
+
+#include <cstdint>
+#include <memory>
+#include <thread>  // NOLINT
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace location {
+namespace nearby {
+namespace posix {
+
+// Watches nonblocking file descriptors for I/O readiness with epoll, on a
+// single thread, so that blocking streams can be built on nonblocking sockets
+// without a thread per socket.
+//
+// Descriptors are watched edge-triggered. A thread whose read or write would
+// block waits on the descriptor's Registration until the reactor reports the
+// descriptor ready again, then retries.
+class EpollReactor {
+ public:
+  class Registration {
+   public:
+    // Blocks until the descriptor has been reported readable (or writable)
+    // since the previous wait, or |timeout| passes, or the registration is
+    // cancelled. Returns false on timeout or cancellation.
+    //
+    // Readiness is only a hint: the caller retries its read or write, and
+    // waits again if that would still block.
+    bool WaitReadable(absl::Duration timeout = absl::InfiniteDuration())
+        ABSL_LOCKS_EXCLUDED(mutex_);
+    bool WaitWritable(absl::Duration timeout = absl::InfiniteDuration())
+        ABSL_LOCKS_EXCLUDED(mutex_);
+
+    // Wakes up all current and future waiters.
+    void Cancel() ABSL_LOCKS_EXCLUDED(mutex_);
+    bool IsCancelled() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+   private:
+    friend class EpollReactor;
+
+    void OnEvents(std::uint32_t events) ABSL_LOCKS_EXCLUDED(mutex_);
+    bool Wait(bool* ready, absl::Duration timeout) ABSL_LOCKS_EXCLUDED(mutex_);
+
+    mutable absl::Mutex mutex_;
+    bool readable_ ABSL_GUARDED_BY(mutex_) = false;
+    bool writable_ ABSL_GUARDED_BY(mutex_) = false;
+    bool cancelled_ ABSL_GUARDED_BY(mutex_) = false;
+  };
+
+  EpollReactor();
+  ~EpollReactor();
+  EpollReactor(const EpollReactor&) = delete;
+  EpollReactor& operator=(const EpollReactor&) = delete;
+
+  // Starts watching |fd| for both reads and writes. Returns nullptr if the
+  // descriptor cannot be watched.
+  std::shared_ptr<Registration> Register(int fd) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Stops watching |fd|, and cancels its registration. Must be called before
+  // |fd| is closed.
+  void Unregister(int fd) ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  // Events handled per epoll_wait() call.
+  static constexpr int kMaxEvents = 64;
+
+  void Loop();
+
+  int epoll_fd_ = -1;
+  // Written to by the destructor to stop the loop.
+  int wake_fd_ = -1;
+
+  absl::Mutex mutex_;
+  absl::flat_hash_map<int, std::shared_ptr<Registration>> registrations_
+      ABSL_GUARDED_BY(mutex_);
+
+  std::thread thread_;
+};
+
+}  // namespace posix
+}  // namespace nearby
+}  // namespace location
+
+#endif  // PLATFORM_IMPL_SHARED_EPOLL_REACTOR_H_
@@ -0,0 +1,101 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/impl/shared/epoll_reactor.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+#include <thread>  // NOLINT
+
+#include "gtest/gtest.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+
+namespace location {
+namespace nearby {
+namespace posix {
+namespace {
+
+constexpr absl::Duration kTimeout = absl::Seconds(5);
+
+class EpollReactorTest : public ::testing::Test {
+ protected:
+  void SetUp() override { ASSERT_EQ(pipe2(fds_, O_NONBLOCK | O_CLOEXEC), 0); }
+
+  void TearDown() override {
+    reactor_.Unregister(fds_[0]);
+    reactor_.Unregister(fds_[1]);
+    close(fds_[0]);
+    close(fds_[1]);
+  }
+
+  int read_fd() const { return fds_[0]; }
+  int write_fd() const { return fds_[1]; }
+
+  EpollReactor reactor_;
+  int fds_[2] = {-1, -1};
+};
+
+TEST_F(EpollReactorTest, ReportsReadable) {
+  auto registration = reactor_.Register(read_fd());
+  ASSERT_NE(registration, nullptr);
+  absl::Notification woken_up;
+
+  std::thread waiter([&]() {
+    EXPECT_TRUE(registration->WaitReadable(kTimeout));
+    woken_up.Notify();
+  });
+  ASSERT_EQ(write(write_fd(), "x", 1), 1);
+
+  EXPECT_TRUE(woken_up.WaitForNotificationWithTimeout(kTimeout));
+  waiter.join();
+}
+
+TEST_F(EpollReactorTest, ReportsWritable) {
+  auto registration = reactor_.Register(write_fd());
+  ASSERT_NE(registration, nullptr);
+
+  // An empty pipe can be written to right away.
+  EXPECT_TRUE(registration->WaitWritable(kTimeout));
+}
+
+TEST_F(EpollReactorTest, WaitTimesOut) {
+  auto registration = reactor_.Register(read_fd());
+  ASSERT_NE(registration, nullptr);
+
+  EXPECT_FALSE(registration->WaitReadable(absl::Milliseconds(10)));
+}
+
+TEST_F(EpollReactorTest, UnregisterCancelsWaiters) {
+  auto registration = reactor_.Register(read_fd());
+  ASSERT_NE(registration, nullptr);
+  absl::Notification woken_up;
+
+  std::thread waiter([&]() {
+    EXPECT_FALSE(registration->WaitReadable());
+    woken_up.Notify();
+  });
+  reactor_.Unregister(read_fd());
+
+  EXPECT_TRUE(woken_up.WaitForNotificationWithTimeout(kTimeout));
+  waiter.join();
+  EXPECT_TRUE(registration->IsCancelled());
+}
+
+}  // namespace
+}  // namespace posix
+}  // namespace nearby
+}  // namespace location
@@ -15,7 +15,8 @@
 #include "platform/impl/shared/file.h"
 
 #include <cstddef>
-#include <memory>
+#include <string>
+#include <utility>
 
 #include "absl/strings/string_view.h"
 #include "platform/base/exception.h"
@@ -42,15 +43,16 @@ ExceptionOr<ByteArray> InputFile::Read(std::int64_t size) {
     return ExceptionOr<ByteArray>{Exception::kIo};
   }
 
-  ByteArray bytes(size);
-  std::unique_ptr<char[]> read_bytes{new char[size]};
-  file_.read(read_bytes.get(), static_cast<ptrdiff_t>(size));
+  // Read straight into the buffer that is handed out.
+  std::string bytes(static_cast<size_t>(size), '\0');
+  file_.read(&bytes[0], static_cast<ptrdiff_t>(size));
   auto num_bytes_read = file_.gcount();
   if (num_bytes_read == 0) {
     return ExceptionOr<ByteArray>{Exception::kIo};
   }
+  bytes.resize(num_bytes_read);
 
-  return ExceptionOr<ByteArray>(ByteArray(read_bytes.get(), num_bytes_read));
+  return ExceptionOr<ByteArray>(ByteArray(std::move(bytes)));
 }
 
 Exception InputFile::Close() {
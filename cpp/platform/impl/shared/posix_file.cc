@@ -0,0 +1,181 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/impl/shared/posix_file.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <utility>
+
+namespace location {
+namespace nearby {
+namespace posix {
+
+// InputFile
+
+InputFile::InputFile(const std::string& path, std::int64_t size)
+    : fd_(open(path.c_str(), O_RDONLY | O_CLOEXEC)),
+      path_(path),
+      total_size_(size) {
+#ifdef POSIX_FADV_SEQUENTIAL
+  if (fd_ >= 0) {
+    posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+#endif
+}
+
+InputFile::~InputFile() { Close(); }
+
+ExceptionOr<ByteArray> InputFile::Read(std::int64_t size) {
+  if (fd_ < 0 || size < 0) {
+    return ExceptionOr<ByteArray>{Exception::kIo};
+  }
+
+  // Don't allocate more than what is left of the file.
+  if (total_size_ > offset_ && size > total_size_ - offset_) {
+    size = total_size_ - offset_;
+  }
+
+  std::string bytes(static_cast<size_t>(size), '\0');
+  ExceptionOr<size_t> read_size =
+      ReadAtOffset(absl::MakeSpan(&bytes[0], bytes.size()));
+  if (!read_size.ok()) {
+    return ExceptionOr<ByteArray>{read_size.exception()};
+  }
+  bytes.resize(read_size.result());
+  return ExceptionOr<ByteArray>{ByteArray(std::move(bytes))};
+}
+
+ExceptionOr<size_t> InputFile::ReadInto(absl::Span<char> buffer) {
+  if (fd_ < 0) {
+    return ExceptionOr<size_t>{Exception::kIo};
+  }
+  return ReadAtOffset(buffer);
+}
+
+ExceptionOr<size_t> InputFile::Skip(size_t offset) {
+  if (fd_ < 0) {
+    return ExceptionOr<size_t>{Exception::kIo};
+  }
+  offset_ += offset;
+  return ExceptionOr<size_t>{offset};
+}
+
+Exception InputFile::Close() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  return {Exception::kSuccess};
+}
+
+ExceptionOr<size_t> InputFile::ReadAtOffset(absl::Span<char> buffer) {
+  size_t total_read = 0;
+  while (total_read < buffer.size()) {
+    ssize_t result = pread(fd_, buffer.data() + total_read,
+                           buffer.size() - total_read, offset_);
+    if (result < 0) {
+      if (errno == EINTR) continue;
+      return ExceptionOr<size_t>{Exception::kIo};
+    }
+    if (result == 0) break;  // End of file.
+    total_read += result;
+    offset_ += result;
+  }
+  return ExceptionOr<size_t>{total_read};
+}
+
+// OutputFile
+
+OutputFile::OutputFile(absl::string_view path)
+    : fd_(open(std::string(path).c_str(),
+               O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) {}
+
+OutputFile::OutputFile(absl::string_view path, std::int64_t offset)
+    : fd_(open(std::string(path).c_str(), O_WRONLY | O_CREAT | O_CLOEXEC,
+               0644)),
+      offset_(offset) {
+  if (fd_ >= 0 && (offset < 0 || ftruncate(fd_, offset) != 0)) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+OutputFile::~OutputFile() { Close(); }
+
+Exception OutputFile::Write(const ByteArray& data) {
+  if (fd_ < 0) {
+    return {Exception::kIo};
+  }
+
+  if (buffer_.size() + data.size() <= kBufferSize) {
+    if (buffer_.capacity() < kBufferSize) buffer_.reserve(kBufferSize);
+    buffer_.append(data.data(), data.size());
+    return {Exception::kSuccess};
+  }
+
+  // The buffer would overflow; drain it, and write large chunks directly
+  // rather than copying them into the buffer first.
+  Exception flush_exception = Flush();
+  if (flush_exception.Raised()) {
+    return flush_exception;
+  }
+  if (data.size() >= kBufferSize) {
+    return WriteAtOffset(absl::string_view(data.data(), data.size()));
+  }
+  buffer_.append(data.data(), data.size());
+  return {Exception::kSuccess};
+}
+
+Exception OutputFile::Flush() {
+  if (fd_ < 0) {
+    return {Exception::kIo};
+  }
+  Exception write_exception = WriteAtOffset(buffer_);
+  buffer_.clear();
+  return write_exception;
+}
+
+Exception OutputFile::Close() {
+  if (fd_ < 0) {
+    return {Exception::kSuccess};
+  }
+  Exception flush_exception = Flush();
+  bool synced = fsync(fd_) == 0;
+  bool closed = close(fd_) == 0;
+  fd_ = -1;
+  if (flush_exception.Raised()) {
+    return flush_exception;
+  }
+  return {synced && closed ? Exception::kSuccess : Exception::kIo};
+}
+
+Exception OutputFile::WriteAtOffset(absl::string_view data) {
+  while (!data.empty()) {
+    ssize_t result = pwrite(fd_, data.data(), data.size(), offset_);
+    if (result < 0) {
+      if (errno == EINTR) continue;
+      return {Exception::kIo};
+    }
+    data.remove_prefix(result);
+    offset_ += result;
+  }
+  return {Exception::kSuccess};
+}
+
+}  // namespace posix
+}  // namespace nearby
+}  // namespace location
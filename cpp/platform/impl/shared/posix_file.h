@@ -0,0 +1,96 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_IMPL_SHARED_POSIX_FILE_H_
+#define PLATFORM_IMPL_SHARED_POSIX_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "platform/api/input_file.h"
+#include "platform/api/output_file.h"
+#include "platform/base/byte_array.h"
+#include "platform/base/exception.h"
+
+namespace location {
+namespace nearby {
+namespace posix {
+
+// InputFile backed by a file descriptor. Reads are positional (pread), go
+// straight into the returned buffer, and the kernel is told to expect
+// sequential access. Skip() moves the read position without reading.
+class InputFile final : public api::InputFile {
+ public:
+  InputFile(const std::string& path, std::int64_t size);
+  ~InputFile() override;
+  InputFile(const InputFile&) = delete;
+  InputFile& operator=(const InputFile&) = delete;
+
+  ExceptionOr<ByteArray> Read(std::int64_t size) override;
+  ExceptionOr<size_t> ReadInto(absl::Span<char> buffer) override;
+  ExceptionOr<size_t> Skip(size_t offset) override;
+  std::string GetFilePath() const override { return path_; }
+  std::int64_t GetTotalSize() const override { return total_size_; }
+  Exception Close() override;
+
+ private:
+  // Reads up to buffer.size() bytes at offset_; returns 0 at end of file.
+  ExceptionOr<size_t> ReadAtOffset(absl::Span<char> buffer);
+
+  int fd_ = -1;
+  std::string path_;
+  std::int64_t total_size_;
+  std::int64_t offset_ = 0;
+};
+
+// OutputFile backed by a file descriptor. Small writes are collected in a
+// buffer and written out with pwrite() once it fills up; large writes bypass
+// the buffer. Flush() hands buffered data to the kernel, and Close() also
+// syncs the file to storage, once per file rather than once per chunk.
+class OutputFile final : public api::OutputFile {
+ public:
+  static constexpr size_t kBufferSize = 1024 * 1024;  // 1 MB
+
+  // Truncates the file at |path|, or creates it.
+  explicit OutputFile(absl::string_view path);
+  // Resumes writing a partially written file at |offset|: keeps its first
+  // |offset| bytes, drops any bytes after them, and writes from there. The
+  // file is created if it does not exist. Platform::CreateOutputFile() does
+  // not use this yet, so file payloads are still received from the start.
+  OutputFile(absl::string_view path, std::int64_t offset);
+  ~OutputFile() override;
+  OutputFile(const OutputFile&) = delete;
+  OutputFile& operator=(const OutputFile&) = delete;
+
+  Exception Write(const ByteArray& data) override;
+  Exception Flush() override;
+  Exception Close() override;
+
+ private:
+  // Writes all of |data| at offset_, and advances offset_.
+  Exception WriteAtOffset(absl::string_view data);
+
+  int fd_ = -1;
+  std::string buffer_;
+  std::int64_t offset_ = 0;
+};
+
+}  // namespace posix
+}  // namespace nearby
+}  // namespace location
+
+#endif  // PLATFORM_IMPL_SHARED_POSIX_FILE_H_
@@ -0,0 +1,174 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/impl/shared/posix_file.h"
+
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+#include "file/util/temp_path.h"
+#include "gtest/gtest.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "platform/base/byte_array.h"
+
+namespace location {
+namespace nearby {
+namespace posix {
+
+class PosixFileTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    temp_path_ = std::make_unique<TempPath>(TempPath::Local);
+    path_ = temp_path_->path() + "/file.txt";
+    std::ofstream output_file(path_);
+  }
+
+  void WriteToFile(absl::string_view text) {
+    std::ofstream file(path_, std::ofstream::app);
+    file << text;
+    size_ += text.size();
+  }
+
+  std::string ReadFile() {
+    std::ifstream file(path_);
+    return std::string(std::istreambuf_iterator<char>(file),
+                       std::istreambuf_iterator<char>());
+  }
+
+  size_t GetSize() const { return size_; }
+
+  void AssertEquals(const ExceptionOr<ByteArray>& bytes,
+                    const std::string& expected) {
+    EXPECT_TRUE(bytes.ok());
+    EXPECT_EQ(std::string(bytes.result()), expected);
+  }
+
+  void AssertEmpty(const ExceptionOr<ByteArray>& bytes) {
+    EXPECT_TRUE(bytes.ok());
+    EXPECT_TRUE(bytes.result().Empty());
+  }
+
+  static constexpr int64_t kMaxSize = 3;
+
+  std::unique_ptr<TempPath> temp_path_;
+  std::string path_;
+  size_t size_ = 0;
+};
+
+TEST_F(PosixFileTest, InputFile_NonExistentPath) {
+  InputFile input_file("/not/a/valid/path.txt", GetSize());
+  ExceptionOr<ByteArray> read_result = input_file.Read(kMaxSize);
+  EXPECT_FALSE(read_result.ok());
+  EXPECT_TRUE(read_result.GetException().Raised(Exception::kIo));
+}
+
+TEST_F(PosixFileTest, InputFile_EmptyFileEOF) {
+  InputFile input_file(path_, GetSize());
+  AssertEmpty(input_file.Read(kMaxSize));
+}
+
+TEST_F(PosixFileTest, InputFile_ReadWithSize) {
+  WriteToFile("abc");
+  InputFile input_file(path_, GetSize());
+  AssertEquals(input_file.Read(2), "ab");
+  AssertEquals(input_file.Read(kMaxSize), "c");
+  AssertEmpty(input_file.Read(kMaxSize));
+}
+
+TEST_F(PosixFileTest, InputFile_ReadInto) {
+  WriteToFile("abcde");
+  InputFile input_file(path_, GetSize());
+  char buffer[3];
+  ExceptionOr<size_t> read_size = input_file.ReadInto(absl::MakeSpan(buffer));
+  ASSERT_TRUE(read_size.ok());
+  EXPECT_EQ(std::string(buffer, read_size.result()), "abc");
+  read_size = input_file.ReadInto(absl::MakeSpan(buffer));
+  ASSERT_TRUE(read_size.ok());
+  EXPECT_EQ(std::string(buffer, read_size.result()), "de");
+}
+
+TEST_F(PosixFileTest, InputFile_SkipMovesReadPosition) {
+  WriteToFile("0123456789");
+  InputFile input_file(path_, GetSize());
+  ExceptionOr<size_t> skipped = input_file.Skip(4);
+  ASSERT_TRUE(skipped.ok());
+  EXPECT_EQ(skipped.result(), 4);
+  AssertEquals(input_file.Read(kMaxSize), "456");
+  AssertEquals(input_file.Read(100), "789");
+  AssertEmpty(input_file.Read(kMaxSize));
+}
+
+TEST_F(PosixFileTest, InputFile_Close) {
+  WriteToFile("abc");
+  InputFile input_file(path_, GetSize());
+  input_file.Close();
+  ExceptionOr<ByteArray> read_result = input_file.Read(kMaxSize);
+  EXPECT_FALSE(read_result.ok());
+  EXPECT_TRUE(read_result.GetException().Raised(Exception::kIo));
+}
+
+TEST_F(PosixFileTest, OutputFile_NonExistentPath) {
+  OutputFile output_file("/not/a/valid/path.txt");
+  ByteArray bytes("a", 1);
+  EXPECT_TRUE(output_file.Write(bytes).Raised(Exception::kIo));
+}
+
+TEST_F(PosixFileTest, OutputFile_WriteIsBufferedUntilFlush) {
+  OutputFile output_file(path_);
+  EXPECT_EQ(output_file.Write(ByteArray("a")), Exception{Exception::kSuccess});
+  EXPECT_EQ(output_file.Write(ByteArray("bc")), Exception{Exception::kSuccess});
+  EXPECT_EQ(ReadFile(), "");
+  EXPECT_EQ(output_file.Flush(), Exception{Exception::kSuccess});
+  EXPECT_EQ(ReadFile(), "abc");
+}
+
+TEST_F(PosixFileTest, OutputFile_LargeWritesKeepOrder) {
+  OutputFile output_file(path_);
+  std::string large(OutputFile::kBufferSize + 1, 'x');
+  EXPECT_EQ(output_file.Write(ByteArray("a")), Exception{Exception::kSuccess});
+  EXPECT_EQ(output_file.Write(ByteArray(large)),
+            Exception{Exception::kSuccess});
+  EXPECT_EQ(output_file.Write(ByteArray("b")), Exception{Exception::kSuccess});
+  EXPECT_EQ(output_file.Close(), Exception{Exception::kSuccess});
+  EXPECT_EQ(ReadFile(), "a" + large + "b");
+}
+
+TEST_F(PosixFileTest, OutputFile_ResumesAtOffset) {
+  WriteToFile("abcdef");
+  OutputFile output_file(path_, 3);
+  EXPECT_EQ(output_file.Write(ByteArray("xy")), Exception{Exception::kSuccess});
+  EXPECT_EQ(output_file.Close(), Exception{Exception::kSuccess});
+  EXPECT_EQ(ReadFile(), "abcxy");
+}
+
+TEST_F(PosixFileTest, OutputFile_NegativeOffset) {
+  OutputFile output_file(path_, -1);
+  EXPECT_TRUE(output_file.Write(ByteArray("a")).Raised(Exception::kIo));
+}
+
+TEST_F(PosixFileTest, OutputFile_Close) {
+  OutputFile output_file(path_);
+  EXPECT_EQ(output_file.Write(ByteArray("abc")),
+            Exception{Exception::kSuccess});
+  output_file.Close();
+  EXPECT_EQ(ReadFile(), "abc");
+  EXPECT_EQ(output_file.Write(ByteArray("a")), Exception{Exception::kIo});
+}
+
+}  // namespace posix
+}  // namespace nearby
+}  // namespace location
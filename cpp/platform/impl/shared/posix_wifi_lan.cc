@@ -0,0 +1,398 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/impl/shared/posix_wifi_lan.h"
+
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <limits.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include "absl/memory/memory.h"
+
+namespace location {
+namespace nearby {
+namespace posix {
+
+namespace {
+
+void ConfigureSocket(int fd) {
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  int buffer_size = WifiLanMedium::kSocketBufferSize;
+  setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+}
+
+std::string ToIpAddress(const in_addr& address) {
+  std::string ip_address(sizeof(address.s_addr), '\0');
+  std::memcpy(&ip_address[0], &address.s_addr, sizeof(address.s_addr));
+  return ip_address;
+}
+
+// Returns the first non-loopback IPv4 address of the host, or the loopback
+// address if there is none.
+std::string GetLocalIpAddress() {
+  in_addr address{htonl(INADDR_LOOPBACK)};
+  ifaddrs* interfaces = nullptr;
+  if (getifaddrs(&interfaces) == 0) {
+    for (ifaddrs* item = interfaces; item != nullptr; item = item->ifa_next) {
+      if (item->ifa_addr == nullptr || item->ifa_addr->sa_family != AF_INET ||
+          !(item->ifa_flags & IFF_UP) || (item->ifa_flags & IFF_LOOPBACK)) {
+        continue;
+      }
+      address = reinterpret_cast<sockaddr_in*>(item->ifa_addr)->sin_addr;
+      break;
+    }
+    freeifaddrs(interfaces);
+  }
+  return ToIpAddress(address);
+}
+
+}  // namespace
+
+// WifiLanService
+
+WifiLanService::WifiLanService(const std::string& ip_address, int port) {
+  nsd_service_info_.SetServiceAddress(ip_address, port);
+}
+
+// WifiLanSocket
+
+WifiLanSocket::WifiLanSocket(
+    std::shared_ptr<EpollReactor> reactor, int fd,
+    std::shared_ptr<EpollReactor::Registration> registration,
+    WifiLanService remote_service)
+    : reactor_(std::move(reactor)),
+      fd_(fd),
+      registration_(std::move(registration)),
+      remote_service_(std::move(remote_service)) {}
+
+WifiLanSocket::~WifiLanSocket() {
+  Close();
+  reactor_->Unregister(fd_);
+  close(fd_);
+}
+
+Exception WifiLanSocket::Close() {
+  if (closed_.exchange(true)) return {Exception::kSuccess};
+  shutdown(fd_, SHUT_RDWR);
+  registration_->Cancel();
+  return {Exception::kSuccess};
+}
+
+ExceptionOr<ByteArray> WifiLanSocket::SocketInputStream::Read(
+    std::int64_t size) {
+  if (size < 0) {
+    return ExceptionOr<ByteArray>{Exception::kIo};
+  }
+  std::string bytes(static_cast<size_t>(size), '\0');
+  ExceptionOr<size_t> read_size =
+      socket_->Receive(absl::MakeSpan(&bytes[0], bytes.size()));
+  if (!read_size.ok()) {
+    return ExceptionOr<ByteArray>{read_size.exception()};
+  }
+  bytes.resize(read_size.result());
+  return ExceptionOr<ByteArray>{ByteArray(std::move(bytes))};
+}
+
+Exception WifiLanSocket::SocketOutputStream::Write(const ByteArray& data) {
+  const absl::string_view buffer(data.data(), data.size());
+  return socket_->Send(absl::MakeConstSpan(&buffer, 1));
+}
+
+ExceptionOr<size_t> WifiLanSocket::Receive(absl::Span<char> buffer) {
+  if (buffer.empty()) return ExceptionOr<size_t>{0};
+  while (!closed_) {
+    ssize_t result = recv(fd_, buffer.data(), buffer.size(), 0);
+    // Once closed locally, the shutdown reads as end of stream; report it as
+    // an error instead.
+    if (result >= 0 && closed_) break;
+    if (result >= 0) return ExceptionOr<size_t>{static_cast<size_t>(result)};
+    if (errno == EINTR) continue;
+    if (errno != EAGAIN && errno != EWOULDBLOCK) break;
+    if (!registration_->WaitReadable()) break;
+  }
+  return ExceptionOr<size_t>{Exception::kIo};
+}
+
+Exception WifiLanSocket::Send(absl::Span<const absl::string_view> buffers) {
+  std::vector<iovec> iovecs;
+  iovecs.reserve(buffers.size());
+  for (const absl::string_view buffer : buffers) {
+    if (buffer.empty()) continue;
+    iovecs.push_back({const_cast<char*>(buffer.data()), buffer.size()});
+  }
+
+  size_t next = 0;
+  while (next < iovecs.size()) {
+    if (closed_) return {Exception::kIo};
+    msghdr message{};
+    message.msg_iov = &iovecs[next];
+    message.msg_iovlen =
+        std::min<size_t>(iovecs.size() - next, static_cast<size_t>(IOV_MAX));
+    ssize_t result = sendmsg(fd_, &message, MSG_NOSIGNAL);
+    if (result < 0) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) return {Exception::kIo};
+      if (!registration_->WaitWritable()) return {Exception::kIo};
+      continue;
+    }
+    // Skip what was sent; the kernel may have taken only part of a slice.
+    size_t sent = static_cast<size_t>(result);
+    while (next < iovecs.size() && sent >= iovecs[next].iov_len) {
+      sent -= iovecs[next].iov_len;
+      next++;
+    }
+    if (sent > 0) {
+      iovecs[next].iov_base = static_cast<char*>(iovecs[next].iov_base) + sent;
+      iovecs[next].iov_len -= sent;
+    }
+  }
+  return {Exception::kSuccess};
+}
+
+// WifiLanMedium
+
+constexpr absl::Duration WifiLanMedium::kConnectTimeout;
+constexpr absl::Duration WifiLanMedium::kCancellationCheckInterval;
+
+WifiLanMedium::WifiLanMedium() : reactor_(std::make_shared<EpollReactor>()) {}
+
+WifiLanMedium::~WifiLanMedium() {
+  absl::flat_hash_map<std::string, std::unique_ptr<ServerSocket>> servers;
+  {
+    absl::MutexLock lock(&mutex_);
+    servers.swap(server_sockets_);
+  }
+  for (auto& item : servers) {
+    CloseServerSocket(std::move(item.second));
+  }
+}
+
+bool WifiLanMedium::StartAdvertising(const std::string& service_id,
+                                     const NsdServiceInfo& nsd_service_info) {
+  return false;
+}
+
+bool WifiLanMedium::StopAdvertising(const std::string& service_id) {
+  return false;
+}
+
+bool WifiLanMedium::StartDiscovery(const std::string& service_id,
+                                   DiscoveredServiceCallback callback) {
+  return false;
+}
+
+bool WifiLanMedium::StopDiscovery(const std::string& service_id) {
+  return false;
+}
+
+bool WifiLanMedium::StartAcceptingConnections(
+    const std::string& service_id, AcceptedConnectionCallback callback) {
+  {
+    absl::MutexLock lock(&mutex_);
+    if (server_sockets_.contains(service_id)) return false;
+  }
+
+  auto server = absl::make_unique<ServerSocket>();
+  server->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (server->fd < 0) return false;
+  int one = 1;
+  setsockopt(server->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  // Accepted sockets inherit the buffer sizes, which have to be set before
+  // the connection is established to take effect.
+  ConfigureSocket(server->fd);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = 0;
+  socklen_t address_size = sizeof(address);
+  if (bind(server->fd, reinterpret_cast<sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      listen(server->fd, kListenBacklog) != 0 ||
+      getsockname(server->fd, reinterpret_cast<sockaddr*>(&address),
+                  &address_size) != 0) {
+    close(server->fd);
+    return false;
+  }
+  server->port = ntohs(address.sin_port);
+  server->registration = reactor_->Register(server->fd);
+  if (server->registration == nullptr) {
+    close(server->fd);
+    return false;
+  }
+  server->callback = std::move(callback);
+  ServerSocket* server_ptr = server.get();
+  server->accept_thread = std::thread(
+      [this, service_id, server_ptr]() { AcceptLoop(service_id, server_ptr); });
+
+  {
+    absl::MutexLock lock(&mutex_);
+    if (!server_sockets_.contains(service_id)) {
+      server_sockets_.emplace(service_id, std::move(server));
+      return true;
+    }
+  }
+  // Lost a race with another StartAcceptingConnections() call.
+  CloseServerSocket(std::move(server));
+  return false;
+}
+
+bool WifiLanMedium::StopAcceptingConnections(const std::string& service_id) {
+  std::unique_ptr<ServerSocket> server;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = server_sockets_.find(service_id);
+    if (it == server_sockets_.end()) return false;
+    server = std::move(it->second);
+    server_sockets_.erase(it);
+  }
+  CloseServerSocket(std::move(server));
+  return true;
+}
+
+std::unique_ptr<api::WifiLanSocket> WifiLanMedium::Connect(
+    api::WifiLanService& remote_wifi_lan_service, const std::string& service_id,
+    CancellationFlag* cancellation_flag) {
+  if (cancellation_flag != nullptr && cancellation_flag->Cancelled()) {
+    return nullptr;
+  }
+  std::pair<std::string, int> service_address =
+      remote_wifi_lan_service.GetServiceInfo().GetServiceAddress();
+  sockaddr_in address{};
+  if (service_address.first.size() != sizeof(address.sin_addr.s_addr)) {
+    return nullptr;
+  }
+  address.sin_family = AF_INET;
+  std::memcpy(&address.sin_addr.s_addr, service_address.first.data(),
+              sizeof(address.sin_addr.s_addr));
+  address.sin_port = htons(service_address.second);
+
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) return nullptr;
+  ConfigureSocket(fd);
+  int result =
+      connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+  if (result != 0 && errno != EINPROGRESS) {
+    close(fd);
+    return nullptr;
+  }
+  // Registered only now: an unconnected socket reports itself writable.
+  std::shared_ptr<EpollReactor::Registration> registration =
+      reactor_->Register(fd);
+  if (registration == nullptr) {
+    close(fd);
+    return nullptr;
+  }
+
+  bool connected = result == 0;
+  absl::Time deadline = absl::Now() + kConnectTimeout;
+  while (!connected) {
+    if ((cancellation_flag != nullptr && cancellation_flag->Cancelled()) ||
+        absl::Now() > deadline) {
+      break;
+    }
+    if (registration->WaitWritable(kCancellationCheckInterval)) {
+      int error = 0;
+      socklen_t error_size = sizeof(error);
+      connected =
+          getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_size) == 0 &&
+          error == 0;
+      break;
+    }
+  }
+  if (!connected) {
+    reactor_->Unregister(fd);
+    close(fd);
+    return nullptr;
+  }
+
+  return absl::make_unique<WifiLanSocket>(
+      reactor_, fd, std::move(registration),
+      WifiLanService(service_address.first, service_address.second));
+}
+
+api::WifiLanService* WifiLanMedium::GetRemoteService(
+    const std::string& ip_address, int port) {
+  absl::MutexLock lock(&mutex_);
+  auto& service = remote_services_[std::make_pair(ip_address, port)];
+  if (service == nullptr) {
+    service = absl::make_unique<WifiLanService>(ip_address, port);
+  }
+  return service.get();
+}
+
+std::pair<std::string, int> WifiLanMedium::GetServiceAddress(
+    const std::string& service_id) {
+  int port;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = server_sockets_.find(service_id);
+    if (it == server_sockets_.end()) return {};
+    port = it->second->port;
+  }
+  return std::make_pair(GetLocalIpAddress(), port);
+}
+
+void WifiLanMedium::AcceptLoop(const std::string& service_id,
+                               ServerSocket* server) {
+  while (true) {
+    sockaddr_in address{};
+    socklen_t address_size = sizeof(address);
+    int fd = accept4(server->fd, reinterpret_cast<sockaddr*>(&address),
+                     &address_size, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) return;
+      if (!server->registration->WaitReadable()) return;
+      continue;
+    }
+
+    ConfigureSocket(fd);
+    std::shared_ptr<EpollReactor::Registration> registration =
+        reactor_->Register(fd);
+    if (registration == nullptr) {
+      close(fd);
+      continue;
+    }
+    auto socket = absl::make_unique<WifiLanSocket>(
+        reactor_, fd, std::move(registration),
+        WifiLanService(ToIpAddress(address.sin_addr), ntohs(address.sin_port)));
+    if (server->registration->IsCancelled()) return;
+    // The callback takes ownership of the socket.
+    server->callback.accepted_cb(*socket.release(), service_id);
+  }
+}
+
+void WifiLanMedium::CloseServerSocket(std::unique_ptr<ServerSocket> server) {
+  server->registration->Cancel();
+  if (server->accept_thread.joinable()) server->accept_thread.join();
+  reactor_->Unregister(server->fd);
+  close(server->fd);
+}
+
+}  // namespace posix
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,209 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_IMPL_SHARED_POSIX_WIFI_LAN_H_
+#define PLATFORM_IMPL_SHARED_POSIX_WIFI_LAN_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "platform/api/wifi_lan.h"
+#include "platform/base/byte_array.h"
+#include "platform/base/cancellation_flag.h"
+#include "platform/base/exception.h"
+#include "platform/base/input_stream.h"
+#include "platform/base/nsd_service_info.h"
+#include "platform/base/output_stream.h"
+#include "platform/impl/shared/epoll_reactor.h"
+
+namespace location {
+namespace nearby {
+namespace posix {
+
+// A WifiLan service at a known IPv4 address and TCP port. The address is
+// kept the way NsdServiceInfo does, as 4 bytes in network order.
+class WifiLanService : public api::WifiLanService {
+ public:
+  WifiLanService(const std::string& ip_address, int port);
+  ~WifiLanService() override = default;
+
+  NsdServiceInfo GetServiceInfo() const override { return nsd_service_info_; }
+
+ private:
+  NsdServiceInfo nsd_service_info_;
+};
+
+// A connected, nonblocking TCP socket. Reads and writes block the calling
+// thread on the socket's EpollReactor registration when the socket is not
+// ready, and writes gather all slices into a single sendmsg() call.
+class WifiLanSocket : public api::WifiLanSocket {
+ public:
+  // Takes ownership of |fd|, which is connected and registered with
+  // |reactor| as |registration|.
+  WifiLanSocket(std::shared_ptr<EpollReactor> reactor, int fd,
+                std::shared_ptr<EpollReactor::Registration> registration,
+                WifiLanService remote_service);
+  ~WifiLanSocket() override;
+  WifiLanSocket(const WifiLanSocket&) = delete;
+  WifiLanSocket& operator=(const WifiLanSocket&) = delete;
+
+  InputStream& GetInputStream() override { return input_stream_; }
+  OutputStream& GetOutputStream() override { return output_stream_; }
+
+  // Shuts the connection down, and wakes up blocked reads and writes. The
+  // descriptor itself is closed by the destructor.
+  Exception Close() override;
+
+  WifiLanService* GetRemoteWifiLanService() override {
+    return &remote_service_;
+  }
+
+ private:
+  class SocketInputStream : public InputStream {
+   public:
+    explicit SocketInputStream(WifiLanSocket* socket) : socket_(socket) {}
+
+    ExceptionOr<ByteArray> Read(std::int64_t size) override;
+    ExceptionOr<size_t> ReadInto(absl::Span<char> buffer) override {
+      return socket_->Receive(buffer);
+    }
+    Exception Close() override { return socket_->Close(); }
+
+   private:
+    WifiLanSocket* socket_;
+  };
+
+  class SocketOutputStream : public OutputStream {
+   public:
+    explicit SocketOutputStream(WifiLanSocket* socket) : socket_(socket) {}
+
+    Exception Write(const ByteArray& data) override;
+    Exception WriteV(absl::Span<const absl::string_view> buffers) override {
+      return socket_->Send(buffers);
+    }
+    Exception Flush() override { return {Exception::kSuccess}; }
+    Exception Close() override { return socket_->Close(); }
+
+   private:
+    WifiLanSocket* socket_;
+  };
+
+  // Reads at most buffer.size() bytes; returns 0 at end of stream.
+  ExceptionOr<size_t> Receive(absl::Span<char> buffer);
+  // Writes all of |buffers|.
+  Exception Send(absl::Span<const absl::string_view> buffers);
+
+  std::shared_ptr<EpollReactor> reactor_;
+  const int fd_;
+  std::shared_ptr<EpollReactor::Registration> registration_;
+  WifiLanService remote_service_;
+  std::atomic_bool closed_ = false;
+  SocketInputStream input_stream_{this};
+  SocketOutputStream output_stream_{this};
+};
+
+// WifiLan medium on TCP/IPv4 sockets, for Linux.
+//
+// Each service that accepts connections gets its own listening socket on an
+// ephemeral port, and an accept loop; GetServiceAddress() reports that port
+// with the first non-loopback IPv4 address of the host, or 127.0.0.1 if
+// there is none. Sockets are nonblocking, and all their I/O readiness is
+// tracked by a single EpollReactor thread.
+//
+// Service discovery (mDNS) is not implemented: advertising and discovery
+// fail, and peers find each other through GetServiceAddress() and
+// GetRemoteService(), as bandwidth upgrades do.
+class WifiLanMedium : public api::WifiLanMedium {
+ public:
+  // Socket send and receive buffer size. Large buffers keep a fast link busy
+  // while the writer is encrypting the next frame.
+  static constexpr int kSocketBufferSize = 1024 * 1024;  // 1 MB
+
+  WifiLanMedium();
+  ~WifiLanMedium() override;
+
+  bool StartAdvertising(const std::string& service_id,
+                        const NsdServiceInfo& nsd_service_info) override;
+  bool StopAdvertising(const std::string& service_id) override;
+  bool StartDiscovery(const std::string& service_id,
+                      DiscoveredServiceCallback callback) override;
+  bool StopDiscovery(const std::string& service_id) override;
+
+  bool StartAcceptingConnections(const std::string& service_id,
+                                 AcceptedConnectionCallback callback) override
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  bool StopAcceptingConnections(const std::string& service_id) override
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Connects to |remote_wifi_lan_service|'s address; gives up after
+  // kConnectTimeout, or once |cancellation_flag| is cancelled.
+  std::unique_ptr<api::WifiLanSocket> Connect(
+      api::WifiLanService& remote_wifi_lan_service,
+      const std::string& service_id,
+      CancellationFlag* cancellation_flag) override;
+
+  api::WifiLanService* GetRemoteService(const std::string& ip_address,
+                                        int port) override
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  std::pair<std::string, int> GetServiceAddress(
+      const std::string& service_id) override ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  static constexpr int kListenBacklog = 16;
+  static constexpr absl::Duration kConnectTimeout = absl::Seconds(10);
+  // How often a pending Connect() checks its cancellation flag.
+  static constexpr absl::Duration kCancellationCheckInterval =
+      absl::Milliseconds(100);
+
+  struct ServerSocket {
+    int fd = -1;
+    int port = 0;
+    std::shared_ptr<EpollReactor::Registration> registration;
+    AcceptedConnectionCallback callback;
+    std::thread accept_thread;
+  };
+
+  // Accepts connections on |server| until its registration is cancelled.
+  void AcceptLoop(const std::string& service_id, ServerSocket* server);
+  // Stops |server|'s accept loop and closes it.
+  void CloseServerSocket(std::unique_ptr<ServerSocket> server);
+
+  std::shared_ptr<EpollReactor> reactor_;
+
+  absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, std::unique_ptr<ServerSocket>>
+      server_sockets_ ABSL_GUARDED_BY(mutex_);
+  // Services returned by GetRemoteService(), which callers do not own.
+  absl::flat_hash_map<std::pair<std::string, int>,
+                      std::unique_ptr<WifiLanService>>
+      remote_services_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace posix
+}  // namespace nearby
+}  // namespace location
+
+#endif  // PLATFORM_IMPL_SHARED_POSIX_WIFI_LAN_H_
@@ -0,0 +1,173 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/impl/shared/posix_wifi_lan.h"
+
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "platform/base/byte_array.h"
+#include "platform/base/cancellation_flag.h"
+
+namespace location {
+namespace nearby {
+namespace posix {
+namespace {
+
+constexpr char kServiceId[] = "service";
+constexpr absl::Duration kTimeout = absl::Seconds(5);
+
+class PosixWifiLanTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(server_medium_.StartAcceptingConnections(
+        kServiceId,
+        {.accepted_cb = [this](api::WifiLanSocket& socket,
+                               const std::string& service_id) {
+          server_socket_.reset(&socket);
+          accepted_.Notify();
+        }}));
+  }
+
+  // Connects a client socket to the server, and waits for the server side.
+  std::unique_ptr<api::WifiLanSocket> Connect() {
+    std::pair<std::string, int> address =
+        server_medium_.GetServiceAddress(kServiceId);
+    api::WifiLanService* service =
+        client_medium_.GetRemoteService(address.first, address.second);
+    CancellationFlag flag;
+    auto socket = client_medium_.Connect(*service, kServiceId, &flag);
+    EXPECT_TRUE(accepted_.WaitForNotificationWithTimeout(kTimeout));
+    return socket;
+  }
+
+  WifiLanMedium server_medium_;
+  WifiLanMedium client_medium_;
+  absl::Notification accepted_;
+  std::unique_ptr<api::WifiLanSocket> server_socket_;
+};
+
+TEST_F(PosixWifiLanTest, ServiceAddressHasPort) {
+  std::pair<std::string, int> address =
+      server_medium_.GetServiceAddress(kServiceId);
+
+  EXPECT_EQ(address.first.size(), 4);
+  EXPECT_GT(address.second, 0);
+  EXPECT_TRUE(server_medium_.GetServiceAddress("other").first.empty());
+}
+
+TEST_F(PosixWifiLanTest, CanNotAcceptTwiceForSameService) {
+  EXPECT_FALSE(server_medium_.StartAcceptingConnections(kServiceId, {}));
+  EXPECT_TRUE(server_medium_.StopAcceptingConnections(kServiceId));
+  EXPECT_FALSE(server_medium_.StopAcceptingConnections(kServiceId));
+}
+
+TEST_F(PosixWifiLanTest, ExchangesData) {
+  auto client_socket = Connect();
+  ASSERT_NE(client_socket, nullptr);
+  ASSERT_NE(server_socket_, nullptr);
+
+  EXPECT_TRUE(
+      client_socket->GetOutputStream().Write(ByteArray{"request"}).Ok());
+  ExceptionOr<ByteArray> request =
+      server_socket_->GetInputStream().Read(1024);
+  ASSERT_TRUE(request.ok());
+  EXPECT_EQ(std::string(request.result()), "request");
+
+  const absl::string_view response[] = {"re", "spo", "nse"};
+  EXPECT_TRUE(server_socket_->GetOutputStream().WriteV(response).Ok());
+  char buffer[1024];
+  ExceptionOr<size_t> response_size =
+      client_socket->GetInputStream().ReadInto(absl::MakeSpan(buffer));
+  ASSERT_TRUE(response_size.ok());
+  EXPECT_EQ(absl::string_view(buffer, response_size.result()), "response");
+}
+
+TEST_F(PosixWifiLanTest, WritesMoreThanSocketBuffers) {
+  auto client_socket = Connect();
+  ASSERT_NE(client_socket, nullptr);
+  ASSERT_NE(server_socket_, nullptr);
+  std::string data(8 * WifiLanMedium::kSocketBufferSize, 'x');
+  for (size_t i = 0; i < data.size(); i += 4096) data[i] = 'a' + i % 26;
+
+  // The writer blocks until the reader catches up.
+  std::thread writer([&]() {
+    const absl::string_view slices[] = {
+        absl::string_view(data).substr(0, 1000),
+        absl::string_view(data).substr(1000)};
+    EXPECT_TRUE(client_socket->GetOutputStream().WriteV(slices).Ok());
+  });
+  std::string received;
+  while (received.size() < data.size()) {
+    ExceptionOr<ByteArray> read =
+        server_socket_->GetInputStream().Read(64 * 1024);
+    ASSERT_TRUE(read.ok());
+    ASSERT_FALSE(read.result().Empty());
+    received += std::string(read.result());
+  }
+  writer.join();
+
+  EXPECT_EQ(received, data);
+}
+
+TEST_F(PosixWifiLanTest, ReadReturnsEmptyOnceRemoteCloses) {
+  auto client_socket = Connect();
+  ASSERT_NE(client_socket, nullptr);
+  ASSERT_NE(server_socket_, nullptr);
+
+  client_socket->Close();
+
+  ExceptionOr<ByteArray> read = server_socket_->GetInputStream().Read(1024);
+  ASSERT_TRUE(read.ok());
+  EXPECT_TRUE(read.result().Empty());
+}
+
+TEST_F(PosixWifiLanTest, CloseUnblocksRead) {
+  auto client_socket = Connect();
+  ASSERT_NE(client_socket, nullptr);
+  absl::Notification read_done;
+
+  std::thread reader([&]() {
+    EXPECT_FALSE(client_socket->GetInputStream().Read(1024).ok());
+    read_done.Notify();
+  });
+  absl::SleepFor(absl::Milliseconds(10));
+  client_socket->Close();
+
+  EXPECT_TRUE(read_done.WaitForNotificationWithTimeout(kTimeout));
+  reader.join();
+  EXPECT_FALSE(client_socket->GetOutputStream().Write(ByteArray{"x"}).Ok());
+}
+
+TEST_F(PosixWifiLanTest, ConnectFailsOnceServerStops) {
+  std::pair<std::string, int> address =
+      server_medium_.GetServiceAddress(kServiceId);
+  api::WifiLanService* service =
+      client_medium_.GetRemoteService(address.first, address.second);
+  server_medium_.StopAcceptingConnections(kServiceId);
+  CancellationFlag flag;
+
+  EXPECT_EQ(client_medium_.Connect(*service, kServiceId, &flag), nullptr);
+}
+
+}  // namespace
+}  // namespace posix
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,106 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/impl/shared/single_thread_executor.h"
+
+#include <utility>
+
+namespace location {
+namespace nearby {
+namespace shared {
+
+SingleThreadExecutor::SingleThreadExecutor()
+    : head_(new Node()), tail_(head_.load()), thread_([this]() { Loop(); }) {}
+
+SingleThreadExecutor::~SingleThreadExecutor() {
+  shutdown_ = true;
+  stopped_ = true;
+  {
+    absl::MutexLock lock(&park_mutex_);
+    park_cond_.Signal();
+  }
+  thread_.join();
+  // Free whatever raced with shutdown and was never run.
+  Runnable runnable;
+  while (Pop(&runnable)) {
+  }
+  delete tail_;
+}
+
+bool SingleThreadExecutor::Push(Runnable&& runnable) {
+  if (shutdown_) return false;
+
+  Node* node = new Node();
+  node->runnable = std::move(runnable);
+  Node* prev = head_.exchange(node);
+  // Until this store, the worker can not see |node| (or anything pushed
+  // after it) yet; it keeps checking until it can.
+  prev->next.store(node, std::memory_order_release);
+
+  if (parked_) {
+    absl::MutexLock lock(&park_mutex_);
+    park_cond_.Signal();
+  }
+  return true;
+}
+
+bool SingleThreadExecutor::Pop(Runnable* runnable) {
+  Node* tail = tail_;
+  Node* next = tail->next.load(std::memory_order_acquire);
+  if (next == nullptr) return false;
+  *runnable = std::move(next->runnable);
+  next->runnable = nullptr;
+  tail_ = next;
+  delete tail;
+  return true;
+}
+
+bool SingleThreadExecutor::IsEmpty() const { return head_.load() == tail_; }
+
+void SingleThreadExecutor::Loop() {
+  Runnable runnable;
+  int idle_spins = 0;
+  while (true) {
+    if (Pop(&runnable)) {
+      runnable();
+      runnable = nullptr;
+      idle_spins = 0;
+      continue;
+    }
+    if (!IsEmpty()) {
+      // A producer is in the middle of pushing.
+      std::this_thread::yield();
+      continue;
+    }
+    if (stopped_) return;
+    if (++idle_spins < kSpinCount) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    // A producer either sees |parked_| set, and signals us under the lock, or
+    // pushed before we set it, in which case the queue is not empty below.
+    absl::MutexLock lock(&park_mutex_);
+    parked_ = true;
+    while (IsEmpty() && !stopped_) {
+      park_cond_.Wait(&park_mutex_);
+    }
+    parked_ = false;
+    idle_spins = 0;
+  }
+}
+
+}  // namespace shared
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,96 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_IMPL_SHARED_SINGLE_THREAD_EXECUTOR_H_
+#define PLATFORM_IMPL_SHARED_SINGLE_THREAD_EXECUTOR_H_
+
+#include <atomic>
+#include <thread>  // NOLINT
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "platform/api/submittable_executor.h"
+#include "platform/base/runnable.h"
+
+namespace location {
+namespace nearby {
+namespace shared {
+
+// An Executor that uses a single worker thread operating off an unbounded
+// queue.
+//
+// The queue is a lock-free multi-producer, single-consumer linked list, so
+// posting a task from any thread is an allocation and an atomic exchange; no
+// lock is taken unless the worker is parked. When it runs out of tasks, the
+// worker spins for a little while before it parks on a condition variable,
+// so bursts of tasks do not pay for a wake-up each.
+//
+// Tasks run in the order they were posted. After Shutdown(), new tasks are
+// dropped; tasks posted before that still run, and the destructor waits for
+// them.
+class SingleThreadExecutor : public api::SubmittableExecutor {
+ public:
+  SingleThreadExecutor();
+  ~SingleThreadExecutor() override;
+  SingleThreadExecutor(const SingleThreadExecutor&) = delete;
+  SingleThreadExecutor& operator=(const SingleThreadExecutor&) = delete;
+
+  void Execute(Runnable&& runnable) override { Push(std::move(runnable)); }
+  bool DoSubmit(Runnable&& runnable) override {
+    return Push(std::move(runnable));
+  }
+  void Shutdown() override { shutdown_ = true; }
+  bool InShutdown() const { return shutdown_; }
+
+ private:
+  struct Node {
+    std::atomic<Node*> next{nullptr};
+    Runnable runnable;
+  };
+
+  // Number of times the worker checks for new tasks before parking.
+  static constexpr int kSpinCount = 128;
+
+  // Called by any thread. Returns false if the task was dropped.
+  bool Push(Runnable&& runnable);
+  // Called by the worker only. Returns false if there is no task to take,
+  // or if the next task is not completely pushed yet.
+  bool Pop(Runnable* runnable);
+  // Called by the worker only.
+  bool IsEmpty() const;
+  void Loop();
+
+  std::atomic_bool shutdown_ = false;
+  // Set by the destructor; the worker exits once the queue is empty.
+  std::atomic_bool stopped_ = false;
+
+  // The most recently pushed node. Producers swap themselves in here.
+  std::atomic<Node*> head_;
+  // The last node taken by the worker; its |next| is the next task to run.
+  // Owned by the worker.
+  Node* tail_;
+
+  // Set while the worker is parked, or about to be.
+  std::atomic_bool parked_ = false;
+  absl::Mutex park_mutex_;
+  absl::CondVar park_cond_;
+
+  std::thread thread_;
+};
+
+}  // namespace shared
+}  // namespace nearby
+}  // namespace location
+
+#endif  // PLATFORM_IMPL_SHARED_SINGLE_THREAD_EXECUTOR_H_
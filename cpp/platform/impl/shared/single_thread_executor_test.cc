@@ -0,0 +1,104 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/impl/shared/single_thread_executor.h"
+
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace location {
+namespace nearby {
+namespace shared {
+namespace {
+
+TEST(SharedSingleThreadExecutorTest, RunsTasksInOrder) {
+  std::vector<int> order;
+  {
+    SingleThreadExecutor executor;
+    for (int i = 0; i < 100; ++i) {
+      executor.Execute([&order, i]() { order.push_back(i); });
+    }
+    // The destructor waits for all tasks.
+  }
+  ASSERT_EQ(order.size(), 100);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+TEST(SharedSingleThreadExecutorTest, RunsTasksFromManyThreads) {
+  constexpr int kThreads = 8;
+  constexpr int kTasksPerThread = 10000;
+  // Only ever touched by the executor thread.
+  int count = 0;
+  std::vector<int> last_seen(kThreads, -1);
+  bool in_order = true;
+  {
+    SingleThreadExecutor executor;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < kThreads; ++t) {
+      producers.emplace_back([&, t]() {
+        for (int i = 0; i < kTasksPerThread; ++i) {
+          executor.Execute([&, t, i]() {
+            ++count;
+            if (last_seen[t] != i - 1) in_order = false;
+            last_seen[t] = i;
+          });
+        }
+      });
+    }
+    for (auto& producer : producers) producer.join();
+  }
+  EXPECT_EQ(count, kThreads * kTasksPerThread);
+  EXPECT_TRUE(in_order);
+}
+
+TEST(SharedSingleThreadExecutorTest, WakesUpAfterParking) {
+  SingleThreadExecutor executor;
+  absl::Mutex mutex;
+  bool done = false;
+
+  // Long enough for the worker to stop spinning and park.
+  absl::SleepFor(absl::Milliseconds(100));
+  executor.Execute([&]() {
+    absl::MutexLock lock(&mutex);
+    done = true;
+  });
+
+  absl::MutexLock lock(&mutex);
+  EXPECT_TRUE(
+      mutex.AwaitWithTimeout(absl::Condition(&done), absl::Seconds(5)));
+}
+
+TEST(SharedSingleThreadExecutorTest, DropsTasksAfterShutdown) {
+  bool ran = false;
+  {
+    SingleThreadExecutor executor;
+    executor.Shutdown();
+    EXPECT_TRUE(executor.InShutdown());
+    EXPECT_FALSE(executor.DoSubmit([&ran]() { ran = true; }));
+    executor.Execute([&ran]() { ran = true; });
+  }
+  EXPECT_FALSE(ran);
+}
+
+}  // namespace
+}  // namespace shared
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,214 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/impl/shared/timer_wheel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <utility>
+
+#include "absl/time/clock.h"
+
+namespace location {
+namespace nearby {
+namespace shared {
+
+class TimerWheel::Timer final : public api::Cancelable {
+ public:
+  Timer(std::uint64_t expiry_tick, Runnable&& runnable)
+      : expiry_tick_(expiry_tick), runnable_(std::move(runnable)) {}
+
+  // Frees the task right away; the timer itself stays in its slot until the
+  // slot comes up.
+  bool Cancel() override {
+    if (!Transition(kCanceled)) return false;
+    runnable_ = nullptr;
+    return true;
+  }
+
+  bool IsCanceled() const { return state_ == kCanceled; }
+
+  // Runs the task, unless it was canceled, and frees it.
+  void Run() {
+    if (!Transition(kExecuted)) return;
+    Runnable runnable = std::move(runnable_);
+    runnable_ = nullptr;
+    runnable();
+  }
+
+  std::uint64_t expiry_tick() const { return expiry_tick_; }
+
+ private:
+  enum State {
+    kPending,
+    kExecuted,
+    kCanceled,
+  };
+
+  bool Transition(State state) {
+    State expected = kPending;
+    return state_.compare_exchange_strong(expected, state);
+  }
+
+  const std::uint64_t expiry_tick_;
+  Runnable runnable_;
+  std::atomic<State> state_ = kPending;
+};
+
+TimerWheel::TimerWheel(absl::Duration tick)
+    : tick_(tick), start_(absl::Now()), thread_([this]() { Loop(); }) {}
+
+TimerWheel::~TimerWheel() {
+  {
+    absl::MutexLock lock(&mutex_);
+    shutdown_ = true;
+    cond_.Signal();
+  }
+  thread_.join();
+}
+
+std::shared_ptr<api::Cancelable> TimerWheel::Schedule(Runnable&& runnable,
+                                                      absl::Duration delay) {
+  absl::Time expiry_time = absl::Now() + std::max(delay, absl::ZeroDuration());
+  // Round up, so that the timer does not fire before |delay| has passed.
+  auto timer = std::make_shared<Timer>(
+      absl::Ceil(expiry_time - start_, tick_) / tick_, std::move(runnable));
+
+  absl::MutexLock lock(&mutex_);
+  if (shutdown_) return timer;
+  InsertLocked(timer);
+  ++pending_;
+  // Only wake the timer thread up if it would otherwise sleep past the new
+  // timer.
+  if (timer->expiry_tick() < wake_tick_) cond_.Signal();
+  return timer;
+}
+
+size_t TimerWheel::PendingCount() const {
+  absl::MutexLock lock(&mutex_);
+  return pending_;
+}
+
+std::uint64_t TimerWheel::TicksSinceStart(absl::Time time) const {
+  return (time - start_) / tick_;
+}
+
+void TimerWheel::InsertLocked(std::shared_ptr<Timer> timer) {
+  std::uint64_t expiry_tick = timer->expiry_tick();
+  if (expiry_tick < next_tick_) {
+    // Already due; collect it with the next tick.
+    wheel_[0][next_tick_ & kSlotMask].push_back(std::move(timer));
+    return;
+  }
+  std::uint64_t delay_ticks = expiry_tick - next_tick_;
+  if (delay_ticks >= kMaxDelayTicks) {
+    // Parked in the last slot in range; when that slot is cascaded, the timer
+    // is re-inserted using its real expiry tick.
+    expiry_tick = next_tick_ + kMaxDelayTicks - 1;
+    delay_ticks = kMaxDelayTicks - 1;
+  }
+  int level = 0;
+  while (delay_ticks >= (std::uint64_t{1} << (kSlotBits * (level + 1)))) {
+    ++level;
+  }
+  wheel_[level][(expiry_tick >> (kSlotBits * level)) & kSlotMask].push_back(
+      std::move(timer));
+}
+
+void TimerWheel::AdvanceLocked(std::uint64_t now_tick, Slot* expired) {
+  if (pending_ == 0) {
+    // Nothing to collect; just catch up with the clock.
+    next_tick_ = std::max(next_tick_, now_tick + 1);
+    return;
+  }
+  while (next_tick_ <= now_tick) {
+    int index = next_tick_ & kSlotMask;
+    // Every time a level wraps around, the timers in the next slot of the
+    // level above are due within one turn of this level.
+    if (index == 0) {
+      for (int level = 1; level < kLevels; ++level) {
+        if (CascadeLocked(level) != 0) break;
+      }
+    }
+    ++next_tick_;
+    Slot& slot = wheel_[0][index];
+    pending_ -= slot.size();
+    for (auto& timer : slot) {
+      if (!timer->IsCanceled()) expired->push_back(std::move(timer));
+    }
+    slot.clear();
+    if (pending_ == 0) {
+      next_tick_ = std::max(next_tick_, now_tick + 1);
+      return;
+    }
+  }
+}
+
+int TimerWheel::CascadeLocked(int level) {
+  int index = (next_tick_ >> (kSlotBits * level)) & kSlotMask;
+  Slot slot;
+  std::swap(slot, wheel_[level][index]);
+  for (auto& timer : slot) {
+    if (timer->IsCanceled()) {
+      --pending_;
+    } else {
+      InsertLocked(std::move(timer));
+    }
+  }
+  return index;
+}
+
+std::uint64_t TimerWheel::NextWakeTickLocked() const {
+  if (pending_ == 0) return std::numeric_limits<std::uint64_t>::max();
+  // Higher levels are only looked at when level 0 wraps around, so that is
+  // the latest the timer thread may sleep until.
+  std::uint64_t wrap_tick = (next_tick_ | kSlotMask) + 1;
+  if ((next_tick_ & kSlotMask) == 0) return next_tick_;
+  for (std::uint64_t tick = next_tick_; tick < wrap_tick; ++tick) {
+    if (!wheel_[0][tick & kSlotMask].empty()) return tick;
+  }
+  return wrap_tick;
+}
+
+void TimerWheel::Loop() {
+  while (true) {
+    Slot expired;
+    {
+      absl::MutexLock lock(&mutex_);
+      while (!shutdown_) {
+        AdvanceLocked(TicksSinceStart(absl::Now()), &expired);
+        if (!expired.empty()) break;
+        wake_tick_ = NextWakeTickLocked();
+        if (wake_tick_ == std::numeric_limits<std::uint64_t>::max()) {
+          cond_.Wait(&mutex_);
+        } else {
+          cond_.WaitWithDeadline(
+              &mutex_, start_ + tick_ * static_cast<std::int64_t>(wake_tick_));
+        }
+        wake_tick_ = 0;
+      }
+      if (shutdown_) return;
+    }
+    // Run the whole batch outside of the lock, so that the tasks may schedule
+    // new timers.
+    for (auto& timer : expired) {
+      timer->Run();
+    }
+  }
+}
+
+}  // namespace shared
+}  // namespace nearby
+}  // namespace location
@@ -0,0 +1,116 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PLATFORM_IMPL_SHARED_TIMER_WHEEL_H_
+#define PLATFORM_IMPL_SHARED_TIMER_WHEEL_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "platform/api/cancelable.h"
+#include "platform/base/runnable.h"
+
+namespace location {
+namespace nearby {
+namespace shared {
+
+// Runs tasks after a delay, on a single timer thread.
+//
+// Pending timers are kept in a hierarchical timing wheel: kLevels levels of
+// kSlots slots each, where a slot of level N covers kSlots^N ticks. Scheduling
+// appends the timer to the slot of its expiry time, and canceling only flips
+// the timer's state and frees its task, so both are O(1) regardless of how
+// many timers are pending. A canceled timer is dropped when its slot comes
+// up. Once per tick with pending timers, the timer thread collects every timer
+// due in that tick and runs all of them in one batch, outside of the wheel's
+// lock.
+//
+// Timers never fire early; they fire up to one tick late. Tasks run on the
+// timer thread and must be short, e.g. hand the real work off to an executor.
+class TimerWheel {
+ public:
+  static constexpr absl::Duration kDefaultTick = absl::Milliseconds(1);
+
+  explicit TimerWheel(absl::Duration tick = kDefaultTick);
+  ~TimerWheel();
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+
+  // Runs |runnable| on the timer thread once |delay| has passed, unless the
+  // returned Cancelable is canceled first.
+  std::shared_ptr<api::Cancelable> Schedule(Runnable&& runnable,
+                                            absl::Duration delay);
+
+  // Returns the number of timers that are scheduled and not yet run; this
+  // includes canceled timers that were not dropped yet.
+  size_t PendingCount() const;
+
+ private:
+  class Timer;
+
+  static constexpr int kSlotBits = 6;
+  static constexpr int kSlots = 1 << kSlotBits;
+  static constexpr std::uint64_t kSlotMask = kSlots - 1;
+  static constexpr int kLevels = 4;
+  // Delays of this many ticks or more do not fit in the wheel; such timers
+  // are parked in the last slot in range, and re-inserted when it comes up.
+  static constexpr std::uint64_t kMaxDelayTicks = std::uint64_t{1}
+                                                  << (kSlotBits * kLevels);
+
+  using Slot = std::vector<std::shared_ptr<Timer>>;
+
+  std::uint64_t TicksSinceStart(absl::Time time) const;
+  void InsertLocked(std::shared_ptr<Timer> timer)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Collects the timers of every tick up to and including |now_tick| into
+  // |expired|, moving next_tick_ past |now_tick|.
+  void AdvanceLocked(std::uint64_t now_tick, Slot* expired)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Re-inserts the timers of a slot of a higher level, now that they are
+  // closer to expiring. Returns the index of that slot.
+  int CascadeLocked(int level) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Returns the next tick at which the timer thread has to wake up.
+  std::uint64_t NextWakeTickLocked() const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void Loop();
+
+  const absl::Duration tick_;
+  const absl::Time start_;
+
+  mutable absl::Mutex mutex_;
+  absl::CondVar cond_;
+  bool shutdown_ ABSL_GUARDED_BY(mutex_) = false;
+  // The next tick whose timers are to be collected.
+  std::uint64_t next_tick_ ABSL_GUARDED_BY(mutex_) = 0;
+  // The tick the timer thread is sleeping until, if it is sleeping.
+  std::uint64_t wake_tick_ ABSL_GUARDED_BY(mutex_) = 0;
+  size_t pending_ ABSL_GUARDED_BY(mutex_) = 0;
+  std::array<std::array<Slot, kSlots>, kLevels> ABSL_GUARDED_BY(mutex_)
+      wheel_;
+
+  std::thread thread_;
+};
+
+}  // namespace shared
+}  // namespace nearby
+}  // namespace location
+
+#endif  // PLATFORM_IMPL_SHARED_TIMER_WHEEL_H_
@@ -0,0 +1,175 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "platform/impl/shared/timer_wheel.h"
+
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace location {
+namespace nearby {
+namespace shared {
+namespace {
+
+TEST(TimerWheelTest, RunsTaskAfterDelay) {
+  TimerWheel timer_wheel;
+  absl::Mutex mutex;
+  absl::Time run_time = absl::InfinitePast();
+  absl::Time start_time = absl::Now();
+
+  timer_wheel.Schedule(
+      [&]() {
+        absl::MutexLock lock(&mutex);
+        run_time = absl::Now();
+      },
+      absl::Milliseconds(50));
+
+  absl::MutexLock lock(&mutex);
+  EXPECT_TRUE(mutex.AwaitWithTimeout(
+      absl::Condition(
+          +[](absl::Time* time) { return *time != absl::InfinitePast(); },
+          &run_time),
+      absl::Seconds(5)));
+  EXPECT_GE(run_time - start_time, absl::Milliseconds(50));
+}
+
+TEST(TimerWheelTest, RunsTasksInDeadlineOrder) {
+  // A coarse tick, so that the delays land on different levels of the wheel.
+  TimerWheel timer_wheel(absl::Microseconds(100));
+  absl::Mutex mutex;
+  std::vector<int> order;
+
+  for (int delay_millis : {300, 5, 80, 30}) {
+    timer_wheel.Schedule(
+        [&, delay_millis]() {
+          absl::MutexLock lock(&mutex);
+          order.push_back(delay_millis);
+        },
+        absl::Milliseconds(delay_millis));
+  }
+
+  absl::MutexLock lock(&mutex);
+  EXPECT_TRUE(mutex.AwaitWithTimeout(
+      absl::Condition(
+          +[](std::vector<int>* order) { return order->size() == 4; }, &order),
+      absl::Seconds(5)));
+  EXPECT_EQ(order, (std::vector<int>{5, 30, 80, 300}));
+}
+
+TEST(TimerWheelTest, CanceledTaskDoesNotRun) {
+  TimerWheel timer_wheel;
+  absl::Mutex mutex;
+  bool canceled_ran = false;
+  bool other_ran = false;
+
+  std::shared_ptr<api::Cancelable> canceled = timer_wheel.Schedule(
+      [&]() {
+        absl::MutexLock lock(&mutex);
+        canceled_ran = true;
+      },
+      absl::Milliseconds(10));
+  timer_wheel.Schedule(
+      [&]() {
+        absl::MutexLock lock(&mutex);
+        other_ran = true;
+      },
+      absl::Milliseconds(30));
+  EXPECT_TRUE(canceled->Cancel());
+  EXPECT_FALSE(canceled->Cancel());
+
+  absl::MutexLock lock(&mutex);
+  EXPECT_TRUE(mutex.AwaitWithTimeout(absl::Condition(&other_ran),
+                                     absl::Seconds(5)));
+  EXPECT_FALSE(canceled_ran);
+}
+
+TEST(TimerWheelTest, CancelAfterRunFails) {
+  TimerWheel timer_wheel;
+  absl::Mutex mutex;
+  bool ran = false;
+
+  std::shared_ptr<api::Cancelable> timer = timer_wheel.Schedule(
+      [&]() {
+        absl::MutexLock lock(&mutex);
+        ran = true;
+      },
+      absl::ZeroDuration());
+
+  {
+    absl::MutexLock lock(&mutex);
+    EXPECT_TRUE(
+        mutex.AwaitWithTimeout(absl::Condition(&ran), absl::Seconds(5)));
+  }
+  EXPECT_FALSE(timer->Cancel());
+}
+
+TEST(TimerWheelTest, CancelFreesTask) {
+  TimerWheel timer_wheel;
+  auto task_state = std::make_shared<int>(0);
+
+  std::shared_ptr<api::Cancelable> timer =
+      timer_wheel.Schedule([task_state]() {}, absl::Hours(1));
+  EXPECT_EQ(task_state.use_count(), 2);
+
+  EXPECT_TRUE(timer->Cancel());
+  EXPECT_EQ(task_state.use_count(), 1);
+}
+
+TEST(TimerWheelTest, ManyTimersAllRunOnce) {
+  constexpr int kTimers = 10000;
+  TimerWheel timer_wheel;
+  absl::Mutex mutex;
+  int runs = 0;
+  std::vector<std::shared_ptr<api::Cancelable>> timers;
+
+  for (int i = 0; i < kTimers; ++i) {
+    timers.push_back(timer_wheel.Schedule(
+        [&]() {
+          absl::MutexLock lock(&mutex);
+          ++runs;
+        },
+        absl::Milliseconds(i % 200)));
+  }
+  // Cancel every other timer.
+  int canceled = 0;
+  for (int i = 0; i < kTimers; i += 2) {
+    if (timers[i]->Cancel()) ++canceled;
+  }
+
+  absl::MutexLock lock(&mutex);
+  auto all_ran = [&]() { return runs + canceled == kTimers; };
+  EXPECT_TRUE(mutex.AwaitWithTimeout(absl::Condition(&all_ran),
+                                     absl::Seconds(5)));
+  EXPECT_EQ(runs + canceled, kTimers);
+}
+
+TEST(TimerWheelTest, LongDelayIsPending) {
+  TimerWheel timer_wheel;
+
+  std::shared_ptr<api::Cancelable> timer =
+      timer_wheel.Schedule([]() {}, absl::Hours(24 * 365));
+
+  EXPECT_EQ(timer_wheel.PendingCount(), 1);
+  EXPECT_TRUE(timer->Cancel());
+}
+
+}  // namespace
+}  // namespace shared
+}  // namespace nearby
+}  // namespace location
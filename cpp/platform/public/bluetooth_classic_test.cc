@@ -15,6 +15,7 @@
 #include "platform/public/bluetooth_classic.h"
 
 #include <memory>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -260,6 +261,33 @@ TEST_F(BluetoothClassicMediumTest, CanStopDiscovery) {
   EXPECT_FALSE(lost_latch.Await(absl::Milliseconds(1000)).result());
 }
 
+TEST_F(BluetoothClassicMediumTest, CanRegisterMediumsWhileDiscoveryIsPending) {
+  constexpr int kMediumCount = 64;
+  // Adapters are created up front, because changing the state of one waits
+  // for the medium environment.
+  std::vector<std::unique_ptr<BluetoothAdapter>> adapters;
+  for (int i = 0; i < kMediumCount; i++) {
+    adapters.push_back(std::make_unique<BluetoothAdapter>());
+  }
+  adapter_a_->SetScanMode(BluetoothAdapter::ScanMode::kConnectable);
+  adapter_b_->SetScanMode(BluetoothAdapter::ScanMode::kConnectableDiscoverable);
+  CountDownLatch found_latch(1);
+  bt_a_->StartDiscovery(DiscoveryCallback{
+      .device_discovered_cb =
+          [this, &found_latch](BluetoothDevice& device) {
+            EXPECT_EQ(device.GetName(), adapter_b_->GetName());
+            found_latch.CountDown();
+          },
+  });
+  // Registered while the discovery of Device-B is queued for bt_a_.
+  std::vector<std::unique_ptr<BluetoothClassicMedium>> mediums;
+  for (auto& adapter : adapters) {
+    mediums.push_back(std::make_unique<BluetoothClassicMedium>(*adapter));
+  }
+  EXPECT_TRUE(found_latch.Await(absl::Milliseconds(1000)).result());
+  env_.Sync();
+}
+
 TEST_F(BluetoothClassicMediumTest, CanListenForService) {
   adapter_a_->SetScanMode(BluetoothAdapter::ScanMode::kConnectable);
   CountDownLatch found_latch(1);
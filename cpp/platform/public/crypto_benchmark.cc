@@ -0,0 +1,51 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Hashing throughput, from service ids up to 1 MB payload chunks.
+//
+// Run with:
+//   blaze run -c opt //platform/public:crypto_benchmark -- \
+//     --benchmark_filter=all
+
+#include <cstdint>
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "platform/base/allocation_counter.h"
+#include "platform/base/byte_array.h"
+#include "platform/public/crypto.h"
+
+namespace location {
+namespace nearby {
+namespace {
+
+constexpr std::int64_t kMinSize = 32;
+constexpr std::int64_t kMaxSize = 1 << 20;
+
+void BM_Sha256(benchmark::State& state) {
+  Crypto::Init();
+  std::string input(state.range(0), 'i');
+  AllocationCounter counter;
+  for (auto _ : state) {
+    ByteArray hash = Crypto::Sha256(input);
+    benchmark::DoNotOptimize(hash.data());
+  }
+  SetAllocationCounters(state, counter);
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Sha256)->RangeMultiplier(8)->Range(kMinSize, kMaxSize);
+
+}  // namespace
+}  // namespace nearby
+}  // namespace location
@@ -15,7 +15,6 @@
 #include "platform/public/monitored_runnable.h"
 
 #include "platform/public/logging.h"
-#include "platform/public/pending_job_registry.h"
 
 namespace location {
 namespace nearby {
@@ -30,8 +29,9 @@ MonitoredRunnable::MonitoredRunnable(Runnable&& runnable)
 
 MonitoredRunnable::MonitoredRunnable(const std::string& name,
                                      Runnable&& runnable)
-    : name_{name}, runnable_{runnable} {
-  PendingJobRegistry::GetInstance().AddPendingJob(name_, post_time_);
+    : name_{PendingJobRegistry::GetInstance().InternName(name)},
+      runnable_{runnable} {
+  job_id_ = PendingJobRegistry::GetInstance().AddPendingJob(name_, post_time_);
 }
 
 MonitoredRunnable::~MonitoredRunnable() = default;
@@ -40,19 +40,28 @@ void MonitoredRunnable::operator()() const {
   auto start_time = SystemClock::ElapsedRealtime();
   auto start_delay = start_time - post_time_;
   if (start_delay >= kMinReportedStartDelay) {
-    NEARBY_LOGS(INFO) << "Task: \"" << name_ << "\" started after "
+    NEARBY_LOGS(INFO) << "Task: \"" << GetName() << "\" started after "
                       << absl::ToInt64Seconds(start_delay) << " seconds";
   }
-  PendingJobRegistry::GetInstance().RemovePendingJob(name_, post_time_);
-  PendingJobRegistry::GetInstance().AddRunningJob(name_, post_time_);
+  PendingJobRegistry& registry = PendingJobRegistry::GetInstance();
+  if (job_id_ != PendingJobRegistry::kInvalidJobId) {
+    registry.AddRunningJob(job_id_, start_time);
+  }
   runnable_();
   auto task_duration = SystemClock::ElapsedRealtime() - start_time;
   if (task_duration >= kMinReportedTaskDuration) {
-    NEARBY_LOGS(INFO) << "Task: \"" << name_ << "\" finished after "
+    NEARBY_LOGS(INFO) << "Task: \"" << GetName() << "\" finished after "
                       << absl::ToInt64Seconds(task_duration) << " seconds";
   }
-  PendingJobRegistry::GetInstance().RemoveRunningJob(name_, post_time_);
-  PendingJobRegistry::GetInstance().ListJobs();
+  if (job_id_ != PendingJobRegistry::kInvalidJobId) {
+    registry.RemoveRunningJob(job_id_);
+  }
+  registry.ListJobs();
+}
+
+const std::string& MonitoredRunnable::GetName() const {
+  static const std::string* const kNoName = new std::string();
+  return name_ != nullptr ? *name_ : *kNoName;
 }
 
 }  // namespace nearby
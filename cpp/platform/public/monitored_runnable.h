@@ -19,6 +19,7 @@
 
 #include "absl/time/time.h"
 #include "platform/base/runnable.h"
+#include "platform/public/pending_job_registry.h"
 #include "platform/public/system_clock.h"
 
 namespace location {
@@ -28,6 +29,7 @@ namespace nearby {
 // We log if the task has been waiting long on the executor or if it was running
 // for a long time. The latter isn't always an issue - some tasks are expected
 // to run for longer periods of time (minutes).
+// Named runnables are also tracked in the PendingJobRegistry until they finish.
 class MonitoredRunnable {
  public:
   explicit MonitoredRunnable(Runnable&& runnable);
@@ -37,9 +39,13 @@ class MonitoredRunnable {
   void operator()() const;
 
  private:
-  const std::string name_;
+  const std::string& GetName() const;
+
+  // Interned by PendingJobRegistry; null for an unnamed runnable.
+  const std::string* name_ = nullptr;
   Runnable runnable_;
   absl::Time post_time_ = SystemClock::ElapsedRealtime();
+  PendingJobRegistry::JobId job_id_ = PendingJobRegistry::kInvalidJobId;
 };
 
 }  // namespace nearby
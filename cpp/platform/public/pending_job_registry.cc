@@ -14,6 +14,8 @@
 
 #include "platform/public/pending_job_registry.h"
 
+#include "absl/strings/string_view.h"
+
 #include "platform/public/logging.h"
 #include "platform/public/mutex_lock.h"
 #include "platform/public/system_clock.h"
@@ -36,55 +38,71 @@ PendingJobRegistry::PendingJobRegistry() = default;
 
 PendingJobRegistry::~PendingJobRegistry() = default;
 
-void PendingJobRegistry::AddPendingJob(const std::string& name,
-                                       absl::Time post_time) {
-  MutexLock lock(&mutex_);
-  pending_jobs_.emplace(CreateKey(name, post_time), post_time);
+const std::string* PendingJobRegistry::InternName(const std::string& name) {
+  thread_local absl::flat_hash_map<absl::string_view, const std::string*>
+      cached_names;
+  auto it = cached_names.find(name);
+  if (it != cached_names.end()) return it->second;
+
+  const std::string* interned_name;
+  {
+    MutexLock lock(&names_mutex_);
+    interned_name = &*names_.insert(name).first;
+  }
+  cached_names.emplace(*interned_name, interned_name);
+  return interned_name;
 }
 
-void PendingJobRegistry::RemovePendingJob(const std::string& name,
-                                          absl::Time post_time) {
-  MutexLock lock(&mutex_);
-  pending_jobs_.erase(CreateKey(name, post_time));
+PendingJobRegistry::JobId PendingJobRegistry::AddPendingJob(
+    const std::string* name, absl::Time post_time) {
+  JobId id = next_job_id_.fetch_add(1, std::memory_order_relaxed);
+  Shard& shard = GetShard(id);
+  MutexLock lock(&shard.mutex);
+  shard.jobs.emplace(id, Job{name, post_time});
+  return id;
 }
 
-void PendingJobRegistry::AddRunningJob(const std::string& name,
-                                       absl::Time post_time) {
-  MutexLock lock(&mutex_);
-  running_jobs_.emplace(CreateKey(name, post_time),
-                        SystemClock::ElapsedRealtime());
+void PendingJobRegistry::AddRunningJob(JobId id, absl::Time start_time) {
+  Shard& shard = GetShard(id);
+  MutexLock lock(&shard.mutex);
+  auto it = shard.jobs.find(id);
+  if (it == shard.jobs.end()) return;
+  it->second.time = start_time;
+  it->second.running = true;
 }
 
-void PendingJobRegistry::RemoveRunningJob(const std::string& name,
-                                          absl::Time post_time) {
-  MutexLock lock(&mutex_);
-  running_jobs_.erase(CreateKey(name, post_time));
+void PendingJobRegistry::RemoveRunningJob(JobId id) {
+  Shard& shard = GetShard(id);
+  MutexLock lock(&shard.mutex);
+  shard.jobs.erase(id);
 }
 
 void PendingJobRegistry::ListJobs() {
   auto current_time = SystemClock::ElapsedRealtime();
-  MutexLock lock(&mutex_);
-  if (current_time - list_jobs_time_ < kMinReportInterval) return;
-  for (auto& job : pending_jobs_) {
-    auto age = current_time - job.second;
-    if (age >= kReportPendingJobsOlderThan) {
-      NEARBY_LOGS(INFO) << "Task \"" << job.first << "\" is waiting for "
-                        << absl::ToInt64Seconds(age) << " s";
-    }
+  std::int64_t list_jobs_nanos =
+      next_list_jobs_nanos_.load(std::memory_order_relaxed);
+  if (absl::ToUnixNanos(current_time) < list_jobs_nanos) return;
+  // If several threads get here at once, only one of them does the scan.
+  if (!next_list_jobs_nanos_.compare_exchange_strong(
+          list_jobs_nanos,
+          absl::ToUnixNanos(current_time + kMinReportInterval))) {
+    return;
   }
-  for (auto& job : running_jobs_) {
-    auto age = current_time - job.second;
-    if (age >= kReportRunningJobsOlderThan) {
-      NEARBY_LOGS(INFO) << "Task \"" << job.first << "\" is running for "
-                        << absl::ToInt64Seconds(age) << " s";
+  for (auto& shard : shards_) {
+    MutexLock lock(&shard.mutex);
+    for (const auto& item : shard.jobs) {
+      const Job& job = item.second;
+      auto age = current_time - job.time;
+      if (!job.running && age >= kReportPendingJobsOlderThan) {
+        NEARBY_LOGS(INFO) << "Task \"" << *job.name << "\" is waiting for "
+                          << absl::ToInt64Seconds(age) << " s";
+      }
+      if (job.running && age >= kReportRunningJobsOlderThan) {
+        NEARBY_LOGS(INFO) << "Task \"" << *job.name << "\" is running for "
+                          << absl::ToInt64Seconds(age) << " s";
+      }
     }
   }
-  list_jobs_time_ = current_time;
-}
-
-std::string PendingJobRegistry::CreateKey(const std::string& name,
-                                          absl::Time post_time) {
-  return name + "." + std::to_string(absl::ToUnixNanos(post_time));
 }
 
 }  // namespace nearby
@@ -15,7 +15,14 @@
 #ifndef PLATFORM_PUBLIC_PENDING_JOB_REGISTRY_H_
 #define PLATFORM_PUBLIC_PENDING_JOB_REGISTRY_H_
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
 #include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/node_hash_set.h"
 #include "absl/time/time.h"
 #include "platform/public/mutex.h"
 
@@ -24,29 +31,62 @@ namespace nearby {
 
 // A global registry of running tasks. The goal is to help us monitor
 // tasks that are either waiting too long for their turn or they never finish
+//
+// The registry is on the path of every executor task, so it is kept cheap:
+// jobs are spread over kShards independently locked shards by id, job names
+// are interned once and then referred to by pointer, and ListJobs() only
+// scans the registry once per report interval; the other calls are a single
+// atomic load.
 class PendingJobRegistry {
  public:
+  // Identifies a job from AddPendingJob() on. Never kInvalidJobId.
+  using JobId = std::uint64_t;
+  static constexpr JobId kInvalidJobId = 0;
+
   static PendingJobRegistry& GetInstance();
 
   ~PendingJobRegistry();
 
-  void AddPendingJob(const std::string& name, absl::Time post_time);
-  void RemovePendingJob(const std::string& name, absl::Time post_time);
-  void AddRunningJob(const std::string& name, absl::Time post_time);
-  void RemoveRunningJob(const std::string& name, absl::Time post_time);
+  // Returns a copy of |name| that lives as long as the registry. Task names
+  // come from a small fixed set, so each one is only stored once, and
+  // looking up a name seen before by the calling thread takes no lock.
+  const std::string* InternName(const std::string& name);
+
+  // |name| must come from InternName().
+  JobId AddPendingJob(const std::string* name, absl::Time post_time);
+  // Moves a pending job over to the running jobs.
+  void AddRunningJob(JobId id, absl::Time start_time);
+  void RemoveRunningJob(JobId id);
   void ListJobs();
 
  private:
+  static constexpr int kShards = 16;
+
+  struct Job {
+    const std::string* name;
+    // Post time while the job is pending, start time once it is running.
+    absl::Time time;
+    bool running = false;
+  };
+
+  struct Shard {
+    Mutex mutex;
+    absl::flat_hash_map<JobId, Job> jobs ABSL_GUARDED_BY(mutex);
+  };
+
   PendingJobRegistry();
 
-  std::string CreateKey(const std::string& name, absl::Time post_time);
+  Shard& GetShard(JobId id) { return shards_[id % kShards]; }
+
+  std::atomic<JobId> next_job_id_ = kInvalidJobId + 1;
+  std::array<Shard, kShards> shards_;
+
+  Mutex names_mutex_;
+  absl::node_hash_set<std::string> names_ ABSL_GUARDED_BY(names_mutex_);
 
-  Mutex mutex_;
-  absl::flat_hash_map<const std::string, absl::Time> pending_jobs_
-      ABSL_GUARDED_BY(mutex_);
-  absl::flat_hash_map<const std::string, absl::Time> running_jobs_
-      ABSL_GUARDED_BY(mutex_);
-  absl::Time list_jobs_time_ ABSL_GUARDED_BY(mutex_) = absl::UnixEpoch();
+  // When the next ListJobs() call scans the registry, in nanoseconds since
+  // the Unix epoch.
+  std::atomic<std::int64_t> next_list_jobs_nanos_ = 0;
 };
 
 }  // namespace nearby
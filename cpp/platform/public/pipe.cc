@@ -25,10 +25,12 @@ namespace {
 using Platform = api::ImplementationPlatform;
 }
 
-Pipe::Pipe() {
+Pipe::Pipe() : Pipe(0) {}
+
+Pipe::Pipe(size_t capacity, absl::Duration write_timeout) {
   auto mutex = Platform::CreateMutex(api::Mutex::Mode::kRegular);
   auto cond = Platform::CreateConditionVariable(mutex.get());
-  Setup(std::move(mutex), std::move(cond));
+  Setup(std::move(mutex), std::move(cond), capacity, write_timeout);
 }
 
 }  // namespace nearby
@@ -25,6 +25,11 @@ namespace nearby {
 class Pipe final : public BasePipe {
  public:
   Pipe();
+  // Creates a bounded pipe that holds at most |capacity| unread bytes; writes
+  // block while it is full, and fail once they have been blocked for
+  // |write_timeout|. See BasePipe.
+  explicit Pipe(size_t capacity,
+                absl::Duration write_timeout = absl::InfiniteDuration());
   ~Pipe() override = default;
   Pipe(Pipe&&) = delete;
   Pipe& operator=(Pipe&&) = delete;
@@ -0,0 +1,101 @@
+// Copyright 2021 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Writes to and reads from unbounded and bounded pipes, from 32 byte control
+// frames up to 1 MB payload chunks.
+//
+// Run with:
+//   blaze run -c opt //platform/public:pipe_benchmark -- \
+//     --benchmark_filter=all
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "platform/base/allocation_counter.h"
+#include "platform/base/byte_array.h"
+#include "platform/public/pipe.h"
+#include "platform/public/single_thread_executor.h"
+
+namespace location {
+namespace nearby {
+namespace {
+
+constexpr std::int64_t kMinSize = 32;
+constexpr std::int64_t kMaxSize = 1 << 20;
+
+// Reads |size| bytes from |pipe|, in chunks of at most Pipe::kChunkSize like
+// the readers of endpoint channels do.
+bool ReadFully(Pipe& pipe, std::int64_t size) {
+  while (size > 0) {
+    ExceptionOr<ByteArray> read = pipe.GetInputStream().Read(
+        std::min<std::int64_t>(size, Pipe::kChunkSize));
+    if (!read.ok() || read.result().Empty()) return false;
+    size -= read.result().size();
+  }
+  return true;
+}
+
+// Writes and reads a frame at a time, on the same thread.
+void BM_WriteRead(benchmark::State& state) {
+  Pipe pipe;
+  ByteArray frame(std::string(state.range(0), 'b'));
+  AllocationCounter counter;
+  for (auto _ : state) {
+    if (pipe.GetOutputStream().Write(frame).Raised()) {
+      state.SkipWithError("Failed to write");
+      break;
+    }
+    if (!ReadFully(pipe, frame.size())) {
+      state.SkipWithError("Failed to read");
+      break;
+    }
+  }
+  SetAllocationCounters(state, counter);
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_WriteRead)->RangeMultiplier(8)->Range(kMinSize, kMaxSize);
+
+// Reads frames that another thread writes into a pipe with room for one
+// chunk, so that the writer keeps waiting for the reader.
+void BM_WriteReadBounded(benchmark::State& state) {
+  Pipe pipe(Pipe::kChunkSize);
+  ByteArray frame(std::string(state.range(0), 'b'));
+  SingleThreadExecutor writer;
+  writer.Execute([&pipe, &frame, count = state.max_iterations]() {
+    for (benchmark::IterationCount i = 0; i < count; i++) {
+      if (pipe.GetOutputStream().Write(frame).Raised()) break;
+    }
+  });
+  AllocationCounter counter;
+  for (auto _ : state) {
+    if (!ReadFully(pipe, frame.size())) {
+      state.SkipWithError("Failed to read");
+      break;
+    }
+  }
+  SetAllocationCounters(state, counter);
+  // Unblocks the writer, if reading stopped early.
+  pipe.GetInputStream().Close();
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_WriteReadBounded)
+    ->RangeMultiplier(8)
+    ->Range(kMinSize, kMaxSize)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace nearby
+}  // namespace location
@@ -21,6 +21,8 @@
 #include <string>
 
 #include "gtest/gtest.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "platform/base/prng.h"
 #include "platform/base/runnable.h"
 
@@ -119,6 +121,53 @@ TEST(PipeTest, SizedReadLessThanFirstChunkSize) {
   EXPECT_EQ(data_second_part, std::string(second_read_data.result()));
 }
 
+TEST(PipeTest, ReadIntoSpansChunks) {
+  Pipe pipe;
+  InputStream& input_stream{pipe.GetInputStream()};
+  OutputStream& output_stream{pipe.GetOutputStream()};
+
+  EXPECT_TRUE(output_stream.Write(ByteArray(std::string("ABC"))).Ok());
+  EXPECT_TRUE(output_stream.Write(ByteArray(std::string("DEFGH"))).Ok());
+
+  // A read never crosses a chunk boundary, but it does resume exactly where
+  // the previous one left off.
+  char buffer[4];
+  ExceptionOr<size_t> read_size = input_stream.ReadInto(absl::MakeSpan(buffer));
+  EXPECT_TRUE(read_size.ok());
+  EXPECT_EQ(std::string("ABC"), std::string(buffer, read_size.result()));
+
+  read_size = input_stream.ReadInto(absl::MakeSpan(buffer));
+  EXPECT_TRUE(read_size.ok());
+  EXPECT_EQ(std::string("DEFG"), std::string(buffer, read_size.result()));
+
+  ExceptionOr<ByteArray> read_data = input_stream.Read(Pipe::kChunkSize);
+  EXPECT_TRUE(read_data.ok());
+  EXPECT_EQ(std::string("H"), std::string(read_data.result()));
+}
+
+TEST(PipeTest, WriteVIsReadAsSingleChunk) {
+  Pipe pipe;
+  InputStream& input_stream{pipe.GetInputStream()};
+  OutputStream& output_stream{pipe.GetOutputStream()};
+
+  const absl::string_view buffers[] = {"AB", "", "CDE"};
+  EXPECT_TRUE(output_stream.WriteV(buffers).Ok());
+
+  ExceptionOr<ByteArray> read_data = input_stream.Read(Pipe::kChunkSize);
+  EXPECT_TRUE(read_data.ok());
+  EXPECT_EQ(std::string("ABCDE"), std::string(read_data.result()));
+}
+
+TEST(PipeTest, WriteVAfterOutputStreamClosed) {
+  Pipe pipe;
+  OutputStream& output_stream{pipe.GetOutputStream()};
+
+  output_stream.Close();
+
+  const absl::string_view buffers[] = {"AB", "CD"};
+  EXPECT_TRUE(output_stream.WriteV(buffers).Raised(Exception::kIo));
+}
+
 TEST(PipeTest, ReadAfterInputStreamClosed) {
   Pipe pipe;
   InputStream& input_stream{pipe.GetInputStream()};
@@ -242,6 +291,92 @@ TEST(PipeTest, ReadBlockedUntilWrite) {
   reader_thread.Join();
 }
 
+TEST(PipeTest, BoundedPipeReadsAcrossRingBufferEnd) {
+  Pipe pipe(4);
+  InputStream& input_stream{pipe.GetInputStream()};
+  OutputStream& output_stream{pipe.GetOutputStream()};
+
+  EXPECT_TRUE(output_stream.Write(ByteArray(std::string("ABC"))).Ok());
+  ExceptionOr<ByteArray> read_data = input_stream.Read(2);
+  ASSERT_TRUE(read_data.ok());
+  EXPECT_EQ("AB", std::string(read_data.result()));
+
+  // Wraps around the end of the ring buffer.
+  EXPECT_TRUE(output_stream.Write(ByteArray(std::string("DEF"))).Ok());
+  char buffer[Pipe::kChunkSize];
+  ExceptionOr<size_t> read_size = input_stream.ReadInto(absl::MakeSpan(buffer));
+  ASSERT_TRUE(read_size.ok());
+  EXPECT_EQ("CDEF", std::string(buffer, read_size.result()));
+
+  EXPECT_TRUE(output_stream.Close().Ok());
+  read_data = input_stream.Read(Pipe::kChunkSize);
+  ASSERT_TRUE(read_data.ok());
+  EXPECT_TRUE(read_data.result().Empty());
+}
+
+TEST(PipeTest, BoundedPipeBlocksWriterUntilRead) {
+  Pipe pipe(4);
+  InputStream& input_stream{pipe.GetInputStream()};
+  OutputStream& output_stream{pipe.GetOutputStream()};
+  std::atomic_bool write_done = false;
+
+  Thread writer_thread;
+  writer_thread.Start([&output_stream, &write_done]() {
+    EXPECT_TRUE(output_stream.Write(ByteArray(std::string("ABCDEFGHIJ"))).Ok());
+    write_done = true;
+  });
+
+  // The writer can't finish until the reader makes room.
+  absl::SleepFor(absl::Milliseconds(100));
+  EXPECT_FALSE(write_done);
+
+  std::string actual_data;
+  while (actual_data.size() < 10) {
+    ExceptionOr<ByteArray> read_data = input_stream.Read(Pipe::kChunkSize);
+    ASSERT_TRUE(read_data.ok());
+    EXPECT_LE(read_data.result().size(), 4);
+    actual_data += std::string(read_data.result());
+  }
+  writer_thread.Join();
+  EXPECT_TRUE(write_done);
+  EXPECT_EQ("ABCDEFGHIJ", actual_data);
+}
+
+TEST(PipeTest, BoundedPipeCloseUnblocksWriter) {
+  Pipe pipe(4);
+  InputStream& input_stream{pipe.GetInputStream()};
+  OutputStream& output_stream{pipe.GetOutputStream()};
+
+  Thread writer_thread;
+  writer_thread.Start([&output_stream]() {
+    EXPECT_EQ(Exception{Exception::kIo},
+              output_stream.Write(ByteArray(std::string("ABCDEFGH"))));
+  });
+
+  absl::SleepFor(absl::Milliseconds(100));
+  EXPECT_TRUE(input_stream.Close().Ok());
+  writer_thread.Join();
+}
+
+TEST(PipeTest, BoundedPipeWriteTimesOutWhileReaderStalls) {
+  Pipe pipe(4, absl::Milliseconds(100));
+  InputStream& input_stream{pipe.GetInputStream()};
+  OutputStream& output_stream{pipe.GetOutputStream()};
+
+  // Only the part that fits is written.
+  EXPECT_EQ(Exception{Exception::kTimeout},
+            output_stream.Write(ByteArray(std::string("ABCDEFGH"))));
+  ExceptionOr<ByteArray> read_data = input_stream.Read(Pipe::kChunkSize);
+  ASSERT_TRUE(read_data.ok());
+  EXPECT_EQ("ABCD", std::string(read_data.result()));
+
+  // Once the reader has made room, writes go through again.
+  EXPECT_TRUE(output_stream.Write(ByteArray(std::string("IJ"))).Ok());
+  read_data = input_stream.Read(Pipe::kChunkSize);
+  ASSERT_TRUE(read_data.ok());
+  EXPECT_EQ("IJ", std::string(read_data.result()));
+}
+
 TEST(PipeTest, ConcurrentWriteAndRead) {
   class BaseRunnable {
    protected:
@@ -16,6 +16,7 @@
 
 #include <atomic>
 #include <functional>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "absl/synchronization/mutex.h"
@@ -85,6 +86,31 @@ TEST(ScheduledExecutorTest, CanSchedule) {
   EXPECT_EQ(value, 5);
 }
 
+TEST(ScheduledExecutorTest, ScheduleWithoutDelayRunsInOrderWithExecute) {
+  absl::Mutex mutex;
+  std::vector<int> order;
+  CountDownLatch latch(2);
+  {
+    ScheduledExecutor executor;
+    // Not delayed by a timer, so it runs before the task executed after it.
+    executor.Schedule(
+        [&]() {
+          absl::MutexLock lock(&mutex);
+          order.push_back(1);
+          latch.CountDown();
+        },
+        absl::ZeroDuration());
+    executor.Execute([&]() {
+      absl::MutexLock lock(&mutex);
+      order.push_back(2);
+      latch.CountDown();
+    });
+    EXPECT_TRUE(latch.Await(kLongDelay).result());
+  }
+  absl::MutexLock lock(&mutex);
+  EXPECT_EQ(order, std::vector<int>({1, 2}));
+}
+
 TEST(ScheduledExecutorTest, CanCancel) {
   ScheduledExecutor executor;
   std::atomic_int value = 0;